@@ -16,6 +16,7 @@
 #include "ThingSpeak.h"
 #include "camera_api.h"
 #include "app_httpd.h"
+#include "frame_broadcaster.h"
 #include "google_drive.h"
 
 #define BUTTON_PIN  0
@@ -61,6 +62,7 @@ void setup() {
 
   if(cameraSetup()==1){
     Serial.println("Camera setup successful");
+    frameBroadcasterBegin(); // The only caller of esp_camera_fb_get(): the stream and the snapshots share its frames
   } else {
     Serial.println("Error: Check your camera setup");
     return;
@@ -139,8 +141,9 @@ void loop() {
   }
 
   if( camera_shutter_trigger ) {
-    camera_fb_t * fb = NULL;
-    fb = cameraSnapShot(size, quality);
+    // The capture task owns the sensor: set the size and quality, then take a frame captured after the change
+    cameraSetFrame(size, quality);
+    shared_frame_t * fb = frameBroadcasterGetLatest(0);
     if (fb != NULL) {
         #ifdef USE_SD_MMC
         int photo_index = readFileNum(SD_MMC, "/camera");
@@ -154,7 +157,7 @@ void loop() {
 
         String driveResponse;
         bool uploadSuccess = uploadToGoogleDrive(webAppUrl, fb->buf, fb->len, driveResponse);
-        cameraFrameBufferTrash(fb);
+        frameBroadcasterRelease(fb);
         if (uploadSuccess) {
           Serial.println("Image uploaded to Google Drive successfully. URL: " + driveResponse);
           // Upload the URL to ThingSpeak
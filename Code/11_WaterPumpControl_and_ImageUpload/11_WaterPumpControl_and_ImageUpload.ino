@@ -71,6 +71,7 @@
 #include "ThingSpeak.h"
 #include "camera_api.h"
 #include "app_httpd.h"
+#include "frame_broadcaster.h"
 #include "google_drive.h"
 
 // --- Hardware Pin Definitions ---
@@ -153,6 +154,7 @@ void setup() {
 
   if(cameraSetup()==1){
     Serial.println("Camera setup successful");
+    frameBroadcasterBegin(); // The only caller of esp_camera_fb_get(): the stream and the snapshots share its frames
   } else {
     Serial.println("Error: Check your camera setup");
     return;
@@ -338,9 +340,10 @@ void manageWaterPumpCycle(unsigned int onTime, unsigned int soakTime) {
  */
 String imageCaptureGoogleDriveUploadAndGetUrl() {
 
-    camera_fb_t * fb = NULL;
     //assumes default frame size and quality, you can modify the function call to specify them if needed
-    fb = cameraSnapShot();  
+    // The capture task owns the sensor: set the size and quality, then take a frame captured after the change
+    cameraSetFrame();
+    shared_frame_t * fb = frameBroadcasterGetLatest(0);
     if (fb != NULL) {
       #ifdef USE_SD_MMC
       int photo_index = readFileNum(SD_MMC, "/camera");
@@ -354,7 +357,7 @@ String imageCaptureGoogleDriveUploadAndGetUrl() {
 
       String driveResponse;
       bool uploadSuccess = uploadToGoogleDrive(webAppUrl, fb->buf, fb->len, driveResponse);
-      cameraFrameBufferTrash(fb);
+      frameBroadcasterRelease(fb);
       if (uploadSuccess) {
         Serial.println("imageCaptureGoogleDriveUploadAndGetUrl(): " + driveResponse);
         return driveResponse; // Return the URL
@@ -28,6 +28,8 @@
 #include "sdkconfig.h"
 
 #include "Arduino.h"
+#include "frame_broadcaster.h"
+#include <atomic>
 //#include "sd_read_write.h"
 
 #if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
@@ -54,64 +56,17 @@ httpd_handle_t camera_httpd = NULL;
 
 static int button_state = 1;
 
-typedef struct
-{
-    size_t size;  // number of values used for filtering
-    size_t index; // current value index
-    size_t count; // value count
-    int sum;
-    int *values; // array to be filled with values
-} ra_filter_t;
-
-static ra_filter_t ra_filter;
-
-static ra_filter_t *ra_filter_init(ra_filter_t *filter, size_t sample_size)
-{
-    memset(filter, 0, sizeof(ra_filter_t));
-
-    filter->values = (int *)malloc(sample_size * sizeof(int));
-    if (!filter->values)
-    {
-        return NULL;
-    }
-    memset(filter->values, 0, sample_size * sizeof(int));
-
-    filter->size = sample_size;
-    return filter;
-}
-
-static int ra_filter_run(ra_filter_t *filter, int value)
-{
-    if (!filter->values)
-    {
-        return value;
-    }
-    filter->sum -= filter->values[filter->index];
-    filter->values[filter->index] = value;
-    filter->sum += filter->values[filter->index];
-    filter->index++;
-    filter->index = filter->index % filter->size;
-    if (filter->count < filter->size)
-    {
-        filter->count++;
-    }
-    return filter->sum / filter->count;
-}
+static std::atomic<int> stream_clients(0);
 
-static esp_err_t stream_handler(httpd_req_t *req)
+/**
+ * @brief Sends the published frames to one client until it disconnects.
+ * All clients read from the frame broadcaster, so each new client no longer takes frames away from the others.
+ */
+static esp_err_t stream_send_frames(httpd_req_t *req)
 {
-    camera_fb_t *fb = NULL;
-    struct timeval _timestamp;
     esp_err_t res = ESP_OK;
-    size_t _jpg_buf_len = 0;
-    uint8_t *_jpg_buf = NULL;
-    char *part_buf[128];
-
-    static int64_t last_frame = 0;
-    if (!last_frame)
-    {
-        last_frame = esp_timer_get_time();
-    }
+    char part_buf[128];
+    uint32_t last_seq = 0;
 
     res = httpd_resp_set_type(req, _STREAM_CONTENT_TYPE);
     if (res != ESP_OK)
@@ -122,83 +77,88 @@ static esp_err_t stream_handler(httpd_req_t *req)
     httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
     httpd_resp_set_hdr(req, "X-Framerate", "60");
 
+    frameBroadcasterSubscribe();
     while (true)
     {
-        fb = esp_camera_fb_get();
-        if (!fb)
+        // Waits for a newer frame than the last one sent; frames published meanwhile are skipped for this client
+        shared_frame_t *frame = frameBroadcasterWaitNext(last_seq);
+        if (!frame)
         {
             ESP_LOGE(TAG, "Camera capture failed");
             res = ESP_FAIL;
         }
         else
         {
-            _timestamp.tv_sec = fb->timestamp.tv_sec;
-            _timestamp.tv_usec = fb->timestamp.tv_usec;
-            if (fb->format != PIXFORMAT_JPEG)
+            last_seq = frame->seq;
+            res = httpd_resp_send_chunk(req, _STREAM_BOUNDARY, strlen(_STREAM_BOUNDARY));
+            if (res == ESP_OK)
             {
-                bool jpeg_converted = frame2jpg(fb, 80, &_jpg_buf, &_jpg_buf_len);
-                esp_camera_fb_return(fb);
-                fb = NULL;
-                if (!jpeg_converted)
-                {
-                    ESP_LOGE(TAG, "JPEG compression failed");
-                    res = ESP_FAIL;
-                }
+                size_t hlen = snprintf(part_buf, sizeof(part_buf), _STREAM_PART, frame->len,
+                                       (int)frame->timestamp.tv_sec, (int)frame->timestamp.tv_usec);
+                res = httpd_resp_send_chunk(req, part_buf, hlen);
             }
-            else
+            if (res == ESP_OK)
             {
-                _jpg_buf_len = fb->len;
-                _jpg_buf = fb->buf;
+                res = httpd_resp_send_chunk(req, (const char *)frame->buf, frame->len);
             }
-        }
-        if (res == ESP_OK)
-        {
-            res = httpd_resp_send_chunk(req, _STREAM_BOUNDARY, strlen(_STREAM_BOUNDARY));
-        }
-        if (res == ESP_OK)
-        {
-            size_t hlen = snprintf((char *)part_buf, 128, _STREAM_PART, _jpg_buf_len, _timestamp.tv_sec, _timestamp.tv_usec);
-            res = httpd_resp_send_chunk(req, (const char *)part_buf, hlen);
-        }
-        if (res == ESP_OK)
-        {
-            res = httpd_resp_send_chunk(req, (const char *)_jpg_buf, _jpg_buf_len);
-        }
-        if (fb)
-        {
-            esp_camera_fb_return(fb);
-            fb = NULL;
-            _jpg_buf = NULL;
-        }
-        else if (_jpg_buf)
-        {
-            free(_jpg_buf);
-            _jpg_buf = NULL;
+            frameBroadcasterRelease(frame);
         }
         if (res != ESP_OK)
         {
             ESP_LOGI(TAG, "res != ESP_OK : %d , break!", res);
             break;
         }
-        int64_t fr_end = esp_timer_get_time();
-
-        int64_t frame_time = fr_end - last_frame;
-        last_frame = fr_end;
-        frame_time /= 1000;
-        uint32_t avg_frame_time = ra_filter_run(&ra_filter, frame_time);
-        delay(1);
         /*
-        ESP_LOGI(TAG, "MJPG: %uB %ums (%.1ffps), AVG: %ums (%.1ffps)",
-                (uint32_t)(_jpg_buf_len),
-                (uint32_t)frame_time, 1000.0 / (uint32_t)frame_time,
-                avg_frame_time, 1000.0 / avg_frame_time);
+        ESP_LOGI(TAG, "MJPG: client %d, frame %u", httpd_req_to_sockfd(req), last_seq);
         */
     }
+    frameBroadcasterUnsubscribe();
     ESP_LOGI(TAG, "Stream exit!");
-    last_frame = 0;
     return res;
 }
 
+#if STREAM_ASYNC_CLIENTS
+/**
+ * @brief Task serving one stream client, so the stream server can accept the next client at once.
+ */
+static void stream_task(void *arg)
+{
+    httpd_req_t *req = (httpd_req_t *)arg;
+    stream_send_frames(req);
+    httpd_req_async_handler_complete(req);
+    stream_clients--;
+    vTaskDelete(NULL);
+}
+#endif
+
+static esp_err_t stream_handler(httpd_req_t *req)
+{
+#if STREAM_ASYNC_CLIENTS
+    if (stream_clients >= STREAM_MAX_CLIENTS)
+    {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_send(req, "Too many viewers", HTTPD_RESP_USE_STRLEN);
+    }
+    // Hand the request over to its own task and return, the server task is free for the next client
+    httpd_req_t *async_req = NULL;
+    if (httpd_req_async_handler_begin(req, &async_req) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+    stream_clients++;
+    if (xTaskCreatePinnedToCore(stream_task, "stream", STREAM_TASK_STACK, async_req,
+                                STREAM_TASK_PRIORITY, NULL, STREAM_TASK_CORE) != pdPASS)
+    {
+        stream_clients--;
+        httpd_req_async_handler_complete(async_req);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+#else
+    return stream_send_frames(req); // Older ESP-IDF: one client at a time, served in the server task
+#endif
+}
+
 static esp_err_t parse_get(httpd_req_t *req, char **obuf)
 {
     char *buf = NULL;
@@ -267,9 +227,9 @@ static esp_err_t index_handler(httpd_req_t *req)
 static esp_err_t button_handler(httpd_req_t *req)
 {
   esp_err_t err;
-  camera_fb_t * fb = NULL;
-  fb = esp_camera_fb_get();
-  if (!fb)
+  // The frame the viewer is looking at, no need to grab the sensor again
+  shared_frame_t * frame = frameBroadcasterGetLatest();
+  if (!frame)
   {
       ESP_LOGE(TAG, "Camera capture failed");
       err = ESP_FAIL;
@@ -279,9 +239,8 @@ static esp_err_t button_handler(httpd_req_t *req)
     String video = "/video";
     int jpgCount=readFileNum(SD_MMC, video.c_str());
     String path = video + "/" + String(jpgCount) +".jpg";
-    writejpg(SD_MMC, path.c_str(), fb->buf, fb->len);
-    esp_camera_fb_return(fb);
-    fb = NULL;
+    writejpg(SD_MMC, path.c_str(), frame->buf, frame->len);
+    frameBroadcasterRelease(frame);
     err=ESP_OK;
   }
   return err;
@@ -313,8 +272,6 @@ void startCameraServer()
         .user_ctx = NULL}; 
 #endif
 
-    ra_filter_init(&ra_filter, 20);
-
     ESP_LOGI(TAG, "Starting web server on port: '%d'", config.server_port);
     if (httpd_start(&camera_httpd, &config) == ESP_OK)
     {
@@ -327,6 +284,7 @@ void startCameraServer()
 
     config.server_port += 1;
     config.ctrl_port += 1;
+    config.max_open_sockets = STREAM_MAX_CLIENTS + 1; // One more to answer 503 to an extra viewer
     ESP_LOGI(TAG, "Starting stream server on port: '%d'", config.server_port);
     if (httpd_start(&stream_httpd, &config) == ESP_OK)
     {
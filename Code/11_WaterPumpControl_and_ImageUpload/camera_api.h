@@ -58,6 +58,12 @@ int cameraSetup(void);
  */
 camera_fb_t* cameraSnapShot(framesize_t size = DEFAULT_FRAME_SIZE, byte quality = DEFAULT_JPEG_QUALITY);
 
+/**
+ * @brief Sets the frame size and the JPEG quality of the sensor for the next frames, as cameraSnapShot() does,
+ *        without capturing. Used when the frame broadcaster captures the frames.
+ */
+void cameraSetFrame(framesize_t size = DEFAULT_FRAME_SIZE, byte quality = DEFAULT_JPEG_QUALITY);
+
 /**
  * @brief Return the frame buffer back to the driver for reuse
  * @param fb Pointer to the frame buffer to be returned
@@ -0,0 +1,88 @@
+#ifndef FRAME_BROADCASTER_H
+#define FRAME_BROADCASTER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "esp_camera.h"
+
+#define FRAME_BROADCASTER_TASK_STACK    4096
+#define FRAME_BROADCASTER_TASK_PRIORITY 2       // Above loop() and the upload task, it mostly waits for the sensor
+#define FRAME_BROADCASTER_TASK_CORE     0       // loop() runs on core 1
+#define FRAME_SNAPSHOT_MAX_AGE_MS       500     // A published frame younger than this is good enough for a snapshot
+#define FRAME_WAIT_TIMEOUT_MS           2000    // How long a snapshot waits for a fresh frame
+
+/**
+ * @brief A captured JPEG frame shared by all its readers.
+ * The frame is copied out of the camera driver buffer, so holding it never stalls the sensor. It is freed when the last
+ * reader calls frameBroadcasterRelease(). Readers must not modify it.
+ */
+typedef struct {
+  uint8_t* buf;            // JPEG data (PSRAM if available)
+  size_t len;
+  size_t width;
+  size_t height;
+  struct timeval timestamp;
+  uint32_t seq;            // Increases by one per published frame
+  int64_t publishedUs;     // esp_timer_get_time() when the frame was published
+  std::atomic<int> refs;
+} shared_frame_t;
+
+/**
+ * @brief Counters of the broadcaster.
+ * captured      Frames taken from the camera driver.
+ * captureFailed Calls to esp_camera_fb_get() that returned no frame.
+ * subscribers   Stream clients currently subscribed.
+ * framesInUse   Frames allocated (the latest one plus those still held by readers).
+ */
+struct FrameBroadcasterStats {
+  uint32_t captured;
+  uint32_t captureFailed;
+  uint32_t subscribers;
+  uint32_t framesInUse;
+};
+
+/**
+ * @brief Starts the capture task, the only place that calls esp_camera_fb_get(). Call it after cameraSetup().
+ *        The task captures continuously while at least one stream client is subscribed, and one frame on demand otherwise.
+ * @return true if the task was started.
+ */
+bool frameBroadcasterBegin();
+
+/**
+ * @brief Registers a stream client, the capture task runs continuously while there is at least one.
+ */
+void frameBroadcasterSubscribe();
+
+/**
+ * @brief Unregisters a stream client.
+ */
+void frameBroadcasterUnsubscribe();
+
+/**
+ * @brief Waits for a frame newer than the one a client has sent last. A slow client simply gets the latest frame when it
+ *        asks again, the frames in between are skipped for it, so it never holds back the capture task or the other clients.
+ * @param lastSeq The seq of the last frame the caller has sent (any value for the first call).
+ * @param timeoutMs Maximum time to wait.
+ * @return The frame with a reference taken (release it with frameBroadcasterRelease()), or NULL on timeout.
+ */
+shared_frame_t* frameBroadcasterWaitNext(uint32_t lastSeq, uint32_t timeoutMs = FRAME_WAIT_TIMEOUT_MS);
+
+/**
+ * @brief Returns the latest published frame for a snapshot (SD save, upload) without grabbing the sensor again.
+ *        If it is older than maxAgeMs (no stream client is watching), a new frame is captured and returned.
+ * @param maxAgeMs Maximum age of the returned frame in milliseconds.
+ * @return The frame with a reference taken (release it with frameBroadcasterRelease()), or NULL if the capture failed.
+ */
+shared_frame_t* frameBroadcasterGetLatest(uint32_t maxAgeMs = FRAME_SNAPSHOT_MAX_AGE_MS);
+
+/**
+ * @brief Drops a reference to a frame, the last one frees it.
+ */
+void frameBroadcasterRelease(shared_frame_t* frame);
+
+/**
+ * @brief Returns the counters of the broadcaster.
+ */
+FrameBroadcasterStats frameBroadcasterGetStats();
+
+#endif
@@ -4,16 +4,22 @@
  * Based on demo `11_WaterPumpControl_and_ImageDemoUpload.ino`, this sketch is enhanced with an LCD display (LovyanGFX/ST7789) to display the moisture value.
  *
  * High-Level Flow:
- * 1. Periodically read soil moisture sensor.
- * 2. Update LCD with latest moisture value.
- * 3. Capture image, upload to Google Drive, and get URL.
- * 4. Upload both moisture value and image URL to ThingSpeak in a single request.
- * 5. Control water pump using hysteresis and soak cycle.
+ * 1. Periodically read soil moisture sensor (every 5 s with ThingSpeak bulk updates, see thingspeak_batch.cpp).
+ *    The sensor is sampled in the background by the ADC DMA driver and filtered (moisture_adc.cpp), a reading only copies the result.
+ * 2. Update the LCD dashboard: latest moisture value, 24 h moisture graph and system status.
+ * 3. Capture image and queue it for the background upload task (upload_worker.cpp).
+ * 4. The upload task uploads the image to Google Drive, then both moisture value and image URL are sent to ThingSpeak in a single request.
+ *    With useThingSpeakBatch, all readings are buffered and sent in one bulk update per minute instead.
+ *    While WiFi is down, the jobs are spooled on the SD card (sd_spool.cpp) and replayed with their capture time once WiFi is back.
+ * 5. Control the water pumps using hysteresis and soak cycle, one zone (sensor and pump) per row of wateringZones[],
+ *    with at most maxPumpsAtOnce pumps running at the same time. With wateringMode WATERING_PREDICTIVE, each watering is
+ *    dosed by the soil response learned from the past ones (watering_model.cpp) instead of the fixed pumpOnTime/pumpSoakTime.
  * 6. Blink LEDs to indicate WiFi status.
  *
  * How to use:
  * 1. Set up hardware according to pin definitions in Hardware section below.
- * 2. Calibrate the moisture sensor and update DRY_VALUE and WET_VALUE.
+ * 2. Calibrate the moisture sensor: either update DRY_VALUE and WET_VALUE (two-point, linear), or calibrate on the device with the
+ *    "cal" serial commands (any number of reference points, stored in NVS, see moisture_calibration.cpp and serialCommandPoll()).
  * 3. Update WiFi credentials, ThingSpeak channel info, and Google Apps Script URL.
  * 4. Upload the sketch to your ESP32 and monitor the Serial output for status and debugging.
  *
@@ -34,21 +40,26 @@
  * Libraries & Dependencies:
  * - LovyanGFX (LCD) — install via Arduino Library Manager
  * - ThingSpeak (cloud upload) — install via Arduino Library Manager
- * - ArduinoJson, base64, and custom camera_api.h, google_drive.h, app_httpd.h (see repo or project docs)
+ * - ArduinoJson and custom camera_api.h, google_drive.h, app_httpd.h (see repo or project docs)
  *
  * LCD Integration:
  * - Uses LGFX_ESP32_ST7789.hpp and LGFX_ESP32_ST7789.cpp for display control
  * - Library: LovyanGFX (https://github.com/lovyan03/LovyanGFX)
- * - lcdMoistureUpdate() updates moisture value on LCD
+ * - lcd_dashboard.cpp draws the moisture reading, a 24 h graph and the status; lcdDashboardUpdate() refreshes it every second
  *
  * Author: John Leung
  * Date: February 27, 2026
  *
  * -----------------------------------------------------------------------------
- * Main Loop Tasks:
- * 1. Periodically read moisture sensor, update LCD, capture/upload image, and update ThingSpeak.
- * 2. Manage water pump state machine.
+ * Main Loop Tasks, registered with the cooperative scheduler (task_scheduler.cpp), which runs each at its deadline and
+ * lets the CPU idle in between; "tasks" on the serial monitor prints their execution time and lateness:
+ * 1. Periodically read moisture sensor, add it to the LCD graph, capture/upload image, and update ThingSpeak.
+ * 2. Manage the water pump state machines of the zones.
  * 3. Blink LED for WiFi status.
+ * 4. Log a reading every second on the SD card (sensor_log.cpp), compacted into hourly aggregates.
+ * 5. Serial monitor commands ("bench" runs the SD storage benchmark, "log" prints the hourly history, "cal" calibrates the sensor,
+ *    "model" shows or switches the watering controller, "tasks" prints the scheduler statistics).
+ * 6. Refresh the LCD dashboard every second, only the parts that changed.
  * -----------------------------------------------------------------------------
  * Troubleshooting:
  * - If WiFi does not connect, check credentials and signal strength.
@@ -64,6 +75,19 @@
 #include "camera_api.h"
 #include "app_httpd.h"
 #include "google_drive.h"
+#include "upload_worker.h"
+#include "frame_broadcaster.h"
+#include "metrics.h"
+#include "thingspeak_batch.h"
+#include "water_pump_control.h"
+#include "sd_benchmark.h"
+#include "sensor_log.h"
+#include "lcd_dashboard.h"
+#include "moisture_adc.h"
+#include "moisture_calibration.h"
+#include "watering_model.h"
+#include "task_scheduler.h"
+#include "esp_heap_caps.h"
 #include "LGFX_ESP32_ST7789.hpp"  //new
 
 // --- Hardware Pin Definitions ---
@@ -73,7 +97,8 @@
 #define LED_BLUE_PIN      42
 
 // --- Sensor Calibration ---
-// Replace these with the values you found in the calibration step
+// Replace these with the values you found in the calibration step. They are only used until a calibration made with the
+// "cal" serial commands is stored in NVS.
 const int DRY_VALUE = 4095; // Raw ADC value for 0% moisture (in air)
 const int WET_VALUE = 1300; // Raw ADC value for 100% moisture (in water)
 
@@ -89,20 +114,35 @@ const unsigned int moistureFieldNumber = 1;          // Field number for moistur
 
 const uint8_t urlFieldNumber = 2; // Field number to upload the URL to
 
+// true: buffer every reading and send them with one ThingSpeak bulk update per flush interval (thingspeak_batch.cpp)
+// false: one ThingSpeak.writeFields() per image, at most every 15 seconds
+const bool useThingSpeakBatch = true;
+const uint16_t thingspeakBatchSize = 60;            // Readings per bulk update
+const uint32_t thingspeakFlushInterval = 60000;     // One bulk update per minute
+
 // Replace with your Google Apps Script Web App URL
 const String webAppUrl = "https://script.google.com/macros/s/YOUR_DEPLOYMENT_ID/exec"; 
+// DRIVE_UPLOAD_BASE64 sends the original base64 text that the Apps Script of docs/4.3 decodes. DRIVE_UPLOAD_BINARY (needs
+// DRIVE_UPLOAD_MULTIPART in google_drive.h) sends the raw JPEG bytes as multipart/form-data, only for an endpoint that reads
+// them as bytes (e.g. Code/tools/apps_script_standin.py)
+const DriveUploadMode driveUploadMode = DRIVE_UPLOAD_BASE64;
 
 // --- Global Variables ---
 WiFiClient thingspeakClient;
 
 // --- Timing Control (Non-Blocking) ---
-// Used to track time for various tasks without using delay()
-unsigned long previousSensorReadMillis = 0;
-unsigned long previousLedBlinkyMillis = 0;
+// The tasks of loop() are run by the scheduler (task_scheduler.cpp) at these intervals, without using delay()
+unsigned long previousImageCaptureMillis = 0;
+uint8_t lastMoistureValue = DASHBOARD_MOISTURE_NONE; // Shown on the LCD dashboard
 
 // Set the intervals for how often tasks should run (in milliseconds)
-const long sensorReadInterval = 30000;        // Read sensor every 30 seconds
+const long sensorReadInterval = useThingSpeakBatch ? 5000 : 30000; // Read sensor every 5 seconds (batched) or 30 seconds
+const long imageCaptureInterval = 30000;      // Capture and upload an image every 30 seconds
 const long ledBlinkyInterval = 1000;          // led blinks in 1 second, with "red led => no wifi", "blue led => good wifi"
+const long sensorLogInterval = 1000;          // A reading in the SD card sensor log (sensor_log.cpp) every second
+const long dashboardInterval = 1000;          // LCD dashboard refresh (pump state, WiFi, queue, heap)
+const long pumpReportInterval = 100;          // Report of the pump state changes (the relays have their own timers)
+const long serialPollInterval = 50;           // Serial monitor commands
 
 // Pump turn-on time and soak time - need tuning for your own case
 const unsigned int pumpOnTime = 1000;     // Pump ON time in milliseconds (1 second)
@@ -111,20 +151,42 @@ const unsigned int pumpSoakTime = 20000;  // Soak time in milliseconds (20 secon
 const unsigned int upperMoistureThreshold = 35; // Upper threshold in %
 const unsigned int lowerMoistureThreshold = 30; // Lower threshold in %
 
+// Watering zones: one pot or tray per row, with its own pump relay, and its moisture sensor at the same index of
+// sensorPins[] (ADC1 pins, GPIO 1-10). Zone 0 is the one shown on the LCD, logged on the SD card and sent to ThingSpeak.
+const uint8_t sensorPins[] = {SENSOR_PIN};
+const pump_zone_t wateringZones[] = {
+  // relay pin,    lower %,                upper %,                pump ON ms, soak ms
+  {PUMP_RELAY_PIN, lowerMoistureThreshold, upperMoistureThreshold, pumpOnTime, pumpSoakTime},
+};
+const uint8_t zoneCount = sizeof(wateringZones) / sizeof(wateringZones[0]);
+const uint8_t maxPumpsAtOnce = 1; // Pumps allowed to run at the same time (power supply, water pressure)
+static_assert(sizeof(sensorPins) == zoneCount, "one sensor pin per watering zone");
+// WATERING_HYSTERESIS: the fixed pumpOnTime and pumpSoakTime above. WATERING_PREDICTIVE: once 3 waterings are learned,
+// the dose that brings the zone to the middle of its band, then a soak time as long as the soil takes to settle.
+// The model learns in both modes; "model predictive" or "model hysteresis" on the serial monitor switches at run time.
+const WateringMode wateringMode = WATERING_HYSTERESIS;
+
+// SD storage benchmark (sd_benchmark.cpp): at boot, with every SD_MMC clock of SD_BENCH_FREQUENCIES (a few minutes),
+// or at any time at the current clock with "bench" or "bench json" on the serial monitor, or http://<board>/bench?format=json
+const bool sdBenchmarkAtBoot = false;
+const SdBenchFormat sdBenchmarkBootFormat = SD_BENCH_CSV;
+
 // --- Function Prototypes ---
 void connectWiFi();
 uint8_t readMoisture();
-void thingspeakChannelsUpdateWithUrl(uint8_t moistureValue, const String& imageUrl);
+uint8_t moisturePercent(int rawValue);
+void logSensorReading();
+bool printSensorLogHour(const sensor_log_hour_t &hour, void *arg);
+bool thingspeakChannelsUpdateWithUrl(uint8_t moistureValue, const String& imageUrl, uint32_t timestamp);
+bool thingspeakBatchPublish(uint8_t moistureValue, const String& imageUrl, uint32_t timestamp);
 void ledBlinky();
-String imageCaptureGoogleDriveUploadAndGetUrl();
-void startWaterPumpCycle();
-void manageWaterPumpCycle(unsigned int onTime, unsigned int soakTime);
-void lcdMoistureUpdate(uint8_t moistureValue);
-
-// --- Add these new global variables ---
-enum PumpState { IDLE, WATERING, SOAKING };
-PumpState currentPumpState = IDLE;
-unsigned long pumpStateChangeMillis = 0; // Tracks time for the current state
+void imageCaptureAndQueueUpload(uint8_t moistureValue);
+void lcdDashboardUpdate();
+void serialCommandPoll();
+void sensorReadTask(void *arg);
+void calibrationCommand(const String& args);
+void wateringModelCommand(const String& args);
+bool seedWateringModel(const sensor_log_hour_t &hour, void *arg);
 
 // ==============================================================================
 // SETUP: Runs once when the Arduino starts up
@@ -133,24 +195,36 @@ void setup() {
   Serial.begin(SERIAL_MON_BAUDRATE);
   delay(500); //a short delay to let Serial port settle
     
-  pinMode(PUMP_RELAY_PIN, OUTPUT);
+  pumpZonesBegin(wateringZones, zoneCount, maxPumpsAtOnce); // Ensures the pumps are OFF by default
+  wateringModelBegin(wateringZones, zoneCount, wateringMode);
+  pumpZonesSetDoseFunction(wateringModelDose); // Every watering goes through the model, which learns from it
   pinMode(LED_RED_PIN, OUTPUT);
   pinMode(LED_BLUE_PIN, OUTPUT);
-  digitalWrite(PUMP_RELAY_PIN, LOW); // Ensure pump is OFF by default
   digitalWrite(LED_RED_PIN, LOW); //turn off RED and BLUE LEDs to start with
   digitalWrite(LED_BLUE_PIN, LOW);
+  moistureAdcBegin(sensorPins, zoneCount); // Bursts of DMA samples, median and IIR filtered; no analogRead() of the sensor afterwards
+  moistureCalibrationBegin(DRY_VALUE, WET_VALUE); // The lookup table stored in NVS, or the two-point default
 
 #ifdef USE_SD_MMC
   sdmmcInit();
+  // Staged JPEG writes through a 32 KB internal-RAM buffer, synced before close; SD_WRITE_DIRECT is the original path, to compare MB/s
+  sdWriteConfigure(SD_WRITE_STAGED, SD_SYNC_ON_CLOSE, 32 * 1024);
+  if (sdBenchmarkAtBoot) {
+    sdBenchmarkRunFrequencies(Serial, sdBenchmarkBootFormat); // Before any other task opens a file on the card
+  }
   createDir(SD_MMC, "/camera");
-  listDir(SD_MMC, "/camera", 0);
+  listDir(SD_MMC, "/camera", 2); // Years, months and days; the images are in the day folders
+  sensorLogBegin(SD_MMC);
+  sensorLogScanHours(0, UINT32_MAX, seedWateringModel, NULL); // The drying rate of zone 0 from the logged history
 #endif
 
-  if(cameraSetup()==1){
+  // Without a camera the plant is still watered and the readings still published, only the images are missing
+  bool cameraReady = cameraSetup() == 1;
+  if(cameraReady){
     Serial.println("Camera setup successful");
+    frameBroadcasterBegin(); // The only caller of esp_camera_fb_get(): stream, SD button and uploads share its frames
   } else {
     Serial.println("Error: Check your camera setup");
-    return;
   }
 
   // --- new code to initialize the LCD and show a startup screen ---
@@ -160,60 +234,93 @@ void setup() {
   spritePrintf(10, 40, 0xFFFF00, "System initializing...");
 
   connectWiFi();
+  configTime(0, 0, "pool.ntp.org", "time.google.com"); // UTC clock for the capture time of spooled jobs, set once WiFi is up
   delay(500); //a short delay to allow WiFi connection
   if (WiFi.status() != WL_CONNECTED) {
     Serial.println("******************************************************");
     Serial.println("ERROR: ESP32 is not connected to the WiFi router");
     Serial.println(" - The program will continue to run without WiFi.");
     Serial.println("******************************************************");
+  } else if (!cameraReady) {
+    Serial.println("WiFi is connected, the camera server is not started.");
   } else {
     Serial.println("WiFi is connected.");
     startCameraServer();
     Serial.print("Camera Ready! Use 'http://");
     Serial.print(WiFi.localIP());
-    Serial.println("' to connect");
+    Serial.println("' to connect, 'http://<same address>/metrics' for the performance counters");
   }
 
   ThingSpeak.begin(thingspeakClient); // Initialize ThingSpeak client
+
+  googleDriveSetUploadMode(driveUploadMode);
+  uploadWorkerSetWiFiReconnect(connectWiFi); // WiFi.begin() blocks, so the upload task reconnects rather than loop()
+  // Google Drive and ThingSpeak uploads run in their own task, the URL comes back through the callback
+  if (useThingSpeakBatch) {
+    thingspeakBatchBegin(myChannelID, writeApiKey, moistureFieldNumber, urlFieldNumber, thingspeakBatchSize, thingspeakFlushInterval);
+    uploadWorkerBegin(webAppUrl, thingspeakBatchPublish, 0); // Buffering only, no need to space the results
+    uploadWorkerSetPublishReady(thingspeakBatchHasRoom); // Spooled jobs wait on the SD card while the buffer is full
+  } else {
+    uploadWorkerBegin(webAppUrl, thingspeakChannelsUpdateWithUrl);
+  }
+  dashboardBegin(lowerMoistureThreshold, upperMoistureThreshold); // Replaces the startup screen
+  lcdDashboardUpdate();
+
+  // The tasks of loop(), each at its interval; the first sensor reading once an interval has passed, as before
+  schedulerBegin();
+  schedulerAdd("sensor_read", sensorReadTask, NULL, sensorReadInterval, sensorReadInterval);
+  schedulerAdd("pump_report", [](void *) { manageWaterPumpCycle(); }, NULL, pumpReportInterval);
+  schedulerAdd("led_blink", [](void *) { ledBlinky(); }, NULL, ledBlinkyInterval);
+  schedulerAdd("sensor_log", [](void *) { logSensorReading(); }, NULL, sensorLogInterval);
+  schedulerAdd("serial_cmd", [](void *) { serialCommandPoll(); }, NULL, serialPollInterval);
+  schedulerAdd("dashboard", [](void *) { lcdDashboardUpdate(); }, NULL, dashboardInterval, dashboardInterval);
 }
 
 // ==============================================================================
 // LOOP: Runs continuously and is kept non-blocking
 // ==============================================================================
 void loop() {
-  // Main loop tasks:
+  // Main loop tasks, run by the scheduler at their deadlines (registered at the end of setup()):
   // 1. Periodically read moisture sensor, update LCD, capture/upload image, and update ThingSpeak.
-  // 2. Manage water pump state machine.
+  // 2. Report the water pump state changes.
   // 3. Blink LED for WiFi status.
+  // 4. Append a reading to the SD card sensor log every second.
+  // 5. Read serial monitor commands.
+  // 6. Refresh the LCD dashboard.
+  // The duration of each pass with work is exported at http://<board>/metrics (metrics.cpp), with the execution time
+  // and lateness of each task. Until the next deadline, loop() sleeps: the idle task runs instead of a polling loop.
+
+  uint32_t loopStartMicros = micros();
+  if (schedulerRun() > 0) {
+    metricsObserve(METRIC_LOOP, micros() - loopStartMicros);
+  }
+  schedulerIdle();
+}
 
+/**
+ * @brief Task 1: reads the moisture sensors, adds zone 0 to the LCD graph and ThingSpeak (with an image every
+ * imageCaptureInterval) and updates the hysteresis of each zone.
+ */
+void sensorReadTask(void *arg) {
   unsigned long currentMillis = millis();
-  uint8_t moistureValue;
-  String imageUrl = "";
-
-  // Task 1: Read the moisture sensor at its specified interval
-  if (currentMillis - previousSensorReadMillis >= sensorReadInterval) {
-    previousSensorReadMillis = currentMillis;
-    moistureValue = readMoisture();
-    lcdMoistureUpdate(moistureValue);
-    if (WiFi.status() != WL_CONNECTED) {
-      connectWiFi();
-    }
-    if (WiFi.status() == WL_CONNECTED) {
-      imageUrl = imageCaptureGoogleDriveUploadAndGetUrl();
-      thingspeakChannelsUpdateWithUrl(moistureValue, imageUrl);
-    }
-    if(moistureValue < lowerMoistureThreshold){
-      startWaterPumpCycle();
-    } else if(moistureValue > upperMoistureThreshold){
-      // Optionally handle overwatering alert/action here.
-    } // else: do nothing, within hysteresis band
+  uint8_t moistureValue = readMoisture();
+  lastMoistureValue = moistureValue;
+  dashboardAddSample(moistureValue);
+  if (currentMillis - previousImageCaptureMillis >= imageCaptureInterval) {
+    previousImageCaptureMillis = currentMillis;
+    // Returns at once, ThingSpeak is updated when the upload is done (or when the upload task has reconnected WiFi)
+    imageCaptureAndQueueUpload(moistureValue);
+  } else if (useThingSpeakBatch) {
+    thingspeakBatchAdd(moistureValue, ""); // A reading without image, sent with the next bulk update
   }
-  // Task 2: Manage the pump state on every single loop iteration
-  manageWaterPumpCycle(pumpOnTime, pumpSoakTime);
-  // Task 3: Blink the LED to give a visual signal in the background.
-  if(currentMillis - previousLedBlinkyMillis >= ledBlinkyInterval){
-    previousLedBlinkyMillis = currentMillis;
-    ledBlinky();
+  // Hysteresis of each zone: a watering is requested below its lower threshold, and waits for a pump if
+  // maxPumpsAtOnce are already running; within the band nothing happens
+  wateringModelAddReading(0, moistureValue);
+  pumpZoneUpdate(0, moistureValue);
+  for (uint8_t zone = 1; zone < zoneCount; zone++) {
+    uint8_t percent = moisturePercent(moistureAdcRead(zone).raw);
+    wateringModelAddReading(zone, percent);
+    pumpZoneUpdate(zone, percent);
   }
 }
 
@@ -224,7 +331,8 @@ void loop() {
 /**
  * @brief Attempts to connect to the Wi-Fi network.
  * NOTE: WiFi.begin() is a BLOCKING call and can take several seconds to
- * execute. During this time, the main loop will be paused.
+ * execute. It is called once by setup(), then by the upload task while WiFi
+ * is down (uploadWorkerSetWiFiReconnect()), so loop() is never paused by it.
  */
 void connectWiFi() {
   Serial.println("Attempting to connect to WiFi (this may block for a few seconds)...");
@@ -237,45 +345,108 @@ void connectWiFi() {
  * @return The current soil moisture percentage (0-100%).
  */
 uint8_t readMoisture() {
-  int rawValue = analogRead(SENSOR_PIN);
-  
-  // Map the raw value to a percentage
-  uint8_t moisturePercent = map(rawValue, DRY_VALUE, WET_VALUE, 0, 100);
-  
-  // Constrain the value to the 0-100 range to prevent invalid readings
-  moisturePercent = constrain(moisturePercent, 0, 100);
+  MoistureReading reading = moistureAdcRead(); // Filtered in the background, a single noisy sample cannot start the pump
+  uint8_t percent = moisturePercent(reading.raw);
 
   Serial.print("Sensor Reading -> Raw: ");
-  Serial.print(rawValue);
+  Serial.print(reading.raw);
+  Serial.print(" (noise ");
+  Serial.print(reading.noise, 1);
+  Serial.print(")");
   Serial.print(", Moisture: ");
-  Serial.print(moisturePercent);
+  Serial.print(percent);
   Serial.println("%");
 
-  return moisturePercent;
+  return percent;
+}
+
+/**
+ * @brief Converts a raw ADC value of the moisture sensor to percent with the calibration table (moisture_calibration.cpp):
+ * the curve through the stored reference points, or the linear DRY_VALUE/WET_VALUE map without a calibration.
+ */
+uint8_t moisturePercent(int rawValue) {
+  return moistureCalibrationPercent(constrain(rawValue, 0, CALIBRATION_LUT_SIZE - 1));
+}
+
+/**
+ * @brief Reads the sensor without printing and appends the reading, the pump state and the WiFi RSSI to the sensor log.
+ * Most appends only copy 16 bytes into the log's sector buffer.
+ */
+void logSensorReading() {
+  int rawValue = moistureAdcRead().raw;
+  time_t now = time(NULL);
+  bool wifiUp = WiFi.status() == WL_CONNECTED;
+  uint8_t flags = (getPumpState() == WATERING ? SENSOR_LOG_FLAG_PUMP : 0) | (wifiUp ? SENSOR_LOG_FLAG_WIFI : 0);
+  sensorLogAppend(now >= (time_t)SENSOR_LOG_CLOCK_VALID ? (uint32_t)now : 0, rawValue, moisturePercent(rawValue), flags,
+                  wifiUp ? WiFi.RSSI() : 0);
+}
+
+/**
+ * @brief Prints one hourly aggregate of the sensor log as a CSV line, for the "log" serial command.
+ */
+bool printSensorLogHour(const sensor_log_hour_t &hour, void *arg) {
+  Serial.printf("%u,%u,%u,%u,%u,%u,%u,%u,%d\n", hour.hour, hour.count, hour.moistureMin, hour.moistureMean,
+                hour.moistureMax, hour.rawMean, hour.pumpOn, hour.wifiOn, hour.rssiMean);
+  return true;
+}
+
+/**
+ * @brief Feeds an hourly aggregate of the sensor log to the watering model of zone 0, the zone the log records.
+ */
+bool seedWateringModel(const sensor_log_hour_t &hour, void *arg) {
+  wateringModelAddHour(0, hour.moistureMean, hour.pumpOn);
+  return true;
 }
 
 /**
  * @brief Uploads the given moisture value and image URL to ThingSpeak in a single upload.
+ * Called from the upload task (see upload_worker.cpp) once the Google Drive upload has finished.
  * @param moistureValue The soil moisture percentage to upload.
  * @param imageUrl The URL of the uploaded image to include in the ThingSpeak upload. This should be URL-encoded if it contains special characters.
+ * @param timestamp The capture time in seconds since the epoch (UTC), sent as the entry's created_at so that readings replayed
+ *                  from the SD card spool keep their time. 0 lets ThingSpeak use the time of arrival.
+ * @return true if ThingSpeak accepted the update.
  */
-void thingspeakChannelsUpdateWithUrl(uint8_t moistureValue, const String& imageUrl) {
+bool thingspeakChannelsUpdateWithUrl(uint8_t moistureValue, const String& imageUrl, uint32_t timestamp) {
 
   Serial.println("Uploading data to ThingSpeak with image URL...");
   ThingSpeak.setField(moistureFieldNumber, moistureValue);
   if(imageUrl != "") {
     ThingSpeak.setField(urlFieldNumber, imageUrl);
   }
+  if(timestamp != 0) {
+    char createdAt[24];
+    time_t t = timestamp;
+    strftime(createdAt, sizeof(createdAt), "%Y-%m-%dT%H:%M:%SZ", gmtime(&t)); // ISO 8601, UTC
+    ThingSpeak.setCreatedAt(createdAt);
+  }
 
+  uint32_t start = micros();
   int httpCode = ThingSpeak.writeFields(myChannelID, writeApiKey);
+  metricsObserve(METRIC_UPLOAD_THINGSPEAK, micros() - start);
+  metricsThingSpeakResponse(httpCode);
 
   if (httpCode == 200) {
     Serial.println("Image URL uploaded to ThingSpeak successfully.");
+    return true;
   } else {
     Serial.println("Failed to upload image URL to ThingSpeak. Response code: " + String(httpCode));
+    return false;
   }
 }
 
+/**
+ * @brief Adds the given moisture value and image URL to the ThingSpeak bulk update buffer (useThingSpeakBatch).
+ * Called from the upload task (see upload_worker.cpp) once the Google Drive upload has finished.
+ * @param moistureValue The soil moisture percentage to upload.
+ * @param imageUrl The URL-encoded URL of the uploaded image, or an empty string.
+ * @param timestamp The capture time in seconds since the epoch (UTC), or 0 for now.
+ * @return true if the reading was buffered.
+ */
+bool thingspeakBatchPublish(uint8_t moistureValue, const String& imageUrl, uint32_t timestamp) {
+  return thingspeakBatchAdd(moistureValue, imageUrl, timestamp);
+}
+
 /**
  * @brief Blinks the LED to indicate WiFi status.
  * Red LED indicates no WiFi connection. Blue LED indicates good WiFi connection.
@@ -292,94 +463,158 @@ void ledBlinky() {
   }
 }
 
-// --- The new function to START the cycle ---
-void startWaterPumpCycle() {
-  // Only start a new cycle if the pump is currently idle
-  if (currentPumpState == IDLE) {
-    currentPumpState = WATERING;
-    pumpStateChangeMillis = millis(); // Record the time we started watering
-    digitalWrite(PUMP_RELAY_PIN, HIGH);
-    Serial.println("Pump cycle started: WATERING");
-  }
+/**
+ * @brief Captures an image using the camera and queues it for the background upload task.
+ * It is called whether WiFi is connected or not: the upload task spools the job on the SD card while WiFi is down.
+ * The frame is shared with the stream viewers, the upload job only takes a reference to it. The upload task saves it to the SD card, uploads it
+ * to Google Drive and then calls thingspeakChannelsUpdateWithUrl() with the moisture value and the URL-encoded image URL,
+ * which is in the format "https://drive.google.com/uc?export=view&id=FILE_ID" before encoding.
+ * @param moistureValue The moisture value to upload to ThingSpeak together with the image URL.
+ */
+void imageCaptureAndQueueUpload(uint8_t moistureValue) {
+
+    // The latest frame published by the frame broadcaster (the one the stream viewers see), or a fresh one if nobody is watching
+    shared_frame_t * frame = frameBroadcasterGetLatest();
+    if (frame != NULL) {
+      if (!uploadWorkerSubmit(frame, moistureValue)) {
+        Serial.println("Image upload could not be queued.");
+      }
+      frameBroadcasterRelease(frame);
+    } else {
+      Serial.println("Camera capture failed.");
+    }
 }
 
 /**
- * @brief Manages the water pump cycle using a state machine.
- * @param onTime Duration for which the pump should be ON (in milliseconds).
- * @param soakTime Duration for which the soil should soak after watering (in milliseconds).
+ * @brief Updates the LCD dashboard (lcd_dashboard.cpp) with the last soil moisture reading and the system status:
+ * pump state, last watering, WiFi RSSI, upload queue depth and free heap. Only the texts that changed are redrawn.
  */
-void manageWaterPumpCycle(unsigned int onTime, unsigned int soakTime) {
-  // This function is a state machine. It does nothing unless a state is active.
-  
-  // State 1: The pump is currently WATERING
-  if (currentPumpState == WATERING) {
-    // Check if the 'onTime' has elapsed
-    if (millis() - pumpStateChangeMillis >= onTime) {
-      // Time to switch to the SOAKING state
-      currentPumpState = SOAKING;
-      pumpStateChangeMillis = millis(); // Record the time we started soaking
-      digitalWrite(PUMP_RELAY_PIN, LOW);
-      Serial.println("Watering finished. Now SOAKING.");
+void lcdDashboardUpdate() {
+  uint32_t start = micros();
+  dashboard_status_t status;
+  status.moisture = lastMoistureValue;
+  status.pump = getPumpState();
+  status.lastWateringMicros = getLastWateringMicros();
+  status.wifiConnected = WiFi.status() == WL_CONNECTED;
+  status.rssi = status.wifiConnected ? WiFi.RSSI() : 0;
+  status.uploadQueue = uploadWorkerQueueDepth();
+  status.spooled = uploadWorkerSpoolDepth();
+  status.freeHeap = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+  dashboardRender(status);
+  metricsObserve(METRIC_LCD_UPDATE, micros() - start);
+}
+
+/**
+ * @brief Reads the serial monitor without blocking and runs a command when a line is complete.
+ * "log" prints the hourly aggregates of the sensor log for the last day.
+ * "cal ..." calibrates the moisture sensor, see calibrationCommand().
+ * "tasks" prints the runs, execution time and lateness of the loop() tasks (task_scheduler.cpp).
+ * "bench" or "bench csv|json" runs the SD storage benchmark at the current clock. It takes a minute or two, during which
+ * loop() is paused; the pump relay is switched by its own timer and the upload task keeps running (and slows the results).
+ */
+void serialCommandPoll() {
+  static String line;
+  while (Serial.available()) {
+    char c = (char)Serial.read();
+    if (c != '\n' && c != '\r') {
+      if (line.length() < 64) {
+        line += c;
+      }
+      continue;
     }
-  }  // State 2: The soil is currently SOAKING
-  else if (currentPumpState == SOAKING) { 
-    // Check if the 'soakTime' has elapsed
-    if (millis() - pumpStateChangeMillis >= soakTime) {
-      // The cycle is complete, return to IDLE
-      currentPumpState = IDLE;
-      Serial.println("Soak time complete. Pump cycle finished.");
+    line.trim();
+    if (line == "bench" || line.startsWith("bench ")) {
+#ifdef USE_SD_MMC
+      String format = line.substring(5);
+      format.trim();
+      sdBenchmarkRun(SD_MMC, Serial, sdBenchmarkParseFormat(format.c_str()), SDMMC_FREQ_DEFAULT);
+#else
+      Serial.println("No SD card (USE_SD_MMC is not defined)");
+#endif
+    } else if (line == "log") {
+      // The last day of hourly aggregates, then the time a whole month takes to scan
+      uint32_t now = (uint32_t)time(NULL);
+      Serial.println("hour,readings,moisture_min,moisture_mean,moisture_max,raw_mean,pump_on,wifi_on,rssi_mean");
+      sensorLogScanHours(now > 86400 ? now - 86400 : 0, UINT32_MAX, printSensorLogHour, NULL);
+      uint32_t start = micros();
+      uint32_t hours = sensorLogScanHours(now > 30 * 86400 ? now - 30 * 86400 : 0, UINT32_MAX,
+                                          [](const sensor_log_hour_t &, void *) { return true; }, NULL);
+      Serial.printf("%u hourly aggregates of the last 30 days scanned in %u us\n", hours, (uint32_t)(micros() - start));
+    } else if (line == "cal" || line.startsWith("cal ")) {
+      String args = line.substring(3);
+      args.trim();
+      calibrationCommand(args);
+    } else if (line == "model" || line.startsWith("model ")) {
+      String args = line.substring(5);
+      args.trim();
+      wateringModelCommand(args);
+    } else if (line == "tasks") {
+      schedulerPrintStats(Serial);
+    } else if (line.length() > 0) {
+      Serial.printf("Unknown command: %s (try \"bench\", \"bench json\", \"log\", \"cal\", \"model\" or \"tasks\")\n", line.c_str());
     }
+    line = "";
   }
 }
 
 /**
- * @brief Captures an image using the camera, uploads it to Google Drive, and returns the URL of the uploaded image.
- * @return A String containing the URL of the uploaded image if successful, or an empty string if the capture or upload fails.
- * The URL will be URL-encoded (e.g., < becomes %3C, > becomes %3E, & becomes %26, = becomes %3D, etc.) to ensure it can be safely transmitted and used in HTTP requests.
- * The URL will be in the format "https://drive.google.com/uc?export=view&id=FILE_ID" which can be directly used to display the image in ThingSpeak or other platforms. 
+ * @brief Runs a "cal" serial command, the on-device calibration of the moisture sensor (moisture_calibration.cpp):
+ * "cal start"     begins a calibration; the table in use stays until "cal save".
+ * "cal <percent>" with the probe in soil of a known moisture (0 in air, 100 in water, weighed samples in between),
+ *                 takes the current filtered reading as the reference point for that percentage.
+ * "cal save"      builds the lookup table from the points, uses it and stores it in NVS (at least 2 points).
+ * "cal reset"     erases the stored calibration, back to DRY_VALUE and WET_VALUE.
+ * "cal"           prints the points in use and the current reading.
  */
-String imageCaptureGoogleDriveUploadAndGetUrl() {
-
-    camera_fb_t * fb = NULL;
-    //assumes default frame size and quality, you can modify the function call to specify them if needed
-    fb = cameraSnapShot();  
-    if (fb != NULL) {
-      #ifdef USE_SD_MMC
-      int photo_index = readFileNum(SD_MMC, "/camera");
-      if(photo_index!=-1)
-      {
-        String filePath = "/camera/" + String(photo_index) +".jpg";
-        writejpg(SD_MMC, filePath.c_str(), fb->buf, fb->len);
-        Serial.printf("Image saved to %s\n", filePath.c_str());
-      }
-      #endif
-
-      String driveResponse;
-      bool uploadSuccess = uploadToGoogleDrive(webAppUrl, fb->buf, fb->len, driveResponse);
-      cameraFrameBufferTrash(fb);
-      if (uploadSuccess) {
-        Serial.println("imageCaptureGoogleDriveUploadAndGetUrl(): " + driveResponse);
-        return driveResponse; // Return the URL
-      } else {
-        Serial.println("Upload to Google Drive failed!");
-        return ""; // Return empty string on failure
-      }
+void calibrationCommand(const String& args) {
+  calibration_point_t points[CALIBRATION_MAX_POINTS];
+  if (args == "start") {
+    moistureCalibrationStart();
+    Serial.println("Calibration started: put the probe in reference soil and enter \"cal <percent>\" for each");
+  } else if (args == "save") {
+    bool saved = moistureCalibrationFinish();
+    uint8_t count = moistureCalibrationGetPoints(points);
+    Serial.printf("Calibration %s (%u points)\n", saved ? "stored in NVS" : "failed: start it and add 2 or more monotone points", count);
+  } else if (args == "reset") {
+    Serial.println(moistureCalibrationReset() ? "Calibration erased, using DRY_VALUE and WET_VALUE" : "Calibration reset failed");
+  } else if (args.length() > 0 && isDigit(args[0])) {
+    MoistureReading reading = moistureAdcRead();
+    long percent = args.toInt();
+    if (moistureCalibrationAddPoint(reading.raw, (uint8_t)constrain(percent, 0L, 255L))) {
+      Serial.printf("Point %ld%% = raw %u (noise %.1f), %u points\n", percent, reading.raw, reading.noise,
+                    moistureCalibrationGetPoints(points, true));
     } else {
-      Serial.println("Camera capture failed.");
-      return ""; // Return empty string on failure
+      Serial.println("Point not added: \"cal start\" first, 0-100%, 8 points at most");
     }
+  } else {
+    uint8_t count = moistureCalibrationGetPoints(points);
+    for (uint8_t i = 0; i < count; i++) {
+      Serial.printf("  raw %u -> %u%%\n", points[i].raw, points[i].percent);
+    }
+    uint16_t raw = moistureAdcRead().raw;
+    Serial.printf("Now: raw %u -> %u%% (commands: cal start, cal <percent>, cal save, cal reset)\n", raw, moisturePercent(raw));
+  }
 }
 
 /**
- * @brief Updates the soil moisture value displayed on the LCD. This function takes the moisture value as a parameter, 
- * allowing it to be called with any moisture value without relying on a global variable. 
- * The LCD will show the text "Moisture:" followed by the percentage value of the soil moisture.
- * @param moistureValue The soil moisture percentage to display on the LCD (0-100%
+ * @brief Runs a "model" serial command, the watering controller (watering_model.cpp):
+ * "model predictive"  doses each watering with the learned model.
+ * "model hysteresis"  back to the fixed pumpOnTime and pumpSoakTime.
+ * "model bench"       times the model's computations on this CPU.
+ * "model"             prints the mode and what each zone has learned.
  */
-void lcdMoistureUpdate(uint8_t moistureValue) {
-  spriteDrawBackground(); // Redraw background to clear previous text
-  spriteSetFont(&fonts::DejaVu24);
-  spritePrintf(40, 40, 0xFFFF00U, "Moisture:"); 
-  spriteSetFont(&fonts::DejaVu40);
-  spritePrintf(40, 80, 0xFFFF00U, "%d%%", moistureValue);
-}
\ No newline at end of file
+void wateringModelCommand(const String& args) {
+  if (args == "predictive" || args == "hysteresis") {
+    wateringModelSetMode(args == "predictive" ? WATERING_PREDICTIVE : WATERING_HYSTERESIS);
+  } else if (args == "bench") {
+    wateringModelBenchmark(Serial);
+    return;
+  }
+  Serial.printf("Watering controller: %s\n", wateringModelGetMode() == WATERING_PREDICTIVE ? "predictive" : "hysteresis");
+  for (uint8_t zone = 0; zone < zoneCount; zone++) {
+    WateringEstimate e = wateringModelGetEstimate(zone);
+    Serial.printf("  zone %u: gain %.2f %%/s, response %.0f s, drying %.2f %%/h, %u waterings learned (%u not), "
+                  "last dose %u ms, last error %+.1f %%\n", zone, e.gain, e.responseS, e.dryingPerHour, e.cycles,
+                  e.discarded, e.lastDoseMs, e.lastError);
+  }
+}
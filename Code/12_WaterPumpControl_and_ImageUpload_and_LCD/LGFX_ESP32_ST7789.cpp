@@ -7,15 +7,21 @@
  * Features:
  * - LCD initialization and rotation
  * - Sprite creation and font management
- * - Custom background and formatted text rendering
+ * - Custom background, rendered once and restored with a block copy, and formatted text rendering
  * - Efficient SPI transaction handling
+ * - Frames: the texts printed between lcdFrameBegin() and lcdFrameEnd() are compared with the ones on screen, only the
+ *   changed ones are redrawn, and only the dirty rectangles go to the panel, by DMA
  *
  * Usage:
  *   #include "LGFX_ESP32_ST7789.hpp"
  *   lcdInit(); // Initialize LCD
  *   spriteSetFont(&fonts::Font0); // Set font
  *   spriteDrawBackground(); // Draw background
- *   spritePrintf(10, 30, 0xFFFF00, "Moisture: %d%%", moistureValue); // Print text
+ *   spritePrintf(10, 30, 0xFFFF00, "Moisture: %d%%", moistureValue); // Print text and push it at once
+ *
+ *   lcdFrameBegin(); // Batch the texts of one update
+ *   spritePrintf(10, 30, 0xFFFF00, "Moisture: %d%%", moistureValue);
+ *   lcdFrameEnd(); // Redraw what changed, push the dirty rectangles
  *
  * Hardware: ESP32 + ST7789 LCD
  * Library: LovyanGFX (https://github.com/lovyan03/LovyanGFX)
@@ -23,9 +29,199 @@
  * Date: February 26, 2026
  */
 #include "LGFX_ESP32_ST7789.hpp"
+#include "esp_heap_caps.h"
+#include "metrics.h"
 
 LGFX_Custom lcd;
 LGFX_Sprite sprite(&lcd);
+static uint16_t* background = NULL; // The gradient in the sprite's pixel format (byte-swapped RGB565), rendered once
+
+typedef struct {
+  int16_t x, y, w, h;
+} lcd_rect_t;
+
+// A text of a frame: what was asked for, and the area it covers once drawn
+typedef struct {
+  int16_t x, y;
+  uint32_t color;
+  const lgfx::IFont* font;
+  char text[LCD_TEXT_LENGTH];
+  lcd_rect_t rect;
+} lcd_text_t;
+
+static lcd_text_t shown[LCD_TEXT_ITEMS];    // Texts on the panel now
+static uint8_t shownCount = 0;
+static lcd_text_t pending[LCD_TEXT_ITEMS];  // Texts of the frame being built
+static uint8_t pendingCount = 0;
+static bool inFrame = false;
+static lcd_rect_t dirty[LCD_DIRTY_RECTS];   // Areas of the sprite that differ from the panel
+static uint8_t dirtyCount = 0;
+static uint16_t* staging[2] = {NULL, NULL}; // DMA buffers: one is filled while the other is sent
+static uint8_t stagingNext = 0;
+static LcdStats lcdStats;
+
+/**
+ * A helper function to render the background gradient once, row by row, in the sprite's own pixel format, so that
+ * spriteDrawBackground() only has to copy it. The buffer is as large as the sprite (110 KB) and goes to PSRAM if there is one.
+ * @return true if the background buffer is ready.
+ */
+static bool backgroundRender() {
+  int32_t w = sprite.width();
+  int32_t h = sprite.height();
+  size_t bytes = (size_t)w * h * sizeof(uint16_t);
+  background = (uint16_t*)(psramFound() ? ps_malloc(bytes) : malloc(bytes));
+  if (background == NULL) {
+    return false;
+  }
+  for (int32_t y = 0; y < h; ++y) {
+    uint16_t* row = background + y * w;
+    for (int32_t x = 0; x < w; ++x) {
+      uint16_t color = lcd.color565(x >> 1, (x + y) >> 2, y >> 1);
+      row[x] = (uint16_t)((color << 8) | (color >> 8));
+    }
+  }
+  return true;
+}
+
+/**
+ * Copies the background into one rectangle of the sprite, clearing what was drawn there.
+ */
+static void backgroundRestore(const lcd_rect_t& r) {
+  sprite.setClipRect(r.x, r.y, r.w, r.h);
+  if (background != NULL) {
+    sprite.pushImage(0, 0, sprite.width(), sprite.height(), (const lgfx::swap565_t*)background); // Only the clip rectangle is copied
+  } else {
+    sprite.fillRect(r.x, r.y, r.w, r.h, 0U);
+  }
+  sprite.clearClipRect();
+}
+
+static int32_t rectArea(const lcd_rect_t& r) {
+  return (int32_t)r.w * r.h;
+}
+
+static lcd_rect_t rectUnion(const lcd_rect_t& a, const lcd_rect_t& b) {
+  int16_t x0 = min(a.x, b.x), y0 = min(a.y, b.y);
+  int16_t x1 = max(a.x + a.w, b.x + b.w), y1 = max(a.y + a.h, b.y + b.h);
+  return {x0, y0, (int16_t)(x1 - x0), (int16_t)(y1 - y0)};
+}
+
+static bool rectsIntersect(const lcd_rect_t& a, const lcd_rect_t& b) {
+  return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+/**
+ * Adds a rectangle to the dirty list. Rectangles whose union costs no more pixels than the two apart are merged; when
+ * the list is full, the new one is merged with the rectangle whose union grows the least.
+ */
+static void dirtyAdd(lcd_rect_t r) {
+  int16_t x0 = max<int16_t>(r.x, 0), y0 = max<int16_t>(r.y, 0);
+  int16_t x1 = min<int32_t>(r.x + r.w, sprite.width()), y1 = min<int32_t>(r.y + r.h, sprite.height());
+  if (x1 <= x0 || y1 <= y0) {
+    return;
+  }
+  r = {x0, y0, (int16_t)(x1 - x0), (int16_t)(y1 - y0)};
+  for (uint8_t i = 0; i < dirtyCount; ) {
+    if (rectArea(rectUnion(dirty[i], r)) <= rectArea(dirty[i]) + rectArea(r)) {
+      r = rectUnion(dirty[i], r);
+      dirty[i] = dirty[--dirtyCount]; // The union may now reach others: check again from the start
+      i = 0;
+    } else {
+      i++;
+    }
+  }
+  if (dirtyCount == LCD_DIRTY_RECTS) {
+    uint8_t best = 0;
+    int32_t bestGrowth = INT32_MAX;
+    for (uint8_t i = 0; i < dirtyCount; i++) {
+      int32_t growth = rectArea(rectUnion(dirty[i], r)) - rectArea(dirty[i]);
+      if (growth < bestGrowth) {
+        best = i;
+        bestGrowth = growth;
+      }
+    }
+    r = rectUnion(dirty[best], r);
+    dirty[best] = dirty[--dirtyCount];
+  }
+  dirty[dirtyCount++] = r;
+}
+
+static bool dirtyIntersects(const lcd_rect_t& r) {
+  for (uint8_t i = 0; i < dirtyCount; i++) {
+    if (rectsIntersect(dirty[i], r)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Draws a text on the sprite and records the area it covers.
+ */
+static void textDraw(lcd_text_t& t) {
+  sprite.setFont(t.font);
+  sprite.setTextColor(t.color);
+  sprite.setCursor(t.x, t.y);
+  sprite.print(t.text);
+  int32_t h = sprite.fontHeight();
+  if (sprite.getCursorY() != t.y) {
+    t.rect = {0, t.y, (int16_t)sprite.width(), (int16_t)(sprite.getCursorY() - t.y + h)}; // Wrapped to the next lines
+  } else {
+    t.rect = {t.x, t.y, (int16_t)(sprite.getCursorX() - t.x), (int16_t)h};
+  }
+}
+
+static bool textSame(const lcd_text_t& a, const lcd_text_t& b) {
+  return a.x == b.x && a.y == b.y && a.color == b.color && a.font == b.font && strcmp(a.text, b.text) == 0;
+}
+
+/**
+ * Sends one rectangle of the sprite to the panel. The rows are copied into the two staging buffers in turn: while one
+ * is sent by DMA the next one is filled, and the last transfer is still running when this function returns. Without
+ * staging buffers the rectangle is pushed by clipping the sprite, which blocks until it is sent.
+ * @return The SPI bytes of the transfer.
+ */
+static uint32_t rectPush(const lcd_rect_t& r) {
+  if (staging[0] == NULL || staging[1] == NULL) {
+    lcd.setClipRect(r.x, r.y, r.w, r.h);
+    sprite.pushSprite(0, 0);
+    lcd.clearClipRect();
+    return (uint32_t)rectArea(r) * sizeof(uint16_t) + LCD_WINDOW_BYTES;
+  }
+  const uint16_t* src = (const uint16_t*)sprite.getBuffer();
+  int32_t stride = sprite.width();
+  int32_t rows = max<int32_t>(1, LCD_DMA_CHUNK_BYTES / (r.w * sizeof(uint16_t)));
+  uint32_t bytes = 0;
+  for (int32_t y = r.y; y < r.y + r.h; y += rows) {
+    int32_t n = min<int32_t>(rows, r.y + r.h - y);
+    uint16_t* buf = staging[stagingNext]; // The other buffer may still be on its way to the panel
+    stagingNext ^= 1;
+    for (int32_t i = 0; i < n; i++) {
+      memcpy(buf + i * r.w, src + (y + i) * stride + r.x, r.w * sizeof(uint16_t));
+    }
+    lcd.pushImageDMA(r.x, y, r.w, n, (const lgfx::swap565_t*)buf); // Waits for the previous transfer, then starts this one
+    bytes += n * r.w * sizeof(uint16_t) + LCD_WINDOW_BYTES;
+  }
+  return bytes;
+}
+
+/**
+ * Pushes the dirty rectangles and updates the counters.
+ */
+static void dirtyPush(uint32_t start) {
+  uint32_t bytes = 0;
+  for (uint8_t i = 0; i < dirtyCount; i++) {
+    bytes += rectPush(dirty[i]);
+  }
+  lcdStats.frames++;
+  lcdStats.spiBytes += bytes;
+  lcdStats.lastSpiBytes = bytes;
+  lcdStats.lastRects = dirtyCount;
+  lcdStats.lastBlockingUs = micros() - start;
+  metricsCount(METRIC_LCD_SPI_BYTES, bytes);
+  metricsObserve(METRIC_LCD_FRAME, lcdStats.lastBlockingUs);
+  dirtyCount = 0;
+}
 
 /**
  * API (Application Programming Interface)
@@ -34,6 +230,17 @@ LGFX_Sprite sprite(&lcd);
 void lcdInit() {
     lcd.init();
     lcd.setRotation(1);
+    sprite.createSprite(lcd.width(), lcd.height()); // Allocated once, kept for the lifetime of the program
+    if (!backgroundRender()) {
+        Serial.println("LCD background buffer allocation failed");
+    }
+    for (uint8_t i = 0; i < 2; i++) {
+        staging[i] = (uint16_t*)heap_caps_malloc(LCD_DMA_CHUNK_BYTES, MALLOC_CAP_DMA);
+    }
+    if (staging[0] == NULL || staging[1] == NULL) {
+        Serial.println("LCD DMA buffer allocation failed, pushing without DMA");
+    }
+    lcd.startWrite(); // The SPI transaction stays open, so a DMA transfer can still run after lcdFrameEnd() returns
 }
 
 /**
@@ -48,18 +255,19 @@ void spriteSetFont(const lgfx::IFont* font) {
 }
 
 /**
- * A helper function to draw the background pattern on the sprite. It fills the sprite with a gradient pattern based on pixel coordinates.
- * This function is called in the loop to clear the previous text before drawing new text.
+ * A helper function to draw the background pattern on the sprite. It copies the gradient rendered by lcdInit() into the sprite,
+ * a block copy of the sprite buffer instead of ~55k drawPixel() calls. The whole screen becomes dirty and the texts on it are forgotten.
+ * This function is called in the setup to clear the screen; lcdFrameBegin() clears only the texts that change.
  */
 void spriteDrawBackground() {
-  lcd.startWrite();
-  sprite.createSprite(lcd.width(), lcd.height());
-  for (int y = 0; y < sprite.height(); ++y) {
-    for (int x = 0; x < sprite.width(); ++x) {
-      sprite.drawPixel(x, y, lcd.color888(x>>1, (x + y) >> 2, y>>1));
-    }
+  if (background == NULL) {
+    sprite.fillScreen(0U); // No memory for the gradient: plain black
+  } else {
+    sprite.pushImage(0, 0, sprite.width(), sprite.height(), (const lgfx::swap565_t*)background); // Same pixel format: copied row by row
   }
-  lcd.endWrite();
+  shownCount = 0;
+  dirtyCount = 0;
+  dirtyAdd({0, 0, (int16_t)sprite.width(), (int16_t)sprite.height()});
 }
 
 /**
@@ -69,19 +277,93 @@ void spriteDrawBackground() {
  * @param textcolor The color of the text to be drawn, specified as a 24
  * -bit RGB value (e.g., 0xFFFF00 for yellow).
  * @param format A C-style format string that specifies how to format the text, similar to printf in C/C++. It can include format specifiers like %d for integers, %s for strings, etc.
- * This function uses variable argument lists (va_list) to handle the format string and its arguments, allowing for flexible and dynamic text rendering on the sprite. After drawing the text, it pushes the sprite to the display at coordinates (0, 0).
+ * This function uses variable argument lists (va_list) to handle the format string and its arguments, allowing for flexible and dynamic text rendering on the sprite.
+ * Between lcdFrameBegin() and lcdFrameEnd() the text is only recorded; otherwise it is drawn at once and the dirty rectangles are pushed to the display.
  */
 void spritePrintf(int32_t x, int32_t y, uint32_t textcolor, const char * __restrict format, ...)
 {
-  lcd.startWrite();
-  sprite.setTextColor(textcolor);
-  sprite.setCursor(x, y);
-  
+  uint32_t start = micros();
+  lcd_text_t t;
+  t.x = x;
+  t.y = y;
+  t.color = textcolor;
+  t.font = sprite.getFont();
   va_list args;
   va_start(args, format);
-  sprite.vprintf(format, args);
+  vsnprintf(t.text, sizeof(t.text), format, args);
   va_end(args);
 
-  sprite.pushSprite(0, 0);
-  lcd.endWrite();
-}
\ No newline at end of file
+  if (inFrame) {
+    if (pendingCount < LCD_TEXT_ITEMS) {
+      pending[pendingCount++] = t;
+    }
+    return;
+  }
+  textDraw(t);
+  dirtyAdd(t.rect);
+  if (shownCount < LCD_TEXT_ITEMS) {
+    shown[shownCount++] = t; // Cleared by the next frame if it does not print it again
+  }
+  dirtyPush(start);
+}
+
+/**
+ * Starts a frame: the texts printed until lcdFrameEnd() replace the ones on screen.
+ */
+void lcdFrameBegin() {
+  inFrame = true;
+  pendingCount = 0;
+}
+
+/**
+ * Ends a frame. Texts that are on screen but were not printed again are cleared, new or changed texts are drawn (and
+ * the unchanged ones they overlap), then only the dirty rectangles are sent to the display, by DMA when the staging
+ * buffers could be allocated. Costs the CPU the copy into the staging buffers; the last transfer finishes in the background.
+ */
+void lcdFrameEnd() {
+  uint32_t start = micros();
+  inFrame = false;
+  bool kept[LCD_TEXT_ITEMS];
+  for (uint8_t i = 0; i < shownCount; i++) {
+    kept[i] = false;
+    for (uint8_t j = 0; j < pendingCount && !kept[i]; j++) {
+      kept[i] = textSame(shown[i], pending[j]);
+    }
+    if (!kept[i]) {
+      backgroundRestore(shown[i].rect);
+      dirtyAdd(shown[i].rect);
+    }
+  }
+  for (uint8_t j = 0; j < pendingCount; j++) {
+    bool drawn = false;
+    for (uint8_t i = 0; i < shownCount && !drawn; i++) {
+      if (kept[i] && textSame(shown[i], pending[j]) && !dirtyIntersects(shown[i].rect)) {
+        pending[j].rect = shown[i].rect; // Still on screen, untouched
+        drawn = true;
+      }
+    }
+    if (!drawn) {
+      textDraw(pending[j]);
+      dirtyAdd(pending[j].rect);
+    }
+  }
+  memcpy(shown, pending, pendingCount * sizeof(lcd_text_t));
+  shownCount = pendingCount;
+  pendingCount = 0;
+  dirtyPush(start);
+}
+
+/**
+ * Marks an area of the sprite as changed, for code that draws on the sprite directly (lines, graphs). It is sent to
+ * the display by the next lcdFrameEnd().
+ */
+void lcdMarkDirty(int32_t x, int32_t y, int32_t w, int32_t h) {
+  dirtyAdd({(int16_t)x, (int16_t)y, (int16_t)w, (int16_t)h});
+}
+
+/**
+ * Returns the display counters: frames, SPI bytes and the time the caller was kept busy.
+ */
+LcdStats lcdGetStats() {
+  return lcdStats;
+}
@@ -59,8 +59,36 @@ public:
   }
 };
 
+#define LCD_TEXT_ITEMS      8     // Texts per frame at most
+#define LCD_TEXT_LENGTH     32    // Characters per text at most, longer texts are cut
+#define LCD_DIRTY_RECTS     8     // Dirty rectangles per frame; more are merged into the nearest one
+#define LCD_DMA_CHUNK_BYTES 8192  // Size of each of the two DMA staging buffers (internal RAM)
+#define LCD_WINDOW_BYTES    11    // SPI bytes to set the address window of a transfer (CASET, RASET, RAMWR)
+
+/**
+ * Display counters.
+ * frames          Frames pushed by lcdFrameEnd() (and by spritePrintf() outside a frame).
+ * spiBytes        Bytes sent to the panel since boot, pixels and address windows.
+ * lastSpiBytes    Bytes sent by the last frame, lastRects rectangles.
+ * lastBlockingUs  Time the last frame kept the caller busy; the last DMA transfer may still be running after it.
+ */
+typedef struct {
+  uint32_t frames;
+  uint64_t spiBytes;
+  uint32_t lastSpiBytes;
+  uint32_t lastRects;
+  uint32_t lastBlockingUs;
+} LcdStats;
+
+extern LGFX_Custom lcd;
+extern LGFX_Sprite sprite;  // Persistent full-screen sprite; code drawing on it directly reports the area with lcdMarkDirty()
+
 // API (Application Programming Interface)
 void lcdInit();
 void spriteDrawBackground();
 void spriteSetFont(const lgfx::IFont* font);
-void spritePrintf(int32_t x, int32_t y, uint32_t textcolor, const char * __restrict format, ...);
\ No newline at end of file
+void spritePrintf(int32_t x, int32_t y, uint32_t textcolor, const char * __restrict format, ...);
+void lcdFrameBegin();
+void lcdFrameEnd();
+void lcdMarkDirty(int32_t x, int32_t y, int32_t w, int32_t h);
+LcdStats lcdGetStats();
\ No newline at end of file
@@ -8,6 +8,24 @@
 #include "sd_read_write.h"
 #endif
 
+#include "esp_idf_version.h"
+
+#define STREAM_MAX_CLIENTS   4      // Viewers served at the same time, each needs a socket and a task
+#define STREAM_TASK_STACK    4096
+#define STREAM_TASK_PRIORITY 1
+#define STREAM_TASK_CORE     0
+
+// httpd_req_async_handler_begin() lets each viewer run in its own task (ESP-IDF 5.1 and later, Arduino core 3.x)
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+#define STREAM_ASYNC_CLIENTS 1
+#else
+#define STREAM_ASYNC_CLIENTS 0
+#endif
+
+/**
+ * @brief Starts the web page server (port 80) and the MJPEG stream server (port 81).
+ *        The stream reads the frames published by the frame broadcaster, so call frameBroadcasterBegin() first.
+ */
 void startCameraServer();
 
 #endif
\ No newline at end of file
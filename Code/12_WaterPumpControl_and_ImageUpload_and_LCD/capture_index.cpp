@@ -0,0 +1,555 @@
+/**
+ * capture_index.cpp
+ *
+ * A persistent index of the images in a capture directory (/camera, /video), so that picking the name of the next image
+ * does not walk the whole directory with openNextFile() like readFileNum() does. With a few thousand time-lapse frames
+ * that walk took seconds of FAT traversal on every capture.
+ *
+ * File layout (<dir>.idx):
+ *   [header copy 0][header copy 1][record of seq 0][record of seq 1] ...
+ * The record of an image is at a fixed offset given by its sequence number, so reading or updating it is a single seek.
+ * The header holds the next sequence number; like in sd_spool.cpp it is written alternately to two copies with a
+ * generation number, and at boot the valid copy with the highest generation wins. A number is taken by the record of a
+ * saved image, written before the header: a failed write leaves the number free for the next capture, and a record
+ * whose header update was lost to a power cut is found again at boot.
+ *
+ * Image layout: <dir>/YYYY/MM/DD/HHMMSS_<seq>.jpg. FAT looks names up with a linear walk of the directory, so a flat
+ * directory of tens of thousands of images made every create and open slower; a day directory holds at most a day of
+ * images. The path is derived from the record (sequence number and capture time), so it is not stored anywhere.
+ *
+ * Author: John Leung
+ * Date: October 16, 2026
+ */
+#include "capture_index.h"
+#include "esp_rom_crc.h"
+#include <time.h>
+
+#define CAPTURE_INDEX_MAGIC 0x58444943UL  // "CIDX"
+
+typedef struct {
+  uint32_t magic;
+  uint32_t generation;
+  uint32_t firstSeq;  // Records below it are all deleted
+  uint32_t nextSeq;
+  uint32_t count;     // Images in the directory: found by the last rebuild, plus the names handed out, minus the deleted
+  uint32_t crc;
+} capture_header_t;
+
+#define SCAN_BLOCK_RECORDS (4096 / sizeof(capture_record_t))
+#define MIGRATE_BATCH      64    // Flat images collected per listing of the top directory during the migration
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+static uint32_t headerCrc(const capture_header_t &header){
+    return esp_rom_crc32_le(0, (const uint8_t *)&header, offsetof(capture_header_t, crc));
+}
+
+static uint32_t recordCrc(const capture_record_t &record){
+    return esp_rom_crc32_le(0, (const uint8_t *)&record, offsetof(capture_record_t, crc));
+}
+
+static size_t recordOffset(uint32_t seq){
+    return 2 * sizeof(capture_header_t) + (size_t)seq * sizeof(capture_record_t);
+}
+
+static bool dated(uint32_t timestamp){
+    return timestamp >= CAPTURE_CLOCK_VALID;
+}
+
+/**
+ * @brief Returns the shard directory of an image: <dir>/YYYY/MM/DD, or <dir>/undated/<seq / 1000>.
+ */
+static String shardPath(const capture_index_t &index, uint32_t timestamp, uint32_t seq){
+    char shard[32];
+    if(dated(timestamp)){
+        time_t t = timestamp;
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        snprintf(shard, sizeof(shard), "/%04d/%02d/%02d", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+    } else {
+        snprintf(shard, sizeof(shard), "/" CAPTURE_UNDATED_DIR "/%u", seq / CAPTURE_UNDATED_SHARD);
+    }
+    return index.dirname + shard;
+}
+
+static String imagePath(const capture_index_t &index, uint32_t timestamp, uint32_t seq){
+    char name[24];
+    if(dated(timestamp)){
+        time_t t = timestamp;
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        snprintf(name, sizeof(name), "/%02d%02d%02d_%u.jpg", tm.tm_hour, tm.tm_min, tm.tm_sec, seq);
+    } else {
+        snprintf(name, sizeof(name), "/%u.jpg", seq);
+    }
+    return shardPath(index, timestamp, seq) + name;
+}
+
+/**
+ * @brief Days from 1970-01-01 to a date of the Gregorian calendar (timegm() is not in newlib).
+ */
+static uint32_t daysFromCivil(uint32_t year, uint32_t month, uint32_t day){
+    year -= month <= 2;
+    uint32_t era = year / 400;
+    uint32_t yoe = year - era * 400;
+    uint32_t doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+/**
+ * @brief Returns the capture time encoded in a path .../YYYY/MM/DD/HHMMSS_<seq>.jpg, 0 for any other path.
+ */
+static uint32_t pathTimestamp(const char * path){
+    const char * p = path + strlen(path);
+    for(uint8_t slashes = 0; p > path && slashes < CAPTURE_SHARD_DEPTH + 1; ){
+        if(*--p == '/'){
+            slashes++;
+        }
+    }
+    unsigned year, month, day, hour, minute, second;
+    if(sscanf(p, "/%4u/%2u/%2u/%2u%2u%2u_", &year, &month, &day, &hour, &minute, &second) != 6 ||
+       year < 1970 || month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 59){
+        return 0;
+    }
+    uint32_t timestamp = daysFromCivil(year, month, day) * 86400UL + hour * 3600 + minute * 60 + second;
+    return dated(timestamp) ? timestamp : 0;
+}
+
+/**
+ * @brief Creates the shard directory and its parents, unless it is the last one created.
+ */
+static bool makeShard(capture_index_t &index, const String &shard){
+    if(shard == index.shard){
+        return true;
+    }
+    for(int slash = shard.indexOf('/', index.dirname.length() + 1); ; slash = shard.indexOf('/', slash + 1)){
+        String dir = slash < 0 ? shard : shard.substring(0, slash);
+        if(!index.fs->exists(dir) && !index.fs->mkdir(dir)){
+            Serial.printf("Failed to create %s\n", dir.c_str());
+            return false;
+        }
+        if(slash < 0){
+            break;
+        }
+    }
+    index.shard = shard;
+    return true;
+}
+
+/**
+ * @brief Removes a shard directory and its parents up to the capture directory, as long as they are empty.
+ */
+static void pruneShard(capture_index_t &index, String shard){
+    if(shard == index.shard){
+        index.shard = "";
+    }
+    while(shard.length() > index.dirname.length() && index.fs->rmdir(shard)){  // rmdir() fails on a directory that is not empty
+        shard = shard.substring(0, shard.lastIndexOf('/'));
+    }
+}
+
+/**
+ * @brief Writes the header to the copy selected by its new generation number and flushes it to the card.
+ */
+static bool writeHeader(capture_index_t &index){
+    capture_header_t header;
+    header.magic = CAPTURE_INDEX_MAGIC;
+    header.generation = ++index.generation;
+    header.firstSeq = index.firstSeq;
+    header.nextSeq = index.nextSeq;
+    header.count = index.count;
+    header.crc = headerCrc(header);
+    if(!index.file.seek((header.generation & 1) * sizeof(capture_header_t))){
+        return false;
+    }
+    bool ok = index.file.write((const uint8_t *)&header, sizeof(header)) == sizeof(header);
+    index.file.flush();
+    return ok;
+}
+
+/**
+ * @brief Reads one header copy, returns false if it is not valid.
+ */
+static bool readHeader(capture_index_t &index, uint8_t copy, capture_header_t &header){
+    if(!index.file.seek(copy * sizeof(capture_header_t))){
+        return false;
+    }
+    if(index.file.read((uint8_t *)&header, sizeof(header)) != sizeof(header)){
+        return false;
+    }
+    return header.magic == CAPTURE_INDEX_MAGIC && header.crc == headerCrc(header);
+}
+
+static bool writeRecord(capture_index_t &index, capture_record_t &record){
+    record.crc = recordCrc(record);
+    if(!index.file.seek(recordOffset(record.seq)) ||
+       index.file.write((const uint8_t *)&record, sizeof(record)) != sizeof(record)){
+        return false;
+    }
+    index.file.flush();
+    return true;
+}
+
+/**
+ * @brief Takes the numbers of the records written after the header, before a power loss kept the header from following.
+ */
+static void recoverRecords(capture_index_t &index){
+    capture_record_t record;
+    uint32_t recovered = 0;
+    while(index.file.seek(recordOffset(index.nextSeq)) &&
+          index.file.read((uint8_t *)&record, sizeof(record)) == sizeof(record) &&
+          record.seq == index.nextSeq && record.crc == recordCrc(record)){
+        index.nextSeq++;
+        index.count++;
+        recovered++;
+    }
+    if(recovered > 0){
+        writeHeader(index);
+        Serial.printf("Capture index: %u records recovered, next is %u\n", recovered, index.nextSeq);
+    }
+}
+
+/**
+ * @brief Adds a record for every image in a directory and, down to the day directories, in its subdirectories.
+ *        Images at the top of the capture directory (flat layout) get their file time, the others the time in their path.
+ */
+static void rebuildDir(capture_index_t &index, File &dir, uint8_t depth){
+    File file = dir.openNextFile();
+    while(file){
+        if(file.isDirectory()){
+            if(depth < CAPTURE_SHARD_DEPTH){
+                File sub = index.fs->open(file.path());
+                if(sub){
+                    rebuildDir(index, sub, depth + 1);
+                }
+            }
+        } else {
+            int32_t seq = captureIndexSeqOf(file.name());
+            if(seq >= 0){
+                capture_record_t record;
+                memset(&record, 0, sizeof(record));
+                record.seq = seq;
+                record.timestamp = depth == 0 ? (uint32_t)file.getLastWrite() : pathTimestamp(file.path());
+                record.timestamp = dated(record.timestamp) ? record.timestamp : 0;
+                record.size = file.size();
+                record.moisture = CAPTURE_MOISTURE_UNKNOWN;
+                record.status = CAPTURE_STATUS_UNKNOWN;
+                if(writeRecord(index, record)){
+                    index.count++;
+                }
+                if((uint32_t)seq >= index.nextSeq){
+                    index.nextSeq = seq + 1;
+                }
+                if((uint32_t)seq < index.firstSeq){
+                    index.firstSeq = seq;
+                }
+            }
+        }
+        file = dir.openNextFile();
+    }
+}
+
+/**
+ * @brief Recreates the index from one pass over the directory tree: a record for every image, next number after the largest.
+ */
+static bool rebuild(capture_index_t &index, fs::FS &fs, const char * indexPath){
+    Serial.printf("Rebuilding capture index %s\n", indexPath);
+    uint32_t start = millis();
+    index.file.close();
+    index.file = fs.open(indexPath, FILE_WRITE);  // Truncates the old index
+    if(!index.file){
+        Serial.println("Failed to create capture index");
+        return false;
+    }
+    index.file.close();
+    index.file = fs.open(indexPath, "r+");
+    if(!index.file){
+        return false;
+    }
+    index.generation = 0;
+    index.firstSeq = UINT32_MAX;
+    index.nextSeq = 0;
+    index.count = 0;
+
+    File root = fs.open(index.dirname.c_str());
+    if(root && root.isDirectory()){
+        rebuildDir(index, root, 0);
+    }
+    if(index.firstSeq > index.nextSeq){
+        index.firstSeq = index.nextSeq;   // Empty directory
+    }
+    if(!writeHeader(index) || !writeHeader(index)){  // Initialize both copies
+        return false;
+    }
+    Serial.printf("Capture index: %u images, next is %u (rebuilt in %u ms)\n", index.count, index.nextSeq, (uint32_t)(millis() - start));
+    return true;
+}
+
+/**
+ * @brief Moves one image of the flat layout, <dir>/<seq>.jpg, into its shard and updates its record.
+ *        An image without a record (copied onto the card) gets one; one without a capture time takes its file time.
+ */
+static bool migrateImage(capture_index_t &index, const String &name){
+    int32_t seq = captureIndexSeqOf(name.c_str());
+    String from = index.dirname + "/" + name;
+    File file = index.fs->open(from);
+    if(seq < 0 || !file){
+        return false;
+    }
+    capture_record_t record;
+    if((uint32_t)seq >= index.nextSeq){
+        index.nextSeq = seq + 1;
+    }
+    if(!captureIndexGet(index, seq, record) || record.status == CAPTURE_STATUS_DELETED){
+        memset(&record, 0, sizeof(record));
+        record.seq = seq;
+        record.moisture = CAPTURE_MOISTURE_UNKNOWN;
+        record.status = CAPTURE_STATUS_UNKNOWN;
+        index.count++;
+    }
+    record.size = file.size();
+    if(!dated(record.timestamp)){
+        uint32_t written = (uint32_t)file.getLastWrite();
+        record.timestamp = dated(written) ? written : 0;
+    }
+    file.close();
+    if((uint32_t)seq < index.firstSeq){
+        index.firstSeq = seq;
+    }
+    String to = imagePath(index, record.timestamp, seq);
+    if(!makeShard(index, shardPath(index, record.timestamp, seq)) || !index.fs->rename(from, to)){
+        Serial.printf("Failed to move %s to %s\n", from.c_str(), to.c_str());
+        return false;
+    }
+    return writeRecord(index, record);
+}
+
+/**
+ * @brief One-time migration of the flat layout: moves every <dir>/<seq>.jpg into its shard. The top directory is listed
+ *        again after each batch because renaming while openNextFile() walks it could skip entries.
+ */
+static void migrateFlat(capture_index_t &index){
+    uint32_t start = millis();
+    uint32_t moved = 0;
+    for(uint32_t movedBefore = UINT32_MAX; moved != movedBefore; ){   // Stops when a batch moves nothing
+        movedBefore = moved;
+        String names[MIGRATE_BATCH];
+        uint16_t found = 0;
+        File root = index.fs->open(index.dirname.c_str());
+        if(!root || !root.isDirectory()){
+            return;
+        }
+        for(File file = root.openNextFile(); file && found < MIGRATE_BATCH; file = root.openNextFile()){
+            if(!file.isDirectory() && captureIndexSeqOf(file.name()) >= 0){
+                names[found++] = file.name();
+            }
+        }
+        root.close();
+        for(uint16_t i = 0; i < found; i++){
+            if(migrateImage(index, names[i])){
+                moved++;
+            }
+        }
+    }
+    if(moved > 0){
+        writeHeader(index);
+        Serial.printf("Capture index: %u images moved from %s into dated folders in %u ms\n", moved, index.dirname.c_str(),
+                      (uint32_t)(millis() - start));
+    }
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+bool captureIndexBegin(capture_index_t &index, fs::FS &fs, const char * dirname){
+    index.fs = &fs;
+    index.dirname = dirname;
+    String indexPath = index.dirname + CAPTURE_INDEX_SUFFIX;
+    if(!fs.exists(dirname) && !fs.mkdir(dirname)){
+        Serial.printf("Failed to create %s\n", dirname);
+        return false;
+    }
+    index.shard = "";
+    if(fs.exists(indexPath)){
+        index.file = fs.open(indexPath, "r+");
+        if(!index.file){
+            Serial.println("Failed to open capture index");
+            return false;
+        }
+    }
+
+    capture_header_t copy0, copy1;
+    bool valid0 = index.file && readHeader(index, 0, copy0);
+    bool valid1 = index.file && readHeader(index, 1, copy1);
+    if(!valid0 && !valid1){
+        if(!rebuild(index, fs, indexPath.c_str())){
+            return false;
+        }
+    } else {
+        const capture_header_t &header = (valid0 && valid1) ? (copy1.generation > copy0.generation ? copy1 : copy0)
+                                                             : (valid0 ? copy0 : copy1);
+        index.generation = header.generation;
+        index.firstSeq = header.firstSeq;
+        index.nextSeq = header.nextSeq;
+        index.count = header.count;
+        Serial.printf("Capture index %s: %u images, next is %u\n", indexPath.c_str(), index.count, index.nextSeq);
+        recoverRecords(index);
+    }
+    // Also brings an index that is behind its directory up to date: images copied in flat get their number reserved
+    migrateFlat(index);
+    return true;
+}
+
+int32_t captureIndexNext(capture_index_t &index, uint32_t timestamp, String &path){
+    if(!index.file){
+        return -1;
+    }
+    uint32_t seq = index.nextSeq;
+    timestamp = dated(timestamp) ? timestamp : 0;
+    if(!makeShard(index, shardPath(index, timestamp, seq))){
+        return -1;
+    }
+    path = imagePath(index, timestamp, seq);
+    return seq;
+}
+
+bool captureIndexAdd(capture_index_t &index, uint32_t seq, uint32_t timestamp, uint32_t size, uint8_t moisture){
+    if(!index.file){
+        return false;
+    }
+    capture_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.seq = seq;
+    record.timestamp = dated(timestamp) ? timestamp : 0;
+    record.size = size;
+    record.moisture = moisture;
+    record.status = CAPTURE_STATUS_SAVED;
+    if(!writeRecord(index, record)){
+        return false;
+    }
+    if(seq >= index.nextSeq){
+        index.nextSeq = seq + 1;
+        index.count++;
+        if(!writeHeader(index)){
+            Serial.println("Capture index update failed");   // The record is taken again at the next boot
+            return false;
+        }
+    }
+    return true;
+}
+
+bool captureIndexSetStatus(capture_index_t &index, uint32_t seq, capture_status_t status){
+    capture_record_t record;
+    if(!captureIndexGet(index, seq, record)){
+        return false;
+    }
+    record.status = status;
+    return writeRecord(index, record);
+}
+
+bool captureIndexGet(capture_index_t &index, uint32_t seq, capture_record_t &record){
+    if(!index.file || seq >= index.nextSeq){
+        return false;
+    }
+    if(!index.file.seek(recordOffset(seq)) ||
+       index.file.read((uint8_t *)&record, sizeof(record)) != sizeof(record)){
+        return false;
+    }
+    return record.seq == seq && record.crc == recordCrc(record);
+}
+
+bool captureIndexPath(capture_index_t &index, uint32_t seq, String &path){
+    capture_record_t record;
+    if(!captureIndexGet(index, seq, record)){
+        return false;
+    }
+    path = imagePath(index, record.timestamp, seq);
+    return true;
+}
+
+bool captureIndexRemove(capture_index_t &index, uint32_t seq){
+    capture_record_t record;
+    if(!captureIndexGet(index, seq, record) || record.status == CAPTURE_STATUS_DELETED){
+        return false;
+    }
+    String path = imagePath(index, record.timestamp, seq);
+    if(!index.fs->remove(path) && index.fs->exists(path)){
+        return false;
+    }
+    record.status = CAPTURE_STATUS_DELETED;
+    if(index.count > 0){
+        index.count--;
+    }
+    if(!writeRecord(index, record)){
+        return false;
+    }
+    // Images are deleted oldest first: the last one of its shard leaves the directory empty, unless thinning kept some
+    String shard = shardPath(index, record.timestamp, seq);
+    capture_record_t next;
+    if(seq + 1 < index.nextSeq && (!captureIndexGet(index, seq + 1, next) ||
+                                   shardPath(index, next.timestamp, next.seq) != shard)){
+        pruneShard(index, shard);
+    }
+    return true;
+}
+
+bool captureIndexSetFirst(capture_index_t &index, uint32_t seq){
+    if(!index.file || seq < index.firstSeq || seq > index.nextSeq){
+        return false;
+    }
+    index.firstSeq = seq;
+    return writeHeader(index);
+}
+
+uint32_t captureIndexScan(capture_index_t &index, uint32_t from, capture_scan_cb callback, void *arg){
+    if(!index.file){
+        return 0;
+    }
+    capture_record_t *block = (capture_record_t *)malloc(SCAN_BLOCK_RECORDS * sizeof(capture_record_t));
+    if(block == NULL){
+        return 0;
+    }
+    uint32_t visited = 0;
+    bool more = true;
+    for(uint32_t seq = max(from, index.firstSeq); more && seq < index.nextSeq; seq += SCAN_BLOCK_RECORDS){
+        size_t n = min((size_t)(index.nextSeq - seq), (size_t)SCAN_BLOCK_RECORDS);
+        // Seek for every block: the callback may have written a record in between
+        if(!index.file.seek(recordOffset(seq))){
+            break;
+        }
+        n = index.file.read((uint8_t *)block, n * sizeof(capture_record_t)) / sizeof(capture_record_t);
+        for(size_t i = 0; more && i < n; i++){
+            if(block[i].seq == seq + i && block[i].crc == recordCrc(block[i])){
+                visited++;
+                more = callback(block[i], arg);
+            }
+        }
+        if(n < SCAN_BLOCK_RECORDS && seq + n < index.nextSeq){
+            break;   // Short read: the index file ends early
+        }
+    }
+    free(block);
+    return visited;
+}
+
+int32_t captureIndexSeqOf(const char * path){
+    const char * name = strrchr(path, '/');
+    name = (name != NULL) ? name + 1 : path;
+    const char * underscore = strchr(name, '_');
+    if(underscore != NULL){
+        if(underscore - name != 6){   // HHMMSS_<seq>.jpg
+            return -1;
+        }
+        name = underscore + 1;
+    }
+    char * end = NULL;
+    long seq = strtol(name, &end, 10);
+    if(end == name || !isdigit((unsigned char)name[0]) || strcmp(end, ".jpg") != 0 || seq > INT32_MAX){
+        return -1;
+    }
+    return (int32_t)seq;
+}
+
+uint32_t captureIndexCount(const capture_index_t &index){
+    return index.count;
+}
@@ -0,0 +1,144 @@
+#ifndef __CAPTURE_INDEX_H
+#define __CAPTURE_INDEX_H
+
+#include "Arduino.h"
+#include "FS.h"
+
+#define CAPTURE_INDEX_SUFFIX    ".idx"  // The index of "/camera" is "/camera.idx", outside the directory it describes
+#define CAPTURE_MOISTURE_UNKNOWN 0xFF   // Moisture of an image found by a rebuild
+#define CAPTURE_CLOCK_VALID     1600000000UL  // Older timestamps were taken before NTP set the clock
+#define CAPTURE_UNDATED_DIR     "undated"     // Shard of the images without a capture time: <dir>/undated/<seq / 1000>/
+#define CAPTURE_UNDATED_SHARD   1000          // Images per undated shard
+#define CAPTURE_SHARD_DEPTH     3             // <dir>/YYYY/MM/DD
+
+typedef enum {
+  CAPTURE_STATUS_UNKNOWN = 0,   // Found on the card by a rebuild
+  CAPTURE_STATUS_SAVED,         // Saved, upload not tried yet
+  CAPTURE_STATUS_UPLOADED,      // Uploaded to Google Drive
+  CAPTURE_STATUS_SPOOLED,       // Waiting in the spool for WiFi to come back
+  CAPTURE_STATUS_FAILED,        // Upload failed, the reading was published without the URL
+  CAPTURE_STATUS_DELETED,       // Removed from the card by the retention manager (capture_retention.cpp)
+} capture_status_t;
+
+/**
+ * @brief Metadata of one image. The path of the image follows from its sequence number and capture time:
+ *        <dir>/YYYY/MM/DD/HHMMSS_<seq>.jpg (UTC), or <dir>/undated/<seq / 1000>/<seq>.jpg without a capture time, so
+ *        that no directory holds more than a day of images (2880 at one image per 30 seconds) or 1000 undated ones.
+ * seq       Sequence number, also in the file name.
+ * timestamp Capture time in seconds since the epoch (UTC), or 0 if the clock was not set. Also in the path.
+ * size      Size of the JPEG in bytes.
+ * moisture  Soil moisture in percent at capture time, CAPTURE_MOISTURE_UNKNOWN if not known.
+ * status    Upload status, see capture_status_t.
+ * crc       CRC32 of all fields above, a record with a wrong CRC is treated as absent.
+ */
+typedef struct {
+  uint32_t seq;
+  uint32_t timestamp;
+  uint32_t size;
+  uint8_t moisture;
+  uint8_t status;
+  uint8_t reserved[2];
+  uint32_t crc;
+} capture_record_t;
+
+/**
+ * @brief A capture directory and its index file. One instance per directory, used by one task.
+ * firstSeq is the oldest sequence number that may still have an image; the records below it are all deleted.
+ */
+typedef struct {
+  File file;
+  fs::FS *fs;
+  String dirname;
+  String shard;       // Last shard directory known to exist, so that mkdir() runs once a day
+  uint32_t generation;
+  uint32_t firstSeq;
+  uint32_t nextSeq;
+  uint32_t count;
+} capture_index_t;
+
+/**
+ * @brief Called by captureIndexScan() for each valid record. Return false to stop the scan.
+ */
+typedef bool (*capture_scan_cb)(const capture_record_t &record, void *arg);
+
+/**
+ * @brief Opens the index of a capture directory, creating the directory if needed. The index is rebuilt from a single
+ *        pass over the directory tree only when the index file is missing or corrupt. Images still at the top of the
+ *        directory (the flat <dir>/<seq>.jpg layout of older firmware, or copied there on a PC) are then moved into
+ *        their shards once; the top of a sharded directory holds a few year folders, so that check is cheap.
+ * @param index The index to open.
+ * @param fs The file system holding the directory (SD_MMC).
+ * @param dirname The capture directory, e.g. "/camera".
+ * @return true if the index is ready.
+ */
+bool captureIndexBegin(capture_index_t &index, fs::FS &fs, const char * dirname);
+
+/**
+ * @brief Returns the next sequence number and the path to save the image to, creating its shard directory if needed.
+ *        The number is taken by captureIndexAdd() once the image is saved; until then every call returns the same
+ *        number, so a failed write does not leave a gap or a record without an image. Constant time: no directory scan.
+ * @param index The index.
+ * @param timestamp Capture time in seconds since the epoch, 0 if the clock is not set. It selects the shard.
+ * @param path Receives the path of the image, e.g. "/camera/2026/10/16/093000_1234.jpg".
+ * @return The sequence number, or -1 if the index is not open or the shard directory could not be created.
+ */
+int32_t captureIndexNext(capture_index_t &index, uint32_t timestamp, String &path);
+
+/**
+ * @brief Records the metadata of an image saved at a path returned by captureIndexNext() and takes its number: the
+ *        record is written first and then the header with the new next number. Call it only after the image was saved.
+ *        'timestamp' must be the one given to captureIndexNext(), the path of the image is derived from it.
+ * @return true if the record and the header were written.
+ */
+bool captureIndexAdd(capture_index_t &index, uint32_t seq, uint32_t timestamp, uint32_t size, uint8_t moisture);
+
+/**
+ * @brief Updates the upload status of an image.
+ * @return false if the image has no record.
+ */
+bool captureIndexSetStatus(capture_index_t &index, uint32_t seq, capture_status_t status);
+
+/**
+ * @brief Reads the record of an image.
+ * @return false if the image has no valid record.
+ */
+bool captureIndexGet(capture_index_t &index, uint32_t seq, capture_record_t &record);
+
+/**
+ * @brief Returns the path of an image from its record.
+ * @return false if the image has no valid record.
+ */
+bool captureIndexPath(capture_index_t &index, uint32_t seq, String &path);
+
+/**
+ * @brief Removes an image from the card and marks its record CAPTURE_STATUS_DELETED. The new image count is written to
+ *        the card with the next header update (captureIndexAdd() or captureIndexSetFirst()). When the next image is in
+ *        another shard, the shard directory is removed too if it is now empty.
+ * @return true if the image is gone (also if its file was already missing).
+ */
+bool captureIndexRemove(capture_index_t &index, uint32_t seq);
+
+/**
+ * @brief Moves firstSeq forward once the images before 'seq' are all deleted, and writes the header.
+ */
+bool captureIndexSetFirst(capture_index_t &index, uint32_t seq);
+
+/**
+ * @brief Reads the records from 'from' to the last one in 4 KB blocks and calls 'callback' for each valid record,
+ *        in sequence order. The callback may call captureIndexRemove() or captureIndexSetStatus().
+ * @return The number of records passed to the callback.
+ */
+uint32_t captureIndexScan(capture_index_t &index, uint32_t from, capture_scan_cb callback, void *arg);
+
+/**
+ * @brief Returns the sequence number of an image path such as "/camera/2026/10/16/093000_1234.jpg" or
+ *        "/camera/1234.jpg", or -1 if it is not one.
+ */
+int32_t captureIndexSeqOf(const char * path);
+
+/**
+ * @brief Returns the number of images in the directory: the images found by the last rebuild plus the images added since.
+ */
+uint32_t captureIndexCount(const capture_index_t &index);
+
+#endif
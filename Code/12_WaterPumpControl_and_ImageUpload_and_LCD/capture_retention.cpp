@@ -0,0 +1,272 @@
+/**
+ * capture_retention.cpp
+ *
+ * Retention manager of a capture directory. Without it /camera grows until the card is full, and from then on writejpg()
+ * fails and every FAT operation slows down.
+ *
+ * It works from the capture index (capture_index.cpp), never from directory listings: the records give the size, the
+ * capture time and the upload status of every image in sequence order, so the oldest images are simply the lowest
+ * sequence numbers. A batch first deletes from the oldest image up while a limit (bytes, count, free space, age) is
+ * exceeded, then thins the images older than thinAfterDays to one per thinInterval. Batches are small (a few tens of
+ * deletions, half a second) and run in the task that owns the index when it has nothing else to do, so a deletion
+ * never runs in the middle of a capture.
+ *
+ * Author: John Leung
+ * Date: October 16, 2026
+ */
+#include "capture_retention.h"
+#include "SD_MMC.h"
+#include "metrics.h"
+#include <time.h>
+
+#define RETENTION_CLOCK_VALID   1600000000UL    // Before 2020 means NTP has not set the clock yet
+#define FREE_SPACE_REFRESH_MS   60000           // How often the card's free space is read (f_getfree) at most
+
+const capture_retention_policy_t captureRetentionDefaultPolicy = {
+    RETENTION_MAX_BYTES, RETENTION_MIN_FREE_BYTES, RETENTION_MAX_IMAGES, RETENTION_MAX_AGE_DAYS,
+    RETENTION_THIN_AFTER_DAYS, RETENTION_THIN_INTERVAL, RETENTION_BATCH_IMAGES, RETENTION_BATCH_MS
+};
+
+typedef struct {
+    uint32_t start;             // micros() at the start of the batch
+    uint32_t now;               // Clock time, 0 if not set
+    uint32_t deleted;
+    uint64_t deletedBytes;
+    bool (*shouldStop)(void);
+    bool contiguous;            // Every record before the current one is deleted
+    uint32_t newFirst;
+} retention_batch_t;
+
+static capture_index_t *retentionIndex = NULL;
+static capture_retention_policy_t retentionPolicy;
+static CaptureRetentionStats retentionStats;
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;   // The httpd task copies retentionStats for /metrics
+static uint32_t accountedSeq = 0;       // Records below it are counted in retentionStats.images and .bytes
+static uint32_t thinSeq = 0;            // Records below it are thinned
+static uint32_t thinBucket = UINT32_MAX;    // Interval of the last image kept by the thinning
+static uint32_t undatedUntil = 0;       // Records are looked up to here for the capture time that bounds the undated ones
+static uint32_t undatedTime = 0;        // Capture time of the record at undatedUntil, 0 if none has one yet
+static uint64_t freeBytes = UINT64_MAX;
+static uint32_t freeCheckedMillis = 0;
+static bool freeChecked = false;
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+static bool accountRecord(const capture_record_t &record, void *arg){
+    if(record.status != CAPTURE_STATUS_DELETED){
+        portENTER_CRITICAL(&statsMux);
+        retentionStats.images++;
+        retentionStats.bytes += record.size;
+        portEXIT_CRITICAL(&statsMux);
+    }
+    return true;
+}
+
+/**
+ * @brief Adds the images captured since the last batch to the totals.
+ */
+static void accountNewImages(void){
+    if(accountedSeq < retentionIndex->nextSeq){
+        captureIndexScan(*retentionIndex, accountedSeq, accountRecord, NULL);
+        accountedSeq = retentionIndex->nextSeq;
+    }
+}
+
+static void refreshFreeSpace(void){
+    if(retentionPolicy.minFreeBytes == 0){
+        return;
+    }
+    if(!freeChecked || millis() - freeCheckedMillis >= FREE_SPACE_REFRESH_MS){
+        freeBytes = SD_MMC.totalBytes() - SD_MMC.usedBytes();
+        freeCheckedMillis = millis();
+        freeChecked = true;
+    }
+}
+
+static bool batchOver(const retention_batch_t &batch){
+    return batch.deleted >= retentionPolicy.batchImages ||
+           micros() - batch.start >= (uint32_t)retentionPolicy.batchMs * 1000 ||
+           (batch.shouldStop != NULL && batch.shouldStop());
+}
+
+static bool overLimit(void){
+    const capture_retention_policy_t &p = retentionPolicy;
+    return (p.maxBytes > 0 && retentionStats.bytes > p.maxBytes) ||
+           (p.maxImages > 0 && retentionStats.images > p.maxImages) ||
+           (p.minFreeBytes > 0 && freeBytes < p.minFreeBytes);
+}
+
+/**
+ * @brief Looks for the first record after 'seq' with a capture time, from where the last lookup stopped if that was
+ *        already past 'seq'. Records do not change their capture time, so the result holds for the following batches.
+ */
+static void findNextDated(uint32_t seq){
+    uint32_t from = seq + 1;
+    if(seq < undatedUntil){
+        if(undatedTime != 0){
+            return;
+        }
+        from = undatedUntil;   // None was found up to there, look at the images captured since
+    }
+    undatedTime = 0;
+    capture_record_t next;
+    for(undatedUntil = from; undatedUntil < retentionIndex->nextSeq; undatedUntil++){
+        if(captureIndexGet(*retentionIndex, undatedUntil, next) && next.timestamp != 0){
+            undatedTime = next.timestamp;
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Whether an image is older than maxAgeDays. An image without a capture time (taken before NTP set the clock)
+ *        was captured before the next image that has one, so it is too old when that image is.
+ */
+static bool tooOld(const capture_record_t &record, uint32_t now){
+    if(retentionPolicy.maxAgeDays == 0 || now == 0){
+        return false;
+    }
+    uint32_t cutoff = now - retentionPolicy.maxAgeDays * 86400UL;
+    if(record.timestamp != 0){
+        return record.timestamp < cutoff;
+    }
+    findNextDated(record.seq);
+    return undatedTime != 0 && undatedTime < cutoff;
+}
+
+/**
+ * @brief Deletes one image and updates the totals.
+ */
+static bool deleteImage(retention_batch_t &batch, const capture_record_t &record){
+    uint32_t start = micros();
+    if(!captureIndexRemove(*retentionIndex, record.seq)){
+        return false;
+    }
+    metricsObserve(METRIC_RETENTION_DELETE, micros() - start);
+    metricsCount(METRIC_RETENTION_DELETED);
+    batch.deleted++;
+    batch.deletedBytes += record.size;
+    portENTER_CRITICAL(&statsMux);
+    retentionStats.images--;
+    retentionStats.bytes -= min((uint64_t)record.size, retentionStats.bytes);
+    portEXIT_CRITICAL(&statsMux);
+    if(freeBytes != UINT64_MAX){
+        freeBytes += record.size;   // Estimate until the next refresh
+    }
+    return true;
+}
+
+/**
+ * @brief Scan callback of the first pass: oldest images first, while a limit is exceeded or the image is too old.
+ */
+static bool deleteOldest(const capture_record_t &record, void *arg){
+    retention_batch_t &batch = *(retention_batch_t *)arg;
+    if(record.status != CAPTURE_STATUS_DELETED){
+        if(!overLimit() && !tooOld(record, batch.now)){
+            return false;   // Everything from here on is kept
+        }
+        if(batchOver(batch)){
+            return false;
+        }
+        // An image waiting in the spool is uploaded first, the next one goes instead
+        if(record.status == CAPTURE_STATUS_SPOOLED || !deleteImage(batch, record)){
+            batch.contiguous = false;
+            return true;
+        }
+    }
+    if(batch.contiguous){
+        batch.newFirst = record.seq + 1;
+    }
+    return true;
+}
+
+/**
+ * @brief Scan callback of the second pass: of the images older than thinAfterDays, keeps the first of every thinInterval.
+ */
+static bool thinOld(const capture_record_t &record, void *arg){
+    retention_batch_t &batch = *(retention_batch_t *)arg;
+    if(record.status != CAPTURE_STATUS_DELETED && record.timestamp != 0){
+        if(record.timestamp >= batch.now - retentionPolicy.thinAfterDays * 86400UL){
+            return false;   // Not old enough yet, neither are the ones after it
+        }
+        uint32_t bucket = record.timestamp / retentionPolicy.thinInterval;
+        if(bucket != thinBucket){
+            thinBucket = bucket;
+        } else if(record.status != CAPTURE_STATUS_SPOOLED){
+            if(batchOver(batch)){
+                return false;   // Resumes here next time
+            }
+            deleteImage(batch, record);
+        }
+    }
+    thinSeq = record.seq + 1;
+    return true;
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+void captureRetentionBegin(capture_index_t &index, const capture_retention_policy_t *policy){
+    retentionIndex = &index;
+    retentionPolicy = policy != NULL ? *policy : captureRetentionDefaultPolicy;
+    portENTER_CRITICAL(&statsMux);
+    memset(&retentionStats, 0, sizeof(retentionStats));
+    portEXIT_CRITICAL(&statsMux);
+    accountedSeq = index.firstSeq;
+    thinSeq = index.firstSeq;
+    thinBucket = UINT32_MAX;
+    undatedUntil = 0;
+    undatedTime = 0;
+    uint32_t start = millis();
+    accountNewImages();
+    Serial.printf("Retention: %s holds %u images, %llu MB (counted in %u ms)\n", index.dirname.c_str(),
+                  retentionStats.images, (unsigned long long)(retentionStats.bytes / (1024 * 1024)),
+                  (uint32_t)(millis() - start));
+}
+
+uint32_t captureRetentionRun(bool (*shouldStop)(void)){
+    if(retentionIndex == NULL){
+        return 0;
+    }
+    accountNewImages();
+    refreshFreeSpace();
+
+    retention_batch_t batch;
+    memset(&batch, 0, sizeof(batch));
+    batch.start = micros();
+    time_t now = time(NULL);
+    batch.now = now >= (time_t)RETENTION_CLOCK_VALID ? (uint32_t)now : 0;
+    batch.shouldStop = shouldStop;
+    batch.contiguous = true;
+    batch.newFirst = retentionIndex->firstSeq;
+
+    captureIndexScan(*retentionIndex, retentionIndex->firstSeq, deleteOldest, &batch);
+    if(batch.newFirst > retentionIndex->firstSeq){
+        captureIndexSetFirst(*retentionIndex, batch.newFirst);   // Also writes the new image count
+    }
+    if(retentionPolicy.thinAfterDays > 0 && retentionPolicy.thinInterval > 0 && batch.now != 0 && !batchOver(batch)){
+        captureIndexScan(*retentionIndex, max(thinSeq, retentionIndex->firstSeq), thinOld, &batch);
+    }
+
+    if(batch.deleted > 0){
+        uint32_t elapsed = micros() - batch.start;
+        portENTER_CRITICAL(&statsMux);
+        retentionStats.deleted += batch.deleted;
+        retentionStats.deletedBytes += batch.deletedBytes;
+        retentionStats.batches++;
+        retentionStats.lastBatchImages = batch.deleted;
+        retentionStats.lastBatchUs = elapsed;
+        retentionStats.imagesPerSec = elapsed > 0 ? batch.deleted * 1e6f / elapsed : 0;
+        portEXIT_CRITICAL(&statsMux);
+        Serial.printf("Retention: %u images (%llu KB) deleted in %u ms, %.1f images/s, %u images left\n",
+                      batch.deleted, (unsigned long long)(batch.deletedBytes / 1024), (uint32_t)(elapsed / 1000), retentionStats.imagesPerSec,
+                      retentionStats.images);
+    }
+    return batch.deleted;
+}
+
+CaptureRetentionStats captureRetentionGetStats(void){
+    portENTER_CRITICAL(&statsMux);
+    CaptureRetentionStats stats = retentionStats;   // The 64-bit counters are not written in one store
+    portEXIT_CRITICAL(&statsMux);
+    return stats;
+}
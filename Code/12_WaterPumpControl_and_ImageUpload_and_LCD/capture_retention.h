@@ -0,0 +1,83 @@
+#ifndef __CAPTURE_RETENTION_H
+#define __CAPTURE_RETENTION_H
+
+#include "Arduino.h"
+#include "capture_index.h"
+
+// Default policy, see capture_retention_policy_t
+#define RETENTION_MAX_BYTES       (4ULL * 1024 * 1024 * 1024)  // 4 GB of images
+#define RETENTION_MIN_FREE_BYTES  (256ULL * 1024 * 1024)       // Always leave 256 MB free on the card
+#define RETENTION_MAX_IMAGES      100000
+#define RETENTION_MAX_AGE_DAYS    180
+#define RETENTION_THIN_AFTER_DAYS 7
+#define RETENTION_THIN_INTERVAL   3600    // Thinned images: keep one per hour
+#define RETENTION_BATCH_IMAGES    32      // Deletions per batch at most
+#define RETENTION_BATCH_MS        500     // Time per batch at most
+#define RETENTION_IDLE_MS         5000    // A batch runs only after the upload task has been idle this long
+
+/**
+ * @brief Limits of the retention manager. 0 disables a limit.
+ * maxBytes       Total size of the images in the directory.
+ * minFreeBytes   Free space to keep on the card, whatever else uses it.
+ * maxImages      Number of images.
+ * maxAgeDays     Images older than this are deleted. An image without a capture time is as old as the next one with one.
+ * thinAfterDays  Images older than this are thinned to one per thinInterval seconds.
+ * thinInterval   Seconds between the images kept by the thinning.
+ * batchImages    Deletions per call of captureRetentionRun() at most.
+ * batchMs        Time per call of captureRetentionRun() at most.
+ */
+typedef struct {
+  uint64_t maxBytes;
+  uint64_t minFreeBytes;
+  uint32_t maxImages;
+  uint32_t maxAgeDays;
+  uint32_t thinAfterDays;
+  uint32_t thinInterval;
+  uint16_t batchImages;
+  uint16_t batchMs;
+} capture_retention_policy_t;
+
+extern const capture_retention_policy_t captureRetentionDefaultPolicy;
+
+/**
+ * @brief Counters of the retention manager.
+ * images, bytes     What the directory holds now.
+ * deleted           Images deleted since boot, deletedBytes their size.
+ * batches           Batches that deleted at least one image.
+ * lastBatchImages   Images deleted by the last such batch, in lastBatchUs.
+ * imagesPerSec      Deletion throughput of the last batch.
+ */
+typedef struct {
+  uint32_t images;
+  uint64_t bytes;
+  uint32_t deleted;
+  uint64_t deletedBytes;
+  uint32_t batches;
+  uint32_t lastBatchImages;
+  uint32_t lastBatchUs;
+  float imagesPerSec;
+} CaptureRetentionStats;
+
+/**
+ * @brief Attaches the retention manager to an open capture index and adds up the size of its images (one read of the
+ *        index in 4 KB blocks). The index stays owned by its task: captureRetentionRun() must be called from that task.
+ * @param index The capture index, e.g. of /camera.
+ * @param policy The limits, NULL for captureRetentionDefaultPolicy. The policy is copied.
+ */
+void captureRetentionBegin(capture_index_t &index, const capture_retention_policy_t *policy = NULL);
+
+/**
+ * @brief Runs one batch: deletes the oldest images while a limit is exceeded, then thins the images older than
+ *        thinAfterDays. Images still waiting in the spool for an upload are never deleted. Call it when the task is idle,
+ *        never in the middle of a capture; the batch stops after the current deletion as soon as 'shouldStop' returns true.
+ * @param shouldStop Polled before each deletion, e.g. "a capture job is waiting". NULL to run the whole batch.
+ * @return The number of images deleted.
+ */
+uint32_t captureRetentionRun(bool (*shouldStop)(void) = NULL);
+
+/**
+ * @brief Returns a consistent copy of the counters of the retention manager, from any task (e.g. /metrics in the httpd task).
+ */
+CaptureRetentionStats captureRetentionGetStats(void);
+
+#endif
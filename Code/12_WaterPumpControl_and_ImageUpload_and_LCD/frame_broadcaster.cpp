@@ -0,0 +1,203 @@
+/**
+ * frame_broadcaster.cpp
+ *
+ * A single camera producer for all the consumers of frames: the MJPEG stream clients, the "Save it to SDcard" button and
+ * the periodic capture for Google Drive. Before, every stream client called esp_camera_fb_get() in its own loop, so two
+ * viewers halved each other's frame rate and a snapshot had to fight them for the sensor.
+ *
+ * The capture task copies each frame out of the driver buffer into a reference-counted frame and publishes it as "latest".
+ * A reader takes a reference under the mutex and sends or saves the frame at its own pace; the frame is freed by whoever
+ * drops the last reference. The capture task never waits for a reader: a slow stream client gets the latest frame when it
+ * is ready for the next one and skips the frames in between.
+ *
+ * Author: John Leung
+ * Date: October 16, 2026
+ */
+#include "frame_broadcaster.h"
+#include "img_converters.h"
+#include "esp_timer.h"
+#include "metrics.h"
+#include <new>
+
+#define FRAME_PUBLISHED_BIT BIT0
+
+static TaskHandle_t captureTaskHandle = NULL;
+static SemaphoreHandle_t frameMutex = NULL;
+static EventGroupHandle_t frameEvents = NULL;
+static shared_frame_t* latestFrame = NULL;
+static uint32_t nextSeq = 1;
+static std::atomic<uint32_t> subscriberCount(0);
+static std::atomic<uint32_t> framesInUse(0);
+static FrameBroadcasterStats broadcasterStats = {0, 0, 0, 0};
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+/**
+ * @brief Copies a driver frame into a new shared frame holding one reference (the "latest" one).
+ * @return The new frame, or NULL if there was not enough memory.
+ */
+static shared_frame_t* frameCopy(camera_fb_t* fb) {
+  shared_frame_t* frame = new (std::nothrow) shared_frame_t;
+  if (frame == NULL) {
+    return NULL;
+  }
+  if (fb->format == PIXFORMAT_JPEG) {
+    frame->buf = (uint8_t*)(psramFound() ? ps_malloc(fb->len) : malloc(fb->len));
+    if (frame->buf != NULL) {
+      memcpy(frame->buf, fb->buf, fb->len);
+      frame->len = fb->len;
+    }
+  } else if (!frame2jpg(fb, 80, &frame->buf, &frame->len)) {
+    frame->buf = NULL;
+  }
+  if (frame->buf == NULL) {
+    delete frame;
+    return NULL;
+  }
+  frame->width = fb->width;
+  frame->height = fb->height;
+  frame->timestamp = fb->timestamp;
+  frame->publishedUs = esp_timer_get_time();
+  frame->refs = 1;
+  framesInUse++;
+  return frame;
+}
+
+/**
+ * @brief Makes a frame the latest one and wakes up the readers waiting for it.
+ */
+static void framePublish(shared_frame_t* frame) {
+  xSemaphoreTake(frameMutex, portMAX_DELAY);
+  shared_frame_t* previous = latestFrame;
+  frame->seq = nextSeq++;
+  latestFrame = frame;
+  xSemaphoreGive(frameMutex);
+
+  frameBroadcasterRelease(previous); // Freed now unless a reader still holds it
+  // Waiters clear the bit on exit; a bit left set by a frame nobody waited for only costs them one extra frameAcquire()
+  xEventGroupSetBits(frameEvents, FRAME_PUBLISHED_BIT);
+}
+
+/**
+ * @brief Takes a reference to the latest frame if it is newer than lastSeq and younger than maxAgeUs.
+ */
+static shared_frame_t* frameAcquire(uint32_t lastSeq, int64_t maxAgeUs) {
+  shared_frame_t* frame = NULL;
+  xSemaphoreTake(frameMutex, portMAX_DELAY);
+  if (latestFrame != NULL && latestFrame->seq != lastSeq &&
+      (maxAgeUs < 0 || esp_timer_get_time() - latestFrame->publishedUs <= maxAgeUs)) {
+    frame = latestFrame;
+    frame->refs++;
+  }
+  xSemaphoreGive(frameMutex);
+  return frame;
+}
+
+/**
+ * @brief The capture task. Captures back to back while stream clients are subscribed, otherwise sleeps until a snapshot
+ *        asks for a frame.
+ */
+static void captureTask(void* arg) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, subscriberCount > 0 ? 0 : portMAX_DELAY);
+
+    int64_t start = esp_timer_get_time();
+    camera_fb_t* fb = esp_camera_fb_get();
+    if (fb == NULL) {
+      broadcasterStats.captureFailed++;
+      vTaskDelay(pdMS_TO_TICKS(10));
+      continue;
+    }
+    shared_frame_t* frame = frameCopy(fb);
+    esp_camera_fb_return(fb); // The driver gets its buffer back at once, readers use the copy
+    broadcasterStats.captured++;
+    metricsObserve(METRIC_FRAME_CAPTURE, (uint32_t)(esp_timer_get_time() - start));
+    if (frame != NULL) {
+      framePublish(frame);
+    } else {
+      Serial.println("frameBroadcaster: not enough memory for a frame");
+      vTaskDelay(pdMS_TO_TICKS(100));
+    }
+  }
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+bool frameBroadcasterBegin() {
+  if (captureTaskHandle != NULL) {
+    return true; // Already running
+  }
+  frameMutex = xSemaphoreCreateMutex();
+  frameEvents = xEventGroupCreate();
+  if (frameMutex == NULL || frameEvents == NULL) {
+    Serial.println("frameBroadcasterBegin(): not enough memory");
+    return false;
+  }
+  if (xTaskCreatePinnedToCore(captureTask, "capture", FRAME_BROADCASTER_TASK_STACK, NULL,
+                              FRAME_BROADCASTER_TASK_PRIORITY, &captureTaskHandle, FRAME_BROADCASTER_TASK_CORE) != pdPASS) {
+    Serial.println("frameBroadcasterBegin(): failed to create the capture task");
+    return false;
+  }
+  return true;
+}
+
+void frameBroadcasterSubscribe() {
+  if (subscriberCount++ == 0 && captureTaskHandle != NULL) {
+    xTaskNotifyGive(captureTaskHandle); // Start capturing continuously
+  }
+}
+
+void frameBroadcasterUnsubscribe() {
+  subscriberCount--;
+}
+
+shared_frame_t* frameBroadcasterWaitNext(uint32_t lastSeq, uint32_t timeoutMs) {
+  if (frameEvents == NULL) {
+    return NULL;
+  }
+  TickType_t start = xTaskGetTickCount();
+  TickType_t timeout = pdMS_TO_TICKS(timeoutMs);
+  for (;;) {
+    shared_frame_t* frame = frameAcquire(lastSeq, -1);
+    if (frame != NULL) {
+      return frame;
+    }
+    TickType_t elapsed = xTaskGetTickCount() - start;
+    if (elapsed >= timeout) {
+      return NULL;
+    }
+    xEventGroupWaitBits(frameEvents, FRAME_PUBLISHED_BIT, pdTRUE, pdTRUE, timeout - elapsed);
+  }
+}
+
+shared_frame_t* frameBroadcasterGetLatest(uint32_t maxAgeMs) {
+  if (captureTaskHandle == NULL) {
+    return NULL;
+  }
+  shared_frame_t* frame = frameAcquire(0, (int64_t)maxAgeMs * 1000);
+  if (frame != NULL) {
+    return frame;
+  }
+  // Too old (nobody is streaming): ask the capture task for one more frame
+  uint32_t lastSeq = nextSeq - 1;
+  xTaskNotifyGive(captureTaskHandle);
+  return frameBroadcasterWaitNext(lastSeq);
+}
+
+void frameBroadcasterRelease(shared_frame_t* frame) {
+  if (frame == NULL) {
+    return;
+  }
+  if (--frame->refs == 0) {
+    free(frame->buf);
+    delete frame;
+    framesInUse--;
+  }
+}
+
+FrameBroadcasterStats frameBroadcasterGetStats() {
+  FrameBroadcasterStats stats = broadcasterStats;
+  stats.subscribers = subscriberCount;
+  stats.framesInUse = framesInUse;
+  return stats;
+}
@@ -2,12 +2,228 @@
 // February 27, 2026 -
 // 1. Added a local function urlEncode() to convert special characters in the Google Drive URL into their percent-encoded forms (e.g., < becomes %3C, > becomes %3E, & becomes %26, = becomes %3D, etc.) to ensure the URL can be safely transmitted and used in HTTP requests when uploading to ThingSpeak or other platforms.
 // 2. Added URL encoding to the response URL in uploadToGoogleDrive() to ensure special characters are properly handled when transmitting the URL to ThingSpeak or other platforms.
+// October 16, 2026 -
+// 1. uploadToGoogleDrive() no longer builds the whole base64 image in one String. A local Base64Stream class encodes 3-byte groups on demand
+//    while HTTPClient copies the request body into the socket, so the extra heap is HTTPClient's fixed TCP buffer (~1.4 KB) whatever the frame size.
+// 2. Content-Length is precomputed from the image size (4 * ceil(n / 3)), so the Apps Script endpoint sees exactly the same request as before.
+// 3. Added googleDriveGetLastUploadStats() to report upload time and peak heap use of the last upload.
+// 4. The POST and the redirected GET go over connections kept alive by secure_client_pool.cpp instead of a new HTTPClient
+//    connection (and TLS handshake) per request. A request on a kept-alive connection that the server has closed is retried once.
+// 5. Added the DRIVE_UPLOAD_BINARY mode which POSTs the JPEG bytes as application/octet-stream straight from the image buffer,
+//    saving the 33% base64 overhead. If the Apps Script does not accept binary bodies (returns an error), the upload is retried
+//    in base64 and base64 is used from then on.
+// 6. DRIVE_UPLOAD_BINARY sends the JPEG as the file part of a multipart/form-data body (MultipartStream) instead of a bare
+//    application/octet-stream body, and the base64 fallback is kept in NVS for the web app URL that refused the binary
+//    upload, so the first image after a reboot is not sent twice.
+// 7. DRIVE_UPLOAD_BINARY, MultipartStream and the NVS fallback are only built with DRIVE_UPLOAD_MULTIPART (google_drive.h),
+//    because the Apps Script of docs/4.3 cannot read a binary body.
 
 #include "google_drive.h"
+#include "secure_client_pool.h"
 #include <WiFiClientSecure.h>
 #include <HTTPClient.h>
-#include <base64.h> // Arduino base64 library
 #include <ArduinoJson.h>
+#include <Preferences.h>
+
+#define DRIVE_NVS_NAMESPACE   "gdrive"
+#define MULTIPART_BOUNDARY    "esp32s3-plant-jpeg-boundary"
+
+static GoogleDriveUploadStats lastUploadStats = {0, 0, 0, 0};
+static DriveUploadMode uploadMode = DRIVE_UPLOAD_BASE64;
+#ifdef DRIVE_UPLOAD_MULTIPART
+static bool fallbackLoaded = false;
+static uint32_t base64OnlyUrlHash = 0;   // Hash of the web app URL that refused a binary upload, 0 if none
+#endif
+
+/**
+ * @brief A read-only Stream that base64 encodes a memory buffer on the fly.
+ * HTTPClient::sendRequest() pulls the request body through readBytes() in blocks of its own TCP buffer size,
+ * so only 3 input bytes and 4 output characters are ever held here at a time.
+ * The minimum free internal heap seen while the body is being pulled is recorded for the upload statistics.
+ */
+class Base64Stream : public Stream {
+  public:
+    Base64Stream(const uint8_t* data, size_t size)
+      : _data(data), _size(size), _inPos(0), _outPos(0), _outLen(0),
+        _minFreeHeap(ESP.getFreeHeap()) {}
+
+    // Number of base64 characters produced for 'size' input bytes, used as the Content-Length
+    static size_t encodedLength(size_t size) { return ((size + 2) / 3) * 4; }
+
+    int available() override {
+      return (int)(encodedLength(_size) - (encodedLength(_inPos) - (_outLen - _outPos)));
+    }
+
+    int read() override {
+      if (_outPos == _outLen && !encodeNextGroup()) {
+        return -1;
+      }
+      return _out[_outPos++];
+    }
+
+    int peek() override {
+      if (_outPos == _outLen && !encodeNextGroup()) {
+        return -1;
+      }
+      return _out[_outPos];
+    }
+
+    size_t readBytes(char* buffer, size_t length) override {
+      size_t count = 0;
+      while (count < length) {
+        if (_outPos == _outLen && !encodeNextGroup()) {
+          break;
+        }
+        buffer[count++] = _out[_outPos++];
+      }
+      uint32_t freeHeap = ESP.getFreeHeap();
+      if (freeHeap < _minFreeHeap) {
+        _minFreeHeap = freeHeap;
+      }
+      return count;
+    }
+
+    size_t write(uint8_t) override { return 0; }
+    void flush() override {}
+
+    uint32_t minFreeHeap() const { return _minFreeHeap; }
+
+  private:
+    // Encodes the next (up to) 3 input bytes into 4 output characters, returns false at the end of the data
+    bool encodeNextGroup() {
+      static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+      if (_inPos >= _size) {
+        return false;
+      }
+      size_t remaining = _size - _inPos;
+      uint32_t group = (uint32_t)_data[_inPos] << 16;
+      if (remaining > 1) group |= (uint32_t)_data[_inPos + 1] << 8;
+      if (remaining > 2) group |= (uint32_t)_data[_inPos + 2];
+      _out[0] = table[(group >> 18) & 0x3F];
+      _out[1] = table[(group >> 12) & 0x3F];
+      _out[2] = remaining > 1 ? table[(group >> 6) & 0x3F] : '=';
+      _out[3] = remaining > 2 ? table[group & 0x3F] : '=';
+      _inPos += remaining > 3 ? 3 : remaining;
+      _outPos = 0;
+      _outLen = 4;
+      return true;
+    }
+
+    const uint8_t* _data;
+    size_t _size;
+    size_t _inPos;
+    uint8_t _outPos;
+    uint8_t _outLen;
+    char _out[4];
+    uint32_t _minFreeHeap;
+};
+
+#ifdef DRIVE_UPLOAD_MULTIPART
+/**
+ * @brief A read-only Stream that sends a JPEG buffer as the only file part of a multipart/form-data body.
+ * The part headers and the closing boundary are short strings around the image, which is read straight from the
+ * image buffer, so the bytes go into the socket as they are and nothing the size of the image is allocated.
+ */
+class MultipartStream : public Stream {
+  public:
+    MultipartStream(const uint8_t* data, size_t size) : _data(data), _size(size), _pos(0) {}
+
+    static size_t length(size_t size) { return strlen(head) + size + strlen(tail); }
+
+    int available() override { return (int)(length(_size) - _pos); }
+
+    int read() override {
+      int c = peek();
+      if (c >= 0) {
+        _pos++;
+      }
+      return c;
+    }
+
+    int peek() override {
+      size_t headLength = strlen(head);
+      if (_pos < headLength) {
+        return (uint8_t)head[_pos];
+      }
+      if (_pos < headLength + _size) {
+        return _data[_pos - headLength];
+      }
+      if (_pos < length(_size)) {
+        return (uint8_t)tail[_pos - headLength - _size];
+      }
+      return -1;
+    }
+
+    size_t readBytes(char* buffer, size_t length) override {
+      size_t count = 0;
+      size_t headLength = strlen(head);
+      while (count < length && _pos < MultipartStream::length(_size)) {
+        if (_pos >= headLength && _pos < headLength + _size) {
+          // Copy the run of image bytes in one go
+          size_t run = headLength + _size - _pos;
+          if (run > length - count) {
+            run = length - count;
+          }
+          memcpy(buffer + count, _data + (_pos - headLength), run);
+          count += run;
+          _pos += run;
+        } else {
+          buffer[count++] = (char)read();
+        }
+      }
+      return count;
+    }
+
+    size_t write(uint8_t) override { return 0; }
+    void flush() override {}
+
+  private:
+    static constexpr const char* head =
+      "--" MULTIPART_BOUNDARY "\r\n"
+      "Content-Disposition: form-data; name=\"image\"; filename=\"image.jpg\"\r\n"
+      "Content-Type: image/jpeg\r\n\r\n";
+    static constexpr const char* tail = "\r\n--" MULTIPART_BOUNDARY "--\r\n";
+
+    const uint8_t* _data;
+    size_t _size;
+    size_t _pos;
+};
+
+// FNV-1a hash of the web app URL, the key of the base64 fallback kept in NVS
+static uint32_t urlHash(const String& url) {
+  uint32_t hash = 2166136261u;
+  for (unsigned int i = 0; i < url.length(); i++) {
+    hash = (hash ^ (uint8_t)url.charAt(i)) * 16777619u;
+  }
+  return hash == 0 ? 1 : hash;
+}
+
+// Reads the base64 fallback of an earlier boot, once
+static void loadFallback() {
+  if (fallbackLoaded) {
+    return;
+  }
+  fallbackLoaded = true;
+  Preferences nvs;
+  if (nvs.begin(DRIVE_NVS_NAMESPACE, true)) {
+    base64OnlyUrlHash = nvs.getUInt("b64url", 0);
+    nvs.end();
+  }
+}
+
+// Remembers that the web app at 'url' only takes base64, or forgets it with 0
+static void storeFallback(uint32_t hash) {
+  if (hash == base64OnlyUrlHash) {
+    return;
+  }
+  base64OnlyUrlHash = hash;
+  Preferences nvs;
+  if (nvs.begin(DRIVE_NVS_NAMESPACE, false)) {
+    nvs.putUInt("b64url", hash);
+    nvs.end();
+  }
+}
+#endif
 
 // URL encode function to handle special characters
 // Characters <, >, &, =, etc. should become %3C, %3E, %26, %3D, etc.
@@ -16,7 +232,7 @@ static String urlEncode(const String& str) {
   char c;
   char code0;
   char code1;
-  for (int i = 0; i < str.length(); i++) {
+  for (unsigned int i = 0; i < str.length(); i++) {
     c = str.charAt(i);
     if (isalnum(c)) {
       encodedString += c;
@@ -31,30 +247,78 @@ static String urlEncode(const String& str) {
   return encodedString;
 }
 
-/**
- * @brief Uploads an image to Google Drive via a Google Apps Script Web App.
- * @param webAppUrl The URL of the deployed Google Apps Script Web App that handles the upload.
- * @param imageData A pointer to the image data in memory (e.g., from the camera frame buffer).
- * @param imageSize The size of the image data in bytes.
- * @param response  A reference to a String variable where the function will store the URL of the uploaded image if the upload is successful.
- *                  Special characters in the URL will be URL-encoded (e.g., < becomes %3C, > becomes %3E, & becomes %26, = becomes %3D, etc.) to ensure it can be safely transmitted and used in HTTP requests.
- *                  The URL will be in the format "https%3A%2F%2Fdrive%2Egoogle%2Ecom%2Fuc%3Fexport%3Dview%26id..." which can be directly used in ThingSpeak to display the image.
- * @return Returns true if the upload was successful and the URL was retrieved, false otherwise.
- */
-bool uploadToGoogleDrive(const String& webAppUrl, uint8_t* imageData, size_t imageSize, String& response) {
-    // Encode image data to base64
-    String encoded = base64::encode(imageData, imageSize);
+// Sends one request over a pooled connection. The image, if given, is sent as the body in the given mode.
+// If a kept-alive connection turns out to be closed by the server, the request is retried once over a new connection.
+static int pooledRequest(HTTPClient& http, const String& url, const char* type, DriveUploadMode mode,
+                         const uint8_t* imageData, size_t imageSize, uint32_t* minFreeHeap) {
+    int httpCode = HTTPC_ERROR_CONNECTION_REFUSED;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused = false;
+        WiFiClient* client = secureClientPoolConnect(url, &reused);
+        if (client == NULL) {
+            return HTTPC_ERROR_CONNECTION_REFUSED;
+        }
+        http.setReuse(true); // Keep the connection open after http.end()
+        http.begin(*client, url);
+        http.setTimeout(30000); // Set timeout to 30 seconds
 
-    HTTPClient http;
-    http.begin(webAppUrl);
-    http.setTimeout(30000); // Set timeout to 30 seconds
-    http.addHeader("Content-Type", "text/plain");
+        // Explicitly tell the client to collect the "Location" header
+        const char* headerKeys[] = {"Location"};
+        http.collectHeaders(headerKeys, 1);
 
-    // Explicitly tell the client to collect the "Location" header
-    const char* headerKeys[] = {"Location"};
-    http.collectHeaders(headerKeys, 1);
+#ifdef DRIVE_UPLOAD_MULTIPART
+        if (imageData != NULL && mode == DRIVE_UPLOAD_BINARY) {
+            // The JPEG bytes are sent as they are, straight from the image buffer, as the file part of a form
+            http.addHeader("Content-Type", "multipart/form-data; boundary=" MULTIPART_BOUNDARY);
+            MultipartStream multipart(imageData, imageSize);
+            httpCode = http.sendRequest(type, &multipart, MultipartStream::length(imageSize));
+        } else
+#endif
+        if (imageData != NULL) {
+            // The body is base64 encoded while it is being sent, see Base64Stream above
+            http.addHeader("Content-Type", "text/plain");
+            Base64Stream encoded(imageData, imageSize);
+            httpCode = http.sendRequest(type, &encoded, Base64Stream::encodedLength(imageSize));
+            if (minFreeHeap != NULL) {
+                *minFreeHeap = encoded.minFreeHeap();
+            }
+        } else {
+            httpCode = http.sendRequest(type);
+        }
 
-    int httpCode = http.POST(encoded);
+        if (httpCode >= 0 || !reused) {
+            break;
+        }
+        Serial.println("Kept-alive connection was closed by the server, retrying.");
+        http.end();
+        secureClientPoolDrop(url);
+    }
+    return httpCode;
+}
+
+// Uploads the image in the given mode. appsScriptError is set when the request went through but the script returned an error.
+static bool uploadInMode(const String& webAppUrl, DriveUploadMode mode, uint8_t* imageData, size_t imageSize,
+                         String& response, bool& appsScriptError) {
+    appsScriptError = false;
+    uint32_t startMillis = millis();
+    uint32_t freeHeapBefore = ESP.getFreeHeap();
+    uint32_t minFreeHeap = freeHeapBefore;
+
+    HTTPClient http;
+    int httpCode = pooledRequest(http, webAppUrl, "POST", mode, imageData, imageSize, &minFreeHeap);
+
+    lastUploadStats.durationMs = millis() - startMillis;
+#ifdef DRIVE_UPLOAD_MULTIPART
+    lastUploadStats.bytesSent = mode == DRIVE_UPLOAD_BINARY ? MultipartStream::length(imageSize)
+                                                           : Base64Stream::encodedLength(imageSize);
+#else
+    lastUploadStats.bytesSent = Base64Stream::encodedLength(imageSize);
+#endif
+    lastUploadStats.freeHeapBefore = freeHeapBefore;
+    lastUploadStats.minFreeHeap = minFreeHeap;
+    Serial.printf("Google Drive POST: %u bytes in %u ms, peak heap use %u bytes\n",
+                  lastUploadStats.bytesSent, lastUploadStats.durationMs,
+                  lastUploadStats.freeHeapBefore - lastUploadStats.minFreeHeap);
 
     // Manually handle the redirect
     if (httpCode == 301 || httpCode == 302) {
@@ -63,8 +327,7 @@ bool uploadToGoogleDrive(const String& webAppUrl, uint8_t* imageData, size_t ima
         http.end(); // End the first request
 
         // Make a new request to the redirected URL
-        http.begin(redirectUrl);
-        httpCode = http.GET(); // The redirected request is a GET
+        httpCode = pooledRequest(http, redirectUrl, "GET", mode, NULL, 0, NULL); // The redirected request is a GET
     }
 
     if (httpCode == HTTP_CODE_OK) {
@@ -92,6 +355,7 @@ bool uploadToGoogleDrive(const String& webAppUrl, uint8_t* imageData, size_t ima
         } else {
             Serial.println("Google Apps Script returned an error:");
             Serial.println(doc["message"].as<const char*>());
+            appsScriptError = true;
             http.end();
             return false;
         }
@@ -102,4 +366,62 @@ bool uploadToGoogleDrive(const String& webAppUrl, uint8_t* imageData, size_t ima
         http.end();
         return false;
     }
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Uploads an image to Google Drive via a Google Apps Script Web App.
+ * @param webAppUrl The URL of the deployed Google Apps Script Web App that handles the upload.
+ * @param imageData A pointer to the image data in memory (e.g., from the camera frame buffer).
+ * @param imageSize The size of the image data in bytes.
+ * @param response  A reference to a String variable where the function will store the URL of the uploaded image if the upload is successful.
+ *                  Special characters in the URL will be URL-encoded (e.g., < becomes %3C, > becomes %3E, & becomes %26, = becomes %3D, etc.) to ensure it can be safely transmitted and used in HTTP requests.
+ *                  The URL will be in the format "https%3A%2F%2Fdrive%2Egoogle%2Ecom%2Fuc%3Fexport%3Dview%26id..." which can be directly used in ThingSpeak to display the image.
+ * The connections are taken from secure_client_pool.cpp and stay open for the next upload.
+ * @return Returns true if the upload was successful and the URL was retrieved, false otherwise.
+ */
+bool uploadToGoogleDrive(const String& webAppUrl, uint8_t* imageData, size_t imageSize, String& response) {
+    DriveUploadMode mode = uploadMode;
+    bool appsScriptError = false;
+#ifdef DRIVE_UPLOAD_MULTIPART
+    if (mode == DRIVE_UPLOAD_BINARY) {
+        loadFallback();
+        if (base64OnlyUrlHash == urlHash(webAppUrl)) {
+            mode = DRIVE_UPLOAD_BASE64; // This web app refused a binary upload before, possibly on an earlier boot
+        }
+    }
+    bool ok = uploadInMode(webAppUrl, mode, imageData, imageSize, response, appsScriptError);
+    if (!ok && appsScriptError && mode == DRIVE_UPLOAD_BINARY) {
+        // The deployed Apps Script only understands base64, use it from now on, also after a reboot
+        Serial.println("Apps Script did not accept the binary upload, falling back to base64.");
+        storeFallback(urlHash(webAppUrl));
+        ok = uploadInMode(webAppUrl, DRIVE_UPLOAD_BASE64, imageData, imageSize, response, appsScriptError);
+    }
+    return ok;
+#else
+    return uploadInMode(webAppUrl, mode, imageData, imageSize, response, appsScriptError);
+#endif
+}
+
+/**
+ * @brief Selects how the image is sent to the Apps Script, see DriveUploadMode.
+ */
+void googleDriveSetUploadMode(DriveUploadMode mode) {
+    uploadMode = mode;
+}
+
+#ifdef DRIVE_UPLOAD_MULTIPART
+/**
+ * @brief Forgets the base64 fallback kept in NVS, so that the next upload tries DRIVE_UPLOAD_BINARY again.
+ */
+void googleDriveResetUploadFallback() {
+    loadFallback();
+    storeFallback(0);
+}
+#endif
+
+/**
+ * @brief Returns the statistics of the last call to uploadToGoogleDrive().
+ */
+GoogleDriveUploadStats googleDriveGetLastUploadStats() {
+    return lastUploadStats;
+}
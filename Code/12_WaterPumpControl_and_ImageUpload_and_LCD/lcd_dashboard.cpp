@@ -0,0 +1,171 @@
+/**
+ * lcd_dashboard.cpp
+ *
+ * A dashboard for the 320x172 LCD: the last moisture reading, the state of the pump, the last watering, WiFi, the upload
+ * queue and the free heap above a 24 h moisture graph.
+ *
+ * Everything is drawn incrementally on the persistent sprite of LGFX_ESP32_ST7789.cpp:
+ * - the graph is a scroll rectangle of the sprite: a new column scrolls it left by one pixel and only the new column is
+ *   drawn, once every DASHBOARD_COLUMN_SECONDS;
+ * - the texts go through lcdFrameBegin()/lcdFrameEnd(), which redraw and send only the texts that changed.
+ * The pump is switched by its own esp_timer (water_pump_control.cpp), so the display never delays it.
+ *
+ * Author: John Leung
+ * Date: October 16, 2026
+ */
+#include "lcd_dashboard.h"
+#include "LGFX_ESP32_ST7789.hpp"
+#include "sensor_log.h"
+#include "esp_timer.h"
+#include <time.h>
+
+static const uint32_t labelColor = 0xFFFFFFU;
+static const uint32_t valueColor = 0xFFFF00U;
+static const uint32_t wateringColor = 0x00FFFFU;
+static const uint32_t alertColor = 0xFF4040U;
+static const uint32_t graphBackground = 0x101828U;
+static const uint32_t graphFill = 0x1E6E3CU;
+static const uint32_t graphLine = 0x40FF80U;
+static const uint32_t thresholdColor = 0x606070U;
+
+static const char* pumpStateNames[] = {"idle", "WATERING", "soaking", "waiting"};
+
+static uint8_t lowerLine, upperLine;        // Thresholds in percent
+static uint32_t columnStartMillis = 0;
+static uint32_t columnSum = 0;
+static uint16_t columnCount = 0;
+static uint16_t liveColumns = 0;            // Columns drawn from readings since boot, at the right of the graph
+static bool seeded = false;                 // The older columns were filled from the sensor log
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+static int32_t graphY(uint8_t moisture) {
+  return DASHBOARD_GRAPH_Y + DASHBOARD_GRAPH_HEIGHT - 1 - moisture * (DASHBOARD_GRAPH_HEIGHT - 1) / 100;
+}
+
+/**
+ * @brief Draws one column of the graph: background, threshold lines and, if there was a reading, the filled sparkline.
+ */
+static void graphColumn(int32_t x, uint8_t moisture) {
+  sprite.drawFastVLine(x, DASHBOARD_GRAPH_Y, DASHBOARD_GRAPH_HEIGHT, graphBackground);
+  if (moisture != DASHBOARD_MOISTURE_NONE) {
+    int32_t top = graphY(min<uint8_t>(moisture, 100));
+    sprite.drawFastVLine(x, top, DASHBOARD_GRAPH_Y + DASHBOARD_GRAPH_HEIGHT - top, graphFill);
+    sprite.drawPixel(x, top, graphLine);
+  }
+  sprite.drawPixel(x, graphY(lowerLine), thresholdColor);
+  sprite.drawPixel(x, graphY(upperLine), thresholdColor);
+}
+
+/**
+ * @brief Ends the current period: scrolls the graph by one column and draws the mean of its readings.
+ */
+static void graphScroll(uint8_t moisture) {
+  sprite.scroll(-1, 0);
+  graphColumn(DASHBOARD_GRAPH_X + DASHBOARD_GRAPH_WIDTH - 1, moisture);
+  lcdMarkDirty(DASHBOARD_GRAPH_X, DASHBOARD_GRAPH_Y, DASHBOARD_GRAPH_WIDTH, DASHBOARD_GRAPH_HEIGHT);
+  if (liveColumns < DASHBOARD_GRAPH_WIDTH) {
+    liveColumns++;
+  }
+}
+
+typedef struct {
+  uint32_t now;
+  bool drawn;
+} graph_seed_t;
+
+/**
+ * @brief Sensor log callback: draws the columns of one hour that are older than the live ones.
+ */
+static bool graphSeedHour(const sensor_log_hour_t& hour, void* arg) {
+  graph_seed_t& seed = *(graph_seed_t*)arg;
+  for (uint32_t t = hour.hour; t < hour.hour + 3600 && t < seed.now; t += DASHBOARD_COLUMN_SECONDS) {
+    int32_t column = DASHBOARD_GRAPH_WIDTH - 1 - (int32_t)((seed.now - t) / DASHBOARD_COLUMN_SECONDS);
+    if (column >= 0 && column < DASHBOARD_GRAPH_WIDTH - liveColumns) {
+      graphColumn(DASHBOARD_GRAPH_X + column, hour.moistureMean);
+      seed.drawn = true;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Fills the graph left of the live columns with the hourly means of the sensor log, once the clock is set.
+ */
+static void graphSeed() {
+  time_t now = time(NULL);
+  if (now < (time_t)SENSOR_LOG_CLOCK_VALID) {
+    return;
+  }
+  seeded = true;
+  graph_seed_t seed = {(uint32_t)now, false};
+  sensorLogScanHours(seed.now - 86400, seed.now, graphSeedHour, &seed);
+  if (seed.drawn) {
+    lcdMarkDirty(DASHBOARD_GRAPH_X, DASHBOARD_GRAPH_Y, DASHBOARD_GRAPH_WIDTH, DASHBOARD_GRAPH_HEIGHT);
+  }
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+void dashboardBegin(uint8_t lowerThreshold, uint8_t upperThreshold) {
+  lowerLine = lowerThreshold;
+  upperLine = upperThreshold;
+  spriteDrawBackground();
+  for (int32_t x = 0; x < DASHBOARD_GRAPH_WIDTH; x++) {
+    graphColumn(DASHBOARD_GRAPH_X + x, DASHBOARD_MOISTURE_NONE);
+  }
+  sprite.setScrollRect(DASHBOARD_GRAPH_X, DASHBOARD_GRAPH_Y, DASHBOARD_GRAPH_WIDTH, DASHBOARD_GRAPH_HEIGHT);
+  sprite.setBaseColor(graphBackground);
+  columnStartMillis = millis();
+  graphSeed();
+}
+
+void dashboardAddSample(uint8_t moisture) {
+  if (!seeded) {
+    graphSeed();
+  }
+  // A long stall (e.g. a blocking WiFi.begin()) leaves empty columns, so the graph stays a time axis
+  for (uint16_t n = 0; millis() - columnStartMillis >= DASHBOARD_COLUMN_SECONDS * 1000UL; n++) {
+    if (n < DASHBOARD_GRAPH_WIDTH) {
+      graphScroll(columnCount > 0 ? columnSum / columnCount : DASHBOARD_MOISTURE_NONE);
+    }
+    columnStartMillis += DASHBOARD_COLUMN_SECONDS * 1000UL;
+    columnSum = 0;
+    columnCount = 0;
+  }
+  columnSum += moisture;
+  columnCount++;
+}
+
+void dashboardRender(const dashboard_status_t& status) {
+  lcdFrameBegin();
+  spriteSetFont(&fonts::DejaVu18);
+  spritePrintf(12, 8, labelColor, "Moisture");
+  spriteSetFont(&fonts::DejaVu40);
+  if (status.moisture == DASHBOARD_MOISTURE_NONE) {
+    spritePrintf(12, 34, valueColor, "--%%");
+  } else {
+    spritePrintf(12, 34, valueColor, "%u%%", status.moisture);
+  }
+
+  spriteSetFont(&fonts::DejaVu12);
+  spritePrintf(150, 8, status.pump == WATERING ? wateringColor : labelColor, "Pump: %s", pumpStateNames[status.pump]);
+  if (status.lastWateringMicros < 0) {
+    spritePrintf(150, 26, labelColor, "Watered: never");
+  } else {
+    uint32_t minutes = (uint32_t)((esp_timer_get_time() - status.lastWateringMicros) / 60000000LL);
+    if (minutes < 60) {
+      spritePrintf(150, 26, labelColor, "Watered: %u min ago", minutes);
+    } else {
+      spritePrintf(150, 26, labelColor, "Watered: %u h ago", minutes / 60);
+    }
+  }
+  if (status.wifiConnected) {
+    spritePrintf(150, 44, labelColor, "WiFi: %d dBm", status.rssi);
+  } else {
+    spritePrintf(150, 44, alertColor, "WiFi: down");
+  }
+  spritePrintf(150, 62, labelColor, "Uploads: %u, spool %u", status.uploadQueue, status.spooled);
+  spritePrintf(150, 80, labelColor, "Heap: %u KB", status.freeHeap / 1024);
+  lcdFrameEnd();
+}
@@ -0,0 +1,56 @@
+#ifndef LCD_DASHBOARD_H
+#define LCD_DASHBOARD_H
+
+#include <Arduino.h>
+#include "water_pump_control.h"
+
+#define DASHBOARD_GRAPH_X         16
+#define DASHBOARD_GRAPH_Y         104
+#define DASHBOARD_GRAPH_WIDTH     288     // One column per sample period: 288 x 5 minutes = 24 hours
+#define DASHBOARD_GRAPH_HEIGHT    60
+#define DASHBOARD_COLUMN_SECONDS  (86400 / DASHBOARD_GRAPH_WIDTH)
+#define DASHBOARD_MOISTURE_NONE   0xFF    // No reading yet
+
+/**
+ * @brief What the status area of the dashboard shows, gathered by the caller.
+ * moisture            Last soil moisture reading in percent, DASHBOARD_MOISTURE_NONE before the first one.
+ * pump                State of the pump cycle.
+ * lastWateringMicros  Start of the last watering (getLastWateringMicros()), -1 if none yet.
+ * wifiConnected, rssi WiFi link and its RSSI in dBm.
+ * uploadQueue         Capture jobs waiting for the upload task; spooled: jobs waiting on the SD card for WiFi.
+ * freeHeap            Free internal heap in bytes.
+ */
+typedef struct {
+  uint8_t moisture;
+  PumpState pump;
+  int64_t lastWateringMicros;
+  bool wifiConnected;
+  int8_t rssi;
+  uint32_t uploadQueue;
+  uint32_t spooled;
+  uint32_t freeHeap;
+} dashboard_status_t;
+
+/**
+ * @brief Clears the screen and draws the static parts of the dashboard: the background and the empty moisture graph
+ *        with its threshold lines. Call it once after lcdInit(); the next dashboardRender() sends the whole screen.
+ * @param lowerThreshold Moisture in percent below which the pump starts, drawn as a line on the graph.
+ * @param upperThreshold Upper moisture threshold in percent, drawn as a line on the graph.
+ */
+void dashboardBegin(uint8_t lowerThreshold, uint8_t upperThreshold);
+
+/**
+ * @brief Adds a moisture reading to the 24 h graph. The readings of each DASHBOARD_COLUMN_SECONDS are averaged; when a
+ *        period ends, the graph scrolls left by one column and the new column is drawn, nothing else. Once the clock is
+ *        set, the older columns are filled once from the hourly aggregates of the sensor log (sensor_log.cpp).
+ *        The graph reaches the display with the next dashboardRender().
+ */
+void dashboardAddSample(uint8_t moisture);
+
+/**
+ * @brief Shows the moisture reading and the status. The texts are compared with the ones on screen, so only the ones
+ *        that changed are redrawn and sent (with the graph when it scrolled): usually a few hundred microseconds of CPU.
+ */
+void dashboardRender(const dashboard_status_t& status);
+
+#endif
@@ -0,0 +1,270 @@
+/**
+ * metrics.cpp
+ *
+ * Performance counters of the plant controller, served in the Prometheus text format at http://<board>/metrics
+ * (see app_httpd.cpp), e.g. for `curl` or a Prometheus scrape every 15 s.
+ *
+ * The hot paths (capture task, stream tasks, upload task, esp_timer callback, loop()) update the counters with 32-bit
+ * std::atomic operations only, which are lock-free on the ESP32-S3; no mutex is ever taken to record a value. Histograms
+ * keep one counter per bucket (not cumulative, that is done when rendering) and their sum as whole seconds plus
+ * microseconds, so that it cannot overflow in 32 bits. A scrape may see a histogram between two updates of the same
+ * value, which Prometheus tolerates.
+ *
+ * Author: John Leung
+ * Date: October 16, 2026
+ */
+#include "metrics.h"
+#include <atomic>
+#include <WiFi.h>
+#include "esp_heap_caps.h"
+#include "water_pump_control.h"
+#include "watering_model.h"
+#include "upload_worker.h"
+#include "thingspeak_batch.h"
+#include "frame_broadcaster.h"
+#include "secure_client_pool.h"
+#include "capture_retention.h"
+#include "moisture_adc.h"
+#include "task_scheduler.h"
+
+#define METRICS_MAX_BUCKETS 10
+
+typedef struct {
+  const char* name;
+  const char* labels;         // Extra labels, e.g. backend="thingspeak", or ""
+  const char* help;
+  uint32_t boundsUs[METRICS_MAX_BUCKETS];  // Upper bounds of the buckets, the +Inf bucket is implicit
+  uint8_t bucketCount;
+  std::atomic<uint32_t> buckets[METRICS_MAX_BUCKETS + 1] = {};
+  std::atomic<uint32_t> count{0};
+  std::atomic<uint32_t> sumSec{0};
+  std::atomic<uint32_t> sumUs{0};  // Always below one million after a carry into sumSec
+} metrics_histogram_t;
+
+static metrics_histogram_t histograms[METRIC_HISTOGRAM_COUNT] = {
+  {"camera_frame_capture_seconds", "", "Time to grab a frame from the camera driver and copy it",
+   {2000, 5000, 10000, 20000, 40000, 70000, 100000, 200000}, 8},
+  {"stream_frame_send_seconds", "", "Time to send one frame to one stream client",
+   {5000, 10000, 20000, 50000, 100000, 200000, 500000, 1000000}, 8},
+  {"upload_duration_seconds", "backend=\"google_drive\"", "Duration of one upload per backend",
+   {250000, 500000, 1000000, 2000000, 3000000, 5000000, 10000000, 20000000, 30000000}, 9},
+  {"upload_duration_seconds", "backend=\"thingspeak\"", "Duration of one upload per backend",
+   {100000, 250000, 500000, 1000000, 2000000, 5000000, 10000000, 30000000}, 8},
+  {"loop_iteration_seconds", "", "Duration of one loop() iteration that ran tasks",
+   {50, 100, 500, 1000, 5000, 10000, 50000, 100000, 500000, 1000000}, 10},
+  {"sd_jpeg_write_seconds", "", "Time to write one JPEG to the SD card, open to close",
+   {5000, 10000, 20000, 50000, 100000, 200000, 500000, 1000000, 2000000}, 9},
+  {"upload_queue_wait_seconds", "", "Time a capture job waited in the upload queue before it was saved",
+   {1000, 10000, 50000, 100000, 250000, 500000, 1000000, 5000000, 30000000}, 9},
+  {"capture_retention_delete_seconds", "", "Time to delete one image and mark its index record",
+   {1000, 2000, 5000, 10000, 20000, 50000, 100000, 500000}, 8},
+  {"lcd_update_seconds", "", "Time to refresh the LCD dashboard",
+   {500, 1000, 2000, 5000, 10000, 20000, 50000, 100000}, 8},
+  {"lcd_frame_blocking_seconds", "", "Time an LCD frame keeps its caller busy; its last DMA transfer may still be running",
+   {100, 250, 500, 1000, 2000, 5000, 10000, 50000}, 8},
+};
+
+static const char* counterNames[METRIC_COUNTER_COUNT][2] = {
+  {"pump_cycles_total", "Completed watering cycles"},
+  {"pump_on_seconds_total", "Total time the pump relay was on"},
+  {"upload_failures_total{backend=\"google_drive\"}", "Failed uploads per backend"},
+  {"stream_frames_sent_total", "Frames sent to stream clients"},
+  {"capture_retention_deleted_total", "Images deleted by the retention manager"},
+  {"lcd_spi_bytes_total", "Bytes sent to the LCD panel, pixels and address windows"},
+};
+static std::atomic<uint32_t> counters[METRIC_COUNTER_COUNT];
+
+// ThingSpeak responses by code class
+static const char* thingspeakCodeLabels[] = {"200", "202", "4xx", "5xx", "error", "other"};
+static std::atomic<uint32_t> thingspeakCodes[6];
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+static void renderHelp(String& body, const char* name, const char* help, const char* type) {
+  String family = name;
+  int brace = family.indexOf('{');
+  if (brace >= 0) {
+    family = family.substring(0, brace);
+  }
+  body += "# HELP " + family + " " + help + "\n";
+  body += "# TYPE " + family + " " + type + "\n";
+}
+
+static void renderGauge(String& body, const char* name, const char* help, double value) {
+  char line[128];
+  renderHelp(body, name, help, "gauge");
+  snprintf(line, sizeof(line), "%s %.10g\n", name, value);
+  body += line;
+}
+
+static void renderHistogram(String& body, const metrics_histogram_t& h, bool withHelp) {
+  char line[160];
+  const char* sep = h.labels[0] != '\0' ? "," : "";
+  if (withHelp) {
+    renderHelp(body, h.name, h.help, "histogram");
+  }
+  uint32_t cumulative = 0;
+  for (uint8_t i = 0; i <= h.bucketCount; i++) {
+    cumulative += h.buckets[i];
+    if (i < h.bucketCount) {
+      snprintf(line, sizeof(line), "%s_bucket{%s%sle=\"%g\"} %u\n", h.name, h.labels, sep, h.boundsUs[i] / 1e6, cumulative);
+    } else {
+      snprintf(line, sizeof(line), "%s_bucket{%s%sle=\"+Inf\"} %u\n", h.name, h.labels, sep, cumulative);
+    }
+    body += line;
+  }
+  const char* open = h.labels[0] != '\0' ? "{" : "";
+  const char* close = h.labels[0] != '\0' ? "}" : "";
+  snprintf(line, sizeof(line), "%s_sum%s%s%s %.6f\n", h.name, open, h.labels, close, h.sumSec + h.sumUs / 1e6);
+  body += line;
+  snprintf(line, sizeof(line), "%s_count%s%s%s %u\n", h.name, open, h.labels, close, (uint32_t)h.count);
+  body += line;
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+void metricsObserve(MetricHistogram histogram, uint32_t valueUs) {
+  metrics_histogram_t& h = histograms[histogram];
+  uint8_t i = 0;
+  while (i < h.bucketCount && valueUs > h.boundsUs[i]) {
+    i++;
+  }
+  h.buckets[i]++;
+  h.count++;
+
+  // Carry whole seconds out of sumUs; only the task whose compare_exchange succeeds moves them
+  uint32_t current = h.sumUs.fetch_add(valueUs) + valueUs;
+  while (current >= 1000000 && !h.sumUs.compare_exchange_weak(current, current % 1000000)) {
+  }
+  if (current >= 1000000) {
+    h.sumSec += current / 1000000;
+  }
+}
+
+void metricsCount(MetricCounter counter, uint32_t n) {
+  counters[counter] += n;
+}
+
+void metricsThingSpeakResponse(int httpCode) {
+  uint8_t slot;
+  if (httpCode == 200) {
+    slot = 0;
+  } else if (httpCode == 202) {
+    slot = 1;
+  } else if (httpCode >= 400 && httpCode < 500) {
+    slot = 2;
+  } else if (httpCode >= 500) {
+    slot = 3;
+  } else if (httpCode < 0) {
+    slot = 4; // HTTPClient error: connection refused, timeout, ...
+  } else {
+    slot = 5;
+  }
+  thingspeakCodes[slot]++;
+}
+
+void metricsRender(String& body) {
+  char line[128];
+  body.reserve(body.length() + 8192);
+
+  for (uint8_t i = 0; i < METRIC_HISTOGRAM_COUNT; i++) {
+    bool newFamily = i == 0 || strcmp(histograms[i].name, histograms[i - 1].name) != 0;
+    renderHistogram(body, histograms[i], newFamily);
+  }
+
+  for (uint8_t i = 0; i < METRIC_COUNTER_COUNT; i++) {
+    renderHelp(body, counterNames[i][0], counterNames[i][1], "counter");
+    if (i == METRIC_PUMP_ON_MS) {
+      snprintf(line, sizeof(line), "%s %.3f\n", counterNames[i][0], counters[i] / 1000.0);
+    } else {
+      snprintf(line, sizeof(line), "%s %u\n", counterNames[i][0], (uint32_t)counters[i]);
+    }
+    body += line;
+  }
+
+  renderHelp(body, "thingspeak_responses_total", "ThingSpeak HTTP responses by code", "counter");
+  for (uint8_t i = 0; i < 6; i++) {
+    snprintf(line, sizeof(line), "thingspeak_responses_total{code=\"%s\"} %u\n", thingspeakCodeLabels[i], (uint32_t)thingspeakCodes[i]);
+    body += line;
+  }
+
+  FrameBroadcasterStats frames = frameBroadcasterGetStats();
+  renderHelp(body, "camera_frames_captured_total", "Frames taken from the camera driver", "counter");
+  body += "camera_frames_captured_total " + String(frames.captured) + "\n";
+  renderHelp(body, "camera_capture_failures_total", "Failed camera captures", "counter");
+  body += "camera_capture_failures_total " + String(frames.captureFailed) + "\n";
+  renderGauge(body, "stream_clients", "Stream clients currently connected", frames.subscribers);
+
+  SecureClientPoolStats pool = secureClientPoolGetStats();
+  renderHelp(body, "tls_handshakes_total", "TLS handshakes of the upload connection pool", "counter");
+  body += "tls_handshakes_total " + String(pool.handshakes) + "\n";
+  renderHelp(body, "tls_connection_reuses_total", "Requests sent over a kept-alive connection", "counter");
+  body += "tls_connection_reuses_total " + String(pool.reuses) + "\n";
+
+  renderGauge(body, "heap_free_bytes{region=\"internal\"}", "Free heap", heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+  body += "heap_free_bytes{region=\"psram\"} " + String(heap_caps_get_free_size(MALLOC_CAP_SPIRAM)) + "\n";
+  renderGauge(body, "heap_largest_free_block_bytes{region=\"internal\"}", "Largest allocatable block",
+              heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL));
+  body += "heap_largest_free_block_bytes{region=\"psram\"} " + String(heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM)) + "\n";
+  renderGauge(body, "heap_min_free_bytes", "Lowest free internal heap since boot", heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL));
+  if (WiFi.status() == WL_CONNECTED) {
+    renderGauge(body, "wifi_rssi_dbm", "WiFi signal strength", WiFi.RSSI());
+  }
+  renderGauge(body, "upload_queue_depth", "Capture jobs waiting for the upload task", uploadWorkerQueueDepth());
+  renderGauge(body, "upload_spool_depth", "Jobs spooled on the SD card while WiFi was down", uploadWorkerSpoolDepth());
+  renderGauge(body, "thingspeak_batch_pending", "Readings waiting for the next ThingSpeak bulk update", thingspeakBatchPending());
+  CaptureRetentionStats retention = captureRetentionGetStats();
+  renderGauge(body, "capture_images", "Images in /camera", retention.images);
+  renderGauge(body, "capture_bytes", "Size of the images in /camera", (double)retention.bytes);
+  renderGauge(body, "capture_retention_images_per_second", "Deletion throughput of the last retention batch",
+              retention.imagesPerSec);
+  MoistureReading moisture = moistureAdcLatest();
+  renderGauge(body, "moisture_adc_raw", "Filtered raw ADC value of the moisture sensor", moisture.raw);
+  renderGauge(body, "moisture_adc_noise", "Noise of one moisture sensor sample, standard deviation in ADC counts",
+              moisture.noise);
+  renderHelp(body, "moisture_adc_bursts_total", "Sample bursts reduced by the moisture filter", "counter");
+  body += "moisture_adc_bursts_total " + String(moisture.bursts) + "\n";
+  renderHelp(body, "moisture_adc_overflows_total", "DMA frames of the moisture ADC lost because the task was late", "counter");
+  body += "moisture_adc_overflows_total " + String(moisture.overflows) + "\n";
+  renderGauge(body, "pump_state", "Pump cycle state of zone 0 (0 idle, 1 watering, 2 soaking, 3 waiting)", getPumpState());
+  PumpZoneStats zones = pumpZonesGetStats();
+  renderGauge(body, "pump_zones_active", "Zones watering now", zones.active);
+  renderGauge(body, "pump_zones_waiting", "Zones waiting for a pump", zones.waiting);
+  renderGauge(body, "pump_zones_peak_active", "Most zones watering at the same time since boot", zones.peakActive);
+  renderGauge(body, "pump_zone_max_wait_seconds", "Longest wait of a zone for a pump", zones.maxWaitMs / 1000.0);
+  WateringEstimate model = wateringModelGetEstimate(0);
+  renderGauge(body, "watering_model_predictive", "1 if the waterings are dosed by the model", wateringModelGetMode() == WATERING_PREDICTIVE);
+  renderGauge(body, "watering_model_gain", "Learned moisture gain of zone 0 per second of pumping, %", model.gain);
+  renderGauge(body, "watering_model_response_seconds", "Learned response time of zone 0", model.responseS);
+  renderGauge(body, "watering_model_drying_per_hour", "Learned drying rate of zone 0, %", model.dryingPerHour);
+  renderGauge(body, "watering_model_last_error", "Settled moisture minus prediction for the last learned watering, %", model.lastError);
+
+  SchedulerTaskStats tasks[SCHEDULER_MAX_TASKS];
+  uint8_t taskCount = schedulerGetStats(tasks, SCHEDULER_MAX_TASKS);
+  renderHelp(body, "scheduler_task_runs_total", "Runs of each loop() task (task_scheduler.cpp)", "counter");
+  for (uint8_t i = 0; i < taskCount; i++) {
+    snprintf(line, sizeof(line), "scheduler_task_runs_total{task=\"%s\"} %u\n", tasks[i].name, tasks[i].runs);
+    body += line;
+  }
+  renderHelp(body, "scheduler_task_skipped_total", "Periods skipped because the task ran more than a period late", "counter");
+  for (uint8_t i = 0; i < taskCount; i++) {
+    snprintf(line, sizeof(line), "scheduler_task_skipped_total{task=\"%s\"} %u\n", tasks[i].name, tasks[i].skipped);
+    body += line;
+  }
+  renderHelp(body, "scheduler_task_run_seconds_total", "Execution time of each loop() task", "counter");
+  for (uint8_t i = 0; i < taskCount; i++) {
+    snprintf(line, sizeof(line), "scheduler_task_run_seconds_total{task=\"%s\"} %.6f\n", tasks[i].name, tasks[i].totalUs / 1e6);
+    body += line;
+  }
+  renderHelp(body, "scheduler_task_run_seconds_max", "Longest run of each loop() task", "gauge");
+  for (uint8_t i = 0; i < taskCount; i++) {
+    snprintf(line, sizeof(line), "scheduler_task_run_seconds_max{task=\"%s\"} %.6f\n", tasks[i].name, tasks[i].maxUs / 1e6);
+    body += line;
+  }
+  renderHelp(body, "scheduler_task_lateness_seconds_max", "Longest delay of a run after its deadline", "gauge");
+  for (uint8_t i = 0; i < taskCount; i++) {
+    snprintf(line, sizeof(line), "scheduler_task_lateness_seconds_max{task=\"%s\"} %.3f\n", tasks[i].name, tasks[i].maxLateMs / 1e3);
+    body += line;
+  }
+  renderGauge(body, "uptime_seconds", "Time since boot", millis() / 1000.0);
+}
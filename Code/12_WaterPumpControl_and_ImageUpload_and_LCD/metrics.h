@@ -0,0 +1,59 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Latency histograms. All values are observed in microseconds and exported in seconds.
+ */
+enum MetricHistogram {
+  METRIC_FRAME_CAPTURE,     // esp_camera_fb_get() plus the copy into a shared frame (frame_broadcaster.cpp)
+  METRIC_FRAME_SEND,        // Sending one frame to one stream client (app_httpd.cpp)
+  METRIC_UPLOAD_DRIVE,      // One Google Drive upload, including the redirect (upload_worker.cpp)
+  METRIC_UPLOAD_THINGSPEAK, // One ThingSpeak update or bulk update
+  METRIC_LOOP,              // One loop() iteration that ran tasks (the idle wait excluded)
+  METRIC_SD_WRITE,          // One JPEG written to the SD card by writejpg(), open to close (sd_read_write.cpp)
+  METRIC_UPLOAD_QUEUE_WAIT, // Time a capture job waited in the upload queue, e.g. behind a retention batch (upload_worker.cpp)
+  METRIC_RETENTION_DELETE,  // Deleting one image and its index record (capture_retention.cpp)
+  METRIC_LCD_UPDATE,        // One lcdDashboardUpdate(): status, redraw and the transfer to the panel
+  METRIC_LCD_FRAME,         // Time one LCD frame keeps its caller busy: redraw and queueing the dirty rectangles (LGFX_ESP32_ST7789.cpp)
+  METRIC_HISTOGRAM_COUNT
+};
+
+/**
+ * @brief Event counters.
+ */
+enum MetricCounter {
+  METRIC_PUMP_CYCLES,       // Completed watering cycles
+  METRIC_PUMP_ON_MS,        // Total relay on-time in milliseconds
+  METRIC_DRIVE_FAILED,      // Failed Google Drive uploads
+  METRIC_STREAM_FRAMES,     // Frames sent to stream clients
+  METRIC_RETENTION_DELETED, // Images deleted by the retention manager
+  METRIC_LCD_SPI_BYTES,     // Bytes sent to the LCD panel
+  METRIC_COUNTER_COUNT
+};
+
+/**
+ * @brief Records one latency value. Lock-free (32-bit atomics only), so it can be called from any task or the esp_timer callback.
+ * @param histogram The histogram to update.
+ * @param valueUs The measured duration in microseconds.
+ */
+void metricsObserve(MetricHistogram histogram, uint32_t valueUs);
+
+/**
+ * @brief Adds to an event counter. Lock-free, can be called from any task.
+ */
+void metricsCount(MetricCounter counter, uint32_t n = 1);
+
+/**
+ * @brief Counts one ThingSpeak HTTP response by code (200, 202, 4xx, 5xx, or negative for a connection error).
+ */
+void metricsThingSpeakResponse(int httpCode);
+
+/**
+ * @brief Appends all metrics to body in the Prometheus text format (version 0.0.4): the histograms and counters above,
+ *        plus gauges read at call time (heap and PSRAM, largest free block, WiFi RSSI, queue depths, pump state).
+ */
+void metricsRender(String& body);
+
+#endif
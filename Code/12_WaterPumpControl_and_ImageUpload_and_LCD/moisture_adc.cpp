@@ -0,0 +1,207 @@
+/**
+ * moisture_adc.cpp
+ *
+ * Background sampling of the soil moisture sensors with the ESP-IDF ADC continuous (DMA) driver. The ADC scans the
+ * sensors in turn and fills frames of MOISTURE_ADC_BURST samples per sensor without the CPU; at the end of each frame
+ * the driver's callback wakes a small task, which reduces each sensor's samples with its own filter
+ * (moisture_filter.cpp) and publishes the filtered values and noise estimates under a spinlock. loop() and the sensor
+ * log only copy the published readings, so a reading costs them nothing and can never be a single disturbed sample.
+ *
+ * Author: John Leung
+ * Date: October 16, 2026
+ */
+#include "moisture_adc.h"
+#include "esp_adc/adc_continuous.h"
+#include "esp_idf_version.h"
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 2, 0)
+#define MOISTURE_ADC_ATTEN  ADC_ATTEN_DB_12
+#else
+#define MOISTURE_ADC_ATTEN  ADC_ATTEN_DB_11     // Same 0-3.1 V range as analogRead(), renamed in ESP-IDF 5.2
+#endif
+#define MAX_FRAME_BYTES     (MOISTURE_ADC_MAX_SENSORS * MOISTURE_ADC_BURST * SOC_ADC_DIGI_RESULT_BYTES)
+
+static uint8_t sensorCount = 0;
+static uint8_t sensorPins[MOISTURE_ADC_MAX_SENSORS];
+static int8_t sensorOfChannel[MOISTURE_ADC_MAX_SENSORS];   // ADC1 channel -> sensor, -1 if not sampled
+static uint32_t frameBytes = 0;
+static adc_continuous_handle_t adcHandle = NULL;
+static TaskHandle_t adcTaskHandle = NULL;
+static moisture_filter_t filters[MOISTURE_ADC_MAX_SENSORS];   // Owned by the ADC task, or by moistureAdcRead() without the driver
+static volatile uint32_t overflowCount = 0;
+static portMUX_TYPE readingMux = portMUX_INITIALIZER_UNLOCKED;
+static MoistureReading published[MOISTURE_ADC_MAX_SENSORS];
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+/**
+ * @brief Driver callback (ISR) at the end of each DMA frame: wakes the ADC task.
+ */
+static bool IRAM_ATTR adcFrameDone(adc_continuous_handle_t handle, const adc_continuous_evt_data_t* edata, void* arg) {
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(adcTaskHandle, &woken);
+  return woken == pdTRUE;
+}
+
+/**
+ * @brief Driver callback (ISR) when its buffer is full because the task did not read it in time.
+ */
+static bool IRAM_ATTR adcPoolOverflow(adc_continuous_handle_t handle, const adc_continuous_evt_data_t* edata, void* arg) {
+  overflowCount++;
+  return false;
+}
+
+static void publish(uint8_t sensor, bool dma) {
+  const moisture_filter_t& filter = filters[sensor];
+  portENTER_CRITICAL(&readingMux);
+  MoistureReading& reading = published[sensor];
+  reading.raw = moistureFilterValue(filter);
+  reading.noise = filter.noise;
+  reading.bursts = filter.bursts;
+  reading.overflows = overflowCount;
+  reading.dma = dma;
+  portEXIT_CRITICAL(&readingMux);
+}
+
+/**
+ * @brief Reads every frame the driver holds (one notification may stand for several), sorts the samples by sensor and
+ *        filters each sensor's samples as one burst.
+ */
+static void adcTask(void* arg) {
+  static uint8_t frame[MAX_FRAME_BYTES];
+  static uint16_t samples[MOISTURE_ADC_MAX_SENSORS][MOISTURE_ADC_BURST];
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    uint32_t length = 0;
+    while (adc_continuous_read(adcHandle, frame, frameBytes, &length, 0) == ESP_OK) {
+      size_t counts[MOISTURE_ADC_MAX_SENSORS] = {0};
+      for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= length; i += SOC_ADC_DIGI_RESULT_BYTES) {
+        const adc_digi_output_data_t* result = (const adc_digi_output_data_t*)&frame[i];
+        int8_t sensor = result->type2.channel < MOISTURE_ADC_MAX_SENSORS ? sensorOfChannel[result->type2.channel] : -1;
+        if (sensor >= 0 && counts[sensor] < MOISTURE_ADC_BURST) {
+          samples[sensor][counts[sensor]++] = result->type2.data;
+        }
+      }
+      for (uint8_t sensor = 0; sensor < sensorCount; sensor++) {
+        if (moistureFilterAddBurst(filters[sensor], samples[sensor], counts[sensor])) {
+          publish(sensor, true);
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief Frees what moistureAdcBegin() set up before it failed.
+ */
+static bool adcAbort(const char* step) {
+  Serial.printf("moistureAdcBegin(): %s failed, the sensor is read with analogRead()\n", step);
+  if (adcTaskHandle != NULL) {
+    vTaskDelete(adcTaskHandle);
+    adcTaskHandle = NULL;
+  }
+  if (adcHandle != NULL) {
+    adc_continuous_deinit(adcHandle);
+    adcHandle = NULL;
+  }
+  return false;
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+bool moistureAdcBegin(const uint8_t* pins, uint8_t count) {
+  sensorCount = min(count, (uint8_t)MOISTURE_ADC_MAX_SENSORS);
+  memset(sensorOfChannel, -1, sizeof(sensorOfChannel));
+  memset(published, 0, sizeof(published));
+  adc_digi_pattern_config_t patterns[MOISTURE_ADC_MAX_SENSORS];
+  bool channelsOk = true;
+  for (uint8_t sensor = 0; sensor < sensorCount; sensor++) {
+    sensorPins[sensor] = pins[sensor];
+    moistureFilterReset(filters[sensor]);
+    adc_unit_t unit;
+    adc_channel_t channel;
+    // ADC2 is shared with WiFi
+    if (adc_continuous_io_to_channel(pins[sensor], &unit, &channel) != ESP_OK || unit != ADC_UNIT_1) {
+      channelsOk = false;
+      continue;
+    }
+    sensorOfChannel[channel] = sensor;
+    patterns[sensor] = {
+      .atten = MOISTURE_ADC_ATTEN,
+      .channel = (uint8_t)channel,
+      .unit = ADC_UNIT_1,
+      .bit_width = SOC_ADC_DIGI_MAX_BITWIDTH,
+    };
+  }
+  if (!channelsOk || sensorCount == 0) {
+    return adcAbort("ADC1 channel lookup");
+  }
+
+  // One frame holds a burst of every sensor, the pattern converts them in turn
+  frameBytes = sensorCount * MOISTURE_ADC_BURST * SOC_ADC_DIGI_RESULT_BYTES;
+  adc_continuous_handle_cfg_t handleConfig = {};  // The flags of newer ESP-IDF versions stay 0
+  handleConfig.max_store_buf_size = MOISTURE_ADC_FRAMES * frameBytes;
+  handleConfig.conv_frame_size = frameBytes;
+  if (adc_continuous_new_handle(&handleConfig, &adcHandle) != ESP_OK) {
+    return adcAbort("adc_continuous_new_handle()");
+  }
+  adc_continuous_config_t config = {
+    .pattern_num = sensorCount,
+    .adc_pattern = patterns,
+    .sample_freq_hz = (uint32_t)MOISTURE_ADC_SAMPLE_HZ * sensorCount,
+    .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+    .format = ADC_DIGI_OUTPUT_FORMAT_TYPE2,
+  };
+  if (adc_continuous_config(adcHandle, &config) != ESP_OK) {
+    return adcAbort("adc_continuous_config()");
+  }
+  adc_continuous_evt_cbs_t callbacks = {
+    .on_conv_done = adcFrameDone,
+    .on_pool_ovf = adcPoolOverflow,
+  };
+  if (adc_continuous_register_event_callbacks(adcHandle, &callbacks, NULL) != ESP_OK) {
+    return adcAbort("adc_continuous_register_event_callbacks()");
+  }
+  // The task exists before the first frame can call back
+  if (xTaskCreatePinnedToCore(adcTask, "moisture_adc", MOISTURE_ADC_TASK_STACK, NULL, MOISTURE_ADC_TASK_PRIORITY,
+                              &adcTaskHandle, MOISTURE_ADC_TASK_CORE) != pdPASS) {
+    return adcAbort("creating the ADC task");
+  }
+  if (adc_continuous_start(adcHandle) != ESP_OK) {
+    return adcAbort("adc_continuous_start()");
+  }
+  Serial.printf("Moisture ADC: %u sensor(s) sampled at %u Hz each by DMA, %u samples per burst\n", sensorCount,
+                MOISTURE_ADC_SAMPLE_HZ, MOISTURE_ADC_BURST);
+  return true;
+}
+
+MoistureReading moistureAdcRead(uint8_t sensor) {
+  if (sensor >= sensorCount) {
+    return MoistureReading{0, 0, 0, 0, false};
+  }
+  if (adcHandle == NULL) {
+    uint16_t samples[MOISTURE_ADC_BURST];
+    for (size_t i = 0; i < MOISTURE_ADC_BURST; i++) {
+      samples[i] = analogRead(sensorPins[sensor]);
+    }
+    moistureFilterAddBurst(filters[sensor], samples, MOISTURE_ADC_BURST);
+    publish(sensor, false);
+    return moistureAdcLatest(sensor);
+  }
+  MoistureReading reading = moistureAdcLatest(sensor);
+  for (uint32_t waited = 0; reading.bursts == 0 && waited < MOISTURE_ADC_FIRST_WAIT_MS; waited += 10) {
+    delay(10);
+    reading = moistureAdcLatest(sensor);
+  }
+  return reading;
+}
+
+MoistureReading moistureAdcLatest(uint8_t sensor) {
+  MoistureReading reading = {0, 0, 0, 0, false};
+  if (sensor < sensorCount) {
+    portENTER_CRITICAL(&readingMux);
+    reading = published[sensor];
+    portEXIT_CRITICAL(&readingMux);
+  }
+  return reading;
+}
@@ -0,0 +1,56 @@
+#ifndef MOISTURE_ADC_H
+#define MOISTURE_ADC_H
+
+#include <Arduino.h>
+#include "moisture_filter.h"
+
+#define MOISTURE_ADC_MAX_SENSORS    10      // ADC1 has 10 channels (GPIO 1-10 on the ESP32-S3)
+#define MOISTURE_ADC_SAMPLE_HZ      1000    // DMA sample rate per sensor (the ESP32-S3 cannot go below 611 Hz in total)
+#define MOISTURE_ADC_BURST          64      // Samples per sensor in a DMA frame, reduced to one value: ~16 bursts per second
+#define MOISTURE_ADC_FRAMES         4       // DMA frames the driver buffers for the task
+#define MOISTURE_ADC_TASK_STACK     4096
+#define MOISTURE_ADC_TASK_PRIORITY  2       // Above loop(), it only wakes up once per frame
+#define MOISTURE_ADC_TASK_CORE      0       // loop() runs on core 1
+#define MOISTURE_ADC_FIRST_WAIT_MS  200     // How long moistureAdcRead() waits for the first burst after boot
+
+/**
+ * @brief The published state of the moisture ADC.
+ * raw       Filtered raw ADC value (4095 dry, ~1300 in water with the default calibration).
+ * noise     Noise estimate, one standard deviation of a single sample in raw ADC counts.
+ * bursts    Bursts reduced since moistureAdcBegin().
+ * overflows DMA frames lost because the task was late.
+ * dma       true if the value comes from the DMA driver, false if it was sampled by moistureAdcRead() itself.
+ */
+typedef struct {
+  uint16_t raw;
+  float noise;
+  uint32_t bursts;
+  uint32_t overflows;
+  bool dma;
+} MoistureReading;
+
+/**
+ * @brief Starts sampling the moisture sensors in the background: the ADC continuous driver scans the sensors in turn and
+ *        fills DMA frames of MOISTURE_ADC_BURST samples per sensor; a task reduces each sensor's samples with its own
+ *        filter (moisture_filter.cpp) and publishes the results. analogRead() must not be used on the ADC1 pins
+ *        afterwards, the driver owns the unit.
+ * @param pins GPIOs of the sensors, ADC1 pins. Sensor n of the other functions is pins[n].
+ * @param count Number of sensors, at most MOISTURE_ADC_MAX_SENSORS.
+ * @return true if the driver runs; false if it could not be started, moistureAdcRead() then samples with analogRead().
+ */
+bool moistureAdcBegin(const uint8_t* pins, uint8_t count);
+
+/**
+ * @brief Returns the latest filtered reading of a sensor. With the driver running this only copies the published value
+ *        (it waits for the first burst right after moistureAdcBegin()). Without the driver, it samples a burst with
+ *        analogRead() (~1 ms) and filters it: call it from one task only, e.g. loop().
+ */
+MoistureReading moistureAdcRead(uint8_t sensor = 0);
+
+/**
+ * @brief Returns the last published reading of a sensor without sampling, from any task (e.g. for /metrics). bursts is
+ *        0 before the first one.
+ */
+MoistureReading moistureAdcLatest(uint8_t sensor = 0);
+
+#endif
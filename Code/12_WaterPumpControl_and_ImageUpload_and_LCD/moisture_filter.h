@@ -0,0 +1,50 @@
+#ifndef MOISTURE_FILTER_H
+#define MOISTURE_FILTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define MOISTURE_FILTER_BURST_MAX   256     // Samples per burst at most
+#define MOISTURE_FILTER_MEDIAN      3       // The median of the last 3 burst values goes into the IIR
+#define MOISTURE_FILTER_IIR_WEIGHT  0.125f  // Weight of a new burst in the IIR: ~8 bursts to settle
+
+/**
+ * @brief State of the moisture filter, a plain struct so that the host build can run it on recorded traces.
+ * bursts   Bursts added since the last moistureFilterReset().
+ * value    Filtered raw ADC value.
+ * noise    Filtered noise estimate of the samples, one standard deviation in raw ADC counts.
+ * spread   Noise estimate of the last burst alone.
+ */
+typedef struct {
+  uint16_t recent[MOISTURE_FILTER_MEDIAN];
+  uint32_t bursts;
+  float value;
+  float noise;
+  float spread;
+} moisture_filter_t;
+
+/**
+ * @brief Clears the filter, the next burst sets the value directly.
+ */
+void moistureFilterReset(moisture_filter_t& filter);
+
+/**
+ * @brief Reduces one burst of raw ADC samples and adds it to the filter:
+ *        - the samples are sorted and the middle half is averaged (interquartile mean), so that up to a quarter of the
+ *          burst can be spikes, e.g. while WiFi transmits, without moving the result;
+ *        - the spread of the middle half (interquartile range / 1.349) estimates the noise of a single sample;
+ *        - the median of the last MOISTURE_FILTER_MEDIAN burst values rejects a whole burst that was disturbed;
+ *        - a first-order IIR with MOISTURE_FILTER_IIR_WEIGHT smooths what is left.
+ *        64 samples take a few microseconds; there is no allocation.
+ * @param samples The 12-bit samples, sorted in place. Samples above 4095 are ignored.
+ * @param count Number of samples, at most MOISTURE_FILTER_BURST_MAX.
+ * @return false if the burst held no valid sample (the filter is unchanged).
+ */
+bool moistureFilterAddBurst(moisture_filter_t& filter, uint16_t* samples, size_t count);
+
+/**
+ * @brief The filtered raw ADC value, rounded. Only valid once filter.bursts > 0.
+ */
+uint16_t moistureFilterValue(const moisture_filter_t& filter);
+
+#endif
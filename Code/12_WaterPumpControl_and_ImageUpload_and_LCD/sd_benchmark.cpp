@@ -0,0 +1,453 @@
+/**
+ * sd_benchmark.cpp
+ *
+ * SD storage benchmark. testFileIO() only times 512-byte reads and 1 MB of 512-byte writes, which says little about how
+ * the card behaves with our JPEG frames. This suite sweeps the block size from 512 B to 64 KB for sequential and random
+ * access, compares one file per frame with frames appended to one file, measures how file creation, lookup and listing
+ * slow down as a directory fills up, and repeats everything at several SD_MMC.begin() clocks.
+ *
+ * It only uses fs::FS, so the same code runs on the board (SD_MMC) and in host_sim, where the card is a host directory:
+ * ./plant_sim --sd-bench csv gives the numbers of the PC's disk to compare with.
+ *
+ * Author: John Leung
+ * Date: October 16, 2026
+ */
+#include "sd_benchmark.h"
+#include "sd_read_write.h"
+#include "esp_heap_caps.h"
+
+const SdBenchConfig sdBenchDefaultConfig = {
+    SD_BENCH_FILE_SIZE, SD_BENCH_RANDOM_OPS, SD_BENCH_FRAME_SIZE, SD_BENCH_FRAMES, SD_BENCH_DIR_FILES
+};
+
+static const uint32_t dirSteps[] = {0, 100, 250, 500, 1000, 2000, 5000};  // Directory sizes measured, up to dirFiles
+#define DIR_PROBES 10   // Creates and lookups timed at each directory size
+
+typedef struct {
+    const char * test;
+    uint32_t blockSize;
+    uint32_t files;
+    uint32_t bytes;
+    uint32_t ops;
+    uint32_t totalUs;
+    uint32_t maxOpUs;
+} bench_result_t;
+
+typedef struct {
+    fs::FS *fs;
+    Print *out;
+    SdBenchFormat format;
+    const SdBenchConfig *config;
+    uint32_t freqKhz;
+    uint8_t *buf;           // SD_BENCH_BLOCK_MAX bytes, DMA-capable internal RAM if there is enough
+    uint32_t rows;          // Results written so far, for the JSON separators
+} bench_ctx_t;
+
+static SemaphoreHandle_t benchMutex = NULL;
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+static void emitBegin(bench_ctx_t &ctx){
+    if(ctx.format == SD_BENCH_JSON){
+        ctx.out->print("[\n");
+    } else {
+        ctx.out->print("test,freq_khz,block_bytes,files,bytes,ops,total_us,mb_per_s,avg_op_us,max_op_us\n");
+    }
+}
+
+static void emitEnd(bench_ctx_t &ctx){
+    if(ctx.format == SD_BENCH_JSON){
+        ctx.out->print("\n]\n");
+    }
+}
+
+static void emit(bench_ctx_t &ctx, const bench_result_t &r){
+    float mbPerSec = r.totalUs > 0 ? (float)r.bytes / r.totalUs : 0;  // bytes per us = MB/s
+    uint32_t avgUs = r.ops > 0 ? r.totalUs / r.ops : 0;
+    if(ctx.format == SD_BENCH_JSON){
+        ctx.out->printf("%s{\"test\":\"%s\",\"freq_khz\":%u,\"block_bytes\":%u,\"files\":%u,\"bytes\":%u,\"ops\":%u,"
+                        "\"total_us\":%u,\"mb_per_s\":%.3f,\"avg_op_us\":%u,\"max_op_us\":%u}",
+                        ctx.rows > 0 ? ",\n" : "", r.test, ctx.freqKhz, r.blockSize, r.files, r.bytes, r.ops,
+                        r.totalUs, mbPerSec, avgUs, r.maxOpUs);
+    } else {
+        ctx.out->printf("%s,%u,%u,%u,%u,%u,%u,%.3f,%u,%u\n", r.test, ctx.freqKhz, r.blockSize, r.files, r.bytes, r.ops,
+                        r.totalUs, mbPerSec, avgUs, r.maxOpUs);
+    }
+    ctx.rows++;
+}
+
+static void resultInit(bench_result_t &r, const char * test, uint32_t blockSize, uint32_t files){
+    memset(&r, 0, sizeof(r));
+    r.test = test;
+    r.blockSize = blockSize;
+    r.files = files;
+}
+
+/**
+ * @brief Adds the time of one operation, started at 'start' (micros()), to a result.
+ */
+static void resultOp(bench_result_t &r, uint32_t start, uint32_t bytes){
+    uint32_t elapsed = micros() - start;
+    r.ops++;
+    r.bytes += bytes;
+    r.totalUs += elapsed;
+    if(elapsed > r.maxOpUs){
+        r.maxOpUs = elapsed;
+    }
+}
+
+static String benchPath(const char * name){
+    return String(SD_BENCH_ROOT) + "/" + name;
+}
+
+static String dirFilePath(uint32_t i){
+    return String(SD_BENCH_ROOT) + "/dir/" + String(i) + ".jpg";
+}
+
+/**
+ * @brief Removes every file of a directory, then the directory. Names are collected before removing, a few at a time,
+ *        so the directory is not modified while it is being listed.
+ */
+static void removeTree(fs::FS &fs, const char * dirname){
+    const uint8_t batch = 32;
+    String names[batch];
+    bool isDir[batch];
+    while(true){
+        File root = fs.open(dirname);
+        if(!root || !root.isDirectory()){
+            return;
+        }
+        uint8_t n = 0;
+        File file = root.openNextFile();
+        while(file && n < batch){
+            names[n] = String(file.path());
+            isDir[n++] = file.isDirectory();
+            file = root.openNextFile();
+        }
+        file.close();
+        root.close();
+        if(n == 0){
+            break;
+        }
+        for(uint8_t i = 0; i < n; i++){
+            if(isDir[i]){
+                removeTree(fs, names[i].c_str());
+            } else {
+                fs.remove(names[i]);
+            }
+        }
+    }
+    fs.rmdir(dirname);
+}
+
+static void fillPattern(uint8_t *buf, size_t size){
+    for(size_t i = 0; i < size; i++){
+        buf[i] = (uint8_t)(i * 31 + 7);   // Not all zeros, in case the card or the host compresses
+    }
+}
+
+/**
+ * @brief Writes the large file from start to end in blocks, timing each write; the final flush counts as one more op.
+ */
+static void seqWrite(bench_ctx_t &ctx, uint32_t blockSize){
+    bench_result_t r;
+    resultInit(r, "seq_write", blockSize, 1);
+    File file = ctx.fs->open(benchPath("large.bin"), FILE_WRITE);
+    if(!file){
+        Serial.println("# seq_write: cannot create the file");
+        return;
+    }
+    for(uint32_t offset = 0; offset < ctx.config->fileSize; offset += blockSize){
+        uint32_t start = micros();
+        if(file.write(ctx.buf, blockSize) != blockSize){
+            Serial.println("# seq_write: write failed, card full?");
+            break;
+        }
+        resultOp(r, start, blockSize);
+    }
+    uint32_t start = micros();
+    file.flush();
+    resultOp(r, start, 0);
+    file.close();
+    emit(ctx, r);
+}
+
+static void seqRead(bench_ctx_t &ctx, uint32_t blockSize){
+    bench_result_t r;
+    resultInit(r, "seq_read", blockSize, 1);
+    File file = ctx.fs->open(benchPath("large.bin"));
+    if(!file){
+        return;
+    }
+    while(true){
+        uint32_t start = micros();
+        size_t n = file.read(ctx.buf, blockSize);
+        if(n == 0){
+            break;
+        }
+        resultOp(r, start, n);
+    }
+    file.close();
+    emit(ctx, r);
+}
+
+/**
+ * @brief Block-aligned reads or writes at random offsets of the large file.
+ */
+static void randomAccess(bench_ctx_t &ctx, uint32_t blockSize, bool write){
+    bench_result_t r;
+    resultInit(r, write ? "rand_write" : "rand_read", blockSize, 1);
+    File file = ctx.fs->open(benchPath("large.bin"), write ? "r+" : FILE_READ);
+    if(!file){
+        return;
+    }
+    uint32_t blocks = ctx.config->fileSize / blockSize;
+    for(uint32_t i = 0; i < ctx.config->randomOps && blocks > 0; i++){
+        uint32_t offset = (uint32_t)random(blocks) * blockSize;
+        uint32_t start = micros();
+        bool ok = file.seek(offset) &&
+                  (write ? file.write(ctx.buf, blockSize) : file.read(ctx.buf, blockSize)) == blockSize;
+        if(!ok){
+            Serial.printf("# %s: failed at offset %u\n", r.test, offset);
+            break;
+        }
+        resultOp(r, start, blockSize);
+    }
+    if(write){
+        uint32_t start = micros();
+        file.flush();
+        resultOp(r, start, 0);
+    }
+    file.close();
+    emit(ctx, r);
+}
+
+/**
+ * @brief One file per frame (open, write, flush, close, like writejpg()) versus frames appended to one open file with a
+ *        flush after each, then both read back frame by frame.
+ */
+static void framesTest(bench_ctx_t &ctx){
+    const SdBenchConfig &c = *ctx.config;
+    uint8_t *frame = (uint8_t *)(psramFound() ? ps_malloc(c.frameSize) : malloc(c.frameSize));
+    if(frame == NULL){
+        Serial.println("# frames: not enough memory for a frame");
+        return;
+    }
+    fillPattern(frame, c.frameSize);
+    ctx.fs->mkdir(benchPath("frames"));
+
+    bench_result_t r;
+    resultInit(r, "small_files_write", c.frameSize, c.frames);
+    for(uint32_t i = 0; i < c.frames; i++){
+        uint32_t start = micros();
+        File file = ctx.fs->open(benchPath("frames/") + String(i) + ".jpg", FILE_WRITE);
+        if(!file || file.write(frame, c.frameSize) != c.frameSize){
+            Serial.println("# small_files_write: write failed");
+            break;
+        }
+        file.flush();
+        file.close();
+        resultOp(r, start, c.frameSize);
+    }
+    emit(ctx, r);
+
+    resultInit(r, "one_file_write", c.frameSize, 1);
+    File large = ctx.fs->open(benchPath("frames.bin"), FILE_WRITE);
+    for(uint32_t i = 0; large && i < c.frames; i++){
+        uint32_t start = micros();
+        if(large.write(frame, c.frameSize) != c.frameSize){
+            Serial.println("# one_file_write: write failed");
+            break;
+        }
+        large.flush();
+        resultOp(r, start, c.frameSize);
+    }
+    large.close();
+    emit(ctx, r);
+
+    resultInit(r, "small_files_read", c.frameSize, c.frames);
+    for(uint32_t i = 0; i < c.frames; i++){
+        uint32_t start = micros();
+        File file = ctx.fs->open(benchPath("frames/") + String(i) + ".jpg");
+        if(!file || file.read(frame, c.frameSize) != c.frameSize){
+            break;
+        }
+        file.close();
+        resultOp(r, start, c.frameSize);
+    }
+    emit(ctx, r);
+
+    resultInit(r, "one_file_read", c.frameSize, 1);
+    large = ctx.fs->open(benchPath("frames.bin"));
+    for(uint32_t i = 0; large && i < c.frames; i++){
+        uint32_t start = micros();
+        if(large.read(frame, c.frameSize) != c.frameSize){
+            break;
+        }
+        resultOp(r, start, c.frameSize);
+    }
+    large.close();
+    emit(ctx, r);
+
+    free(frame);
+    removeTree(*ctx.fs, benchPath("frames").c_str());
+    ctx.fs->remove(benchPath("frames.bin"));
+}
+
+/**
+ * @brief Fills a directory with 512-byte files, and at each size of dirSteps times creating a file, looking up a name
+ *        that does not exist (what fs.exists() costs the capture index) and listing the directory (what readFileNum() costs).
+ */
+static void directoryTest(bench_ctx_t &ctx){
+    String dir = benchPath("dir");
+    ctx.fs->mkdir(dir);
+    uint32_t files = 0;
+    for(uint8_t step = 0; step < sizeof(dirSteps) / sizeof(dirSteps[0]); step++){
+        uint32_t target = dirSteps[step];
+        if(target > ctx.config->dirFiles){
+            break;
+        }
+        for(; files < target; files++){
+            File file = ctx.fs->open(dirFilePath(files), FILE_WRITE);
+            if(!file){
+                Serial.printf("# dir: cannot create file %u\n", files);
+                return;
+            }
+            file.write(ctx.buf, 512);
+            file.close();
+        }
+
+        bench_result_t r;
+        resultInit(r, "dir_create", 512, files);
+        for(uint32_t i = 0; i < DIR_PROBES; i++){
+            uint32_t start = micros();
+            File file = ctx.fs->open(dirFilePath(files + i), FILE_WRITE);
+            if(file){
+                file.write(ctx.buf, 512);
+                file.close();
+            }
+            resultOp(r, start, 512);
+        }
+        emit(ctx, r);
+        for(uint32_t i = 0; i < DIR_PROBES; i++){
+            ctx.fs->remove(dirFilePath(files + i));   // Back to 'files' entries
+        }
+
+        resultInit(r, "dir_exists", 0, files);
+        for(uint32_t i = 0; i < DIR_PROBES; i++){
+            uint32_t start = micros();
+            ctx.fs->exists(dirFilePath(1000000 + i));
+            resultOp(r, start, 0);
+        }
+        emit(ctx, r);
+
+        resultInit(r, "dir_scan", 0, files);
+        uint32_t start = micros();
+        readFileNum(*ctx.fs, dir.c_str());
+        resultOp(r, start, 0);
+        emit(ctx, r);
+        Serial.printf("# dir: %u files done\n", files);
+    }
+    removeTree(*ctx.fs, dir.c_str());
+}
+
+/**
+ * @brief One pass of every test, without the CSV header or the JSON brackets.
+ */
+static bool runSuite(bench_ctx_t &ctx){
+    removeTree(*ctx.fs, SD_BENCH_ROOT);   // Left over by a run that was cut short
+    if(!ctx.fs->mkdir(SD_BENCH_ROOT)){
+        Serial.printf("# Cannot create %s\n", SD_BENCH_ROOT);
+        return false;
+    }
+    uint32_t start = millis();
+    for(uint32_t block = SD_BENCH_BLOCK_MIN; block <= SD_BENCH_BLOCK_MAX; block *= 2){
+        seqWrite(ctx, block);
+        seqRead(ctx, block);
+        randomAccess(ctx, block, true);
+        randomAccess(ctx, block, false);
+        Serial.printf("# %u byte blocks done\n", block);
+    }
+    ctx.fs->remove(benchPath("large.bin"));
+    framesTest(ctx);
+    directoryTest(ctx);
+    removeTree(*ctx.fs, SD_BENCH_ROOT);
+    Serial.printf("# Benchmark pass at %u kHz done in %u s\n", ctx.freqKhz, (uint32_t)(millis() - start) / 1000);
+    return true;
+}
+
+/**
+ * @brief Takes the benchmark lock and allocates the block buffer; false if another run holds the lock.
+ */
+static bool benchBegin(bench_ctx_t &ctx, Print &out, SdBenchFormat format, const SdBenchConfig *config){
+    if(benchMutex == NULL){
+        benchMutex = xSemaphoreCreateMutex();
+    }
+    if(xSemaphoreTake(benchMutex, 0) != pdTRUE){
+        Serial.println("# A benchmark is already running");
+        return false;
+    }
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.out = &out;
+    ctx.format = format;
+    ctx.config = config != NULL ? config : &sdBenchDefaultConfig;
+    // Internal RAM like the writejpg() staging buffer, so the block sweep measures the card and not PSRAM bounce copies
+    ctx.buf = (uint8_t *)heap_caps_malloc(SD_BENCH_BLOCK_MAX, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    if(ctx.buf == NULL){
+        Serial.println("# No internal RAM for the block buffer, using PSRAM");
+        ctx.buf = (uint8_t *)(psramFound() ? ps_malloc(SD_BENCH_BLOCK_MAX) : malloc(SD_BENCH_BLOCK_MAX));
+    }
+    if(ctx.buf == NULL){
+        xSemaphoreGive(benchMutex);
+        return false;
+    }
+    fillPattern(ctx.buf, SD_BENCH_BLOCK_MAX);
+    emitBegin(ctx);
+    return true;
+}
+
+static void benchEnd(bench_ctx_t &ctx){
+    emitEnd(ctx);
+    heap_caps_free(ctx.buf);   // Frees ps_malloc() and malloc() memory as well
+    xSemaphoreGive(benchMutex);
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+bool sdBenchmarkRun(fs::FS &fs, Print &out, SdBenchFormat format, uint32_t freqKhz, const SdBenchConfig *config){
+    bench_ctx_t ctx;
+    if(!benchBegin(ctx, out, format, config)){
+        return false;
+    }
+    ctx.fs = &fs;
+    ctx.freqKhz = freqKhz;
+    bool ok = runSuite(ctx);
+    benchEnd(ctx);
+    return ok;
+}
+
+bool sdBenchmarkRunFrequencies(Print &out, SdBenchFormat format, const SdBenchConfig *config){
+    bench_ctx_t ctx;
+    if(!benchBegin(ctx, out, format, config)){
+        return false;
+    }
+    ctx.fs = &SD_MMC;
+    const uint32_t frequencies[] = SD_BENCH_FREQUENCIES;
+    for(uint8_t i = 0; i < sizeof(frequencies) / sizeof(frequencies[0]); i++){
+        if(!sdmmcRemount(frequencies[i])){
+            Serial.printf("# Card does not mount at %u kHz, skipped\n", frequencies[i]);
+            continue;
+        }
+        ctx.freqKhz = frequencies[i];
+        runSuite(ctx);
+    }
+    if(!sdmmcRemount(SDMMC_FREQ_DEFAULT)){
+        Serial.println("# Card Mount Failed after the benchmark");
+    }
+    benchEnd(ctx);
+    return true;
+}
+
+SdBenchFormat sdBenchmarkParseFormat(const char * name){
+    return (name != NULL && strcasecmp(name, "json") == 0) ? SD_BENCH_JSON : SD_BENCH_CSV;
+}
@@ -0,0 +1,65 @@
+#ifndef __SD_BENCHMARK_H
+#define __SD_BENCHMARK_H
+
+#include "Arduino.h"
+#include "FS.h"
+
+#define SD_BENCH_ROOT           "/bench"        // Scratch directory, removed at the end of a run
+#define SD_BENCH_BLOCK_MIN      512             // Block size sweep: 512 B, 1 KB, ... 64 KB
+#define SD_BENCH_BLOCK_MAX      (64 * 1024)
+#define SD_BENCH_FILE_SIZE      (2 * 1024 * 1024)   // The one large file of the sequential and random tests
+#define SD_BENCH_RANDOM_OPS     64              // Reads or writes per block size in the random tests
+#define SD_BENCH_FRAME_SIZE     (48 * 1024)     // A JPEG of our capture size (SVGA, quality 12)
+#define SD_BENCH_FRAMES         32              // Frames of the many-small-files versus one-large-file test
+#define SD_BENCH_DIR_FILES      1000            // Directory population test: files in the directory at the last step
+#define SD_BENCH_FREQUENCIES    {10000, SDMMC_FREQ_DEFAULT, SDMMC_FREQ_HIGHSPEED}   // kHz, SD_MMC.begin() sweep
+
+typedef enum {
+  SD_BENCH_CSV,             // A header line, then one line per result
+  SD_BENCH_JSON,            // One array of objects
+} SdBenchFormat;
+
+/**
+ * @brief Sizes of a benchmark run, sdBenchDefaultConfig holds the SD_BENCH_ values above. Smaller values give a quick run.
+ */
+typedef struct {
+  uint32_t fileSize;
+  uint32_t randomOps;
+  uint32_t frameSize;
+  uint32_t frames;
+  uint32_t dirFiles;
+} SdBenchConfig;
+
+extern const SdBenchConfig sdBenchDefaultConfig;
+
+/**
+ * @brief Runs the storage benchmark once on a file system and writes one result per test and block size to 'out'.
+ *        Tests: seq_write, seq_read, rand_write and rand_read on one large file for every block size;
+ *        small_files_write/read (one file per frame) versus one_file_write/read (frames appended to one file);
+ *        dir_create, dir_exists and dir_scan as the directory grows to SD_BENCH_DIR_FILES files.
+ *        Every write test ends with a flush (fsync) inside the timing. Columns of a result:
+ *        test, freq_khz, block_bytes, files, bytes, ops, total_us, mb_per_s, avg_op_us, max_op_us.
+ *        Other tasks writing to the card at the same time slow the results down; progress notes go to Serial as "# ..." lines.
+ * @param fs The file system to measure: SD_MMC on the board, the host directory in host_sim.
+ * @param out Where the results go: Serial, an HTTP response, a file.
+ * @param format CSV or JSON.
+ * @param freqKhz Card clock reported in the freq_khz column, 0 if not known (host directory).
+ * @param config Sizes of the run, NULL for sdBenchDefaultConfig.
+ * @return false if a run is already in progress or the scratch directory could not be created.
+ */
+bool sdBenchmarkRun(fs::FS &fs, Print &out, SdBenchFormat format, uint32_t freqKhz = 0, const SdBenchConfig *config = NULL);
+
+/**
+ * @brief Runs the benchmark on SD_MMC at each clock of SD_BENCH_FREQUENCIES, remounting the card between runs, then
+ *        remounts it at SDMMC_FREQ_DEFAULT. Open files do not survive a remount, so only call it at boot, before the
+ *        upload worker and the web server open theirs. A clock the card cannot mount at is skipped.
+ * @return false if a run is already in progress.
+ */
+bool sdBenchmarkRunFrequencies(Print &out, SdBenchFormat format, const SdBenchConfig *config = NULL);
+
+/**
+ * @brief Parses "csv" or "json" (from a serial command or an HTTP query), CSV for anything else.
+ */
+SdBenchFormat sdBenchmarkParseFormat(const char * name);
+
+#endif
@@ -1,6 +1,20 @@
 #include "sd_read_write.h"
+#include "esp_heap_caps.h"
+#include "metrics.h"
+
+// JPEG write path (writejpg), shared by the upload task and the web server task
+static SdWriteMode writeMode = SD_WRITE_STAGED;
+static SdSyncPolicy writeSync = SD_SYNC_ON_CLOSE;
+static size_t writeBufferSize = SD_WRITE_BUFFER_DEFAULT;
+static uint8_t * writeBuffer = NULL;        // Staging buffer in DMA-capable internal RAM
+static size_t writeBufferAllocated = 0;
+static SemaphoreHandle_t writeMutex = NULL;
+static SdWriteStats writeStats = {0, 0, 0, 0, 0, 0};
 
 void sdmmcInit(void){
+  if (writeMutex == NULL) {   // Created before any task can call writejpg(), so that the tasks never race to create it
+    writeMutex = xSemaphoreCreateMutex();
+  }
   SD_MMC.setPins(SD_MMC_CLK, SD_MMC_CMD, SD_MMC_D0);
   if (!SD_MMC.begin("/sdcard", true, true, SDMMC_FREQ_DEFAULT, 5)) {
     Serial.println("Card Mount Failed");
@@ -22,9 +36,17 @@ void sdmmcInit(void){
       Serial.println("UNKNOWN");
   }
   uint64_t cardSize = SD_MMC.cardSize() / (1024 * 1024);
-  Serial.printf("SD_MMC Card Size: %lluMB\n", cardSize);  
-  Serial.printf("Total space: %lluMB\r\n", SD_MMC.totalBytes() / (1024 * 1024));
-  Serial.printf("Used space: %lluMB\r\n", SD_MMC.usedBytes() / (1024 * 1024));
+  Serial.printf("SD_MMC Card Size: %lluMB\n", (unsigned long long)cardSize);  
+  Serial.printf("Total space: %lluMB\r\n", (unsigned long long)(SD_MMC.totalBytes() / (1024 * 1024)));
+  Serial.printf("Used space: %lluMB\r\n", (unsigned long long)(SD_MMC.usedBytes() / (1024 * 1024)));
+}
+
+bool sdmmcRemount(int frequencyKhz){
+  SD_MMC.end();
+  if (!SD_MMC.begin("/sdcard", true, false, frequencyKhz, 5)) {
+    return false;
+  }
+  return SD_MMC.cardType() != CARD_NONE;
 }
 
 void listDir(fs::FS &fs, const char * dirname, uint8_t levels){
@@ -158,7 +180,7 @@ void testFileIO(fs::FS &fs, const char * path){
             len -= toRead;
         }
         end = millis() - start;
-        Serial.printf("%u bytes read for %u ms\r\n", flen, end);
+        Serial.printf("%u bytes read for %u ms\r\n", (unsigned)flen, (unsigned)end);
         file.close();
     } else {
         Serial.println("Failed to open file for reading");
@@ -180,14 +202,116 @@ void testFileIO(fs::FS &fs, const char * path){
     file.close();
 }
 
-void writejpg(fs::FS &fs, const char * path, const uint8_t *buf, size_t size){
+void sdWriteConfigure(SdWriteMode mode, SdSyncPolicy sync, size_t bufferSize){
+    bufferSize = constrain(bufferSize, (size_t)SD_WRITE_BUFFER_MIN, (size_t)SD_WRITE_BUFFER_MAX) & ~(size_t)4095;
+    xSemaphoreTake(writeMutex, portMAX_DELAY);
+    writeMode = mode;
+    writeSync = sync;
+    if(bufferSize != writeBufferSize && writeBuffer != NULL){
+        heap_caps_free(writeBuffer);   // Reallocated with the new size at the next staged write
+        writeBuffer = NULL;
+        writeBufferAllocated = 0;
+    }
+    writeBufferSize = bufferSize;
+    xSemaphoreGive(writeMutex);
+}
+
+/**
+ * @brief Timed file.write() of one block, updates the write count and the slowest write.
+ */
+static bool timedWrite(File &file, const uint8_t *buf, size_t size, SdWriteStats &stats){
+    uint32_t start = micros();
+    size_t written = file.write(buf, size);
+    uint32_t elapsed = micros() - start;
+    stats.writes++;
+    if(elapsed > stats.maxWriteUs){
+        stats.maxWriteUs = elapsed;
+    }
+    return written == size;
+}
+
+static void timedSync(File &file, SdWriteStats &stats){
+    uint32_t start = micros();
+    file.flush();   // fflush() and fsync(): data, directory entry and FAT are written to the card
+    stats.syncUs += micros() - start;
+}
+
+/**
+ * @brief The staged path. The SDMMC host can only DMA from internal RAM, so a write straight from a PSRAM frame buffer is
+ *        split by the driver into small bounce copies. Copying each block into one large internal buffer first lets the
+ *        driver send it as a single multi-sector transfer. The file is stretched to its final size before the data is
+ *        written, so FATFS allocates the whole cluster chain once instead of extending it on every block.
+ */
+static bool writeStaged(File &file, const uint8_t *buf, size_t size, SdWriteStats &stats){
+    // Preallocate: seeking past the end of a file open for writing makes FATFS allocate the clusters up to there
+    if(size > 0 && (!file.seek(size - 1) || file.write((uint8_t)0) != 1 || !file.seek(0))){
+        return false;
+    }
+    size_t offset = 0;
+    while(offset < size){
+        size_t n = size - offset;
+        if(n > writeBufferAllocated){
+            n = writeBufferAllocated;   // Every block but the last is a whole buffer, so blocks start on cluster boundaries
+        }
+        memcpy(writeBuffer, buf + offset, n);
+        if(!timedWrite(file, writeBuffer, n, stats)){
+            return false;
+        }
+        if(writeSync == SD_SYNC_EVERY_BLOCK){
+            timedSync(file, stats);
+        }
+        offset += n;
+    }
+    return true;
+}
+
+bool writejpg(fs::FS &fs, const char * path, const uint8_t *buf, size_t size){
+    xSemaphoreTake(writeMutex, portMAX_DELAY);
+    SdWriteStats stats = {0, 0, 0, 0, 0, 0};
+    uint32_t start = micros();
+    bool ok = false;
+
     File file = fs.open(path, FILE_WRITE);
     if(!file){
       Serial.println("Failed to open file for writing");
-      return;
+      xSemaphoreGive(writeMutex);
+      return false;
+    }
+    if(writeMode == SD_WRITE_STAGED && writeBuffer == NULL){
+        writeBuffer = (uint8_t *)heap_caps_malloc(writeBufferSize, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        writeBufferAllocated = writeBuffer != NULL ? writeBufferSize : 0;
+        if(writeBuffer == NULL){
+            Serial.printf("No internal RAM for a %u byte SD staging buffer, writing directly\n", (unsigned)writeBufferSize);
+        }
+    }
+    if(writeMode == SD_WRITE_STAGED && writeBuffer != NULL){
+        ok = writeStaged(file, buf, size, stats);
+    } else {
+        ok = timedWrite(file, buf, size, stats);
+    }
+    if(writeSync != SD_SYNC_NONE){
+        timedSync(file, stats);
+    }
+    file.close();
+
+    stats.bytes = size;
+    stats.totalUs = micros() - start;
+    stats.mbPerSec = stats.totalUs > 0 ? (float)size / stats.totalUs : 0;  // bytes per us = MB/s
+    writeStats = stats;
+    xSemaphoreGive(writeMutex);
+
+    metricsObserve(METRIC_SD_WRITE, stats.totalUs);
+    if(!ok){
+        Serial.printf("Write failed: %s\r\n", path);
+        return false;
     }
-    file.write(buf, size);
-    Serial.printf("Saved file to path: %s\r\n", path);
+    Serial.printf("Saved file to path: %s (%u bytes, %.2f MB/s, %u writes, slowest %u us, sync %u us)\r\n",
+                  path, stats.bytes, stats.mbPerSec, stats.writes, stats.maxWriteUs, stats.syncUs);
+    return true;
+}
+
+SdWriteStats sdWriteGetStats(void){
+    return writeStats;
 }
 
 int readFileNum(fs::FS &fs, const char * dirname){
@@ -209,3 +333,25 @@ int readFileNum(fs::FS &fs, const char * dirname){
     }
     return num;  
 }
+
+// Reads a whole file into a buffer allocated in PSRAM (if available). The caller frees the buffer.
+uint8_t * readjpg(fs::FS &fs, const char * path, size_t * size){
+    File file = fs.open(path);
+    if(!file){
+        Serial.printf("Failed to open file for reading: %s\r\n", path);
+        return NULL;
+    }
+    size_t len = file.size();
+    uint8_t * buf = (uint8_t *)(psramFound() ? ps_malloc(len) : malloc(len));
+    if(buf == NULL){
+        Serial.println("Not enough memory to read the file");
+        return NULL;
+    }
+    if(file.read(buf, len) != len){
+        Serial.println("Read failed");
+        free(buf);
+        return NULL;
+    }
+    *size = len;
+    return buf;
+}
@@ -9,7 +9,53 @@
 #define SD_MMC_CLK  39 //Please do not modify it. 
 #define SD_MMC_D0   40 //Please do not modify it.
 
-void sdmmcInit(void); 
+// JPEG write path of writejpg()
+#define SD_WRITE_BUFFER_DEFAULT (32 * 1024)   // Internal-RAM DMA staging buffer, a multiple of the cluster size keeps writes aligned
+#define SD_WRITE_BUFFER_MIN     (16 * 1024)
+#define SD_WRITE_BUFFER_MAX     (64 * 1024)
+
+typedef enum {
+  SD_WRITE_DIRECT,          // The original path: one file.write() straight from the (PSRAM) frame buffer
+  SD_WRITE_STAGED,          // Preallocated file, written in buffer-sized blocks through the internal-RAM staging buffer
+} SdWriteMode;
+
+typedef enum {
+  SD_SYNC_ON_CLOSE,         // fsync() once before closing: the file and its FAT entries are on the card when writejpg() returns
+  SD_SYNC_EVERY_BLOCK,      // fsync() after every block as well, for the least data lost on a power cut, at a cost in MB/s
+  SD_SYNC_NONE,             // Only close(), the FAT driver writes its cache when it needs to
+} SdSyncPolicy;
+
+/**
+ * @brief Measurements of the last writejpg().
+ * bytes       Size of the file.
+ * totalUs     Open to close, including preallocation and sync.
+ * writes      Number of write calls.
+ * maxWriteUs  Slowest single write call.
+ * syncUs      Time spent in fsync().
+ * mbPerSec    bytes / totalUs.
+ */
+typedef struct {
+  uint32_t bytes;
+  uint32_t totalUs;
+  uint32_t writes;
+  uint32_t maxWriteUs;
+  uint32_t syncUs;
+  float mbPerSec;
+} SdWriteStats;
+
+/**
+ * @brief Mounts the card and creates the lock of the JPEG write path. Call it once from setup(), before starting the
+ *        tasks that call sdWriteConfigure() or writejpg().
+ */
+void sdmmcInit(void);
+
+/**
+ * @brief Unmounts the card and mounts it again at another clock, without formatting it if the mount fails.
+ *        Files open on the card become invalid.
+ * @param frequencyKhz SDMMC_FREQ_DEFAULT (20 MHz), SDMMC_FREQ_HIGHSPEED (40 MHz) or another clock in kHz.
+ * @return true if the card is mounted.
+ */
+bool sdmmcRemount(int frequencyKhz);
 
 void listDir(fs::FS &fs, const char * dirname, uint8_t levels);
 void createDir(fs::FS &fs, const char * path);
@@ -21,7 +67,25 @@ void renameFile(fs::FS &fs, const char * path1, const char * path2);
 void deleteFile(fs::FS &fs, const char * path);
 void testFileIO(fs::FS &fs, const char * path);
 
-void writejpg(fs::FS &fs, const char * path, const uint8_t *buf, size_t size);
+/**
+ * @brief Selects the JPEG write path of writejpg(), see SdWriteMode and SdSyncPolicy.
+ * @param bufferSize Size of the staging buffer, clamped to SD_WRITE_BUFFER_MIN..SD_WRITE_BUFFER_MAX and rounded down to 4 KB.
+ *                   It is allocated in DMA-capable internal RAM at the next staged write; if that fails the write is direct.
+ */
+void sdWriteConfigure(SdWriteMode mode, SdSyncPolicy sync = SD_SYNC_ON_CLOSE, size_t bufferSize = SD_WRITE_BUFFER_DEFAULT);
+
+/**
+ * @brief Writes a JPEG to the SD card with the configured write path and prints its MB/s and slowest write.
+ * @return true if the whole file was written.
+ */
+bool writejpg(fs::FS &fs, const char * path, const uint8_t *buf, size_t size);
+
+/**
+ * @brief Returns the measurements of the last writejpg().
+ */
+SdWriteStats sdWriteGetStats(void);
+
 int readFileNum(fs::FS &fs, const char * dirname);
+uint8_t * readjpg(fs::FS &fs, const char * path, size_t * size);
 
 #endif
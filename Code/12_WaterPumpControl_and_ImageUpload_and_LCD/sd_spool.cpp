@@ -0,0 +1,193 @@
+/**
+ * sd_spool.cpp
+ *
+ * A store-and-forward spool on the SD card for readings and images that could not be uploaded while WiFi was down.
+ *
+ * File layout:
+ *   [header copy 0][header copy 1][record 0][record 1] ... [record capacity-1]
+ * The records form a ring: 'tail' is the oldest record, 'head' the next slot to write. One slot is always kept free, so
+ * 'head' is never a slot that holds a job: when the spool is full, the header that makes the new record visible also
+ * moves 'tail' past the oldest one, and no job is lost before that single header write. Each header update goes to the
+ * copy selected by its generation number, so the copy of the previous generation is always intact. At boot the valid
+ * copy with the highest generation wins. A record is written and flushed before the header that makes it visible.
+ * The file is created at its full size, so the ring never extends the FAT cluster chain.
+ *
+ * Author: John Leung
+ * Date: October 16, 2026
+ */
+#include "sd_spool.h"
+#include "esp_rom_crc.h"
+
+#define SPOOL_MAGIC 0x4C4F5053UL  // "SPOL"
+
+typedef struct {
+  uint32_t magic;
+  uint32_t generation;
+  uint32_t capacity;
+  uint32_t head;      // next slot to write
+  uint32_t tail;      // oldest record
+  uint32_t count;
+  uint32_t nextSeq;
+  uint32_t crc;
+} spool_header_t;
+
+static File spoolFile;
+static spool_header_t spoolHeader;
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+static uint32_t headerCrc(const spool_header_t &header){
+    return esp_rom_crc32_le(0, (const uint8_t *)&header, offsetof(spool_header_t, crc));
+}
+
+static uint32_t recordCrc(const spool_record_t &record){
+    return esp_rom_crc32_le(0, (const uint8_t *)&record, offsetof(spool_record_t, crc));
+}
+
+static size_t recordOffset(uint32_t slot){
+    return 2 * sizeof(spool_header_t) + (size_t)slot * sizeof(spool_record_t);
+}
+
+/**
+ * @brief Writes the header to the copy selected by its new generation number and flushes it to the card.
+ */
+static bool writeHeader(void){
+    spoolHeader.generation++;
+    spoolHeader.crc = headerCrc(spoolHeader);
+    if(!spoolFile.seek((spoolHeader.generation & 1) * sizeof(spool_header_t))){
+        return false;
+    }
+    bool ok = spoolFile.write((const uint8_t *)&spoolHeader, sizeof(spoolHeader)) == sizeof(spoolHeader);
+    spoolFile.flush();
+    return ok;
+}
+
+/**
+ * @brief Reads one header copy, returns false if it is not valid.
+ */
+static bool readHeader(uint8_t copy, spool_header_t &header){
+    if(!spoolFile.seek(copy * sizeof(spool_header_t))){
+        return false;
+    }
+    if(spoolFile.read((uint8_t *)&header, sizeof(header)) != sizeof(header)){
+        return false;
+    }
+    return header.magic == SPOOL_MAGIC && header.crc == headerCrc(header) && header.capacity > 0 &&
+           header.head < header.capacity && header.tail < header.capacity && header.count <= header.capacity;
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+bool sdSpoolBegin(fs::FS &fs, const char * path, uint32_t capacity){
+    if(!fs.exists(path)){
+        File file = fs.open(path, FILE_WRITE);
+        if(!file){
+            Serial.println("Failed to create spool file");
+            return false;
+        }
+        file.close();
+    }
+    spoolFile = fs.open(path, "r+");
+    if(!spoolFile){
+        Serial.println("Failed to open spool file");
+        return false;
+    }
+
+    spool_header_t copy0, copy1;
+    bool valid0 = readHeader(0, copy0);
+    bool valid1 = readHeader(1, copy1);
+    if(valid0 && valid1){
+        spoolHeader = (copy1.generation > copy0.generation) ? copy1 : copy0;
+    } else if(valid0){
+        spoolHeader = copy0;
+    } else if(valid1){
+        spoolHeader = copy1;
+    } else {
+        Serial.println("Spool is empty or corrupt, starting a new one");
+        if(capacity < 2){
+            return false;   // One slot is kept free
+        }
+        memset(&spoolHeader, 0, sizeof(spoolHeader));
+        spoolHeader.magic = SPOOL_MAGIC;
+        spoolHeader.capacity = capacity;
+        // Preallocate: seeking past the end of the file makes FATFS allocate the clusters of all the records at once
+        size_t size = recordOffset(capacity);
+        if(!spoolFile.seek(size - 1) || spoolFile.write((uint8_t)0) != 1){
+            Serial.println("Failed to preallocate the spool file");
+            return false;
+        }
+        if(!writeHeader() || !writeHeader()){  // Initialize both copies
+            return false;
+        }
+    }
+    if(spoolHeader.capacity != capacity){
+        Serial.printf("Spool capacity is %u records (file created with that size)\n", spoolHeader.capacity);
+    }
+    Serial.printf("Spool: %u pending jobs\n", spoolHeader.count);
+    return true;
+}
+
+bool sdSpoolAppend(const char * jpgPath, uint8_t moisture, uint32_t timestamp){
+    if(!spoolFile){
+        return false;
+    }
+    if(spoolHeader.count == spoolHeader.capacity){
+        // Filled by a version without the free slot: drop the oldest job first, the write below would replace it
+        sdSpoolPop();
+    }
+    spool_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.seq = spoolHeader.nextSeq;
+    record.timestamp = timestamp;
+    record.moisture = moisture;
+    strlcpy(record.jpgPath, jpgPath != NULL ? jpgPath : "", sizeof(record.jpgPath));
+    record.crc = recordCrc(record);
+
+    if(!spoolFile.seek(recordOffset(spoolHeader.head)) ||
+       spoolFile.write((const uint8_t *)&record, sizeof(record)) != sizeof(record)){
+        Serial.println("Spool append failed");
+        return false;
+    }
+    spoolFile.flush();
+
+    if(spoolHeader.count == spoolHeader.capacity - 1){
+        // Full: the record went to the free slot, which the oldest record now becomes in the same header write
+        spoolHeader.tail = (spoolHeader.tail + 1) % spoolHeader.capacity;
+        Serial.println("Spool full, oldest job dropped");
+    } else {
+        spoolHeader.count++;
+    }
+    spoolHeader.head = (spoolHeader.head + 1) % spoolHeader.capacity;
+    spoolHeader.nextSeq++;
+    return writeHeader();
+}
+
+bool sdSpoolPeek(spool_record_t &record){
+    while(spoolFile && spoolHeader.count > 0){
+        if(!spoolFile.seek(recordOffset(spoolHeader.tail)) ||
+           spoolFile.read((uint8_t *)&record, sizeof(record)) != sizeof(record)){
+            return false;
+        }
+        if(record.crc == recordCrc(record)){
+            record.jpgPath[SPOOL_PATH_LENGTH - 1] = '\0';
+            return true;
+        }
+        // A record torn by a power loss or damaged on the card, it cannot be replayed
+        Serial.println("Spool record is corrupt, dropped");
+        sdSpoolPop();
+    }
+    return false;
+}
+
+bool sdSpoolPop(void){
+    if(!spoolFile || spoolHeader.count == 0){
+        return false;
+    }
+    spoolHeader.tail = (spoolHeader.tail + 1) % spoolHeader.capacity;
+    spoolHeader.count--;
+    return writeHeader();
+}
+
+uint32_t sdSpoolCount(void){
+    return spoolHeader.count;
+}
@@ -0,0 +1,62 @@
+#ifndef __SD_SPOOL_H
+#define __SD_SPOOL_H
+
+#include "Arduino.h"
+#include "FS.h"
+
+#define SPOOL_FILE_PATH     "/spool.bin"
+#define SPOOL_CAPACITY      20161   // One week of readings at the 30 s sensor interval and the free slot (64 bytes each, about 1.3 MB)
+#define SPOOL_PATH_LENGTH   48      // Maximum length of the JPEG path, including the terminating zero
+
+/**
+ * @brief One pending job: a reading (and its image on the SD card) that could not be uploaded yet.
+ * seq       Sequence number of the job, increases by one for every append.
+ * timestamp Capture time in seconds since the epoch (UTC), or 0 if the clock was not set.
+ * jpgPath   Path of the image on the SD card, empty if there is no image.
+ * moisture  Soil moisture in percent.
+ * crc       CRC32 of all fields above, used to detect a record torn by a power loss.
+ */
+typedef struct {
+  uint32_t seq;
+  uint32_t timestamp;
+  char jpgPath[SPOOL_PATH_LENGTH];
+  uint8_t moisture;
+  uint8_t reserved[3];
+  uint32_t crc;
+} spool_record_t;
+
+/**
+ * @brief Opens the spool file, creating it if needed. The spool is a fixed-size ring of records behind two copies of a
+ *        header, so appends and dequeues are a single seek and write. A new file is created at its full size.
+ * @param fs The file system holding the spool (SD_MMC).
+ * @param path Path of the spool file.
+ * @param capacity Record slots of a new spool, at least 2. One slot is kept free, so the spool holds capacity - 1 jobs;
+ *                 when it is full the oldest job is dropped.
+ * @return true if the spool is ready.
+ */
+bool sdSpoolBegin(fs::FS &fs, const char * path = SPOOL_FILE_PATH, uint32_t capacity = SPOOL_CAPACITY);
+
+/**
+ * @brief Appends a job. The record is written to the free slot and flushed before the header that makes it visible (and
+ *        drops the oldest job when the spool is full), so a power loss during the append leaves the spool as it was before.
+ * @return true if the record was stored.
+ */
+bool sdSpoolAppend(const char * jpgPath, uint8_t moisture, uint32_t timestamp);
+
+/**
+ * @brief Reads the oldest job without removing it.
+ * @return false if the spool is empty or the record could not be read.
+ */
+bool sdSpoolPeek(spool_record_t &record);
+
+/**
+ * @brief Removes the oldest job, call it once the job returned by sdSpoolPeek() has been uploaded.
+ */
+bool sdSpoolPop(void);
+
+/**
+ * @brief Returns the number of jobs in the spool.
+ */
+uint32_t sdSpoolCount(void);
+
+#endif
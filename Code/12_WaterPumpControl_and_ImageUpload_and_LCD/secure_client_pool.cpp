@@ -0,0 +1,156 @@
+/**
+ * secure_client_pool.cpp
+ *
+ * Keeps one connection per host alive across image uploads. Every upload to the Google Apps Script used to create a new
+ * HTTPClient and do two full TLS handshakes (script.google.com, then the 302 redirect host), each costing hundreds of ms
+ * of CPU and about 40 KB of heap. With the connections kept open, a handshake is only needed after the server closes them.
+ *
+ * Note: the Arduino WiFiClientSecure does not expose the mbedTLS session cache, so TLS session tickets cannot be
+ * resumed after a connection was closed; keeping the connection alive avoids the handshake altogether instead.
+ *
+ * Author: John Leung
+ * Date: October 16, 2026
+ */
+#include "secure_client_pool.h"
+#include <WiFiClientSecure.h>
+
+typedef struct {
+  String host;
+  uint16_t port;
+  bool secure;
+  WiFiClient* client;
+  uint32_t lastUsedMillis;
+} pool_entry_t;
+
+static pool_entry_t pool[SECURE_POOL_MAX_HOSTS];
+static SecureClientPoolStats poolStats = {0, 0, 0, 0, 0};
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+/**
+ * @brief Splits "scheme://host[:port]/path" into its host, port and whether it uses TLS.
+ * @return false if the URL has no scheme.
+ */
+static bool parseUrl(const String& url, String& host, uint16_t& port, bool& secure) {
+  int schemeEnd = url.indexOf("://");
+  if (schemeEnd < 0) {
+    return false;
+  }
+  secure = url.substring(0, schemeEnd).equalsIgnoreCase("https");
+  int hostStart = schemeEnd + 3;
+  int pathStart = url.indexOf('/', hostStart);
+  String hostPort = pathStart < 0 ? url.substring(hostStart) : url.substring(hostStart, pathStart);
+  int colon = hostPort.indexOf(':');
+  if (colon >= 0) {
+    host = hostPort.substring(0, colon);
+    port = hostPort.substring(colon + 1).toInt();
+  } else {
+    host = hostPort;
+    port = secure ? 443 : 80;
+  }
+  return true;
+}
+
+/**
+ * @brief Finds the pool entry of a host, or NULL if the host is not in the pool.
+ */
+static pool_entry_t* findEntry(const String& host, uint16_t port, bool secure) {
+  for (int i = 0; i < SECURE_POOL_MAX_HOSTS; i++) {
+    if (pool[i].client != NULL && pool[i].port == port && pool[i].secure == secure && pool[i].host == host) {
+      return &pool[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Returns a free pool entry, closing the least recently used connection if the pool is full.
+ */
+static pool_entry_t* allocateEntry() {
+  pool_entry_t* oldest = &pool[0];
+  for (int i = 0; i < SECURE_POOL_MAX_HOSTS; i++) {
+    if (pool[i].client == NULL) {
+      return &pool[i];
+    }
+    if (pool[i].lastUsedMillis - oldest->lastUsedMillis > 0x80000000UL) {
+      oldest = &pool[i]; // pool[i] was used before 'oldest' (wrap-around safe)
+    }
+  }
+  oldest->client->stop();
+  delete oldest->client;
+  oldest->client = NULL;
+  return oldest;
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+WiFiClient* secureClientPoolConnect(const String& url, bool* reused) {
+  String host;
+  uint16_t port;
+  bool secure;
+  if (reused != NULL) {
+    *reused = false;
+  }
+  if (!parseUrl(url, host, port, secure)) {
+    return NULL;
+  }
+
+  pool_entry_t* entry = findEntry(host, port, secure);
+  if (entry != NULL && entry->client->connected()) {
+    entry->lastUsedMillis = millis();
+    poolStats.reuses++;
+    if (reused != NULL) {
+      *reused = true;
+    }
+    return entry->client;
+  }
+
+  if (entry == NULL) {
+    entry = allocateEntry();
+    entry->host = host;
+    entry->port = port;
+    entry->secure = secure;
+    if (secure) {
+      WiFiClientSecure* secureClient = new WiFiClientSecure();
+      secureClient->setInsecure(); // Same as HTTPClient::begin(url) without a CA certificate
+      entry->client = secureClient;
+    } else {
+      entry->client = new WiFiClient();
+    }
+  } else {
+    entry->client->stop(); // The server has closed the kept-alive connection
+  }
+
+  uint32_t start = millis();
+  bool ok = entry->client->connect(host.c_str(), port);
+  uint32_t elapsed = millis() - start;
+  if (!ok) {
+    poolStats.handshakeFailed++;
+    Serial.printf("secureClientPool: connection to %s:%u failed\n", host.c_str(), port);
+    return NULL;
+  }
+  poolStats.handshakes++;
+  poolStats.lastHandshakeMs = elapsed;
+  poolStats.totalHandshakeMs += elapsed;
+  entry->lastUsedMillis = millis();
+  Serial.printf("secureClientPool: connected to %s:%u in %u ms (%u handshakes, %u reuses)\n",
+                host.c_str(), port, elapsed, poolStats.handshakes, poolStats.reuses);
+  return entry->client;
+}
+
+void secureClientPoolDrop(const String& url) {
+  String host;
+  uint16_t port;
+  bool secure;
+  if (!parseUrl(url, host, port, secure)) {
+    return;
+  }
+  pool_entry_t* entry = findEntry(host, port, secure);
+  if (entry != NULL) {
+    entry->client->stop();
+  }
+}
+
+SecureClientPoolStats secureClientPoolGetStats() {
+  return poolStats;
+}
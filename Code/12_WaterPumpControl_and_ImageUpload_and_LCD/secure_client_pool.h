@@ -0,0 +1,46 @@
+#ifndef SECURE_CLIENT_POOL_H
+#define SECURE_CLIENT_POOL_H
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+#define SECURE_POOL_MAX_HOSTS 2   // script.google.com and the script.googleusercontent.com redirect host
+
+/**
+ * @brief Connection statistics of the pool, used to confirm the saving of keeping connections alive.
+ * handshakes       Number of new connections (full TLS handshakes for https).
+ * handshakeFailed  Number of connection attempts that failed.
+ * reuses           Number of requests served over an already open connection.
+ * lastHandshakeMs  Duration of the last handshake in milliseconds.
+ * totalHandshakeMs Sum of all handshake durations in milliseconds.
+ */
+struct SecureClientPoolStats {
+  uint32_t handshakes;
+  uint32_t handshakeFailed;
+  uint32_t reuses;
+  uint32_t lastHandshakeMs;
+  uint32_t totalHandshakeMs;
+};
+
+/**
+ * @brief Returns an open connection to the host of the given URL, connecting (and timing the TLS handshake) only when
+ *        there is no live connection to that host yet. Pass the client to HTTPClient::begin(client, url) with
+ *        HTTPClient::setReuse(true) so that the connection stays open after HTTPClient::end().
+ *        The pool is not thread safe; it is meant to be used by the upload task only.
+ * @param url The full request URL, "https://host[:port]/path" or "http://host[:port]/path".
+ * @param reused Optional, set to true if an existing connection was returned.
+ * @return The connected client, or NULL if the connection failed.
+ */
+WiFiClient* secureClientPoolConnect(const String& url, bool* reused = NULL);
+
+/**
+ * @brief Closes the pooled connection to the host of the given URL, e.g. after the server dropped a kept-alive connection.
+ */
+void secureClientPoolDrop(const String& url);
+
+/**
+ * @brief Returns the handshake count and time of the pool.
+ */
+SecureClientPoolStats secureClientPoolGetStats();
+
+#endif
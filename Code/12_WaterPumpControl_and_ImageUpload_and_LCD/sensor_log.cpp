@@ -0,0 +1,505 @@
+/**
+ * sensor_log.cpp
+ *
+ * A log-structured store of the sensor readings on the SD card, so that the history survives a cloud outage and can be
+ * analysed without the network.
+ *
+ * Directory layout (SENSOR_LOG_DIR):
+ *   <n>.seg     Raw segments: 16-byte records, appended in whole 512-byte sectors. Segment n+1 starts when the hour
+ *               changes, when segment n is full, or at boot. Only the last SENSOR_LOG_RAW_SEGMENTS are kept.
+ *   hourly.bin  Two copies of a header, then 32-byte hourly aggregates. A closed segment is compacted into it before it
+ *               can be removed. The header records the last compacted segment and hour and the size of the aggregates;
+ *               it is written after the aggregates of a segment, alternately to each copy like in sd_spool.cpp. A power
+ *               loss during a compaction leaves the previous header, so the segment is compacted again over its partial
+ *               aggregates, and a segment at or before the header's one is never compacted twice.
+ * Every record has a CRC32, and a scan skips the records torn by a power loss. Segments are never rewritten, except for the
+ * sector being filled: it is written again in full each time it is flushed, so all writes stay sector-aligned.
+ *
+ * Author: John Leung
+ * Date: October 16, 2026
+ */
+#include "sensor_log.h"
+#include "esp_rom_crc.h"
+
+#define SCAN_BUFFER_SIZE 4096
+#define HOURLY_MAGIC     0x52554F48UL  // "HOUR"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t generation;
+    uint32_t segments;      // Segments below this number are compacted
+    uint32_t lastHour;      // Start of the hour of the last aggregate with a clock, 0 if none yet
+    uint32_t size;          // Bytes of aggregates after the headers
+    uint32_t reserved[2];
+    uint32_t crc;
+} hourly_header_t;
+
+#define HOURLY_DATA      (2 * sizeof(hourly_header_t))
+
+static_assert(SENSOR_LOG_SECTOR % sizeof(sensor_log_record_t) == 0, "records must not cross sectors");
+static_assert(sizeof(sensor_log_hour_t) == 32, "hourly aggregate layout");
+static_assert(sizeof(hourly_header_t) == sizeof(sensor_log_hour_t), "the aggregates stay aligned after the headers");
+
+static fs::FS *logFs = NULL;
+static String logDir;
+static File segmentFile;
+static File hourlyFile;
+static uint32_t hourlySize = 0;         // Bytes of the aggregates in hourly.bin, after the headers
+static uint32_t hourlyGeneration = 0;
+static uint32_t compactedSegments = 0;  // Segments below this number are in hourly.bin
+static uint32_t compactedHour = 0;      // Start of the last hour in hourly.bin, 0 if none yet
+static uint32_t firstSegment = 0;       // Oldest raw segment on the card
+static uint32_t segment = 0;            // Segment being written
+static uint32_t segmentRecords = 0;     // Readings in it, including the buffered ones
+static uint32_t segmentHour = 0;        // Hour (timestamp / 3600) of its first reading with a clock, 0 if none yet
+static uint32_t sectorOffset = 0;       // Offset of the sector being filled in the segment
+static uint8_t sectorBuffer[SENSOR_LOG_SECTOR];
+static uint32_t sectorUsed = 0;         // Bytes of sectorBuffer in use
+static uint32_t unsyncedSectors = 0;
+static SemaphoreHandle_t logMutex = NULL;
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+static uint32_t recordCrc(const sensor_log_record_t &record){
+    return esp_rom_crc32_le(0, (const uint8_t *)&record, offsetof(sensor_log_record_t, crc));
+}
+
+static uint32_t hourCrc(const sensor_log_hour_t &hour){
+    return esp_rom_crc32_le(0, (const uint8_t *)&hour, offsetof(sensor_log_hour_t, crc));
+}
+
+static uint32_t hourlyHeaderCrc(const hourly_header_t &header){
+    return esp_rom_crc32_le(0, (const uint8_t *)&header, offsetof(hourly_header_t, crc));
+}
+
+/**
+ * @brief Writes the compaction state to the header copy selected by its new generation number and flushes hourly.bin.
+ */
+static bool writeHourlyHeader(void){
+    hourly_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = HOURLY_MAGIC;
+    header.generation = ++hourlyGeneration;
+    header.segments = compactedSegments;
+    header.lastHour = compactedHour;
+    header.size = hourlySize;
+    header.crc = hourlyHeaderCrc(header);
+    bool ok = hourlyFile.seek((header.generation & 1) * sizeof(header)) &&
+              hourlyFile.write((const uint8_t *)&header, sizeof(header)) == sizeof(header);
+    hourlyFile.flush();
+    return ok;
+}
+
+/**
+ * @brief Reads one header copy, returns false if it is not valid.
+ */
+static bool readHourlyHeader(uint8_t copy, hourly_header_t &header){
+    return hourlyFile.seek(copy * sizeof(header)) &&
+           hourlyFile.read((uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+           header.magic == HOURLY_MAGIC && header.crc == hourlyHeaderCrc(header);
+}
+
+static String segmentPath(uint32_t seq){
+    return logDir + "/" + String(seq) + ".seg";
+}
+
+static uint32_t hourOf(uint32_t timestamp){
+    return timestamp >= SENSOR_LOG_CLOCK_VALID ? timestamp / 3600 : 0;
+}
+
+/**
+ * @brief Writes the sector buffer at its place in the segment. A full sector moves the buffer to the next sector;
+ *        the segment is synced every SENSOR_LOG_SYNC_SECTORS sectors, or now if 'sync' is set.
+ */
+static bool writeSector(bool sync){
+    if(sectorUsed == 0 && !sync){
+        return true;
+    }
+    if(sectorUsed > 0){
+        if(!segmentFile.seek(sectorOffset) || segmentFile.write(sectorBuffer, sectorUsed) != sectorUsed){
+            Serial.println("Sensor log write failed");
+            return false;
+        }
+        if(sectorUsed == SENSOR_LOG_SECTOR){
+            sectorOffset += SENSOR_LOG_SECTOR;
+            sectorUsed = 0;
+            unsyncedSectors++;
+        }
+    }
+    if(sync || unsyncedSectors >= SENSOR_LOG_SYNC_SECTORS){
+        segmentFile.flush();
+        unsyncedSectors = 0;
+    }
+    return true;
+}
+
+/**
+ * @brief Reads a file from 'offset' in SCAN_BUFFER_SIZE chunks and calls 'visit' for each whole item of 'itemSize' bytes.
+ * @return false if 'visit' asked to stop.
+ */
+template <typename Visit>
+static bool readItems(File &file, uint32_t offset, uint32_t end, size_t itemSize, uint8_t *buf, Visit visit){
+    if(!file.seek(offset)){
+        return true;
+    }
+    while(offset + itemSize <= end){
+        size_t want = min((size_t)(end - offset), (size_t)SCAN_BUFFER_SIZE) / itemSize * itemSize;
+        size_t got = file.read(buf, want);
+        for(size_t i = 0; i + itemSize <= got; i += itemSize){
+            if(!visit(buf + i)){
+                return false;
+            }
+        }
+        if(got < want){
+            break;
+        }
+        offset += got;
+    }
+    return true;
+}
+
+typedef struct {
+    sensor_log_hour_t hour;
+    uint32_t rawSum;
+    uint32_t moistureSum;
+    int32_t rssiSum;
+} hour_acc_t;
+
+static void hourStart(hour_acc_t &acc, uint32_t hour, uint32_t seq){
+    memset(&acc, 0, sizeof(acc));
+    acc.hour.hour = hour * 3600;
+    acc.hour.segment = seq;
+    acc.hour.moistureMin = 255;
+}
+
+static void hourAdd(hour_acc_t &acc, const sensor_log_record_t &record){
+    sensor_log_hour_t &h = acc.hour;
+    h.count++;
+    acc.rawSum += record.raw;
+    acc.moistureSum += record.moisture;
+    h.moistureMin = min(h.moistureMin, record.moisture);
+    h.moistureMax = max(h.moistureMax, record.moisture);
+    if(record.flags & SENSOR_LOG_FLAG_PUMP){
+        h.pumpOn++;
+    }
+    if(record.flags & SENSOR_LOG_FLAG_WIFI){
+        h.rssiMin = h.wifiOn == 0 ? record.rssi : min(h.rssiMin, record.rssi);
+        h.wifiOn++;
+        acc.rssiSum += record.rssi;
+    }
+}
+
+static bool hourWrite(hour_acc_t &acc){
+    sensor_log_hour_t &h = acc.hour;
+    if(h.count == 0){
+        return true;
+    }
+    h.rawMean = acc.rawSum / h.count;
+    h.moistureMean = acc.moistureSum / h.count;
+    h.rssiMean = h.wifiOn > 0 ? acc.rssiSum / (int32_t)h.wifiOn : 0;
+    h.crc = hourCrc(h);
+    if(!hourlyFile.seek(HOURLY_DATA + hourlySize) || hourlyFile.write((const uint8_t *)&h, sizeof(h)) != sizeof(h)){
+        return false;
+    }
+    hourlySize += sizeof(h);
+    compactedHour = max(compactedHour, h.hour);
+    return true;
+}
+
+/**
+ * @brief Appends the hourly aggregates of a closed segment to hourly.bin, then records the segment in the header.
+ *        Readings are in time order, so an hour is a run of consecutive readings; a segment normally holds one hour.
+ *        A segment at or before the last compacted one is skipped.
+ */
+static bool compactSegment(uint32_t seq){
+    if(seq < compactedSegments){
+        return true;   // Already in hourly.bin
+    }
+    File file = logFs->open(segmentPath(seq));
+    if(!file){
+        compactedSegments = seq + 1;
+        return writeHourlyHeader();   // Nothing to compact
+    }
+    uint8_t *buf = (uint8_t *)malloc(SCAN_BUFFER_SIZE);
+    if(buf == NULL){
+        return false;
+    }
+    uint32_t committedSize = hourlySize;
+    uint32_t committedHour = compactedHour;
+    uint32_t start = millis();
+    hour_acc_t acc;
+    hourStart(acc, 0, seq);
+    bool first = true;
+    bool ok = true;
+    readItems(file, 0, file.size(), sizeof(sensor_log_record_t), buf, [&](const uint8_t *item){
+        const sensor_log_record_t &record = *(const sensor_log_record_t *)item;
+        if(record.crc != recordCrc(record)){
+            return true;
+        }
+        uint32_t hour = hourOf(record.timestamp);
+        if(first || hour * 3600 != acc.hour.hour || acc.hour.count == UINT16_MAX){
+            ok = ok && hourWrite(acc);
+            hourStart(acc, hour, seq);
+            first = false;
+        }
+        hourAdd(acc, record);
+        return true;
+    });
+    ok = ok && hourWrite(acc);
+    hourlyFile.flush();
+    free(buf);
+    if(!ok){
+        hourlySize = committedSize;   // The next compaction overwrites the partial aggregates
+        compactedHour = committedHour;
+        return false;
+    }
+    compactedSegments = seq + 1;
+    ok = writeHourlyHeader();
+    Serial.printf("Sensor log: segment %u compacted in %u ms\n", seq, (uint32_t)(millis() - start));
+    return ok;
+}
+
+/**
+ * @brief Removes the oldest raw segments beyond SENSOR_LOG_RAW_SEGMENTS (all of them are compacted by then).
+ */
+static void pruneSegments(void){
+    while(segment - firstSegment > SENSOR_LOG_RAW_SEGMENTS){
+        logFs->remove(segmentPath(firstSegment));
+        firstSegment++;
+    }
+}
+
+static bool openSegment(uint32_t seq){
+    segment = seq;
+    segmentRecords = 0;
+    segmentHour = 0;
+    sectorOffset = 0;
+    sectorUsed = 0;
+    unsyncedSectors = 0;
+    segmentFile = logFs->open(segmentPath(seq), FILE_WRITE);
+    if(!segmentFile){
+        Serial.println("Failed to create sensor log segment");
+        return false;
+    }
+    pruneSegments();
+    return true;
+}
+
+/**
+ * @brief Closes the segment being written, compacts it and starts the next one.
+ */
+static bool rotate(void){
+    bool ok = writeSector(true);
+    segmentFile.close();
+    ok = compactSegment(segment) && ok;
+    return openSegment(segment + 1) && ok;
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+bool sensorLogBegin(fs::FS &fs, const char * dirname){
+    if(logMutex == NULL){
+        logMutex = xSemaphoreCreateMutex();
+    }
+    xSemaphoreTake(logMutex, portMAX_DELAY);
+    logFs = &fs;
+    logDir = dirname;
+    if(!fs.exists(dirname) && !fs.mkdir(dirname)){
+        Serial.printf("Failed to create %s\n", dirname);
+        xSemaphoreGive(logMutex);
+        return false;
+    }
+
+    String hourlyPath = logDir + "/" + SENSOR_LOG_HOURLY_FILE;
+    if(!fs.exists(hourlyPath)){
+        File file = fs.open(hourlyPath, FILE_WRITE);
+        file.close();
+    }
+    hourlyFile = fs.open(hourlyPath, "r+");
+    if(!hourlyFile){
+        Serial.println("Failed to open the hourly sensor log");
+        xSemaphoreGive(logMutex);
+        return false;
+    }
+    // Aggregates past the header's size are from a compaction cut short, and are overwritten by its next run
+    hourly_header_t copy0, copy1;
+    bool valid0 = readHourlyHeader(0, copy0);
+    bool valid1 = readHourlyHeader(1, copy1);
+    bool hourlyValid = valid0 || valid1;
+    if(hourlyValid){
+        const hourly_header_t &header = (valid0 && valid1) ? (copy1.generation > copy0.generation ? copy1 : copy0)
+                                                            : (valid0 ? copy0 : copy1);
+        hourlyGeneration = header.generation;
+        compactedSegments = header.segments;
+        compactedHour = header.lastHour;
+        hourlySize = header.size;
+    } else {
+        if(hourlyFile.size() > 0){
+            Serial.println("Sensor log: hourly.bin has no valid header, compacting the raw segments again");
+        }
+        hourlyGeneration = 0;
+        compactedSegments = 0;
+        compactedHour = 0;
+        hourlySize = 0;
+    }
+
+    // One pass over the directory for the range of segment numbers
+    int64_t lowest = -1, highest = -1;
+    File root = fs.open(dirname);
+    File file = root.openNextFile();
+    while(file){
+        const char * name = strrchr(file.name(), '/');
+        name = (name != NULL) ? name + 1 : file.name();
+        char * end = NULL;
+        long seq = strtol(name, &end, 10);
+        if(end != name && isdigit((unsigned char)name[0]) && strcmp(end, ".seg") == 0){
+            lowest = (lowest < 0 || seq < lowest) ? seq : lowest;
+            highest = max(highest, (int64_t)seq);
+        }
+        file = root.openNextFile();
+    }
+    root.close();
+
+    bool ok = true;
+    if(!hourlyValid){
+        compactedSegments = highest >= 0 ? lowest : 0;
+        ok = writeHourlyHeader() && writeHourlyHeader();   // Initialize both copies
+    }
+    if(highest >= 0){
+        firstSegment = lowest;
+        for(int64_t seq = lowest; seq <= highest; seq++){
+            ok = compactSegment(seq) && ok;   // Left by the previous boot, unless already compacted
+        }
+        ok = openSegment(max((uint32_t)highest + 1, compactedSegments)) && ok;
+    } else {
+        firstSegment = compactedSegments;
+        ok = openSegment(compactedSegments) && ok;
+    }
+    Serial.printf("Sensor log: %u hourly aggregates, raw segments %u to %u\n",
+                  (unsigned)(hourlySize / sizeof(sensor_log_hour_t)), firstSegment, segment);
+    xSemaphoreGive(logMutex);
+    return ok;
+}
+
+bool sensorLogAppend(uint32_t timestamp, uint16_t raw, uint8_t moisture, uint8_t flags, int8_t rssi){
+    if(logMutex == NULL){
+        return false;
+    }
+    xSemaphoreTake(logMutex, portMAX_DELAY);
+    if(!segmentFile){
+        xSemaphoreGive(logMutex);
+        return false;
+    }
+    bool ok = true;
+    uint32_t hour = hourOf(timestamp);
+    if(segmentRecords >= SENSOR_LOG_SEGMENT_MAX || (hour != 0 && segmentHour != 0 && hour != segmentHour)){
+        ok = rotate();
+    }
+    if(segmentHour == 0){
+        segmentHour = hour;
+    }
+
+    sensor_log_record_t *record = (sensor_log_record_t *)(sectorBuffer + sectorUsed);
+    memset(record, 0, sizeof(*record));
+    record->timestamp = timestamp;
+    record->raw = raw;
+    record->moisture = moisture;
+    record->flags = flags;
+    record->rssi = rssi;
+    record->crc = recordCrc(*record);
+    sectorUsed += sizeof(*record);
+    segmentRecords++;
+    if(sectorUsed == SENSOR_LOG_SECTOR){
+        ok = writeSector(false) && ok;
+    }
+    xSemaphoreGive(logMutex);
+    return ok;
+}
+
+bool sensorLogFlush(void){
+    if(logMutex == NULL){
+        return false;
+    }
+    xSemaphoreTake(logMutex, portMAX_DELAY);
+    bool ok = segmentFile && writeSector(true);
+    xSemaphoreGive(logMutex);
+    return ok;
+}
+
+uint32_t sensorLogScan(uint32_t from, uint32_t to, sensor_log_record_cb callback, void *arg){
+    if(logMutex == NULL){
+        return 0;
+    }
+    uint8_t *buf = (uint8_t *)malloc(SCAN_BUFFER_SIZE);
+    if(buf == NULL){
+        return 0;
+    }
+    xSemaphoreTake(logMutex, portMAX_DELAY);
+    uint32_t count = 0;
+    bool more = true;
+    auto visit = [&](const uint8_t *item){
+        const sensor_log_record_t &record = *(const sensor_log_record_t *)item;
+        if(record.crc != recordCrc(record)){
+            return true;
+        }
+        if(record.timestamp > to){
+            return false;   // Readings are in time order
+        }
+        if(record.timestamp >= from && (record.timestamp >= SENSOR_LOG_CLOCK_VALID || from == 0)){
+            count++;
+            more = callback(record, arg);
+        }
+        return more;
+    };
+    for(uint32_t seq = firstSegment; seq < segment && more; seq++){
+        File file = logFs->open(segmentPath(seq));
+        if(!file){
+            continue;
+        }
+        // Skip a segment that ends before 'from' with one read of its last record
+        uint32_t size = file.size() / sizeof(sensor_log_record_t) * sizeof(sensor_log_record_t);
+        sensor_log_record_t last;
+        if(size > 0 && file.seek(size - sizeof(last)) && file.read((uint8_t *)&last, sizeof(last)) == sizeof(last) &&
+           last.crc == recordCrc(last) && last.timestamp >= SENSOR_LOG_CLOCK_VALID && last.timestamp < from){
+            continue;
+        }
+        more = readItems(file, 0, size, sizeof(sensor_log_record_t), buf, visit);
+    }
+    // The segment being written: its whole sectors on the card, then the sector buffer
+    segmentFile.flush();
+    File current = logFs->open(segmentPath(segment));
+    if(more && current){
+        more = readItems(current, 0, sectorOffset, sizeof(sensor_log_record_t), buf, visit);
+    }
+    for(uint32_t i = 0; more && i < sectorUsed; i += sizeof(sensor_log_record_t)){
+        more = visit(sectorBuffer + i);
+    }
+    xSemaphoreGive(logMutex);
+    free(buf);
+    return count;
+}
+
+uint32_t sensorLogScanHours(uint32_t from, uint32_t to, sensor_log_hour_cb callback, void *arg){
+    if(logMutex == NULL){
+        return 0;
+    }
+    uint8_t *buf = (uint8_t *)malloc(SCAN_BUFFER_SIZE);
+    if(buf == NULL){
+        return 0;
+    }
+    xSemaphoreTake(logMutex, portMAX_DELAY);
+    uint32_t count = 0;
+    if(hourlyFile){
+        readItems(hourlyFile, HOURLY_DATA, HOURLY_DATA + hourlySize, sizeof(sensor_log_hour_t), buf, [&](const uint8_t *item){
+            const sensor_log_hour_t &hour = *(const sensor_log_hour_t *)item;
+            if(hour.crc != hourCrc(hour) || hour.hour < from || hour.hour > to){
+                return true;
+            }
+            count++;
+            return callback(hour, arg);
+        });
+    }
+    xSemaphoreGive(logMutex);
+    free(buf);
+    return count;
+}
@@ -0,0 +1,110 @@
+#ifndef __SENSOR_LOG_H
+#define __SENSOR_LOG_H
+
+#include "Arduino.h"
+#include "FS.h"
+
+#define SENSOR_LOG_DIR          "/log"
+#define SENSOR_LOG_HOURLY_FILE  "hourly.bin"    // Hourly aggregates of the compacted segments and the last compacted one, in SENSOR_LOG_DIR
+#define SENSOR_LOG_SECTOR       512             // Appends are buffered and written one whole sector at a time
+#define SENSOR_LOG_SYNC_SECTORS 8               // fsync() every 8 sectors (256 readings, about 4 minutes at 1 Hz)
+#define SENSOR_LOG_SEGMENT_MAX  8192            // Readings per raw segment at most; a segment also ends when the hour changes
+#define SENSOR_LOG_RAW_SEGMENTS 48              // Raw segments kept after compaction: two days of hourly segments
+#define SENSOR_LOG_CLOCK_VALID  1600000000UL    // Older timestamps were taken before the clock was set
+
+#define SENSOR_LOG_FLAG_PUMP    0x01            // The pump relay was on
+#define SENSOR_LOG_FLAG_WIFI    0x02            // WiFi was connected, rssi is valid
+
+/**
+ * @brief One reading, 16 bytes so that 32 of them fill a sector.
+ * timestamp Seconds since the epoch (UTC), or 0 if the clock was not set.
+ * raw       Raw ADC value of the moisture sensor.
+ * moisture  Soil moisture in percent.
+ * flags     SENSOR_LOG_FLAG_ bits.
+ * rssi      WiFi RSSI in dBm, 0 when not connected.
+ * crc       CRC32 of all fields above; records with a wrong CRC (torn by a power loss) are skipped by the scans.
+ */
+typedef struct {
+  uint32_t timestamp;
+  uint16_t raw;
+  uint8_t moisture;
+  uint8_t flags;
+  int8_t rssi;
+  uint8_t reserved[3];
+  uint32_t crc;
+} sensor_log_record_t;
+
+/**
+ * @brief The aggregate of the readings of one hour of one raw segment, 32 bytes.
+ * hour          Start of the hour in seconds since the epoch, 0 for readings taken before the clock was set.
+ * segment       Number of the raw segment the readings came from.
+ * count         Number of readings.
+ * pumpOn        Readings with the pump on (seconds of watering at 1 Hz).
+ * wifiOn        Readings with WiFi connected.
+ * rawMean       Mean raw ADC value.
+ * moistureMin, moistureMax, moistureMean  Soil moisture in percent.
+ * rssiMin, rssiMean  RSSI in dBm over the readings with WiFi connected, 0 if there were none.
+ * crc           CRC32 of all fields above.
+ */
+typedef struct {
+  uint32_t hour;
+  uint32_t segment;
+  uint16_t count;
+  uint16_t pumpOn;
+  uint16_t wifiOn;
+  uint16_t rawMean;
+  uint8_t moistureMin;
+  uint8_t moistureMax;
+  uint8_t moistureMean;
+  int8_t rssiMin;
+  int8_t rssiMean;
+  uint8_t reserved[7];
+  uint32_t crc;
+} sensor_log_hour_t;
+
+/**
+ * @brief Called by the scans for each record in the time range. Return false to stop the scan.
+ *        It runs with the log locked, so it must not call the sensorLog functions.
+ */
+typedef bool (*sensor_log_record_cb)(const sensor_log_record_t &record, void *arg);
+typedef bool (*sensor_log_hour_cb)(const sensor_log_hour_t &hour, void *arg);
+
+/**
+ * @brief Opens the log in a directory, creating it if needed. The segments left by the previous boot are compacted into
+ *        hourly aggregates, then a new segment is started, so appends always start on a sector boundary.
+ * @param fs The file system holding the log (SD_MMC).
+ * @param dirname The log directory.
+ * @return true if the log is ready.
+ */
+bool sensorLogBegin(fs::FS &fs, const char * dirname = SENSOR_LOG_DIR);
+
+/**
+ * @brief Appends a reading. The record is copied into a sector buffer; the buffer goes to the card when the sector is
+ *        full, so 31 appends in 32 take a few microseconds. When the hour changes or the segment is full, the segment is
+ *        closed and compacted into hourly aggregates (a few tens of milliseconds, once an hour).
+ * @return false if the log is not open or the sector could not be written.
+ */
+bool sensorLogAppend(uint32_t timestamp, uint16_t raw, uint8_t moisture, uint8_t flags, int8_t rssi);
+
+/**
+ * @brief Writes the readings still in the sector buffer and syncs the segment, e.g. before a restart.
+ *        The sector is written again when it fills up, so flushing often only costs card time.
+ */
+bool sensorLogFlush(void);
+
+/**
+ * @brief Calls 'callback' for every reading from 'from' to 'to' (seconds since the epoch, inclusive) in the raw segments
+ *        still on the card (SENSOR_LOG_RAW_SEGMENTS) and in the sector buffer. Readings without a clock are included
+ *        only when 'from' is 0.
+ * @return The number of readings passed to the callback.
+ */
+uint32_t sensorLogScan(uint32_t from, uint32_t to, sensor_log_record_cb callback, void *arg);
+
+/**
+ * @brief Calls 'callback' for every hourly aggregate whose hour starts from 'from' to 'to'. A month is 720 aggregates
+ *        (23 KB), read in a few milliseconds.
+ * @return The number of aggregates passed to the callback.
+ */
+uint32_t sensorLogScanHours(uint32_t from, uint32_t to, sensor_log_hour_cb callback, void *arg);
+
+#endif
@@ -0,0 +1,370 @@
+/**
+ * task_scheduler.cpp
+ *
+ * A cooperative scheduler for the periodic work of loop(), instead of one millis() comparison per task on every pass.
+ * The deadlines are kept in a hierarchical timer wheel of 1 ms ticks:
+ *   level 0: 256 slots of 1 ms       (the next 256 ms)
+ *   level 1:  64 slots of 256 ms     (16 s)
+ *   level 2:  64 slots of 16.4 s     (17 min)
+ *   level 3:  64 slots of 17.5 min   (18.6 h; a later deadline waits in the last slot and is filed again from there)
+ * A task goes to the lowest level whose range holds its deadline. When the clock enters a new slot of a level, the tasks
+ * of that slot are filed again one level down, so a task is moved at most 3 times and the due tasks are always in the
+ * slot of level 0 at the current tick. A bitmap of the occupied slots per level answers the next wake-up time without
+ * walking the slots. The tasks are run and filed from loop() only; the statistics can be read from any task.
+ *
+ * Author: John Leung
+ * Date: October 16, 2026
+ */
+#include "task_scheduler.h"
+
+#define WHEEL_LEVELS        4
+#define WHEEL_LEVEL0_BITS   8
+#define WHEEL_LEVEL_BITS    6
+#define WHEEL_SLOTS         (1 << WHEEL_LEVEL0_BITS)    // Slots of level 0, the largest level
+#define NO_TASK             0xFF
+
+static_assert(SCHEDULER_MAX_TASKS < NO_TASK, "task ids are bytes");
+
+// A list of tasks in deadline order of insertion, linked through the task table
+typedef struct {
+  uint8_t head;
+  uint8_t tail;
+} task_list_t;
+
+typedef struct {
+  scheduler_fn_t fn;            // NULL for a free entry
+  void* arg;
+  uint32_t deadline;            // millis() at which the task is due
+  uint8_t next, prev;
+  task_list_t* list;            // The slot (or the run list) holding the task, NULL while it runs
+  SchedulerTaskStats stats;
+} task_t;
+
+static const uint8_t levelShift[WHEEL_LEVELS] = {0, 8, 14, 20};
+static const uint8_t levelBits[WHEEL_LEVELS] = {WHEEL_LEVEL0_BITS, WHEEL_LEVEL_BITS, WHEEL_LEVEL_BITS, WHEEL_LEVEL_BITS};
+
+static task_t tasks[SCHEDULER_MAX_TASKS];
+static task_list_t wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+static uint32_t occupied[WHEEL_LEVELS][WHEEL_SLOTS / 32];  // One bit per non-empty slot
+static uint32_t nextTick = 0;       // The first tick whose slot has not been run; the wheel holds deadlines from it
+static int runningTask = -1;        // The task whose function is running, -1 if none
+static bool runningCancelled = false;
+static bool wheelReady = false;     // Set by schedulerBegin(): the zero-initialised wheel has no NO_TASK list ends yet
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;  // Guards the statistics, read by /metrics
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+static inline uint32_t slotCount(uint8_t level) {
+  return 1UL << levelBits[level];
+}
+
+static inline uint32_t slotOf(uint8_t level, uint32_t tick) {
+  return (tick >> levelShift[level]) & (slotCount(level) - 1);
+}
+
+static void listAppend(task_list_t* list, uint8_t id) {
+  tasks[id].next = NO_TASK;
+  tasks[id].prev = list->tail;
+  if (list->tail != NO_TASK) {
+    tasks[list->tail].next = id;
+  } else {
+    list->head = id;
+  }
+  list->tail = id;
+  tasks[id].list = list;
+}
+
+static void listRemove(uint8_t id) {
+  task_list_t* list = tasks[id].list;
+  if (tasks[id].prev != NO_TASK) {
+    tasks[tasks[id].prev].next = tasks[id].next;
+  } else {
+    list->head = tasks[id].next;
+  }
+  if (tasks[id].next != NO_TASK) {
+    tasks[tasks[id].next].prev = tasks[id].prev;
+  } else {
+    list->tail = tasks[id].prev;
+  }
+  tasks[id].list = NULL;
+}
+
+static inline uint8_t listOfLevel(const task_list_t* list) {
+  return (list - &wheel[0][0]) / WHEEL_SLOTS;
+}
+
+static inline uint32_t listSlot(const task_list_t* list) {
+  return (list - &wheel[0][0]) % WHEEL_SLOTS;
+}
+
+/**
+ * @brief Takes a task out of its slot, and clears the slot's bit if it is now empty.
+ */
+static void unfile(uint8_t id) {
+  task_list_t* list = tasks[id].list;
+  listRemove(id);
+  if (list >= &wheel[0][0] && list < &wheel[0][0] + WHEEL_LEVELS * WHEEL_SLOTS && list->head == NO_TASK) {
+    uint32_t slot = listSlot(list);
+    occupied[listOfLevel(list)][slot / 32] &= ~(1UL << (slot % 32));
+  }
+}
+
+/**
+ * @brief Puts a task in the slot of its deadline, at the lowest level whose range holds it: level 0 holds the next 256
+ *        ticks, a higher level the 63 slot widths after the one of nextTick (whose deadlines go to the lower levels, and
+ *        which is spread over them when the clock enters it). A deadline that has passed is due at nextTick.
+ */
+static void file(uint8_t id) {
+  uint32_t tick = tasks[id].deadline;
+  if ((int32_t)(tick - nextTick) < 0) {
+    tick = nextTick;
+  }
+  uint8_t level = 0;
+  for (; level < WHEEL_LEVELS; level++) {
+    uint32_t ahead = ((tick >> levelShift[level]) - (nextTick >> levelShift[level])) & (UINT32_MAX >> levelShift[level]);
+    if (ahead < slotCount(level)) {
+      break;
+    }
+  }
+  if (level == WHEEL_LEVELS) {
+    // Beyond the wheel: the farthest slot of the last level, the task is filed again when the clock gets there
+    level = WHEEL_LEVELS - 1;
+    tick = nextTick + ((slotCount(level) - 1) << levelShift[level]);
+  }
+  uint32_t slot = slotOf(level, tick);
+  listAppend(&wheel[level][slot], id);
+  occupied[level][slot / 32] |= 1UL << (slot % 32);
+}
+
+/**
+ * @brief Returns the first occupied slot of a level from the slot of nextTick on, or -1. The slots of a level after the
+ *        one of nextTick are in deadline order, whole bitmap words are skipped at once.
+ */
+static int nextOccupiedSlot(uint8_t level) {
+  uint32_t count = slotCount(level);
+  uint32_t first = slotOf(level, nextTick);
+  for (uint32_t offset = 0; offset < count;) {
+    uint32_t slot = (first + offset) % count;
+    uint32_t bits = occupied[level][slot / 32] >> (slot % 32); // This slot and the following ones of its word
+    if (bits != 0) {
+      offset += __builtin_ctz(bits);
+      return offset < count ? (int)((first + offset) % count) : -1;
+    }
+    offset += 32 - slot % 32;
+  }
+  return -1;
+}
+
+/**
+ * @brief Files the tasks of the slots the clock enters at this tick one level down, highest level first so that a task
+ *        coming down two levels is spread in the same tick.
+ */
+static void cascade(uint32_t tick) {
+  for (int level = WHEEL_LEVELS - 1; level > 0; level--) {
+    if ((tick & ((1UL << levelShift[level]) - 1)) != 0) {
+      continue;
+    }
+    task_list_t* list = &wheel[level][slotOf(level, tick)];
+    while (list->head != NO_TASK) {
+      uint8_t id = list->head;
+      unfile(id);
+      file(id);
+    }
+  }
+}
+
+/**
+ * @brief Runs a due task, then files it again at its next deadline (periodic) or frees it (one-shot).
+ */
+static void dispatch(uint8_t id, uint32_t nowMs) {
+  task_t& task = tasks[id];
+  uint32_t late = nowMs - task.deadline;
+  runningTask = id;
+  runningCancelled = false;
+  uint32_t start = micros();
+  task.fn(task.arg);
+  uint32_t elapsed = micros() - start;
+  runningTask = -1;
+
+  SchedulerTaskStats& stats = task.stats;
+  portENTER_CRITICAL(&statsMux);
+  stats.runs++;
+  stats.lastUs = elapsed;
+  stats.maxUs = max(stats.maxUs, elapsed);
+  stats.totalUs += elapsed;
+  stats.lastLateMs = late;
+  stats.maxLateMs = max(stats.maxLateMs, late);
+  portEXIT_CRITICAL(&statsMux);
+
+  if (runningCancelled || stats.periodMs == 0) {
+    portENTER_CRITICAL(&statsMux);
+    task.fn = NULL;
+    portEXIT_CRITICAL(&statsMux);
+    return;
+  }
+  // The next deadline keeps the phase and is after now: the periods that have passed are skipped, not run in a burst
+  task.deadline += stats.periodMs;
+  uint32_t now = millis();
+  if ((int32_t)(now - task.deadline) >= 0) {
+    uint32_t missed = (now - task.deadline) / stats.periodMs + 1;
+    portENTER_CRITICAL(&statsMux);
+    stats.skipped += missed;
+    portEXIT_CRITICAL(&statsMux);
+    task.deadline += missed * stats.periodMs;
+  }
+  file(id);
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+void schedulerBegin() {
+  for (uint8_t id = 0; id < SCHEDULER_MAX_TASKS; id++) {
+    tasks[id].fn = NULL;
+    tasks[id].list = NULL;
+  }
+  for (uint8_t level = 0; level < WHEEL_LEVELS; level++) {
+    for (uint32_t slot = 0; slot < WHEEL_SLOTS; slot++) {
+      wheel[level][slot] = {NO_TASK, NO_TASK};
+    }
+  }
+  memset(occupied, 0, sizeof(occupied));
+  nextTick = millis();
+  wheelReady = true;
+}
+
+int schedulerAdd(const char* name, scheduler_fn_t fn, void* arg, uint32_t periodMs, uint32_t delayMs) {
+  if (fn == NULL || !wheelReady) {
+    return -1;
+  }
+  for (uint8_t id = 0; id < SCHEDULER_MAX_TASKS; id++) {
+    if (tasks[id].fn == NULL) {
+      task_t& task = tasks[id];
+      task.arg = arg;
+      task.deadline = millis() + delayMs;
+      portENTER_CRITICAL(&statsMux);
+      task.stats = {name, periodMs, 0, 0, 0, 0, 0, 0, 0};
+      task.fn = fn;
+      portEXIT_CRITICAL(&statsMux);
+      file(id);
+      return id;
+    }
+  }
+  return -1;
+}
+
+bool schedulerCancel(int id) {
+  if (id < 0 || id >= SCHEDULER_MAX_TASKS || tasks[id].fn == NULL) {
+    return false;
+  }
+  if (id == runningTask) {
+    runningCancelled = true; // Freed by dispatch() once its function returns
+    return true;
+  }
+  unfile(id);
+  portENTER_CRITICAL(&statsMux);
+  tasks[id].fn = NULL;
+  portEXIT_CRITICAL(&statsMux);
+  return true;
+}
+
+uint32_t schedulerRun() {
+  if (!wheelReady) {
+    return 0;
+  }
+  uint32_t now = millis();
+  uint32_t ran = 0;
+  task_list_t due;
+  while ((int32_t)(now - nextTick) >= 0) {
+    uint32_t tick = nextTick;
+    cascade(tick);
+    uint32_t slot = slotOf(0, tick);
+    if ((occupied[0][slot / 32] & (1UL << (slot % 32))) == 0) {
+      // Nothing due: straight to the next occupied slot of level 0, the next cascade or now + 1, whichever comes first
+      uint32_t skipTo = (tick | (slotCount(0) - 1)) + 1;
+      int next = nextOccupiedSlot(0);
+      if (next >= 0 && (int32_t)(tick + ((next - slot) & (slotCount(0) - 1)) - skipTo) < 0) {
+        skipTo = tick + ((next - slot) & (slotCount(0) - 1));
+      }
+      nextTick = (int32_t)(skipTo - (now + 1)) < 0 ? skipTo : now + 1;
+      continue;
+    }
+    // Move the slot out of the wheel first: the functions may add or cancel tasks, or be late enough to be due again
+    due = {NO_TASK, NO_TASK};
+    while (wheel[0][slot].head != NO_TASK) {
+      uint8_t id = wheel[0][slot].head;
+      unfile(id);
+      if ((int32_t)(tasks[id].deadline - tick) > 0) {
+        file(id); // Beyond the wheel when it was filed, still not due
+      } else {
+        listAppend(&due, id); // Due now, or added with a deadline that had already passed
+      }
+    }
+    nextTick++; // What the functions file from now on goes to the following ticks
+    while (due.head != NO_TASK) {
+      uint8_t id = due.head;
+      listRemove(id);
+      dispatch(id, millis());
+      ran++;
+    }
+  }
+  return ran;
+}
+
+uint32_t schedulerNextWakeMs() {
+  if (!wheelReady) {
+    return UINT32_MAX;
+  }
+  uint32_t earliest = 0;
+  bool found = false;
+  for (uint8_t level = 0; level < WHEEL_LEVELS; level++) {
+    int slot = nextOccupiedSlot(level);
+    if (slot < 0) {
+      continue;
+    }
+    // The first occupied slot of a level holds its earliest deadlines; the levels overlap, so all four are compared
+    for (uint8_t id = wheel[level][slot].head; id != NO_TASK; id = tasks[id].next) {
+      if (!found || (int32_t)(tasks[id].deadline - earliest) < 0) {
+        earliest = tasks[id].deadline;
+        found = true;
+      }
+    }
+  }
+  if (!found) {
+    return UINT32_MAX;
+  }
+  int32_t wait = (int32_t)(earliest - millis());
+  return wait > 0 ? (uint32_t)wait : 0;
+}
+
+uint32_t schedulerIdle() {
+  uint32_t wait = min(schedulerNextWakeMs(), (uint32_t)SCHEDULER_MAX_IDLE_MS);
+  if (wait > 0) {
+    vTaskDelay(max((TickType_t)1, (TickType_t)pdMS_TO_TICKS(wait)));
+  }
+  return wait;
+}
+
+uint8_t schedulerGetStats(SchedulerTaskStats* stats, uint8_t max) {
+  uint8_t count = 0;
+  portENTER_CRITICAL(&statsMux);
+  for (uint8_t id = 0; id < SCHEDULER_MAX_TASKS && count < max; id++) {
+    if (tasks[id].fn != NULL) {
+      stats[count++] = tasks[id].stats;
+    }
+  }
+  portEXIT_CRITICAL(&statsMux);
+  return count;
+}
+
+void schedulerPrintStats(Print& out) {
+  SchedulerTaskStats stats[SCHEDULER_MAX_TASKS];
+  uint8_t count = schedulerGetStats(stats, SCHEDULER_MAX_TASKS);
+  out.println("task             period_ms      runs  skipped  mean_us   max_us  last_late_ms  max_late_ms");
+  for (uint8_t i = 0; i < count; i++) {
+    const SchedulerTaskStats& s = stats[i];
+    out.printf("%-16s %9u %9u %8u %8u %8u %13u %12u\n", s.name ? s.name : "?", (unsigned)s.periodMs, (unsigned)s.runs,
+               (unsigned)s.skipped, (unsigned)(s.runs ? s.totalUs / s.runs : 0), (unsigned)s.maxUs,
+               (unsigned)s.lastLateMs, (unsigned)s.maxLateMs);
+  }
+  out.printf("next wake-up in %u ms\n", (unsigned)schedulerNextWakeMs());
+}
@@ -0,0 +1,90 @@
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include <Arduino.h>
+
+#define SCHEDULER_MAX_TASKS     16
+#define SCHEDULER_MAX_IDLE_MS   1000    // schedulerIdle() sleeps this long at most, e.g. with no task registered
+
+typedef void (*scheduler_fn_t)(void* arg);
+
+/**
+ * @brief Run statistics of a task.
+ * name       Name given to schedulerAdd().
+ * periodMs   Period, 0 for a one-shot task.
+ * runs       Times the task ran.
+ * skipped    Periods skipped because the task was more than a period late (a periodic task runs once to catch up).
+ * lastUs, maxUs, totalUs   Execution time of the task's function.
+ * lastLateMs, maxLateMs    How long after its deadline the task ran.
+ */
+typedef struct {
+  const char* name;
+  uint32_t periodMs;
+  uint32_t runs;
+  uint32_t skipped;
+  uint32_t lastUs;
+  uint32_t maxUs;
+  uint64_t totalUs;
+  uint32_t lastLateMs;
+  uint32_t maxLateMs;
+} SchedulerTaskStats;
+
+/**
+ * @brief Starts the scheduler's clock at millis(). Call it before schedulerAdd(); until then schedulerAdd() fails and
+ *        schedulerRun() runs nothing, so a loop() reached without it only idles. Apart from schedulerGetStats(), the
+ *        functions are called from one task, the one that calls schedulerRun() (loop()).
+ */
+void schedulerBegin();
+
+/**
+ * @brief Registers a task. Periodic tasks keep their phase: each deadline is the previous one plus the period, whatever
+ *        the lateness of the run.
+ * @param name Name for the statistics, a string that outlives the task.
+ * @param fn Function to call, from schedulerRun() in loop().
+ * @param arg Passed to fn.
+ * @param periodMs Period in milliseconds, 0 for a one-shot task (freed after its run).
+ * @param delayMs Time to the first run, 0 for the next schedulerRun().
+ * @return The task id, or -1 if SCHEDULER_MAX_TASKS are registered or schedulerBegin() was not called.
+ */
+int schedulerAdd(const char* name, scheduler_fn_t fn, void* arg, uint32_t periodMs, uint32_t delayMs = 0);
+
+/**
+ * @brief Removes a task, e.g. from its own function. Its statistics are lost.
+ * @return false if the id is not a registered task.
+ */
+bool schedulerCancel(int id);
+
+/**
+ * @brief Runs the tasks that are due, in deadline order (tasks with the same deadline in the order they were scheduled).
+ *        The hierarchical timer wheel makes the cost of a call proportional to the due tasks (plus one step per 256 ms
+ *        since the last call, for the cascades), not to the number of registered tasks.
+ * @return The number of tasks run.
+ */
+uint32_t schedulerRun();
+
+/**
+ * @brief Returns how long until the next task is due, in milliseconds: 0 if one is due now, UINT32_MAX if there is none.
+ */
+uint32_t schedulerNextWakeMs();
+
+/**
+ * @brief Blocks the calling task until the next task is due (at most SCHEDULER_MAX_IDLE_MS) with vTaskDelay(), so the
+ *        CPU idles (and can enter automatic light sleep when power management allows it) instead of polling.
+ * @return The milliseconds slept.
+ */
+uint32_t schedulerIdle();
+
+/**
+ * @brief Copies the statistics of the registered tasks. Can be called from any task, e.g. the web server's.
+ * @param stats SCHEDULER_MAX_TASKS entries at most are written.
+ * @param max Entries available.
+ * @return The number of tasks copied.
+ */
+uint8_t schedulerGetStats(SchedulerTaskStats* stats, uint8_t max);
+
+/**
+ * @brief Prints the statistics of the registered tasks as a table.
+ */
+void schedulerPrintStats(Print& out);
+
+#endif
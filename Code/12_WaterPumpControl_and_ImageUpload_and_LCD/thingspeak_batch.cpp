@@ -0,0 +1,231 @@
+/**
+ * thingspeak_batch.cpp
+ *
+ * A batching ThingSpeak publisher. ThingSpeak.writeFields() costs one HTTP request per reading and a free account may
+ * only write every 15 s, which limits the moisture resolution. Here the readings are buffered in RAM (PSRAM if available)
+ * with their timestamp and sent in one JSON body to the bulk_update.json endpoint once per flush interval:
+ *
+ *   POST /channels/<id>/bulk_update.json
+ *   {"write_api_key":"...","updates":[{"created_at":"2026-10-16T08:00:05Z","field1":"35"}, ...]}
+ *
+ * Readings can therefore be sampled every few seconds with one HTTP request per minute.
+ * A failed flush keeps the readings for the next one; when the buffer is full a new reading is refused, so a reading
+ * replayed from the SD card spool stays in the spool until there is room for it.
+ *
+ * Author: John Leung
+ * Date: October 16, 2026
+ */
+#include "thingspeak_batch.h"
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <time.h>
+#include "metrics.h"
+
+#define THINGSPEAK_BATCH_MIN_INTERVAL 15000   // Minimum time between two bulk updates (free account limit)
+
+typedef struct {
+  uint32_t seq;
+  uint32_t timestamp;   // Seconds since the epoch, 0 if the clock was not set when the reading was added
+  uint32_t millisAt;    // millis() when the reading was added, used to date readings taken before the clock was set
+  uint8_t moisture;
+  char url[THINGSPEAK_BATCH_URL_LENGTH];
+} batch_entry_t;
+
+static batch_entry_t* entries = NULL;
+static uint16_t capacity = 0;       // Twice the batch size, so new readings fit while a flush is in flight
+static uint16_t batchSize = 0;
+static uint16_t head = 0;           // Next slot to write
+static uint16_t count = 0;
+static uint32_t nextSeq = 0;
+static uint32_t flushInterval = THINGSPEAK_BATCH_FLUSH_INTERVAL;
+static SemaphoreHandle_t batchMutex = NULL;
+static TaskHandle_t batchTaskHandle = NULL;
+static ThingSpeakBatchStats batchStats = {0, 0, 0, 0, 0};
+
+static String serverUrl = THINGSPEAK_BATCH_SERVER;
+static unsigned long batchChannelId;
+static String batchApiKey;
+static uint8_t batchMoistureField;
+static uint8_t batchUrlField;
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+// ThingSpeak stores the JSON strings as they are, so the image URL is decoded back from its form-encoded version
+static String urlDecode(const char* str) {
+  String decoded = "";
+  for (const char* p = str; *p != '\0'; p++) {
+    if (*p == '%' && isxdigit(p[1]) && isxdigit(p[2])) {
+      char hex[3] = {p[1], p[2], '\0'};
+      decoded += (char)strtol(hex, NULL, 16);
+      p += 2;
+    } else if (*p == '"' || *p == '\\') {
+      decoded += '\\';
+      decoded += *p;
+    } else {
+      decoded += *p;
+    }
+  }
+  return decoded;
+}
+
+/**
+ * @brief Builds the bulk update body from the oldest readings (at most one batch).
+ * @param lastSeq Set to the sequence number of the last reading in the body.
+ * @return The number of readings in the body.
+ */
+static uint16_t buildBody(String& body, uint32_t& lastSeq) {
+  time_t now = time(NULL);
+  uint32_t nowMillis = millis();
+  char createdAt[24];
+
+  xSemaphoreTake(batchMutex, portMAX_DELAY);
+  uint16_t n = count < batchSize ? count : batchSize;
+  body.reserve(64 + n * 64);
+  body = "{\"write_api_key\":\"" + batchApiKey + "\",\"updates\":[";
+  for (uint16_t i = 0; i < n; i++) {
+    const batch_entry_t& e = entries[(head + capacity - count + i) % capacity];
+    time_t t = e.timestamp != 0 ? (time_t)e.timestamp : now - (time_t)((nowMillis - e.millisAt) / 1000);
+    strftime(createdAt, sizeof(createdAt), "%Y-%m-%dT%H:%M:%SZ", gmtime(&t));
+    if (i > 0) {
+      body += ',';
+    }
+    body += "{\"created_at\":\"";
+    body += createdAt;
+    body += "\",\"field" + String(batchMoistureField) + "\":\"" + String(e.moisture) + "\"";
+    if (e.url[0] != '\0') {
+      body += ",\"field" + String(batchUrlField) + "\":\"" + urlDecode(e.url) + "\"";
+    }
+    body += '}';
+    lastSeq = e.seq;
+  }
+  xSemaphoreGive(batchMutex);
+  body += "]}";
+  return n;
+}
+
+/**
+ * @brief Sends one batch. The readings are removed from the buffer only when ThingSpeak has accepted them.
+ */
+static void flushBatch() {
+  String body;
+  uint32_t lastSeq = 0;
+  uint16_t n = buildBody(body, lastSeq);
+  if (n == 0) {
+    return;
+  }
+
+  HTTPClient http;
+  http.begin(serverUrl + "/channels/" + String(batchChannelId) + "/bulk_update.json");
+  http.setTimeout(30000);
+  http.addHeader("Content-Type", "application/json");
+  uint32_t start = micros();
+  int httpCode = http.POST(body);
+  http.end();
+  metricsObserve(METRIC_UPLOAD_THINGSPEAK, micros() - start);
+  metricsThingSpeakResponse(httpCode);
+  batchStats.lastHttpCode = httpCode;
+
+  if (httpCode == HTTP_CODE_ACCEPTED || httpCode == HTTP_CODE_OK) {
+    // Remove what was sent; readings dropped meanwhile (buffer full) have already left the buffer
+    xSemaphoreTake(batchMutex, portMAX_DELAY);
+    while (count > 0 && (int32_t)(entries[(head + capacity - count) % capacity].seq - lastSeq) <= 0) {
+      count--;
+    }
+    xSemaphoreGive(batchMutex);
+    batchStats.flushes++;
+    Serial.printf("ThingSpeak bulk update: %u readings, %u bytes\n", n, body.length());
+  } else {
+    batchStats.failures++;
+    Serial.printf("ThingSpeak bulk update failed. Response code: %d\n", httpCode);
+  }
+}
+
+/**
+ * @brief The flush task. Flushes once per interval, or earlier when the buffer holds a full batch.
+ */
+static void batchTask(void* arg) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(flushInterval));
+    if (WiFi.status() != WL_CONNECTED || time(NULL) < 1600000000) {
+      continue; // No network, or NTP has not set the clock needed for created_at yet
+    }
+    flushBatch();
+    vTaskDelay(pdMS_TO_TICKS(THINGSPEAK_BATCH_MIN_INTERVAL));
+  }
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+void thingspeakBatchSetServer(const String& url) {
+  serverUrl = url;
+}
+
+bool thingspeakBatchBegin(unsigned long channelId, const char* writeApiKey, uint8_t moistureField, uint8_t urlField,
+                          uint16_t size, uint32_t flushIntervalMs) {
+  if (entries != NULL) {
+    return true; // Already running
+  }
+  batchChannelId = channelId;
+  batchApiKey = writeApiKey;
+  batchMoistureField = moistureField;
+  batchUrlField = urlField;
+  batchSize = size;
+  capacity = size * 2;
+  flushInterval = flushIntervalMs;
+
+  size_t bytes = capacity * sizeof(batch_entry_t);
+  entries = (batch_entry_t*)(psramFound() ? ps_malloc(bytes) : malloc(bytes));
+  batchMutex = xSemaphoreCreateMutex();
+  if (entries == NULL || batchMutex == NULL) {
+    Serial.println("thingspeakBatchBegin(): not enough memory");
+    return false;
+  }
+  if (xTaskCreatePinnedToCore(batchTask, "tsbatch", THINGSPEAK_BATCH_TASK_STACK, NULL,
+                              THINGSPEAK_BATCH_TASK_PRIORITY, &batchTaskHandle, THINGSPEAK_BATCH_TASK_CORE) != pdPASS) {
+    Serial.println("thingspeakBatchBegin(): failed to create the flush task");
+    return false;
+  }
+  return true;
+}
+
+bool thingspeakBatchAdd(uint8_t moistureValue, const String& imageUrl, uint32_t timestamp) {
+  if (entries == NULL) {
+    return false;
+  }
+  time_t now = time(NULL);
+
+  xSemaphoreTake(batchMutex, portMAX_DELAY);
+  if (count == capacity) {
+    xSemaphoreGive(batchMutex);
+    batchStats.dropped++;
+    return false; // Never overwrite a buffered reading: it may have left the spool already
+  }
+  batch_entry_t& e = entries[head];
+  e.seq = nextSeq++;
+  e.timestamp = timestamp != 0 ? timestamp : (now > 1600000000 ? (uint32_t)now : 0);
+  e.millisAt = millis();
+  e.moisture = moistureValue;
+  strlcpy(e.url, imageUrl.c_str(), sizeof(e.url));
+  head = (head + 1) % capacity;
+  count++;
+  bool full = count >= batchSize;
+  xSemaphoreGive(batchMutex);
+
+  batchStats.queued++;
+  if (full) {
+    xTaskNotifyGive(batchTaskHandle); // Flush early
+  }
+  return true;
+}
+
+uint16_t thingspeakBatchPending() {
+  return count;
+}
+
+bool thingspeakBatchHasRoom() {
+  return entries != NULL && count < capacity;
+}
+
+ThingSpeakBatchStats thingspeakBatchGetStats() {
+  return batchStats;
+}
@@ -0,0 +1,76 @@
+#ifndef THINGSPEAK_BATCH_H
+#define THINGSPEAK_BATCH_H
+
+#include <Arduino.h>
+
+#define THINGSPEAK_BATCH_SERVER         "http://api.thingspeak.com"
+#define THINGSPEAK_BATCH_SIZE           60      // Readings buffered before a flush is forced (ThingSpeak accepts up to 960 per request)
+#define THINGSPEAK_BATCH_FLUSH_INTERVAL 60000   // Time between two bulk updates in milliseconds (at least 15000 for a free account)
+#define THINGSPEAK_BATCH_URL_LENGTH     160     // Maximum length of the URL-encoded image URL, including the terminating zero
+#define THINGSPEAK_BATCH_TASK_STACK     8192
+#define THINGSPEAK_BATCH_TASK_PRIORITY  1
+#define THINGSPEAK_BATCH_TASK_CORE      0
+
+/**
+ * @brief Counters of the batching publisher.
+ * queued   Number of readings added.
+ * dropped  Number of readings refused because the buffer was full.
+ * flushes  Number of successful bulk updates.
+ * failures Number of failed bulk updates (the readings are kept and sent with the next flush).
+ * lastHttpCode HTTP code of the last bulk update (202 means accepted).
+ */
+struct ThingSpeakBatchStats {
+  uint32_t queued;
+  uint32_t dropped;
+  uint32_t flushes;
+  uint32_t failures;
+  int lastHttpCode;
+};
+
+/**
+ * @brief Allocates the reading buffer (in PSRAM if available) and starts the task that flushes it with ThingSpeak's
+ *        bulk_update.json endpoint: one HTTP request per flush interval instead of one per reading.
+ * @param channelId The ThingSpeak channel number.
+ * @param writeApiKey The channel's write API key.
+ * @param moistureField Field number of the moisture value.
+ * @param urlField Field number of the image URL.
+ * @param batchSize Number of readings buffered; the buffer is flushed early when it is full.
+ * @param flushIntervalMs Time between two bulk updates in milliseconds.
+ * @return true if the publisher was started.
+ */
+bool thingspeakBatchBegin(unsigned long channelId, const char* writeApiKey, uint8_t moistureField, uint8_t urlField,
+                          uint16_t batchSize = THINGSPEAK_BATCH_SIZE,
+                          uint32_t flushIntervalMs = THINGSPEAK_BATCH_FLUSH_INTERVAL);
+
+/**
+ * @brief Changes the server the bulk updates are sent to, e.g. "http://192.168.1.10:8081" for Code/tools/thingspeak_standin.py.
+ *        Call it before thingspeakBatchBegin().
+ */
+void thingspeakBatchSetServer(const String& serverUrl);
+
+/**
+ * @brief Adds a reading to the batch. Never blocks on the network, can be called from loop() or any task.
+ *        If the buffer is full the reading is refused; the buffered ones are never overwritten.
+ * @param moistureValue The soil moisture percentage.
+ * @param imageUrl The URL-encoded image URL (as returned by uploadToGoogleDrive()), or an empty string.
+ * @param timestamp Time of the reading in seconds since the epoch (UTC), or 0 for "now".
+ * @return true if the reading was added, false if the buffer is full or the publisher is not running.
+ */
+bool thingspeakBatchAdd(uint8_t moistureValue, const String& imageUrl, uint32_t timestamp = 0);
+
+/**
+ * @brief Returns the number of readings waiting for the next flush.
+ */
+uint16_t thingspeakBatchPending();
+
+/**
+ * @brief Returns true if thingspeakBatchAdd() would accept a reading now, e.g. before a job is taken from the SD card spool.
+ */
+bool thingspeakBatchHasRoom();
+
+/**
+ * @brief Returns the counters of the publisher.
+ */
+ThingSpeakBatchStats thingspeakBatchGetStats();
+
+#endif
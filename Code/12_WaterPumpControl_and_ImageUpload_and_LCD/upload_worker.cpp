@@ -0,0 +1,351 @@
+/**
+ * upload_worker.cpp
+ *
+ * A FreeRTOS task that saves captured images to the SD card, uploads them to Google Drive and hands the
+ * resulting URL to a callback, so that loop() never waits for the network.
+ *
+ * loop() only captures the frame and calls uploadWorkerSubmit(), which copies the JPEG to PSRAM and puts a job
+ * into a bounded queue. The upload task takes the jobs one by one; each can block for up to the 30 s HTTP timeout
+ * without affecting the pump control or the LED blinking in loop().
+ *
+ * Store-and-forward: a job handled while WiFi is down is saved to the SD card and recorded in the spool (sd_spool.cpp).
+ * When WiFi is back and the queue is empty, the upload task replays the spool, oldest first, as fast as the Google Drive
+ * uploads and the publish interval allow.
+ *
+ * WiFi: while WiFi is down, the upload task also calls the reconnection function of the sketch every UPLOAD_WIFI_RETRY_MS,
+ * so that the blocking WiFi.begin() runs here rather than in loop().
+ *
+ * Retention: when no job has arrived for RETENTION_IDLE_MS and there is nothing to replay, the upload task runs small
+ * batches of the /camera retention manager (capture_retention.cpp). A batch stops as soon as a job is queued, so a capture
+ * waits for one deletion at most; upload_queue_wait_seconds in /metrics shows that wait.
+ *
+ * Author: John Leung
+ * Date: October 16, 2026
+ */
+#include "upload_worker.h"
+#include "app_httpd.h"
+#include "google_drive.h"
+#include "metrics.h"
+#include <WiFi.h>
+#include <time.h>
+#include "capture_index.h"
+#ifdef USE_SD_MMC
+#include "sd_spool.h"
+#include "capture_retention.h"
+#endif
+
+typedef struct {
+  uint8_t* jpg;      // JPEG copy in PSRAM, freed by the upload task
+  size_t len;
+  shared_frame_t* frame;  // Or a shared frame (jpg points into it), released by the upload task
+  uint8_t moisture;
+  uint32_t timestamp;  // Capture time in seconds since the epoch, 0 if the clock was not set
+  uint32_t submitMicros;  // micros() when the job was queued
+} upload_job_t;
+
+static QueueHandle_t uploadQueue = NULL;
+static TaskHandle_t uploadTaskHandle = NULL;
+static String uploadWebAppUrl;
+static UploadResultCallback uploadResultCallback = NULL;
+static uint32_t publishInterval = UPLOAD_PUBLISH_INTERVAL;
+static uint32_t lastPublishMillis = 0;
+static bool hasPublished = false;
+static uint8_t drainFailures = 0;
+static uint32_t lastJobMillis = 0;     // When the upload task last finished a job
+static WiFiReconnectCallback wifiReconnect = NULL;
+static UploadReadyCallback publishReady = NULL;
+static uint32_t lastReconnectMillis = 0;
+static bool hasReconnected = false;
+#ifdef USE_SD_MMC
+static capture_index_t cameraIndex;   // Names and metadata of the images in /camera, used by the upload task only
+#endif
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+/**
+ * @brief Saves the image of one job to the SD card and records it in the capture index.
+ * @return The path of the saved image, or an empty string if it was not saved.
+ */
+static String uploadWorkerSave(const upload_job_t& job) {
+#ifdef USE_SD_MMC
+  String filePath;
+  int32_t seq = captureIndexNext(cameraIndex, job.timestamp, filePath);
+  if (seq >= 0 && writejpg(SD_MMC, filePath.c_str(), job.jpg, job.len) &&
+      captureIndexAdd(cameraIndex, seq, job.timestamp, job.len, job.moisture)) {
+    Serial.printf("Image saved to %s\n", filePath.c_str());
+    return filePath;
+  }
+#endif
+  return "";
+}
+
+/**
+ * @brief Records the upload status of a saved image in the capture index.
+ */
+static void uploadWorkerSetStatus(const String& filePath, capture_status_t status) {
+#ifdef USE_SD_MMC
+  int32_t seq = captureIndexSeqOf(filePath.c_str());
+  if (seq >= 0) {
+    captureIndexSetStatus(cameraIndex, seq, status);
+  }
+#endif
+}
+
+/**
+ * @brief Uploads an image to Google Drive.
+ * @return The URL-encoded image URL, or an empty string on failure.
+ */
+static String uploadWorkerUpload(uint8_t* jpg, size_t len) {
+  String driveResponse;
+  uint32_t start = micros();
+  bool ok = uploadToGoogleDrive(uploadWebAppUrl, jpg, len, driveResponse);
+  metricsObserve(METRIC_UPLOAD_DRIVE, micros() - start);
+  if (ok) {
+    Serial.println("uploadWorker: " + driveResponse);
+    return driveResponse;
+  }
+  metricsCount(METRIC_DRIVE_FAILED);
+  Serial.println("Upload to Google Drive failed!");
+  return "";
+}
+
+/**
+ * @brief Passes a result to the callback, first waiting (in this task) until the publish interval has passed since the last one.
+ */
+static bool uploadWorkerPublish(uint8_t moisture, const String& imageUrl, uint32_t timestamp) {
+  if (uploadResultCallback == NULL) {
+    return true;
+  }
+  uint32_t elapsed = millis() - lastPublishMillis;
+  if (hasPublished && elapsed < publishInterval) {
+    vTaskDelay(pdMS_TO_TICKS(publishInterval - elapsed));
+  }
+  bool ok = uploadResultCallback(moisture, imageUrl, timestamp);
+  lastPublishMillis = millis();
+  hasPublished = true;
+  return ok;
+}
+
+/**
+ * @brief Handles one job from the queue: save to SD, then upload and publish, or spool it if WiFi is down.
+ */
+static void uploadWorkerProcess(const upload_job_t& job) {
+  String filePath = uploadWorkerSave(job);
+
+  if (WiFi.status() == WL_CONNECTED) {
+    String imageUrl = uploadWorkerUpload(job.jpg, job.len);
+    uploadWorkerSetStatus(filePath, imageUrl != "" ? CAPTURE_STATUS_UPLOADED : CAPTURE_STATUS_FAILED);
+    uploadWorkerPublish(job.moisture, imageUrl, job.timestamp);
+    return;
+  }
+#ifdef USE_SD_MMC
+  if (sdSpoolAppend(filePath.c_str(), job.moisture, job.timestamp)) {
+    uploadWorkerSetStatus(filePath, CAPTURE_STATUS_SPOOLED);
+    Serial.printf("WiFi is down, job spooled (%u pending)\n", sdSpoolCount());
+    return;
+  }
+#endif
+  Serial.println("WiFi is down, reading and image dropped.");
+}
+
+/**
+ * @brief Replays the oldest spooled job. It is removed from the spool only once it has been published,
+ *        so a job interrupted by another outage or a reboot is replayed again.
+ */
+static void uploadWorkerDrainOne() {
+#ifdef USE_SD_MMC
+  if (hasPublished && millis() - lastPublishMillis < publishInterval) {
+    return; // Not allowed to publish yet
+  }
+  if (publishReady != NULL && !publishReady()) {
+    return; // The result callback cannot take the job now, it stays in the spool
+  }
+  spool_record_t record;
+  if (!sdSpoolPeek(record)) {
+    return;
+  }
+
+  String imageUrl = "";
+  if (record.jpgPath[0] != '\0') {
+    size_t len = 0;
+    uint8_t* jpg = readjpg(SD_MMC, record.jpgPath, &len);
+    String movedPath;
+    int32_t seq = captureIndexSeqOf(record.jpgPath);
+    if (jpg == NULL && seq >= 0 && captureIndexPath(cameraIndex, seq, movedPath)) {
+      jpg = readjpg(SD_MMC, movedPath.c_str(), &len); // Spooled before the image was moved into its dated folder
+    }
+    if (jpg != NULL) {
+      imageUrl = uploadWorkerUpload(jpg, len);
+      free(jpg);
+      if (imageUrl == "" && ++drainFailures < UPLOAD_DRAIN_RETRIES) {
+        return; // Try again later, the reading is published without the URL after UPLOAD_DRAIN_RETRIES attempts
+      }
+    }
+  }
+  if (WiFi.status() != WL_CONNECTED || !uploadWorkerPublish(record.moisture, imageUrl, record.timestamp)) {
+    return;
+  }
+  drainFailures = 0;
+  uploadWorkerSetStatus(record.jpgPath, imageUrl != "" ? CAPTURE_STATUS_UPLOADED : CAPTURE_STATUS_FAILED);
+  sdSpoolPop();
+  Serial.printf("Spooled job %u replayed, %u pending\n", record.seq, sdSpoolCount());
+#endif
+}
+
+/**
+ * @brief Stop condition of the retention batches: a capture job is waiting.
+ */
+static bool uploadWorkerJobWaiting() {
+  return uxQueueMessagesWaiting(uploadQueue) > 0;
+}
+
+/**
+ * @brief Calls the WiFi reconnection function if WiFi is down and the last attempt is UPLOAD_WIFI_RETRY_MS ago.
+ */
+static void uploadWorkerReconnect() {
+  if (wifiReconnect == NULL || WiFi.status() == WL_CONNECTED ||
+      (hasReconnected && millis() - lastReconnectMillis < UPLOAD_WIFI_RETRY_MS)) {
+    return;
+  }
+  wifiReconnect();
+  lastReconnectMillis = millis();
+  hasReconnected = true;
+}
+
+/**
+ * @brief The upload task. Processes queued jobs in order, replays the spool when the queue is empty, runs the
+ *        retention manager when there is nothing else to do, and reconnects WiFi when it is down.
+ */
+static void uploadTask(void* arg) {
+  upload_job_t job;
+  for (;;) {
+    uploadWorkerReconnect();
+    if (xQueueReceive(uploadQueue, &job, pdMS_TO_TICKS(UPLOAD_DRAIN_POLL_MS)) == pdTRUE) {
+      metricsObserve(METRIC_UPLOAD_QUEUE_WAIT, micros() - job.submitMicros);
+      uploadWorkerProcess(job);
+      if (job.frame != NULL) {
+        frameBroadcasterRelease(job.frame);
+      } else {
+        free(job.jpg);
+      }
+      lastJobMillis = millis();
+    } else if (WiFi.status() == WL_CONNECTED && uploadWorkerSpoolDepth() > 0) {
+      uploadWorkerDrainOne();
+    }
+#ifdef USE_SD_MMC
+    else if (millis() - lastJobMillis >= RETENTION_IDLE_MS) {
+      captureRetentionRun(uploadWorkerJobWaiting);
+    }
+#endif
+  }
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+bool uploadWorkerBegin(const String& webAppUrl, UploadResultCallback onResult, uint32_t publishIntervalMs) {
+  if (uploadQueue != NULL) {
+    return true; // Already running
+  }
+  uploadWebAppUrl = webAppUrl;
+  uploadResultCallback = onResult;
+  publishInterval = publishIntervalMs;
+#ifdef USE_SD_MMC
+  sdSpoolBegin(SD_MMC);
+  if (captureIndexBegin(cameraIndex, SD_MMC, "/camera")) {
+    captureRetentionBegin(cameraIndex);
+  }
+#endif
+
+  uploadQueue = xQueueCreate(UPLOAD_QUEUE_LENGTH, sizeof(upload_job_t));
+  if (uploadQueue == NULL) {
+    Serial.println("uploadWorkerBegin(): failed to create the job queue");
+    return false;
+  }
+  if (xTaskCreatePinnedToCore(uploadTask, "upload", UPLOAD_TASK_STACK_SIZE, NULL,
+                              UPLOAD_TASK_PRIORITY, &uploadTaskHandle, UPLOAD_TASK_CORE) != pdPASS) {
+    Serial.println("uploadWorkerBegin(): failed to create the upload task");
+    vQueueDelete(uploadQueue);
+    uploadQueue = NULL;
+    return false;
+  }
+  return true;
+}
+
+void uploadWorkerSetWiFiReconnect(WiFiReconnectCallback reconnect) {
+  wifiReconnect = reconnect;
+  lastReconnectMillis = millis();   // setup() has just tried
+  hasReconnected = true;
+}
+
+void uploadWorkerSetPublishReady(UploadReadyCallback ready) {
+  publishReady = ready;
+}
+
+bool uploadWorkerSubmit(const camera_fb_t* fb, uint8_t moistureValue) {
+  if (uploadQueue == NULL || fb == NULL) {
+    return false;
+  }
+  if (uxQueueSpacesAvailable(uploadQueue) == 0) {
+    Serial.println("Upload queue full, image dropped.");
+    return false;
+  }
+
+  upload_job_t job;
+  job.frame = NULL;
+  job.len = fb->len;
+  job.moisture = moistureValue;
+  time_t now = time(NULL);
+  job.timestamp = now > 1600000000 ? (uint32_t)now : 0; // Before 2020 means NTP has not set the clock yet
+  job.submitMicros = micros();
+  job.jpg = (uint8_t*)(psramFound() ? ps_malloc(fb->len) : malloc(fb->len));
+  if (job.jpg == NULL) {
+    Serial.println("Not enough memory to queue the image.");
+    return false;
+  }
+  memcpy(job.jpg, fb->buf, fb->len);
+
+  // Only loop() submits jobs, so the space checked above is still free
+  if (xQueueSend(uploadQueue, &job, 0) != pdTRUE) {
+    free(job.jpg);
+    return false;
+  }
+  return true;
+}
+
+bool uploadWorkerSubmit(shared_frame_t* frame, uint8_t moistureValue) {
+  if (uploadQueue == NULL || frame == NULL) {
+    return false;
+  }
+  if (uxQueueSpacesAvailable(uploadQueue) == 0) {
+    Serial.println("Upload queue full, image dropped.");
+    return false;
+  }
+
+  upload_job_t job;
+  job.frame = frame;
+  job.jpg = frame->buf;
+  job.len = frame->len;
+  job.moisture = moistureValue;
+  time_t now = time(NULL);
+  job.timestamp = now > 1600000000 ? (uint32_t)now : 0;
+  job.submitMicros = micros();
+  frame->refs++; // The job's own reference, dropped by the upload task
+
+  if (xQueueSend(uploadQueue, &job, 0) != pdTRUE) {
+    frameBroadcasterRelease(frame);
+    return false;
+  }
+  return true;
+}
+
+uint32_t uploadWorkerQueueDepth() {
+  return uploadQueue != NULL ? uxQueueMessagesWaiting(uploadQueue) : 0;
+}
+
+uint32_t uploadWorkerSpoolDepth() {
+#ifdef USE_SD_MMC
+  return sdSpoolCount();
+#else
+  return 0;
+#endif
+}
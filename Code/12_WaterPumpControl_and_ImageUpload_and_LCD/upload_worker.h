@@ -0,0 +1,97 @@
+#ifndef UPLOAD_WORKER_H
+#define UPLOAD_WORKER_H
+
+#include <Arduino.h>
+#include "esp_camera.h"
+#include "frame_broadcaster.h"
+
+#define UPLOAD_QUEUE_LENGTH     3       // Maximum number of capture jobs waiting for upload
+#define UPLOAD_TASK_STACK_SIZE  12288   // TLS handshakes need a large stack
+#define UPLOAD_TASK_PRIORITY    1       // Same priority as loop(), but pinned to the other core
+#define UPLOAD_TASK_CORE        0       // loop() runs on core 1
+#define UPLOAD_PUBLISH_INTERVAL 15000   // Default minimum time between two results, the free ThingSpeak limit for single updates
+#define UPLOAD_DRAIN_POLL_MS    1000    // How often the upload task checks for spooled jobs when the queue is empty
+#define UPLOAD_DRAIN_RETRIES    3       // Upload attempts of a spooled image before its reading is published without the URL
+#define UPLOAD_WIFI_RETRY_MS    30000   // Time between two WiFi reconnection attempts of the upload task while WiFi is down
+// With USE_SD_MMC the upload task also runs the /camera retention manager (capture_retention.cpp) when it is idle
+
+/**
+ * @brief Callback invoked by the upload task when a capture job has been handled, either at once or when it is replayed
+ *        from the SD card spool after an outage. The upload task calls it at most once per publish interval (see uploadWorkerBegin()).
+ *        It runs in the context of the upload task, so it may block (e.g. to update ThingSpeak) without delaying loop().
+ * @param moistureValue The moisture value that was submitted together with the image.
+ * @param imageUrl The URL-encoded Google Drive URL of the image, or an empty string if the upload failed.
+ * @param timestamp The capture time in seconds since the epoch (UTC), or 0 if the clock was not set at capture time.
+ * @return true if the result was published. A spooled job is kept and replayed again later if this returns false.
+ */
+typedef bool (*UploadResultCallback)(uint8_t moistureValue, const String& imageUrl, uint32_t timestamp);
+
+/**
+ * @brief Callback invoked by the upload task to reconnect WiFi, e.g. with WiFi.begin(). It may block for seconds.
+ */
+typedef void (*WiFiReconnectCallback)();
+
+/**
+ * @brief Callback asked by the upload task before it replays a spooled job: true if the result callback can take one now.
+ */
+typedef bool (*UploadReadyCallback)();
+
+/**
+ * @brief Creates the job queue and starts the background upload task.
+ *        With USE_SD_MMC, jobs submitted while WiFi is down are saved in the SD card spool (sd_spool.cpp) and replayed
+ *        by the upload task, oldest first, once WiFi is back.
+ *        The images in /camera are deleted by the retention manager when they exceed the default limits of capture_retention.h.
+ * @param webAppUrl The URL of the deployed Google Apps Script Web App that handles the upload.
+ * @param onResult The callback to receive the result of each job, e.g. to publish the URL to ThingSpeak.
+ * @param publishIntervalMs Minimum time between two calls of onResult. Use UPLOAD_PUBLISH_INTERVAL if the callback writes to
+ *                          ThingSpeak directly, 0 if it only buffers the result (e.g. thingspeakBatchAdd()).
+ * @return true if the task was started, false if there was not enough memory.
+ */
+bool uploadWorkerBegin(const String& webAppUrl, UploadResultCallback onResult, uint32_t publishIntervalMs = UPLOAD_PUBLISH_INTERVAL);
+
+/**
+ * @brief Lets the upload task reconnect WiFi: while WiFi is down, it calls 'reconnect' every UPLOAD_WIFI_RETRY_MS between
+ *        two jobs, so that the blocking reconnection never runs in loop(). Jobs queued meanwhile wait, and are spooled.
+ * @param reconnect The reconnection function, NULL to leave WiFi alone.
+ */
+void uploadWorkerSetWiFiReconnect(WiFiReconnectCallback reconnect);
+
+/**
+ * @brief Holds back the spool replay while 'ready' returns false, e.g. while the buffer of a batching result callback is
+ *        full. The spooled jobs then stay on the SD card and their images are not uploaded again and again.
+ * @param ready The readiness check, NULL to replay whenever WiFi is up.
+ */
+void uploadWorkerSetPublishReady(UploadReadyCallback ready);
+
+/**
+ * @brief Queues a captured frame for saving to SD card and uploading to Google Drive.
+ *        Submit frames whether WiFi is connected or not: the upload task spools the job if it cannot be uploaded.
+ *        The JPEG data is copied to PSRAM, so the caller can return the frame buffer to the driver at once.
+ *        The capture time is taken from the system clock (set by NTP) when the job is submitted.
+ *        This function never blocks: if the queue is full the job is dropped.
+ * @param fb The captured frame buffer (JPEG format).
+ * @param moistureValue The moisture value to pass to the result callback together with the image URL.
+ * @return true if the job was queued, false if the queue is full or the copy could not be allocated.
+ */
+bool uploadWorkerSubmit(const camera_fb_t* fb, uint8_t moistureValue);
+
+/**
+ * @brief Queues a frame published by the frame broadcaster (frame_broadcaster.cpp). Same as above, except that the job keeps
+ *        its own reference to the frame instead of copying the JPEG data; the caller still releases its reference.
+ * @param frame The frame, as returned by frameBroadcasterGetLatest().
+ * @param moistureValue The moisture value to pass to the result callback together with the image URL.
+ * @return true if the job was queued, false if the queue is full.
+ */
+bool uploadWorkerSubmit(shared_frame_t* frame, uint8_t moistureValue);
+
+/**
+ * @brief Returns the number of jobs waiting in the queue (not counting the one being uploaded).
+ */
+uint32_t uploadWorkerQueueDepth();
+
+/**
+ * @brief Returns the number of jobs waiting in the SD card spool for WiFi to come back.
+ */
+uint32_t uploadWorkerSpoolDepth();
+
+#endif
@@ -0,0 +1,298 @@
+#include "water_pump_control.h"
+#include "esp_timer.h"
+#include "metrics.h"
+
+// The state of a zone is changed by pumpZoneStart()/pumpZoneUpdate() (only from IDLE, or WAITING -> IDLE) and by its
+// timer callback (from WATERING or SOAKING, and WAITING -> WATERING of the next zone in line)
+typedef struct {
+  pump_zone_t config;
+  esp_timer_handle_t timer;
+  volatile PumpState state;
+  volatile int64_t stateChangeMicros;   // Tracks time for the current state
+  volatile int64_t lastWateringMicros;  // Start of the last watering, -1 before the first one
+  volatile uint32_t lastOnTimeUs;
+  unsigned int cycleSoakTime;           // Soak time of the current cycle, from the dose function
+} zone_state_t;
+
+// A state change, queued for manageWaterPumpCycle()
+typedef struct {
+  uint8_t zone;
+  PumpState from;
+  PumpState to;
+  uint32_t onTimeUs;
+} zone_change_t;
+
+static zone_state_t zones[PUMP_MAX_ZONES];
+static uint8_t zoneCount = 0;
+static uint8_t maxActivePumps = 1;
+static uint8_t waitLine[PUMP_MAX_ZONES];    // WAITING zones in request order, a ring
+static uint8_t waitHead = 0;
+static PumpZoneStats zoneStats = {0, 0, 0, 0, 0};
+static QueueHandle_t changeQueue = NULL;
+static pump_dose_fn_t doseFunction = NULL;
+static portMUX_TYPE zoneMux = portMUX_INITIALIZER_UNLOCKED;   // Guards the states, the wait line and zoneStats
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+static void reportChange(uint8_t zone, PumpState from, PumpState to, uint32_t onTimeUs = 0) {
+  zone_change_t change = {zone, from, to, onTimeUs};
+  xQueueSend(changeQueue, &change, 0);  // A full queue only loses a Serial message
+}
+
+/**
+ * @brief Takes one of the maxActive pumps for an IDLE or WAITING zone, or puts an IDLE zone in the wait line.
+ *        Call it inside the critical section; the caller switches the relay on if it returns true.
+ */
+static bool claimPump(uint8_t zone, int64_t now) {
+  zone_state_t& z = zones[zone];
+  if (zoneStats.active >= maxActivePumps) {
+    waitLine[(waitHead + zoneStats.waiting) % PUMP_MAX_ZONES] = zone;
+    zoneStats.waiting++;
+    z.state = WAITING;
+    z.stateChangeMicros = now;
+    return false;
+  }
+  if (z.state == WAITING && now > z.stateChangeMicros) {
+    // The timer task takes 'now' before the critical section: a zone that started waiting since then has waited 0
+    zoneStats.maxWaitMs = max(zoneStats.maxWaitMs, (uint32_t)((now - z.stateChangeMicros) / 1000));
+  }
+  zoneStats.active++;
+  zoneStats.peakActive = max(zoneStats.peakActive, zoneStats.active);
+  z.state = WATERING;
+  z.stateChangeMicros = now; // Record the time we started watering
+  z.lastWateringMicros = now;
+  return true;
+}
+
+/**
+ * @brief Removes a zone from the wait line (its request was withdrawn). Inside the critical section.
+ */
+static void leaveWaitLine(uint8_t zone) {
+  uint8_t kept = 0;
+  for (uint8_t i = 0; i < zoneStats.waiting; i++) {
+    uint8_t z = waitLine[(waitHead + i) % PUMP_MAX_ZONES];
+    if (z != zone) {
+      waitLine[(waitHead + kept++) % PUMP_MAX_ZONES] = z;
+    }
+  }
+  zoneStats.waiting = kept;
+}
+
+static void relayOn(uint8_t zone, PumpState from) {
+  zone_state_t& z = zones[zone];
+  unsigned int onTime = z.config.onTime;
+  unsigned int soakTime = z.config.soakTime;
+  if (doseFunction != NULL) {
+    doseFunction(zone, &onTime, &soakTime);
+  }
+  z.cycleSoakTime = soakTime;
+  digitalWrite(z.config.relayPin, HIGH);
+  esp_timer_start_once(z.timer, (uint64_t)onTime * 1000ULL);
+  reportChange(zone, from, WATERING);
+}
+
+/**
+ * @brief Local function called by the esp_timer task when the current state of a zone has timed out.
+ * It moves the state machine on and re-arms the timer for the soak time when the watering has finished; the pump it
+ * frees goes to the first zone in the wait line.
+ */
+static void pumpTimerCallback(void* arg) {
+  uint8_t zone = (uint8_t)(uintptr_t)arg;
+  zone_state_t& z = zones[zone];
+  int64_t now = esp_timer_get_time();
+
+  // State 1: The pump was WATERING, the 'onTime' has elapsed
+  if (z.state == WATERING) {
+    digitalWrite(z.config.relayPin, LOW);
+    z.lastOnTimeUs = (uint32_t)(now - z.stateChangeMicros);
+    metricsCount(METRIC_PUMP_CYCLES);
+    metricsCount(METRIC_PUMP_ON_MS, z.lastOnTimeUs / 1000);
+
+    int next = -1;
+    portENTER_CRITICAL(&zoneMux);
+    z.stateChangeMicros = now; // Record the time we started soaking
+    z.state = SOAKING;
+    zoneStats.active--;
+    zoneStats.cycles++;
+    if (zoneStats.waiting > 0) {
+      next = waitLine[waitHead];
+      waitHead = (waitHead + 1) % PUMP_MAX_ZONES;
+      zoneStats.waiting--;
+      claimPump(next, now);
+    }
+    portEXIT_CRITICAL(&zoneMux);
+    esp_timer_start_once(z.timer, (uint64_t)z.cycleSoakTime * 1000ULL);
+    reportChange(zone, WATERING, SOAKING, z.lastOnTimeUs);
+    if (next >= 0) {
+      relayOn(next, WAITING);
+    }
+  }  // State 2: The soil was SOAKING, the 'soakTime' has elapsed
+  else if (z.state == SOAKING) {
+    z.stateChangeMicros = now;
+    z.state = IDLE;
+    reportChange(zone, SOAKING, IDLE);
+  }
+}
+
+/**
+ * @brief Prints "Zone n: " before the messages when there is more than one zone.
+ */
+static void printZone(uint8_t zone) {
+  if (zoneCount > 1) {
+    Serial.printf("Zone %u: ", zone);
+  }
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+bool pumpZonesBegin(const pump_zone_t* zoneTable, uint8_t count, uint8_t maxActive) {
+  if (count == 0 || count > PUMP_MAX_ZONES || maxActive == 0) {
+    return false;
+  }
+  if (changeQueue == NULL) {
+    changeQueue = xQueueCreate(PUMP_MAX_ZONES * 4, sizeof(zone_change_t));
+    if (changeQueue == NULL) {
+      Serial.println("pumpZonesBegin(): not enough memory");
+      return false;
+    }
+  }
+  zoneCount = count;
+  maxActivePumps = maxActive;
+  waitHead = 0;
+  memset(&zoneStats, 0, sizeof(zoneStats));
+  for (uint8_t i = 0; i < count; i++) {
+    zone_state_t& z = zones[i];
+    z.config = zoneTable[i];
+    z.state = IDLE;
+    z.stateChangeMicros = 0;
+    z.lastWateringMicros = -1;
+    z.lastOnTimeUs = 0;
+    pinMode(z.config.relayPin, OUTPUT);
+    digitalWrite(z.config.relayPin, LOW); // Ensure pump is OFF by default
+
+    if (z.timer == NULL) {
+      const esp_timer_create_args_t timerArgs = {
+        .callback = pumpTimerCallback,
+        .arg = (void*)(uintptr_t)i,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "pump",
+        .skip_unhandled_events = false,
+      };
+      if (esp_timer_create(&timerArgs, &z.timer) != ESP_OK) {
+        Serial.println("pumpZonesBegin(): failed to create a pump timer");
+        zoneCount = i;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void pumpZonesSetDoseFunction(pump_dose_fn_t function) {
+  doseFunction = function;
+}
+
+PumpState pumpZoneUpdate(uint8_t zone, uint8_t moisture) {
+  if (zone >= zoneCount) {
+    return IDLE;
+  }
+  zone_state_t& z = zones[zone];
+  if (z.state == IDLE && moisture < z.config.lowerThreshold) {
+    pumpZoneStart(zone);
+  } else if (z.state == WAITING && moisture > z.config.upperThreshold) {
+    bool withdrawn = false;
+    portENTER_CRITICAL(&zoneMux);
+    if (z.state == WAITING) {
+      leaveWaitLine(zone);
+      z.state = IDLE;
+      withdrawn = true;
+    }
+    portEXIT_CRITICAL(&zoneMux);
+    if (withdrawn) {
+      reportChange(zone, WAITING, IDLE);
+    }
+  }
+  return z.state;
+}
+
+bool pumpZoneStart(uint8_t zone) {
+  if (zone >= zoneCount || zones[zone].timer == NULL) {
+    return false;
+  }
+  portENTER_CRITICAL(&zoneMux);
+  if (zones[zone].state != IDLE) {
+    portEXIT_CRITICAL(&zoneMux);
+    return false;
+  }
+  bool started = claimPump(zone, esp_timer_get_time());
+  portEXIT_CRITICAL(&zoneMux);
+  if (started) {
+    relayOn(zone, IDLE);
+  } else {
+    reportChange(zone, IDLE, WAITING);
+  }
+  return true;
+}
+
+PumpState pumpZoneState(uint8_t zone) {
+  return zone < zoneCount ? zones[zone].state : IDLE;
+}
+
+int64_t pumpZoneLastWateringMicros(uint8_t zone) {
+  return zone < zoneCount ? zones[zone].lastWateringMicros : -1;
+}
+
+PumpZoneStats pumpZonesGetStats() {
+  portENTER_CRITICAL(&zoneMux);
+  PumpZoneStats stats = zoneStats;
+  portEXIT_CRITICAL(&zoneMux);
+  return stats;
+}
+
+void InitWaterPump(uint8_t relayPin, unsigned int onTime, unsigned int soakTime) {
+  // The caller decides when to water (startWaterPumpCycle()), the thresholds of the zone are not used
+  const pump_zone_t zone = {relayPin, 0, 100, onTime, soakTime};
+  pumpZonesBegin(&zone, 1, 1);
+}
+
+void startWaterPumpCycle() {
+  // Only start a new cycle if the pump is currently idle
+  pumpZoneStart(0);
+}
+
+void manageWaterPumpCycle() {
+  if (changeQueue == NULL) {
+    return;
+  }
+  zone_change_t change;
+  // Only the zones whose state changed since the last call, in the order of the changes
+  while (xQueueReceive(changeQueue, &change, 0) == pdTRUE) {
+    printZone(change.zone);
+    switch (change.to) {
+      case WATERING:
+        Serial.println("Pump cycle started: WATERING");
+        break;
+      case SOAKING:
+        Serial.printf("Watering finished after %u ms. Now SOAKING.\n", change.onTimeUs / 1000);
+        break;
+      case IDLE:
+        Serial.println(change.from == WAITING ? "Moist again, watering request withdrawn." : "Soak time complete. Pump cycle finished.");
+        break;
+      case WAITING:
+        Serial.printf("Waiting for a pump, all %u are running.\n", maxActivePumps);
+        break;
+    }
+  }
+}
+
+PumpState getPumpState() {
+  return pumpZoneState(0);
+}
+
+uint32_t getLastPumpOnTimeUs() {
+  return zoneCount > 0 ? zones[0].lastOnTimeUs : 0;
+}
+
+int64_t getLastWateringMicros() {
+  return pumpZoneLastWateringMicros(0);
+}
@@ -0,0 +1,134 @@
+#ifndef _WATER_PUMP_CONTROL_H
+#define _WATER_PUMP_CONTROL_H
+
+#include <Arduino.h>
+
+#define PUMP_MAX_ZONES    64
+
+// WAITING: watering requested, the zone waits for one of the maxActive pumps of the supply budget
+enum PumpState { IDLE, WATERING, SOAKING, WAITING };
+
+/**
+ * @brief One watering zone: a pot or a tray with its own moisture sensor and pump relay.
+ * relayPin         GPIO of the pump relay.
+ * lowerThreshold   pumpZoneUpdate() requests a watering below this moisture (percent).
+ * upperThreshold   A waiting request is dropped once the moisture is above this (percent), e.g. after rain.
+ * onTime           Pump ON time in milliseconds.
+ * soakTime         Soak time in milliseconds, no new watering of the zone before it is over.
+ */
+typedef struct {
+  uint8_t relayPin;
+  uint8_t lowerThreshold;
+  uint8_t upperThreshold;
+  unsigned int onTime;
+  unsigned int soakTime;
+} pump_zone_t;
+
+/**
+ * @brief Counters of the zone scheduler.
+ * active       Zones WATERING now, at most maxActive.
+ * waiting      Zones WAITING for a pump.
+ * peakActive   Highest 'active' since pumpZonesBegin().
+ * cycles       Completed waterings of all zones.
+ * maxWaitMs    Longest time a zone has waited for a pump.
+ */
+typedef struct {
+  uint8_t active;
+  uint8_t waiting;
+  uint8_t peakActive;
+  uint32_t cycles;
+  uint32_t maxWaitMs;
+} PumpZoneStats;
+
+/**
+ * @brief Decides the watering of a zone that is starting: it may change the ON time and the soak time of this cycle,
+ *        which hold the zone's onTime and soakTime on entry. It is called by pumpZoneStart() (from loop()) or by the
+ *        esp_timer task when a waiting zone gets a pump, so it must be quick and must not block.
+ */
+typedef void (*pump_dose_fn_t)(uint8_t zone, unsigned int* onTime, unsigned int* soakTime);
+
+/**
+ * @brief Sets up the zones: each relay pin is an output, LOW (pump off), with its own one-shot timer that ends each
+ *        state. The zone table is copied. Zones are numbered from 0 in the order of the table.
+ * @param zoneTable The zones, at most PUMP_MAX_ZONES.
+ * @param count Number of zones.
+ * @param maxActive How many pumps may run at the same time (the supply budget), at least 1.
+ * @return false if the arguments are out of range or a timer could not be created.
+ */
+bool pumpZonesBegin(const pump_zone_t* zoneTable, uint8_t count, uint8_t maxActive);
+
+/**
+ * @brief Installs the function that decides each watering (e.g. wateringModelDose()), NULL for the fixed onTime and
+ *        soakTime of the zones.
+ */
+void pumpZonesSetDoseFunction(pump_dose_fn_t doseFunction);
+
+/**
+ * @brief Feeds a moisture reading of a zone to its hysteresis: below lowerThreshold an IDLE zone requests a watering
+ *        (pumpZoneStart()), above upperThreshold a WAITING request is withdrawn. Constant time.
+ * @return The state of the zone afterwards.
+ */
+PumpState pumpZoneUpdate(uint8_t zone, uint8_t moisture);
+
+/**
+ * @brief Requests a watering of an IDLE zone: it starts at once if fewer than maxActive pumps run, otherwise the zone
+ *        is WAITING and starts, in request order, as soon as a pump has finished (from the timer, without loop()).
+ * @return false if the zone is not IDLE or does not exist.
+ */
+bool pumpZoneStart(uint8_t zone);
+
+/**
+ * @brief Returns the state of a zone (IDLE for a zone that does not exist).
+ */
+PumpState pumpZoneState(uint8_t zone);
+
+/**
+ * @brief Returns when the last watering of a zone started, in esp_timer_get_time() microseconds, or -1 if never.
+ */
+int64_t pumpZoneLastWateringMicros(uint8_t zone);
+
+/**
+ * @brief Returns the counters of the scheduler.
+ */
+PumpZoneStats pumpZonesGetStats();
+
+/**
+ * @brief Single pump: sets up one zone with the given relay and times (pumpZonesBegin() with maxActive 1).
+ *        The relay pin is configured as an output and set to LOW (pump off) by default.
+ * @param relayPin GPIO pin number of the water pump relay.
+ * @param onTime Duration for which the pump should be ON (in milliseconds).
+ * @param soakTime Duration for which the soil should soak after watering (in milliseconds).
+ */
+void InitWaterPump(uint8_t relayPin, unsigned int onTime, unsigned int soakTime);
+
+/**
+ * @brief Starts the water pump cycle of zone 0 by setting the relay pin HIGH and arming a one-shot esp_timer for the
+ *        watering time. The WATERING -> SOAKING -> IDLE transitions happen in the esp_timer task, so the relay is turned
+ *        off on time even while loop() is blocked by WiFi.begin(), an SD write or an upload.
+ *        This function will only start a new cycle if the pump is currently idle to prevent overlapping.
+ */
+void startWaterPumpCycle();
+
+/**
+ * @brief Reports the state changes made by the timers on the Serial Monitor. Call it from loop().
+ *        It does not control the pumps: the relays are switched by the timers even if this function is never called.
+ *        The changes are queued by the timers, so a call costs O(changes since the last call), not O(zones).
+ */
+void manageWaterPumpCycle();
+
+/**
+ * @brief Returns the current state of the pump cycle of zone 0 (IDLE, WATERING, SOAKING or WAITING).
+ */
+PumpState getPumpState();
+
+/**
+ * @brief Returns how long (in microseconds) the relay of zone 0 was actually ON in the last completed watering.
+ */
+uint32_t getLastPumpOnTimeUs();
+
+/**
+ * @brief Returns when the last watering of zone 0 started, in esp_timer_get_time() microseconds since boot, or -1 if the pump has not run yet.
+ */
+int64_t getLastWateringMicros();
+
+#endif
@@ -0,0 +1,331 @@
+/**
+ * watering_model.cpp
+ *
+ * Model-predictive dosing of the pumps. The fixed policy (pump for onTime below the lower threshold, soak for soakTime)
+ * overshoots and oscillates when the soak time is shorter than the time the probe takes to see the water: the zone is
+ * still reading dry when the soak ends, so it is watered again and again. Here each zone learns, from its own waterings
+ * and readings:
+ * - the gain, moisture gained per second of pumping once the soil has settled, by recursive least squares with
+ *   forgetting over the waterings;
+ * - the response time, from the area between the settled value and the rise (for a first-order rise, area = rise x tau);
+ * - the drying rate, between waterings and from the slope once the soil has settled after one, seeded from the hourly
+ *   aggregates of the sensor log after a reboot.
+ * With them, the dose that brings the zone to the middle of its band is computed when a watering starts, and the soak
+ * time becomes the settling time, so one watering does the job. All of it is constant time, with no allocation.
+ * A watering that starts before the soil has settled from the last one (every soak time of the fixed policy, while the
+ * probe still reads dry) joins its observation: the rise then answers the sum of the doses, and each dose's start time
+ * is taken out of the response time, so the fixed policy's bursts are learned from too.
+ *
+ * Author: John Leung
+ * Date: October 16, 2026
+ */
+#include "watering_model.h"
+#include "esp_timer.h"
+
+#define GAIN_VARIANCE_START   100.0f    // Uncertainty of the gain before the first watering: the first one sets it
+#define DRYING_WEIGHT         0.3f      // Weight of a new drying measurement
+#define UNSETTLED_RISE        0.2f      // Rise over the last quarter of the window (%) above which the soil had not settled
+#define UNSETTLED_SHARE       0.1f      // ...or this share of the whole rise
+
+// Model of one zone. A plain struct, so that the benchmark can run the same functions on a scratch copy.
+typedef struct {
+  // Band and fixed dose of the zone
+  float target;
+  unsigned int onTime;
+  // Learned
+  float gain;
+  float gainVariance;
+  float responseS;
+  float dryingPerS;
+  uint16_t cycles;
+  uint16_t discarded;
+  uint32_t lastDoseMs;
+  float lastError;
+  // Readings
+  bool hasReading;
+  float smoothed;
+  float smoothedBefore;     // Smoothed moisture before the last reading
+  int64_t dryAnchorUs;      // Start of the drying measurement, -1 if none
+  float dryAnchor;
+  bool hasHour;             // Seeding from the sensor log
+  float lastHourMean;
+  uint16_t lastHourPump;
+  // Observation of the current waterings, moisture corrected for the drying since the first one started
+  bool observing;
+  int64_t startUs;
+  int64_t windowUs;         // Until the soil has settled from the last watering
+  int64_t settleUs;         // Settling time the window was sized with
+  int64_t tailStartUs;      // Start of the last quarter of the settling after the last watering
+  float doseS;              // Sum of the doses
+  float doseTimeS;          // Sum of dose x its start time, for the response time
+  float startMoisture;
+  float area;               // Integral of the corrected moisture since the start, %.s
+  float prevT, prev;        // Last point of the integral
+  // Line fit of the corrected readings of the last quarter of the settling, time from the start of the quarter
+  uint16_t tailCount;
+  float tailT, tailM, tailTT, tailTM;
+} zone_model_t;
+
+static zone_model_t models[PUMP_MAX_ZONES];
+static uint8_t modelCount = 0;
+static volatile WateringMode controllerMode = WATERING_HYSTERESIS;
+static portMUX_TYPE modelMux = portMUX_INITIALIZER_UNLOCKED;   // wateringModelDose() runs in the esp_timer task too
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+static void modelReset(zone_model_t& m, const pump_zone_t& zone) {
+  memset(&m, 0, sizeof(m));
+  m.target = (zone.lowerThreshold + zone.upperThreshold) / 2.0f;
+  m.onTime = zone.onTime;
+  m.gainVariance = GAIN_VARIANCE_START;
+  m.dryAnchorUs = -1;
+}
+
+static void updateDrying(zone_model_t& m, float perS) {
+  perS = max(perS, 0.0f);   // Rain or a manual watering is not negative drying
+  m.dryingPerS = m.dryingPerS == 0 ? perS : m.dryingPerS + DRYING_WEIGHT * (perS - m.dryingPerS);
+}
+
+/**
+ * @brief Time the soil takes to settle after a watering: the longest window until the response time is known.
+ */
+static int64_t settleUs(const zone_model_t& m) {
+  if (m.cycles == 0) {
+    return WATERING_MODEL_SETTLE_MAX_MS * 1000LL;
+  }
+  float ms = constrain(WATERING_MODEL_SETTLE_TAUS * m.responseS * 1000, (float)WATERING_MODEL_SETTLE_MIN_MS,
+                       (float)WATERING_MODEL_SETTLE_MAX_MS);
+  return (int64_t)ms * 1000;
+}
+
+/**
+ * @brief Closes the observation of a watering and learns the gain and the response time from it.
+ */
+static void learn(zone_model_t& m) {
+  m.observing = false;
+  m.dryAnchorUs = -1;
+  if (m.tailCount < 2 || m.doseS <= 0) {
+    m.discarded++;
+    return;
+  }
+  // Once settled the corrected readings should be flat: their slope is the error of the drying estimate
+  float n = m.tailCount;
+  float meanT = m.tailT / n;
+  float spread = m.tailTT - n * meanT * meanT;
+  float missedDrying = spread > 0 ? -(m.tailTM - meanT * m.tailM) / spread : 0;
+  float tailStartS = m.tailStartUs / 1e6f;
+  float rise = m.tailM / n + missedDrying * (tailStartS + meanT) - m.startMoisture;
+  // Still rising at the end: the window was too short for this soil. Learning from it would make the response time,
+  // hence the next window, shorter still, so the response time grows instead, up to the longest window.
+  float tailRise = -missedDrying * 2 * meanT;
+  if (tailRise > max(UNSETTLED_RISE, UNSETTLED_SHARE * rise) && m.settleUs < (int64_t)WATERING_MODEL_SETTLE_MAX_MS * 1000) {
+    m.responseS = min(m.responseS * 1.5f, WATERING_MODEL_SETTLE_MAX_MS / 1000.0f / WATERING_MODEL_SETTLE_TAUS);
+    m.discarded++;
+    return;
+  }
+  updateDrying(m, m.dryingPerS + missedDrying);
+  if (rise <= 0) {
+    m.discarded++;
+    return;
+  }
+  // Gain: scalar recursive least squares of rise = gain x dose, the doses of the observation summed
+  float predicted = m.gain * m.doseS;
+  float k = m.gainVariance * m.doseS / (WATERING_MODEL_FORGET + m.doseS * m.doseS * m.gainVariance);
+  m.gain += k * (rise - predicted);
+  m.gainVariance = (m.gainVariance - k * m.doseS * m.gainVariance) / WATERING_MODEL_FORGET;
+  m.lastError = m.cycles > 0 ? rise - predicted : 0;
+
+  // Response time: the area between the settled value and the corrected rise, divided by the rise, less the mean
+  // start time of the doses (each dose adds its share of the rise x (its start + tau) to the area)
+  float windowS = m.prevT;
+  float tau = constrain(((m.startMoisture + rise) * windowS - m.area) / rise - m.doseTimeS / m.doseS, 1.0f,
+                        WATERING_MODEL_SETTLE_MAX_MS / 1000.0f / WATERING_MODEL_SETTLE_TAUS);
+  m.responseS = m.cycles == 0 ? tau : m.responseS + DRYING_WEIGHT * (tau - m.responseS);
+  m.cycles++;
+}
+
+static void addReading(zone_model_t& m, float moisture, int64_t now) {
+  m.smoothedBefore = m.hasReading ? m.smoothed : moisture;
+  m.smoothed = m.hasReading ? m.smoothed + WATERING_MODEL_SMOOTHING * (moisture - m.smoothed) : moisture;
+  m.hasReading = true;
+  if (m.observing) {
+    float t = (now - m.startUs) / 1e6f;
+    float corrected = moisture + m.dryingPerS * t;
+    m.area += (m.prev + corrected) / 2 * (t - m.prevT);
+    m.prevT = t;
+    m.prev = corrected;
+    if (now - m.startUs >= m.tailStartUs) {
+      float tail = (now - m.startUs - m.tailStartUs) / 1e6f;
+      m.tailCount++;
+      m.tailT += tail;
+      m.tailM += corrected;
+      m.tailTT += tail * tail;
+      m.tailTM += tail * corrected;
+    }
+    if (now - m.startUs >= m.windowUs) {
+      learn(m);
+    }
+  } else if (m.dryAnchorUs < 0) {
+    m.dryAnchorUs = now;
+    m.dryAnchor = m.smoothed;
+  } else if (now - m.dryAnchorUs >= (int64_t)WATERING_MODEL_DRY_WINDOW_MS * 1000) {
+    updateDrying(m, (m.dryAnchor - m.smoothed) / ((now - m.dryAnchorUs) / 1e6f));
+    m.dryAnchorUs = now;
+    m.dryAnchor = m.smoothed;
+  }
+}
+
+static void dose(zone_model_t& m, int64_t now, WateringMode mode, unsigned int* onTime, unsigned int* soakTime) {
+  if (m.observing && now - m.startUs >= m.windowUs) {
+    learn(m);   // Settled, but the reading that ends the window has not come yet
+  }
+  int64_t settle = settleUs(m);
+  if (mode == WATERING_PREDICTIVE) {
+    if (m.cycles >= WATERING_MODEL_MIN_CYCLES && m.gain > 0) {
+      float needed = m.target - m.smoothed + m.dryingPerS * (settle / 1e6f);
+      *onTime = (unsigned int)constrain(needed / m.gain * 1000, (float)WATERING_MODEL_MIN_DOSE_MS,
+                                        (float)WATERING_MODEL_MAX_DOSE_MS);
+    }
+    *soakTime = (unsigned int)(settle / 1000);
+  }
+  m.lastDoseMs = *onTime;
+  if (!m.hasReading) {
+    return;
+  }
+  if (!m.observing) {
+    m.observing = true;
+    m.startUs = now;
+    m.doseS = 0;
+    m.doseTimeS = 0;
+    // The reading that started the watering is below the threshold partly by noise, so it is left out of the start
+    m.startMoisture = m.smoothedBefore;
+    m.area = 0;
+    m.prevT = 0;
+    m.prev = m.smoothedBefore;
+  }
+  // Watered again before the soil settled: the dose joins the open observation, which then lasts until it has settled too
+  int64_t offset = now - m.startUs;
+  m.settleUs = settle;
+  m.windowUs = offset + (int64_t)*onTime * 1000 + settle;
+  m.tailStartUs = offset + ((int64_t)*onTime * 1000 + settle) * 3 / 4;
+  m.doseS += *onTime / 1000.0f;
+  m.doseTimeS += *onTime / 1000.0f * (offset / 1e6f);
+  m.tailCount = 0;
+  m.tailT = m.tailM = m.tailTT = m.tailTM = 0;
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+void wateringModelBegin(const pump_zone_t* zones, uint8_t count, WateringMode mode) {
+  portENTER_CRITICAL(&modelMux);
+  modelCount = min(count, (uint8_t)PUMP_MAX_ZONES);
+  for (uint8_t i = 0; i < modelCount; i++) {
+    modelReset(models[i], zones[i]);
+  }
+  controllerMode = mode;
+  portEXIT_CRITICAL(&modelMux);
+}
+
+void wateringModelSetMode(WateringMode mode) {
+  controllerMode = mode;
+}
+
+WateringMode wateringModelGetMode() {
+  return controllerMode;
+}
+
+void wateringModelAddReading(uint8_t zone, float moisture) {
+  if (zone >= modelCount) {
+    return;
+  }
+  int64_t now = esp_timer_get_time();
+  portENTER_CRITICAL(&modelMux);
+  addReading(models[zone], moisture, now);
+  portEXIT_CRITICAL(&modelMux);
+}
+
+void wateringModelAddHour(uint8_t zone, float moistureMean, uint16_t pumpSeconds) {
+  if (zone >= modelCount) {
+    return;
+  }
+  portENTER_CRITICAL(&modelMux);
+  zone_model_t& m = models[zone];
+  if (m.hasHour && m.lastHourPump == 0 && pumpSeconds == 0) {
+    updateDrying(m, (m.lastHourMean - moistureMean) / 3600.0f);
+  }
+  m.hasHour = true;
+  m.lastHourMean = moistureMean;
+  m.lastHourPump = pumpSeconds;
+  portEXIT_CRITICAL(&modelMux);
+}
+
+void wateringModelDose(uint8_t zone, unsigned int* onTime, unsigned int* soakTime) {
+  if (zone >= modelCount) {
+    return;
+  }
+  int64_t now = esp_timer_get_time();
+  portENTER_CRITICAL(&modelMux);
+  dose(models[zone], now, controllerMode, onTime, soakTime);
+  portEXIT_CRITICAL(&modelMux);
+}
+
+WateringEstimate wateringModelGetEstimate(uint8_t zone) {
+  WateringEstimate estimate = {0, 0, 0, 0, 0, 0, 0};
+  if (zone < modelCount) {
+    portENTER_CRITICAL(&modelMux);
+    const zone_model_t& m = models[zone];
+    estimate = {m.gain, m.responseS, m.dryingPerS * 3600, m.cycles, m.discarded, m.lastDoseMs, m.lastError};
+    portEXIT_CRITICAL(&modelMux);
+  }
+  return estimate;
+}
+
+void wateringModelBenchmark(Print& out, uint32_t iterations) {
+  const pump_zone_t zone = {0, 30, 35, 1000, 20000};
+  zone_model_t m;
+  modelReset(m, zone);
+  m.gain = 2;
+  m.responseS = 180;
+  m.dryingPerS = 0.0002f;
+  m.cycles = WATERING_MODEL_MIN_CYCLES;
+  int64_t now = 0;
+  uint64_t total[3] = {0, 0, 0};
+  uint32_t worst[3] = {0, 0, 0};
+  for (uint32_t i = 0; i < iterations; i++) {
+    uint32_t cycles[3];
+    // A reading between waterings
+    now += 5000000;
+    uint32_t start = ESP.getCycleCount();
+    addReading(m, 29.5f, now);
+    cycles[0] = ESP.getCycleCount() - start;
+    // The dose of a watering
+    unsigned int onTime = zone.onTime, soakTime = zone.soakTime;
+    start = ESP.getCycleCount();
+    dose(m, now, WATERING_PREDICTIVE, &onTime, &soakTime);
+    cycles[2] = ESP.getCycleCount() - start;
+    // The reading that ends its window and learns from it
+    m.tailCount = 2;
+    m.tailT = 60;
+    m.tailM = 62;
+    m.tailTT = 3600;
+    m.tailTM = 1860;
+    now += m.windowUs;
+    start = ESP.getCycleCount();
+    addReading(m, 31.0f, now);
+    cycles[1] = ESP.getCycleCount() - start;
+
+    for (int k = 0; k < 3; k++) {
+      total[k] += cycles[k];
+      worst[k] = max(worst[k], cycles[k]);
+    }
+  }
+  const char* names[3] = {"reading", "learning reading", "dose"};
+  float nsPerCycle = 1000.0f / ESP.getCpuFreqMHz();
+  char line[160];
+  int length = snprintf(line, sizeof(line), "Watering model, %u calls each:", iterations);
+  for (int k = 0; k < 3 && length < (int)sizeof(line); k++) {
+    length += snprintf(line + length, sizeof(line) - length, " %s %.0f ns (max %.0f ns)%s", names[k],
+                       (double)total[k] / iterations * nsPerCycle, worst[k] * nsPerCycle, k < 2 ? "," : "");
+  }
+  out.println(line);
+}
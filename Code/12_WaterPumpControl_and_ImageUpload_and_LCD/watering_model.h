@@ -0,0 +1,90 @@
+#ifndef WATERING_MODEL_H
+#define WATERING_MODEL_H
+
+#include <Arduino.h>
+#include "water_pump_control.h"
+
+#define WATERING_MODEL_MIN_CYCLES       3                       // Observations learned before the dose is computed
+#define WATERING_MODEL_SETTLE_MIN_MS    (5 * 60 * 1000UL)       // Observation window (and soak time) at least
+#define WATERING_MODEL_SETTLE_MAX_MS    (60 * 60 * 1000UL)      // Observation window (and soak time) at most
+#define WATERING_MODEL_SETTLE_TAUS      4                       // Window of 4 response times: 98 % of the rise
+#define WATERING_MODEL_MIN_DOSE_MS      200                     // Shorter pulses hardly prime the pump
+#define WATERING_MODEL_MAX_DOSE_MS      10000
+#define WATERING_MODEL_FORGET           0.9f                    // Weight of the past per learned cycle: ~10 cycles of memory
+#define WATERING_MODEL_SMOOTHING        0.3f                    // Weight of a new reading in the smoothed moisture
+#define WATERING_MODEL_DRY_WINDOW_MS    (30 * 60 * 1000UL)      // Drying rate measured over 30 minutes without watering
+
+// HYSTERESIS: every watering lasts the zone's onTime, then soakTime (the fixed policy); the model still learns.
+// PREDICTIVE: the dose that brings the zone to the middle of its band once the soil has settled, then a soak time of
+//             the settling time, so the next decision sees the whole effect of this watering.
+enum WateringMode { WATERING_HYSTERESIS, WATERING_PREDICTIVE };
+
+/**
+ * @brief What the model has learned about a zone.
+ * gain           Moisture gained per second of pumping, once settled (%/s).
+ * responseS      Mean delay of the probe's rise after a watering (infiltration and probe lag), seconds.
+ * dryingPerHour  Moisture lost per hour without watering (%/h).
+ * cycles         Observations learned from. Waterings that start before the soil has settled from the previous ones
+ *                are learned together with them, as one observation.
+ * discarded      Observations not learned from (the soil had not settled, or no rise).
+ * lastDoseMs     Dose of the last watering.
+ * lastError      Settled moisture minus the model's prediction, for the last learned watering (%).
+ */
+typedef struct {
+  float gain;
+  float responseS;
+  float dryingPerHour;
+  uint16_t cycles;
+  uint16_t discarded;
+  uint32_t lastDoseMs;
+  float lastError;
+} WateringEstimate;
+
+/**
+ * @brief Sets up one model per zone, with the zone's band as the target. Install wateringModelDose() with
+ *        pumpZonesSetDoseFunction() to let the model decide each watering.
+ * @param zones The zone table given to pumpZonesBegin().
+ * @param count Number of zones, at most PUMP_MAX_ZONES.
+ * @param mode The controller mode.
+ */
+void wateringModelBegin(const pump_zone_t* zones, uint8_t count, WateringMode mode);
+
+void wateringModelSetMode(WateringMode mode);
+WateringMode wateringModelGetMode();
+
+/**
+ * @brief Feeds a moisture reading of a zone (every few seconds, from one task). It updates the smoothed moisture, the
+ *        drying rate, and the observation of the last watering, which is learned from once the window is over.
+ *        Constant time.
+ */
+void wateringModelAddReading(uint8_t zone, float moisture);
+
+/**
+ * @brief Feeds an hourly aggregate of the sensor log, oldest first, to seed the drying rate after a reboot: the change
+ *        of the mean between two hours without watering.
+ */
+void wateringModelAddHour(uint8_t zone, float moistureMean, uint16_t pumpSeconds);
+
+/**
+ * @brief The dose function for pumpZonesSetDoseFunction(), called when a watering of the zone starts. It opens the
+ *        observation of the watering, or adds it to the open one; in PREDICTIVE mode, once WATERING_MODEL_MIN_CYCLES
+ *        observations have been learned, it replaces onTime with the computed dose and soakTime with the settling time.
+ *        Before that, it keeps onTime and only extends the soak time to the observation window, to learn from clean cycles.
+ *        Constant time, a few floating-point operations; called from loop() or the esp_timer task.
+ */
+void wateringModelDose(uint8_t zone, unsigned int* onTime, unsigned int* soakTime);
+
+/**
+ * @brief Returns what the model has learned about a zone.
+ */
+WateringEstimate wateringModelGetEstimate(uint8_t zone);
+
+/**
+ * @brief Times the model's work on a scratch zone (the zones are not touched) and prints the mean and worst time of a
+ *        reading, of a reading that learns a watering, and of a dose.
+ * @param out Where to print the results, e.g. Serial.
+ * @param iterations Calls timed per operation.
+ */
+void wateringModelBenchmark(Print& out, uint32_t iterations = 1000);
+
+#endif
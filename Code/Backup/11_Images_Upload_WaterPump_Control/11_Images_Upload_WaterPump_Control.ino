@@ -1,6 +1,7 @@
 #include <WiFi.h>
 #include "camera_api.h"
 #include "app_httpd.h"
+#include "frame_broadcaster.h"
 
 #include "google_drive.h"
 #include "thingspeak.h"
@@ -17,7 +18,19 @@
 enum {BUTTON_UP, BUTTON_DEBOUNCE, BUTTON_DOWN, BUTTON_HOLD};
 byte button_state = BUTTON_UP;
 
-Sensor soilSensor(SENSOR_PIN);
+// Watering zones: one pot or tray per zone, its moisture sensor in soilSensors[] and its pump relay in wateringZones[]
+// at the same index. Add a row to both tables for each pot of the rack.
+Sensor soilSensors[] = {
+  //     sensor pin, sampling ms, lower %, upper %
+  Sensor(SENSOR_PIN, 5000,        30,      35),
+};
+const pump_zone_t wateringZones[] = {
+  // relay pin,    pump ON ms, soak ms
+  {PUMP_RELAY_PIN, 1000,       20000},
+};
+const uint8_t zoneCount = sizeof(wateringZones) / sizeof(wateringZones[0]);
+const uint8_t maxPumpsAtOnce = 1; // Pumps allowed to run at the same time (power supply, water pressure)
+static_assert(sizeof(soilSensors) / sizeof(soilSensors[0]) == zoneCount, "one sensor per watering zone");
 LedBlinky ledRed(LED_RED_PIN);
 LedBlinky ledBlue(LED_BLUE_PIN, 1000); // Blue LED blinks every 1 second to indicate WiFi connection status
 
@@ -36,12 +49,14 @@ const String webAppUrl = "https://script.google.com/macros/s/<YOUR_DEPLOYMENT_ID
 
 // Local function prototypes
 void connectWiFi();
+void calibrationCommand(const String& args);
 
 void setup() {
   Serial.begin(115200);
   Serial.setDebugOutput(true);
   Serial.println();
   pinMode(BUTTON_PIN, INPUT_PULLUP);
+  soilSensors[0].begin(); // Calibration table from NVS, shared by the sensors of all the zones
 
 #ifdef USE_SD_MMC
   sdmmcInit();
@@ -53,6 +68,7 @@ void setup() {
 
   if(cameraSetup()==1){
     Serial.println("Camera setup successful");
+    frameBroadcasterBegin(); // The only caller of esp_camera_fb_get(): the stream and the snapshots share its frames
   } else {
     Serial.println("Error: Check your camera setup");
     return;
@@ -68,13 +84,12 @@ void setup() {
     wasWifiConnected = false;
   }
 
-  InitWaterPump();
+  pumpZonesBegin(wateringZones, zoneCount, maxPumpsAtOnce); // Ensures the pumps are OFF by default
 }
 
 framesize_t size;
 byte quality;
 bool camera_shutter_trigger = false;
-bool water_pump_trigger = false;
 
 void loop() {
 
@@ -103,11 +118,14 @@ void loop() {
     button_state = BUTTON_UP;
   }
 
-   // Handle serial input for size and quality
+   // Handle serial input: "cal ..." calibrates the moisture sensor, "size quality" captures an image
   if( Serial.available() ) {
       String inputString = Serial.readStringUntil('\n');
+      inputString.trim();
       int spaceIndex = inputString.indexOf(' ');
-      if (spaceIndex != -1) {
+      if (inputString == "cal" || inputString.startsWith("cal ")) {
+        calibrationCommand(spaceIndex != -1 ? inputString.substring(spaceIndex + 1) : String(""));
+      } else if (spaceIndex != -1) {
         String sizeStr = inputString.substring(0, spaceIndex);
         String qualityStr = inputString.substring(spaceIndex + 1);
         int s = sizeStr.toInt();
@@ -128,8 +146,9 @@ void loop() {
 
   // If the camera shutter is triggered, capture an image and handle the upload process
   if( camera_shutter_trigger ) {
-    camera_fb_t * fb = NULL;
-    fb = cameraSnapShot(size, quality);
+    // The capture task owns the sensor: set the size and quality, then take a frame captured after the change
+    cameraSetFrame(size, quality);
+    shared_frame_t * fb = frameBroadcasterGetLatest(0);
     if (fb != NULL) {
         #ifdef USE_SD_MMC
         int photo_index = readFileNum(SD_MMC, "/camera");
@@ -156,7 +175,7 @@ void loop() {
               Serial.println("Upload failed!");
           }
         } 
-        cameraFrameBufferTrash(fb);
+        frameBroadcasterRelease(fb);
     } else {
         Serial.println("Camera capture failed.");
     }
@@ -165,21 +184,15 @@ void loop() {
     Serial.println("Select the image quality from 0-17 and quality from 4-63 (e.g. '10 10'):");
   }
   
-  // Read soil moisture and control water pump
-  soilSensor.readMoisture();
-
-  // If moisture is low, trigger the water pump cycle
-  if(soilSensor.isMoistureLow()){
-    water_pump_trigger = true;
-  }
-
-  // If the water pump is triggered, start the water pump cycle
-  if(water_pump_trigger){
-    startWaterPumpCycle();
-    water_pump_trigger = false;
+  // Read the soil moisture of each zone (each sensor at its own sampling period) and,
+  // if it is low, start the zone's water pump cycle; it waits in line if maxPumpsAtOnce pumps are running
+  for (uint8_t zone = 0; zone < zoneCount; zone++) {
+    if (soilSensors[zone].isMoistureLow()) {
+      startWaterPumpCycle(zone);
+    }
   }
 
-  // Control the water pump based on the current soil moisture level
+  // Control the water pumps of the zones with a cycle in progress
   controlWaterPump();
   
   // Check WiFi connection status and update LED indicators accordingly
@@ -217,6 +230,7 @@ void connectWiFi() {
     Serial.println("' to connect");
     Serial.println("Press IO0 button on ESP32-S3 to capture an image, or");
     Serial.println("Select the image quality from 0-17 and quality from 4-63 (e.g. '10 10'):");
+    Serial.println("or calibrate the moisture sensor with 'cal' (cal start, cal <percent>, cal save, cal reset)");
     startCameraServer();
   } else {
     Serial.println("");
@@ -224,4 +238,41 @@ void connectWiFi() {
   }
 }
 
-
+/**
+ * @brief Runs a "cal" serial command, the on-device calibration of the moisture sensors (moisture_calibration.cpp).
+ * The probe of zone 0 takes the readings; the table is shared by the sensors of all the zones, the same type of probe.
+ * "cal start"     begins a calibration; the table in use stays until "cal save".
+ * "cal <percent>" with the probe in soil of a known moisture (0 in air, 100 in water, weighed samples in between),
+ *                 takes the current filtered reading as the reference point for that percentage.
+ * "cal save"      builds the lookup table from the points, uses it and stores it in NVS (at least 2 points).
+ * "cal reset"     erases the stored calibration, back to DRY_VALUE and WET_VALUE.
+ * "cal"           prints the points in use and the current reading.
+ */
+void calibrationCommand(const String& args) {
+  calibration_point_t points[CALIBRATION_MAX_POINTS];
+  if (args == "start") {
+    soilSensors[0].startCalibration();
+    Serial.println("Calibration started: put the probe in reference soil and enter \"cal <percent>\" for each");
+  } else if (args == "save") {
+    bool saved = soilSensors[0].saveCalibration();
+    uint8_t count = moistureCalibrationGetPoints(points);
+    Serial.printf("Calibration %s (%u points)\n", saved ? "stored in NVS" : "failed: start it and add 2 or more monotone points", count);
+  } else if (args == "reset") {
+    Serial.println(soilSensors[0].resetCalibration() ? "Calibration erased, using DRY_VALUE and WET_VALUE" : "Calibration reset failed");
+  } else if (args.length() > 0 && isDigit(args[0])) {
+    long percent = args.toInt();
+    if (soilSensors[0].addCalibrationPoint((byte)constrain(percent, 0L, 255L))) {
+      Serial.printf("%u points\n", moistureCalibrationGetPoints(points, true));
+    } else {
+      Serial.println("Point not added: \"cal start\" first, 0-100%, 8 points at most");
+    }
+  } else {
+    uint8_t count = moistureCalibrationGetPoints(points);
+    for (uint8_t i = 0; i < count; i++) {
+      Serial.printf("  raw %u -> %u%%\n", points[i].raw, points[i].percent);
+    }
+    int raw = soilSensors[0].readRaw();
+    Serial.printf("Now: raw %d -> %u%% (commands: cal start, cal <percent>, cal save, cal reset)\n", raw,
+                  moistureCalibrationPercent(raw));
+  }
+}
@@ -56,7 +56,7 @@ int cameraSetup(void) {
 }
 
 
-camera_fb_t* cameraSnapShot(framesize_t size, byte quality)
+void cameraSetFrame(framesize_t size, byte quality)
 {
     if (size != DEFAULT_FRAME_SIZE ) {
         sensor_t * s = esp_camera_sensor_get();
@@ -67,7 +67,11 @@ camera_fb_t* cameraSnapShot(framesize_t size, byte quality)
         sensor_t * s = esp_camera_sensor_get();
         s->set_quality(s, quality);
     }
+}
 
+camera_fb_t* cameraSnapShot(framesize_t size, byte quality)
+{
+    cameraSetFrame(size, quality);
     return esp_camera_fb_get();
 }
 
@@ -0,0 +1,249 @@
+/**
+ * moisture_calibration.cpp
+ *
+ * Table-driven conversion of the moisture sensor's raw ADC value to percent. Capacitive probes are far from linear, so
+ * the two-point map(DRY_VALUE, WET_VALUE) of the earlier sketches is off by several percent in the middle of the range,
+ * and a new probe meant a new build. Here the probe is calibrated on the device with as many reference points as wanted
+ * (Sensor::startCalibration() and the methods after it); the curve through them is evaluated once for every possible 12-bit value into a
+ * 4 KB table, so a conversion is a single load. The table is stored in NVS with its points and loaded as is at boot.
+ * Both are stored in one blob with a version and a CRC, so a power loss during a save cannot pair a new table with old
+ * points: NVS keeps the previous blob until the new one is completely written.
+ *
+ * Author: John Leung
+ * Date: October 16, 2026
+ */
+#include "moisture_calibration.h"
+#include <Preferences.h>
+#include "esp_rom_crc.h"
+#include <algorithm>
+
+#define CALIBRATION_NVS_KEY "table"
+
+// The record stored in NVS, written and read in one piece
+typedef struct {
+  uint8_t version;
+  uint8_t count;
+  calibration_point_t points[CALIBRATION_MAX_POINTS];
+  uint8_t lut[CALIBRATION_LUT_SIZE];
+  uint32_t crc;   // CRC32 of the bytes above
+} stored_calibration_t;
+
+uint8_t moistureCalibrationLut[CALIBRATION_LUT_SIZE];
+
+static calibration_point_t activePoints[CALIBRATION_MAX_POINTS];   // Points of the table in use
+static uint8_t activeCount = 0;
+static calibration_point_t capturedPoints[CALIBRATION_MAX_POINTS]; // Calibration in progress
+static uint8_t capturedCount = 0;
+static bool capturing = false;
+static uint16_t defaultDry, defaultWet;
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+/**
+ * @brief Builds the two-point table of DRY_VALUE and WET_VALUE.
+ */
+static void useDefault() {
+  activePoints[0] = {defaultDry, 0};
+  activePoints[1] = {defaultWet, 100};
+  activeCount = 2;
+  moistureCalibrationBuild(activePoints, activeCount, moistureCalibrationLut);
+}
+
+static uint32_t storedCrc(const stored_calibration_t& stored) {
+  return esp_rom_crc32_le(0, (const uint8_t*)&stored, offsetof(stored_calibration_t, crc));
+}
+
+/**
+ * @brief Reads the stored table and its points into the ones in use if the record is complete and of this version.
+ *        The record goes through the heap (4 KB) so that the table in use is only overwritten by a valid one.
+ */
+static bool loadStored(Preferences& nvs) {
+  if (nvs.getBytesLength(CALIBRATION_NVS_KEY) != sizeof(stored_calibration_t)) {
+    return false;
+  }
+  stored_calibration_t* stored = (stored_calibration_t*)malloc(sizeof(stored_calibration_t));
+  if (stored == NULL) {
+    return false;
+  }
+  bool valid = nvs.getBytes(CALIBRATION_NVS_KEY, stored, sizeof(stored_calibration_t)) == sizeof(stored_calibration_t) &&
+               stored->version == CALIBRATION_NVS_VERSION && stored->count >= 2 &&
+               stored->count <= CALIBRATION_MAX_POINTS && stored->crc == storedCrc(*stored);
+  if (valid) {
+    memcpy(moistureCalibrationLut, stored->lut, CALIBRATION_LUT_SIZE);
+    memcpy(activePoints, stored->points, stored->count * sizeof(calibration_point_t));
+    activeCount = stored->count;
+  }
+  free(stored);
+  return valid;
+}
+
+/**
+ * @brief Writes the table and the points in use as one NVS record, then removes the keys of the earlier layout.
+ */
+static bool saveStored(Preferences& nvs) {
+  stored_calibration_t* stored = (stored_calibration_t*)calloc(1, sizeof(stored_calibration_t));
+  if (stored == NULL) {
+    return false;
+  }
+  stored->version = CALIBRATION_NVS_VERSION;
+  stored->count = activeCount;
+  memcpy(stored->points, activePoints, activeCount * sizeof(calibration_point_t));
+  memcpy(stored->lut, moistureCalibrationLut, CALIBRATION_LUT_SIZE);
+  stored->crc = storedCrc(*stored);
+  bool saved = nvs.putBytes(CALIBRATION_NVS_KEY, stored, sizeof(stored_calibration_t)) == sizeof(stored_calibration_t);
+  free(stored);
+  if (saved) {
+    // Version 1 kept the table, the points and the version in three keys
+    nvs.remove("lut");
+    nvs.remove("points");
+    nvs.remove("version");
+  }
+  return saved;
+}
+
+static uint8_t clampPercent(float value) {
+  return (uint8_t)constrain(lroundf(value), 0L, 100L);
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+bool moistureCalibrationBegin(uint16_t dryValue, uint16_t wetValue) {
+  defaultDry = dryValue;
+  defaultWet = wetValue;
+  Preferences nvs;
+  bool loaded = false;
+  if (nvs.begin(CALIBRATION_NVS_NAMESPACE, true)) {
+    loaded = loadStored(nvs);
+    nvs.end();
+  }
+  if (!loaded) {
+    useDefault();
+  }
+  Serial.printf("Moisture calibration: %s, %u points\n", loaded ? "loaded from NVS" : "two-point default", activeCount);
+  return loaded;
+}
+
+bool moistureCalibrationBuild(const calibration_point_t* points, uint8_t count, uint8_t* lut) {
+  if (count < 2 || count > CALIBRATION_MAX_POINTS) {
+    return false;
+  }
+  calibration_point_t p[CALIBRATION_MAX_POINTS];
+  memcpy(p, points, count * sizeof(calibration_point_t));
+  std::sort(p, p + count, [](const calibration_point_t& a, const calibration_point_t& b) { return a.raw < b.raw; });
+
+  // Secants, which must not change sign: the probe reads higher the drier the soil
+  float secant[CALIBRATION_MAX_POINTS - 1];
+  int direction = 0;
+  for (uint8_t k = 0; k + 1 < count; k++) {
+    if (p[k + 1].raw == p[k].raw || p[k].raw >= CALIBRATION_LUT_SIZE || p[k + 1].raw >= CALIBRATION_LUT_SIZE) {
+      return false;
+    }
+    secant[k] = (float)(p[k + 1].percent - p[k].percent) / (p[k + 1].raw - p[k].raw);
+    int sign = (secant[k] > 0) - (secant[k] < 0);
+    if (sign != 0 && direction != 0 && sign != direction) {
+      return false;
+    }
+    direction = sign != 0 ? sign : direction;
+  }
+
+  // Fritsch-Carlson tangents: the mean of the secants, limited so that no segment overshoots
+  float tangent[CALIBRATION_MAX_POINTS];
+  tangent[0] = secant[0];
+  tangent[count - 1] = secant[count - 2];
+  for (uint8_t k = 1; k + 1 < count; k++) {
+    tangent[k] = secant[k - 1] * secant[k] <= 0 ? 0 : (secant[k - 1] + secant[k]) / 2;
+  }
+  for (uint8_t k = 0; k + 1 < count; k++) {
+    if (secant[k] == 0) {
+      tangent[k] = tangent[k + 1] = 0;
+      continue;
+    }
+    float a = tangent[k] / secant[k];
+    float b = tangent[k + 1] / secant[k];
+    float s = a * a + b * b;
+    if (s > 9) {
+      float t = 3 / sqrtf(s);
+      tangent[k] = t * a * secant[k];
+      tangent[k + 1] = t * b * secant[k];
+    }
+  }
+
+  uint8_t k = 0;
+  for (uint32_t raw = 0; raw < CALIBRATION_LUT_SIZE; raw++) {
+    if (raw <= p[0].raw) {
+      lut[raw] = clampPercent(p[0].percent + secant[0] * ((float)raw - p[0].raw));
+    } else if (raw >= p[count - 1].raw) {
+      lut[raw] = clampPercent(p[count - 1].percent + secant[count - 2] * ((float)raw - p[count - 1].raw));
+    } else {
+      while (raw > p[k + 1].raw) {
+        k++;
+      }
+      // Cubic Hermite on [p[k], p[k + 1]]
+      float h = p[k + 1].raw - p[k].raw;
+      float t = (raw - p[k].raw) / h;
+      float t2 = t * t, t3 = t2 * t;
+      float value = (2 * t3 - 3 * t2 + 1) * p[k].percent + (t3 - 2 * t2 + t) * h * tangent[k] +
+                    (-2 * t3 + 3 * t2) * p[k + 1].percent + (t3 - t2) * h * tangent[k + 1];
+      lut[raw] = clampPercent(value);
+    }
+  }
+  return true;
+}
+
+void moistureCalibrationStart() {
+  capturedCount = 0;
+  capturing = true;
+}
+
+bool moistureCalibrationAddPoint(uint16_t raw, uint8_t percent) {
+  if (!capturing || percent > 100) {
+    return false;
+  }
+  for (uint8_t i = 0; i < capturedCount; i++) {
+    if (capturedPoints[i].percent == percent) {
+      capturedPoints[i].raw = raw;
+      return true;
+    }
+  }
+  if (capturedCount >= CALIBRATION_MAX_POINTS) {
+    return false;
+  }
+  capturedPoints[capturedCount++] = {raw, percent};
+  return true;
+}
+
+bool moistureCalibrationFinish() {
+  // The table is only read from loop(), like the serial commands that get here, so it is never seen half rebuilt
+  if (!capturing || !moistureCalibrationBuild(capturedPoints, capturedCount, moistureCalibrationLut)) {
+    return false;
+  }
+  memcpy(activePoints, capturedPoints, capturedCount * sizeof(calibration_point_t));
+  activeCount = capturedCount;
+  capturing = false;
+
+  Preferences nvs;
+  if (!nvs.begin(CALIBRATION_NVS_NAMESPACE, false)) {
+    return false;
+  }
+  bool stored = saveStored(nvs);
+  nvs.end();
+  return stored;
+}
+
+bool moistureCalibrationReset() {
+  capturing = false;
+  useDefault();
+  Preferences nvs;
+  if (!nvs.begin(CALIBRATION_NVS_NAMESPACE, false)) {
+    return false;
+  }
+  bool cleared = nvs.clear();
+  nvs.end();
+  return cleared;
+}
+
+uint8_t moistureCalibrationGetPoints(calibration_point_t* points, bool inProgress) {
+  uint8_t count = inProgress ? capturedCount : activeCount;
+  memcpy(points, inProgress ? capturedPoints : activePoints, count * sizeof(calibration_point_t));
+  return count;
+}
@@ -0,0 +1,85 @@
+#ifndef MOISTURE_CALIBRATION_H
+#define MOISTURE_CALIBRATION_H
+
+#include <Arduino.h>
+
+#define CALIBRATION_LUT_SIZE      4096        // One entry per 12-bit ADC value
+#define CALIBRATION_MAX_POINTS    8           // Reference points of a calibration at most
+#define CALIBRATION_NVS_NAMESPACE "moisture"
+#define CALIBRATION_NVS_VERSION   2           // Stored tables of another layout are ignored
+
+/**
+ * @brief One reference point of a calibration: the filtered raw ADC value read with the probe in soil of a known moisture.
+ */
+typedef struct {
+  uint16_t raw;
+  uint8_t percent;
+} calibration_point_t;
+
+// ADC value -> moisture in percent, filled by moistureCalibrationBegin() and replaced by moistureCalibrationFinish()
+extern uint8_t moistureCalibrationLut[CALIBRATION_LUT_SIZE];
+
+/**
+ * @brief Loads the lookup table stored in NVS: one 4 KB read, no curve to evaluate. Without a stored table, the table is
+ *        built from the two-point calibration given here, i.e. the linear map() of the earlier sketches.
+ * @param dryValue Raw ADC value for 0% (probe in air).
+ * @param wetValue Raw ADC value for 100% (probe in water).
+ * @return true if the table was loaded from NVS.
+ */
+bool moistureCalibrationBegin(uint16_t dryValue, uint16_t wetValue);
+
+/**
+ * @brief Converts a raw ADC value to moisture in percent: a single load from the lookup table.
+ */
+static inline uint8_t moistureCalibrationPercent(uint16_t raw) {
+  return moistureCalibrationLut[raw & (CALIBRATION_LUT_SIZE - 1)];
+}
+
+/**
+ * @brief Fills a lookup table with the monotone cubic (Fritsch-Carlson) through the points: unlike a spline, it never
+ *        overshoots between two points, so the table stays monotone like the probe. Before the first and after the last
+ *        point the end segments are extended linearly, clamped to 0-100%. Two points give the linear map().
+ * @param points The reference points, in any order. Their raw values must differ, and the percentages must fall (or
+ *               rise) steadily with the raw value.
+ * @param count Number of points, 2 to CALIBRATION_MAX_POINTS.
+ * @param lut The CALIBRATION_LUT_SIZE entries to fill.
+ * @return false if the points are not usable; lut is then unchanged.
+ */
+bool moistureCalibrationBuild(const calibration_point_t* points, uint8_t count, uint8_t* lut);
+
+/**
+ * @brief Starts a calibration: clears the reference points captured so far. The current table stays in use until
+ *        moistureCalibrationFinish().
+ */
+void moistureCalibrationStart();
+
+/**
+ * @brief Adds a reference point to the calibration in progress; a point at the same percentage is replaced.
+ * @param raw Filtered raw ADC value with the probe in the reference soil.
+ * @param percent Moisture of the reference soil (0 in air, 100 in water, gravimetric values in between).
+ * @return false if no calibration is in progress, the point list is full or percent is above 100.
+ */
+bool moistureCalibrationAddPoint(uint16_t raw, uint8_t percent);
+
+/**
+ * @brief Builds the table from the captured points, puts it in use and stores it in NVS with its points, as one
+ *        record with a CRC: a power loss during the save leaves the previous calibration in NVS.
+ * @return false if the points are not usable (see moistureCalibrationBuild()) or NVS could not be written; the table
+ *         is put in use even if it could not be stored.
+ */
+bool moistureCalibrationFinish();
+
+/**
+ * @brief Erases the stored calibration and goes back to the two-point table of moistureCalibrationBegin().
+ */
+bool moistureCalibrationReset();
+
+/**
+ * @brief Copies the points of the table in use, or of the calibration in progress.
+ * @param points CALIBRATION_MAX_POINTS entries.
+ * @param inProgress true for the points captured since moistureCalibrationStart().
+ * @return The number of points.
+ */
+uint8_t moistureCalibrationGetPoints(calibration_point_t* points, bool inProgress = false);
+
+#endif
@@ -0,0 +1,78 @@
+/**
+ * moisture_filter.cpp
+ *
+ * Robust reduction of the soil moisture ADC samples. A single analogRead() of the ESP32-S3 ADC is off by tens of counts
+ * now and then, and by hundreds while the WiFi radio transmits; one such sample below the lower threshold started a
+ * watering cycle. The filter works on bursts (SENSOR_BURST samples of Sensor::readMoisture()): a trimmed mean within
+ * the burst, a median across the last bursts and an IIR on top.
+ *
+ * It has no hardware dependency; the 12_ sketch has the same filter behind the ADC DMA driver.
+ *
+ * Author: John Leung
+ * Date: October 16, 2026
+ */
+#include "moisture_filter.h"
+#include <algorithm>
+
+#define ADC_MAX         4095
+#define IQR_TO_SIGMA    1.349f  // Interquartile range of a normal distribution in standard deviations
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+/**
+ * @brief Median of the last burst values, the latest one while there are fewer than MOISTURE_FILTER_MEDIAN.
+ */
+static uint16_t recentMedian(const moisture_filter_t& filter, uint16_t latest) {
+  if (filter.bursts + 1 < MOISTURE_FILTER_MEDIAN) {
+    return latest;
+  }
+  uint16_t sorted[MOISTURE_FILTER_MEDIAN];
+  std::copy(filter.recent, filter.recent + MOISTURE_FILTER_MEDIAN, sorted);
+  std::sort(sorted, sorted + MOISTURE_FILTER_MEDIAN);
+  return sorted[MOISTURE_FILTER_MEDIAN / 2];
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+void moistureFilterReset(moisture_filter_t& filter) {
+  std::fill(filter.recent, filter.recent + MOISTURE_FILTER_MEDIAN, 0);
+  filter.bursts = 0;
+  filter.value = 0;
+  filter.noise = 0;
+  filter.spread = 0;
+}
+
+bool moistureFilterAddBurst(moisture_filter_t& filter, uint16_t* samples, size_t count) {
+  count = std::min(count, (size_t)MOISTURE_FILTER_BURST_MAX);
+  count = std::remove_if(samples, samples + count, [](uint16_t s) { return s > ADC_MAX; }) - samples;
+  if (count == 0) {
+    return false;
+  }
+  std::sort(samples, samples + count);
+
+  // Interquartile mean: the lowest and the highest quarter are dropped, at least one sample is kept
+  size_t first = count / 4;
+  size_t last = std::max(count - count / 4, first + 1);
+  uint32_t sum = 0;
+  for (size_t i = first; i < last; i++) {
+    sum += samples[i];
+  }
+  uint16_t burstValue = (uint16_t)((sum + (last - first) / 2) / (last - first));
+  filter.spread = (samples[last - 1] - samples[first]) / IQR_TO_SIGMA;
+
+  filter.recent[filter.bursts % MOISTURE_FILTER_MEDIAN] = burstValue;
+  uint16_t median = recentMedian(filter, burstValue);
+  if (filter.bursts == 0) {
+    filter.value = median;
+    filter.noise = filter.spread;
+  } else {
+    filter.value += MOISTURE_FILTER_IIR_WEIGHT * (median - filter.value);
+    filter.noise += MOISTURE_FILTER_IIR_WEIGHT * (filter.spread - filter.noise);
+  }
+  filter.bursts++;
+  return true;
+}
+
+uint16_t moistureFilterValue(const moisture_filter_t& filter) {
+  return (uint16_t)(filter.value + 0.5f);
+}
@@ -2,18 +2,21 @@
 
 const int DRY_VALUE = 4095; // Upper calibration value (max ADC value) for 100% reading
 const int WET_VALUE = 1300; // Lower calibration value (min ADC value) for 0% reading
-const byte UPPER_MOISTURE_DEFAULT = 35; // Default upper moisture threshold (in percentage)
-const byte LOWER_MOISTURE_DEFAULT = 30; // Default lower moisture threshold (in percentage)
 
-Sensor::Sensor(int pin, unsigned long samplingPeriod) {
+Sensor::Sensor(int pin, unsigned long samplingPeriod, byte lowerMoisture, byte upperMoisture) {
   _pin = pin;
   _samplingPeriod = samplingPeriod;
   _lastReadTime = 0;
   _lastMoistureValue = 100; //initialize to 100% to avoid unintended water pump action on power up.
   _upperCalibration = DRY_VALUE;
   _lowerCalibration = WET_VALUE;
-  _upperMoisture = UPPER_MOISTURE_DEFAULT;
-  _lowerMoisture = LOWER_MOISTURE_DEFAULT;
+  _upperMoisture = upperMoisture;
+  _lowerMoisture = lowerMoisture;
+  moistureFilterReset(_filter);
+}
+
+void Sensor::begin() {
+  moistureCalibrationBegin(_upperCalibration, _lowerCalibration);
 }
 
 void Sensor::setSamplingPeriod(unsigned long period) {
@@ -40,16 +43,50 @@ byte Sensor::readMoisture() {
   unsigned long currentTime = millis();
   if (currentTime - _lastReadTime >= _samplingPeriod) {
     _lastReadTime = currentTime;
-    int rawValue = analogRead(_pin);
-    // Map the raw ADC value to a percentage based on calibration
-    int moisturePercentage = map(rawValue, _upperCalibration, _lowerCalibration, 0, 100);
-    _lastMoistureValue = constrain(moisturePercentage, 0, 100); // Ensure it's between 0 and 100
+    int rawValue = readRaw();
+    // The calibration table gives the percentage in a single lookup (moisture_calibration.cpp)
+    _lastMoistureValue = moistureCalibrationPercent(rawValue);
 
-    Serial.printf("Raw ADC: %d, Mapped Moisture: %d%%\n", rawValue, _lastMoistureValue);
+    Serial.printf("Pin %d Raw ADC: %d (noise %.1f), Mapped Moisture: %d%%\n", _pin, rawValue, _filter.noise, _lastMoistureValue);
   }
   return _lastMoistureValue;
 }
 
+int Sensor::readRaw() {
+  // Bursts instead of a single sample: one sample disturbed by the WiFi radio used to start the pump
+  moistureFilterReset(_filter);
+  for (int burst = 0; burst < SENSOR_BURSTS; burst++) {
+    uint16_t samples[SENSOR_BURST];
+    for (int i = 0; i < SENSOR_BURST; i++) {
+      samples[i] = analogRead(_pin);
+    }
+    moistureFilterAddBurst(_filter, samples, SENSOR_BURST);
+  }
+  return moistureFilterValue(_filter);
+}
+
+void Sensor::startCalibration() {
+  moistureCalibrationStart();
+}
+
+bool Sensor::addCalibrationPoint(byte percent) {
+  int rawValue = readRaw();
+  Serial.printf("Calibration point: raw %d (noise %.1f) = %d%%\n", rawValue, _filter.noise, percent);
+  return moistureCalibrationAddPoint(rawValue, percent);
+}
+
+bool Sensor::saveCalibration() {
+  return moistureCalibrationFinish();
+}
+
+bool Sensor::resetCalibration() {
+  return moistureCalibrationReset();
+}
+
+float Sensor::getNoise() {
+  return _filter.noise;
+}
+
 bool Sensor::isMoistureLow() {
   byte moisture = readMoisture();
   bool isLow = moisture < _lowerMoisture;
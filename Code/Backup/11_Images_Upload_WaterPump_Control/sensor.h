@@ -2,14 +2,33 @@
 #define _SENSOR_H
 
 #include <Arduino.h>
+#include "moisture_filter.h"
+#include "moisture_calibration.h"
+
+#define SENSOR_BURST  16  // analogRead() samples per burst of moisture_filter.cpp
+#define SENSOR_BURSTS 8   // Bursts per reading (~1.5 ms), filtered from scratch so that a reading does not lag
+#define SENSOR_UPPER_MOISTURE_DEFAULT 35  // Default upper moisture threshold (in percentage)
+#define SENSOR_LOWER_MOISTURE_DEFAULT 30  // Default lower moisture threshold (in percentage)
 
 class Sensor {
   public:
-    // Constructor
+    // Constructor, one Sensor per watering zone
     // pin: GPIO pin number for the sensor
     // samplingPeriod: Minimum time interval (in milliseconds) between consecutive readings to prevent excessive reads
-    Sensor(int pin, unsigned long samplingPeriod = 5000);
+    // lowerMoisture, upperMoisture: hysteresis thresholds of the zone (in percentage)
+    Sensor(int pin, unsigned long samplingPeriod = 5000, byte lowerMoisture = SENSOR_LOWER_MOISTURE_DEFAULT,
+           byte upperMoisture = SENSOR_UPPER_MOISTURE_DEFAULT);
+    // Loads the calibration table stored in NVS (or builds the two-point default), call it once in setup().
+    // The table is shared by all the sensors, which are the same type of probe.
     void setSamplingPeriod(unsigned long period);
+    void begin();
+
+    // On-device calibration: start, then add a point per reference soil (0% in air, 100% in water, weighed samples in
+    // between) with the probe in it, then save to build the lookup table and store it in NVS
+    void startCalibration();
+    bool addCalibrationPoint(byte percent);
+    bool saveCalibration();
+    bool resetCalibration();
 
     // set upper and lower sensor values for calibration
     void setUpperMoisture(byte upper);
@@ -18,6 +37,9 @@ class Sensor {
     byte getUpperMoisture();
     byte getLowerMoisture();
     byte readMoisture();
+    int readRaw();
+    // Noise of one ADC sample (standard deviation in raw counts), as estimated by the last reading
+    float getNoise();
     bool isMoistureLow();
     bool isMoistureHigh();
 
@@ -26,6 +48,7 @@ class Sensor {
     unsigned long _samplingPeriod;
     unsigned long _lastReadTime;
     byte _lastMoistureValue;
+    moisture_filter_t _filter;
     int _upperCalibration;
     int _lowerCalibration;
     byte _upperMoisture;
@@ -1,85 +1,155 @@
 #include "water_pump_control.h"
 
-// --- Add these new global variables ---
-enum PumpState { IDLE, WATERING, SOAKING };
-PumpState currentPumpState = IDLE;
-unsigned long pumpStateChangeMillis = 0; // Tracks time for the current state
+enum PumpState { IDLE, WAITING, WATERING, SOAKING };
 
-// Pump turn-on time and soak time - need tuning for your own case
+// The state of each zone, held in arrays instead of one global pump state
+typedef struct {
+  pump_zone_t config;
+  PumpState state;
+  unsigned long stateChangeMillis; // Tracks time for the current state
+} zone_state_t;
+
+static zone_state_t zones[PUMP_MAX_ZONES];
+static uint8_t zoneCount = 0;
+static uint8_t maxActivePumps = 1;
+static uint8_t activeZones[PUMP_MAX_ZONES];   // Zones WATERING or SOAKING, the only ones controlWaterPump() visits
+static uint8_t activeCount = 0;
+static uint8_t pumpsOn = 0;                   // Zones WATERING
+static uint8_t waitLine[PUMP_MAX_ZONES];      // WAITING zones in request order, a ring
+static uint8_t waitHead = 0;
+static uint8_t waitCount = 0;
+
+// Pump turn-on time and soak time of InitWaterPump() - need tuning for your own case
 const unsigned int pumpOnTime = 1000; // Pump ON time in milliseconds (1 second)
 const unsigned int pumpSoakTime = 20000; // Soak time in milliseconds (20 seconds)
 
-/**
- * @brief Local function to manage the water pump cycle using a state machine. 
- * It checks the current state of the pump and transitions between states based on elapsed time.
- * @param onTime Duration for which the pump should be ON (in milliseconds).
- * @param soakTime Duration for which the soil should soak after watering (in milliseconds).
- */
-void manageWaterPumpCycle(unsigned int onTime, unsigned int soakTime);
+//-----------------------LOCAL FUNCTIONS--------------------------
 
 /**
- * @brief Initializes the water pump control by setting up the relay pin.
- *        The relay pin is configured as an output and set to LOW (pump off) by
+ * @brief Prints "Zone n: " before the messages when there is more than one zone.
  */
-void InitWaterPump()
-{
-  pinMode(PUMP_RELAY_PIN, OUTPUT);
-  digitalWrite(PUMP_RELAY_PIN, LOW); // Ensure pump is OFF by default
+static void printZone(uint8_t zone) {
+  if (zoneCount > 1) {
+    Serial.printf("Zone %u: ", zone);
+  }
 }
 
 /**
- * @brief Controls the water pump by managing the pump state on every loop iteration to handle timing and state changes internally.
- *        The function will use predefined durations for watering and soaking to manage the pump cycle.
+ * @brief Switches the pump of a zone on and adds the zone to the active list.
  */
-void controlWaterPump() {
-
-  // Manage the pump state on every single loop iteration
-  // The function will handle the timing and state changes internally.
-  // Use 1000ms for watering and 20000ms (20s) for soaking.
-  manageWaterPumpCycle(pumpOnTime, pumpSoakTime);  
+static void startWatering(uint8_t zone) {
+  zones[zone].state = WATERING;
+  zones[zone].stateChangeMillis = millis(); // Record the time we started watering
+  digitalWrite(zones[zone].config.relayPin, HIGH);
+  activeZones[activeCount++] = zone;
+  pumpsOn++;
+  printZone(zone);
+  Serial.println("Pump cycle started: WATERING");
 }
 
 /**
- * @brief Starts the water pump cycle by setting the relay pin HIGH to turn on the pump and recording the time when the cycle started.
- *        This function will only start a new cycle if the pump is currently idle to prevent overlapping
+ * @brief Local function to manage the water pump cycle of one zone using a state machine.
+ * It checks the current state of the pump and transitions between states based on elapsed time.
+ * @return false once the cycle is complete and the zone is IDLE again.
  */
-void startWaterPumpCycle() {
-  // Only start a new cycle if the pump is currently idle
-  if (currentPumpState == IDLE) {
-    currentPumpState = WATERING;
-    pumpStateChangeMillis = millis(); // Record the time we started watering
-    digitalWrite(PUMP_RELAY_PIN, HIGH);
-    Serial.println("Pump cycle started: WATERING");
-  }
-}
+static bool manageWaterPumpCycle(uint8_t zone) {
+  zone_state_t& z = zones[zone];
 
-//-----------------------LOCAL FUNCTIONS--------------------------
-
-/**
- * @brief Local function to manage the water pump cycle using a state machine.
- * @param onTime Duration for which the pump should be ON (in milliseconds).
- * @param soakTime Duration for which the soil should soak after watering (in milliseconds).
- */
-void manageWaterPumpCycle(unsigned int onTime, unsigned int soakTime) {
-  // This function is a state machine. It does nothing unless a state is active.
-  
   // State 1: The pump is currently WATERING
-  if (currentPumpState == WATERING) {
+  if (z.state == WATERING) {
     // Check if the 'onTime' has elapsed
-    if (millis() - pumpStateChangeMillis >= onTime) {
+    if (millis() - z.stateChangeMillis >= z.config.onTime) {
       // Time to switch to the SOAKING state
-      currentPumpState = SOAKING;
-      pumpStateChangeMillis = millis(); // Record the time we started soaking
-      digitalWrite(PUMP_RELAY_PIN, LOW);
+      z.state = SOAKING;
+      z.stateChangeMillis = millis(); // Record the time we started soaking
+      digitalWrite(z.config.relayPin, LOW);
+      pumpsOn--;
+      printZone(zone);
       Serial.println("Watering finished. Now SOAKING.");
     }
   }  // State 2: The soil is currently SOAKING
-  else if (currentPumpState == SOAKING) { 
+  else if (z.state == SOAKING) {
     // Check if the 'soakTime' has elapsed
-    if (millis() - pumpStateChangeMillis >= soakTime) {
+    if (millis() - z.stateChangeMillis >= z.config.soakTime) {
       // The cycle is complete, return to IDLE
-      currentPumpState = IDLE;
+      z.state = IDLE;
+      printZone(zone);
       Serial.println("Soak time complete. Pump cycle finished.");
+      return false;
+    }
+  }
+  return true;
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+/**
+ * @brief Initializes the water pump control by setting up the relay pin.
+ *        The relay pin is configured as an output and set to LOW (pump off) by
+ */
+void InitWaterPump()
+{
+  const pump_zone_t zone = {PUMP_RELAY_PIN, pumpOnTime, pumpSoakTime};
+  pumpZonesBegin(&zone, 1, 1);
+}
+
+bool pumpZonesBegin(const pump_zone_t* zoneTable, uint8_t count, uint8_t maxActive) {
+  if (count == 0 || count > PUMP_MAX_ZONES || maxActive == 0) {
+    return false;
+  }
+  zoneCount = count;
+  maxActivePumps = maxActive;
+  activeCount = pumpsOn = waitHead = waitCount = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    zones[i].config = zoneTable[i];
+    zones[i].state = IDLE;
+    zones[i].stateChangeMillis = 0;
+    pinMode(zones[i].config.relayPin, OUTPUT);
+    digitalWrite(zones[i].config.relayPin, LOW); // Ensure pump is OFF by default
+  }
+  return true;
+}
+
+/**
+ * @brief Controls the water pumps by managing the pump state on every loop iteration to handle timing and state changes internally.
+ *        Only the zones with a cycle in progress are visited; a pump freed by a zone goes to the first zone in line.
+ */
+void controlWaterPump() {
+  for (uint8_t i = 0; i < activeCount;) {
+    if (manageWaterPumpCycle(activeZones[i])) {
+      i++;
+    } else {
+      activeZones[i] = activeZones[--activeCount]; // Order does not matter, each zone keeps its own times
     }
   }
-}
\ No newline at end of file
+  while (waitCount > 0 && pumpsOn < maxActivePumps) {
+    uint8_t zone = waitLine[waitHead];
+    waitHead = (waitHead + 1) % PUMP_MAX_ZONES;
+    waitCount--;
+    startWatering(zone);
+  }
+}
+
+/**
+ * @brief Starts the water pump cycle by setting the relay pin HIGH to turn on the pump and recording the time when the cycle started.
+ *        This function will only start a new cycle if the zone is currently idle to prevent overlapping
+ */
+void startWaterPumpCycle(uint8_t zone) {
+  // Only start a new cycle if the zone is currently idle
+  if (zone >= zoneCount || zones[zone].state != IDLE) {
+    return;
+  }
+  if (pumpsOn < maxActivePumps) {
+    startWatering(zone);
+  } else {
+    zones[zone].state = WAITING;
+    zones[zone].stateChangeMillis = millis();
+    waitLine[(waitHead + waitCount++) % PUMP_MAX_ZONES] = zone;
+    printZone(zone);
+    Serial.println("Pump cycle WAITING for a free pump");
+  }
+}
+
+bool isWaterPumpCycleActive(uint8_t zone) {
+  return zone < zoneCount && zones[zone].state != IDLE;
+}
@@ -3,26 +3,48 @@
 
 #include <Arduino.h>
 
-#define PUMP_RELAY_PIN    47    //ESP32-S3 GPIO 47 to control the water pump relay  
+#define PUMP_RELAY_PIN    47    //ESP32-S3 GPIO 47 to control the water pump relay
+#define PUMP_MAX_ZONES    16    // Zones (sensor and pump) of one board
+
+// One watering zone: a pot or tray with its own pump relay
+typedef struct {
+  uint8_t relayPin;
+  unsigned int onTime;      // Pump ON time in milliseconds
+  unsigned int soakTime;    // Soak time in milliseconds
+} pump_zone_t;
 
 /**
  * @brief Initializes the water pump control by setting up the relay pin.
  *        The relay pin is configured as an output and set to LOW (pump off) by default.
+ *        Same as pumpZonesBegin() with a single zone on PUMP_RELAY_PIN.
  */
 void InitWaterPump();
 
+/**
+ * @brief Sets up the zones and switches all their pumps off.
+ * @param zones One entry per zone, copied.
+ * @param count Number of zones, at most PUMP_MAX_ZONES.
+ * @param maxActive Pumps allowed to run at the same time (power supply budget); the other requests wait in line.
+ * @return false if count or maxActive is out of range.
+ */
+bool pumpZonesBegin(const pump_zone_t* zones, uint8_t count, uint8_t maxActive);
 
 /**
- * @brief Starts the water pump cycle by setting the relay pin HIGH to turn on the pump and recording the time when the cycle started.
- *        This function will only start a new cycle if the pump is currently idle to prevent overlapping
+ * @brief Starts the water pump cycle of a zone by setting its relay pin HIGH and recording the time when the cycle started.
+ *        This function will only start a new cycle if the zone is currently idle to prevent overlapping. If maxActive
+ *        pumps are running, the zone waits in line and starts when a pump is free.
  */
-void startWaterPumpCycle();
+void startWaterPumpCycle(uint8_t zone = 0);
 
 /**
- * @brief Controls the water pump by managing the pump state on every main loop iteration to handle timing and state changes internally.
- *        The function will use predefined durations for watering (pumpOnTime = 1000) and soaking (pumpSoakTime = 20000) in water_pump_control.cpp to manage the pump cycle.
+ * @brief Controls the water pumps by managing the pump state of each zone with a cycle in progress on every main loop
+ *        iteration: the cost of a call is proportional to the active zones, not to the number of zones.
  */
 void controlWaterPump();
 
-#endif
+/**
+ * @brief Returns true while the zone is watering, soaking or waiting for a pump.
+ */
+bool isWaterPumpCycleActive(uint8_t zone = 0);
 
+#endif
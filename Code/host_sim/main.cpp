@@ -0,0 +1,470 @@
+/**
+ * main.cpp
+ *
+ * Runs the setup()/loop() of 12_WaterPumpControl_and_ImageUpload_and_LCD on Linux at accelerated virtual time.
+ * See README.md for the options and what each shim simulates.
+ *
+ * Author: John Leung
+ * Date: October 16, 2026
+ */
+#include "Arduino.h"
+#include "SD_MMC.h"
+#include "sd_benchmark.h"
+#include "water_pump_control.h"
+#include "moisture_adc.h"
+#include "moisture_filter.h"
+#include "tune.h"
+#include "storage_test.h"
+#include "scheduler_test.h"
+#include <unistd.h>
+#include <chrono>
+#include <random>
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+static void usage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  --speed N              virtual seconds per host second (default 60)\n"
+          "  --duration S           virtual run time in seconds (default 3600)\n"
+          "  --sd DIR               host directory behind SD_MMC (default sim_sd)\n"
+          "  --nvs DIR              host directory behind the NVS of Preferences (default sim_nvs)\n"
+          "  --camera DIR           serve the .jpg files of DIR as camera frames\n"
+          "  --camera-frame-ms MS   virtual capture time of one frame (default 40)\n"
+          "  --wifi-outage A:B      WiFi down from virtual second A to B (repeatable)\n"
+          "  --thingspeak-server URL  ThingSpeak.writeFields() POSTs to URL/update (e.g. http://127.0.0.1:8081)\n"
+          "  --tls-standin HOST:PORT  https connections go in plain text to HOST:PORT\n"
+          "  --http-port P          host port of the board's port 80 server, +1 for the stream, 0 = off (default 8000)\n"
+          "  --moisture PCT         initial soil moisture (default 40)\n"
+          "  --drying PCT           moisture lost per virtual hour (default 6)\n"
+          "  --adc-spikes P         probability of an ADC spike per sample while WiFi is up (default 0)\n"
+          "  --adc-trace FILE       replay the raw ADC samples of FILE (one per line) instead of the soil model\n"
+          "  --metrics FILE|-       write the /metrics page at the end\n"
+          "  --lcd-dump FILE.ppm    write the LCD framebuffer at the end\n"
+          "  --quiet                do not echo the sketch's Serial output\n"
+          "  --sd-bench csv|json    run the SD benchmark on the --sd directory at real time, results on stdout\n"
+          "  --zone-test N[:M]      run N virtual watering zones with at most M pumps at once instead of the sketch\n"
+          "  --filter-test FILE     check the moisture filter on a recorded ADC trace, e.g. traces/adc_wifi_spikes_33pct.txt\n"
+          "  --stall-test S         block the loop for S virtual s during each watering, check the pump still stops on time\n"
+          "  --scheduler-test N     check the loop() task scheduler over N random clock steps across the millis() wrap\n"
+          "  --storage-test M       check the SD card modules M (all, spool, index, log or retention) on a scratch directory\n"
+          "  --model-test DAYS      check that the watering model learns the gain of the soil-water model over DAYS\n"
+          "  --tune DAYS            sweep the pump parameters over DAYS of the soil-water model instead of the sketch, CSV on stdout\n"
+          "  --jobs N               runs of the sweep in parallel (default: one per core)\n"
+          "  --grid-lower A:B[:S]   lowerMoistureThreshold values of the sweep, %% (default 30)\n"
+          "  --grid-upper A:B[:S]   upperMoistureThreshold values, %% (default 35)\n"
+          "  --grid-on-ms A:B[:S]   pumpOnTime values (default 1000)\n"
+          "  --grid-soak-ms A:B[:S] pumpSoakTime values (default 20000)\n"
+          "  --band LOW:HIGH        moisture band the sweep scores the time out of band against (default 30:35)\n"
+          "  --et PCT               evapotranspiration per day of the sweep's soil, %% (default 15)\n"
+          "  --infiltration-s S     time constant of the water reaching the roots (default 120)\n"
+          "  --sensor-lag-s S       time constant of the probe following the roots (default 60)\n"
+          "  --sensor-noise PCT     standard deviation of one reading (default 0.5)\n"
+          "  --pump-flow ML         pump flow per second, for the water used (default 30)\n"
+          "  --controller hysteresis|predictive  watering controller of the sweep (default hysteresis)\n",
+          program);
+}
+
+/**
+ * @brief Reads a recorded ADC trace: the first number of each line is a raw 12-bit sample, '#' starts a comment line.
+ */
+static bool loadAdcTrace(const char* path) {
+  FILE* f = fopen(path, "r");
+  if (f == NULL) {
+    fprintf(stderr, "[host_sim] Cannot read %s\n", path);
+    return false;
+  }
+  char line[128];
+  while (fgets(line, sizeof(line), f) != NULL) {
+    unsigned sample;
+    if (line[0] != '#' && sscanf(line, "%u", &sample) == 1) {
+      simConfig.adcTrace.push_back((uint16_t)std::min(sample, 4095U));
+    }
+  }
+  fclose(f);
+  fprintf(stderr, "[host_sim] %zu ADC samples from %s\n", simConfig.adcTrace.size(), path);
+  return !simConfig.adcTrace.empty();
+}
+
+/**
+ * @brief Parses "A", "A:B" or "A:B:STEP" (step 1 by default).
+ */
+static bool parseRange(const char* value, SimRange& range) {
+  double first, last, step = 1;
+  int fields = sscanf(value, "%lf:%lf:%lf", &first, &last, &step);
+  if (fields < 1 || step <= 0) {
+    return false;
+  }
+  range = {first, fields >= 2 ? last : first, step};
+  return range.last >= range.first;
+}
+
+/**
+ * @brief Fills simConfig from the command line.
+ * @return false on an unknown option or a missing value.
+ */
+static bool parseArgs(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    std::string opt = argv[i];
+    if (opt == "--quiet") {
+      simConfig.quiet = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const char* value = argv[++i];
+    if (opt == "--speed") {
+      simConfig.speed = atof(value);
+    } else if (opt == "--duration") {
+      simConfig.durationS = strtoul(value, NULL, 10);
+    } else if (opt == "--sd") {
+      simConfig.sdRoot = value;
+    } else if (opt == "--nvs") {
+      simConfig.nvsDir = value;
+    } else if (opt == "--camera") {
+      simConfig.cameraDir = value;
+    } else if (opt == "--camera-frame-ms") {
+      simConfig.cameraFrameMs = strtoul(value, NULL, 10);
+    } else if (opt == "--wifi-outage") {
+      unsigned start, end;
+      if (sscanf(value, "%u:%u", &start, &end) != 2 || end <= start) {
+        return false;
+      }
+      simConfig.wifiOutages.push_back(std::make_pair(start, end));
+    } else if (opt == "--thingspeak-server") {
+      simConfig.thingspeakServer = value;
+    } else if (opt == "--tls-standin") {
+      simConfig.tlsStandIn = value;
+    } else if (opt == "--http-port") {
+      simConfig.httpPort = atoi(value);
+    } else if (opt == "--moisture") {
+      simConfig.soilMoisture = atof(value);
+    } else if (opt == "--drying") {
+      simConfig.dryingPerHour = atof(value);
+    } else if (opt == "--adc-spikes") {
+      simConfig.adcSpikes = atof(value);
+    } else if (opt == "--adc-trace") {
+      if (!loadAdcTrace(value)) {
+        return false;
+      }
+    } else if (opt == "--metrics") {
+      simConfig.metricsOut = value;
+    } else if (opt == "--lcd-dump") {
+      simConfig.lcdDump = value;
+    } else if (opt == "--sd-bench") {
+      simConfig.sdBench = value;
+    } else if (opt == "--zone-test") {
+      unsigned zones, maxActive = 1;
+      if (sscanf(value, "%u:%u", &zones, &maxActive) < 1 || zones == 0 || zones > PUMP_MAX_ZONES || maxActive == 0) {
+        return false;
+      }
+      simConfig.zoneTest = zones;
+      simConfig.zoneMaxActive = maxActive;
+    } else if (opt == "--filter-test") {
+      if (!loadAdcTrace(value)) {
+        return false;
+      }
+      simConfig.filterTest = true;
+    } else if (opt == "--stall-test") {
+      simConfig.stallTestS = strtoul(value, NULL, 10);
+      if (simConfig.stallTestS == 0) {
+        return false;
+      }
+    } else if (opt == "--scheduler-test") {
+      simConfig.schedulerTestSteps = strtoul(value, NULL, 10);
+      if (simConfig.schedulerTestSteps == 0) {
+        return false;
+      }
+    } else if (opt == "--storage-test") {
+      simConfig.storageTest = value;
+    } else if (opt == "--model-test") {
+      simConfig.modelTestDays = atof(value);
+      if (simConfig.modelTestDays <= 0) {
+        return false;
+      }
+    } else if (opt == "--tune") {
+      simConfig.tuneDays = atof(value);
+    } else if (opt == "--jobs") {
+      simConfig.tuneJobs = strtoul(value, NULL, 10);
+    } else if (opt == "--grid-lower") {
+      if (!parseRange(value, simConfig.gridLower)) {
+        return false;
+      }
+    } else if (opt == "--grid-upper") {
+      if (!parseRange(value, simConfig.gridUpper)) {
+        return false;
+      }
+    } else if (opt == "--grid-on-ms") {
+      if (!parseRange(value, simConfig.gridOnMs)) {
+        return false;
+      }
+    } else if (opt == "--grid-soak-ms") {
+      if (!parseRange(value, simConfig.gridSoakMs)) {
+        return false;
+      }
+    } else if (opt == "--band") {
+      if (sscanf(value, "%lf:%lf", &simConfig.bandLow, &simConfig.bandHigh) != 2 || simConfig.bandHigh < simConfig.bandLow) {
+        return false;
+      }
+    } else if (opt == "--et") {
+      simConfig.etPerDay = atof(value);
+    } else if (opt == "--infiltration-s") {
+      simConfig.infiltrationS = std::max(1.0, atof(value));
+    } else if (opt == "--sensor-lag-s") {
+      simConfig.sensorLagS = std::max(1.0, atof(value));
+    } else if (opt == "--sensor-noise") {
+      simConfig.sensorNoise = std::max(0.0, atof(value));
+    } else if (opt == "--pump-flow") {
+      simConfig.pumpFlowMlPerS = atof(value);
+    } else if (opt == "--controller") {
+      if (strcmp(value, "predictive") != 0 && strcmp(value, "hysteresis") != 0) {
+        return false;
+      }
+      simConfig.tunePredictive = strcmp(value, "predictive") == 0;
+    } else {
+      return false;
+    }
+  }
+  return simConfig.speed > 0;
+}
+
+/**
+ * Writes the benchmark results to stdout.
+ */
+class StdoutPrint : public Print {
+  public:
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buf, size_t size) override { return fwrite(buf, 1, size, stdout); }
+};
+
+/**
+ * @brief Runs the sketch's SD benchmark on the host directory, the Linux numbers to compare the card's with.
+ *        Virtual time runs at 1x so the results are in host microseconds; the progress notes go to stderr.
+ */
+static int runSdBenchmark() {
+  simConfig.speed = 1;
+  simConfig.serialToStderr = true;
+  if (!SD_MMC.begin()) {
+    fprintf(stderr, "[host_sim] Cannot use %s as the SD card\n", simConfig.sdRoot.c_str());
+    return 1;
+  }
+  StdoutPrint out;
+  bool ok = sdBenchmarkRun(SD_MMC, out, sdBenchmarkParseFormat(simConfig.sdBench.c_str()));
+  fflush(stdout);
+  return ok ? 0 : 1;
+}
+
+/**
+ * @brief Runs the zone scheduler of water_pump_control.cpp with N virtual zones instead of the sketch: relay pin n waters
+ *        the soil model of zone n, which dries at its own rate. Every 5 virtual seconds each zone's moisture goes to
+ *        pumpZoneUpdate(), as the sketch does, and manageWaterPumpCycle() runs on every iteration. The relays are checked
+ *        independently of the scheduler's counters: the GPIO shim counts the relays HIGH at every digitalWrite(), and no
+ *        more than M may ever be HIGH at the same time, whatever the --speed.
+ * @return 0 if the cap held.
+ */
+static int runZoneTest() {
+  const uint8_t count = simConfig.zoneTest;
+  const uint8_t lower = 30, upper = 35;
+  std::vector<pump_zone_t> table(count);
+  std::vector<double> moisture(count), drying(count);
+  std::mt19937 rng(4242);
+  for (uint8_t i = 0; i < count; i++) {
+    table[i] = {i, lower, upper, 1000, 20000};
+    moisture[i] = std::uniform_real_distribution<double>(29.0, 36.0)(rng); // Many zones ask for water at the start
+    drying[i] = std::uniform_real_distribution<double>(4.0, 10.0)(rng);
+  }
+  simConfig.quiet = true;
+  simConfig.relayPin = PUMP_MAX_ZONES; // Keeps the sketch's soil model away from the zone relays
+  if (!pumpZonesBegin(table.data(), count, simConfig.zoneMaxActive)) {
+    fprintf(stderr, "[host_sim] pumpZonesBegin() failed\n");
+    return 1;
+  }
+  simGpioWatch(count);
+
+  int64_t endUs = (int64_t)simConfig.durationS * 1000000;
+  int64_t lastUs = simNowUs(), nextReadUs = 0;
+  double dryZoneSeconds = 0, wetZoneSeconds = 0;
+  uint64_t manageCalls = 0, manageNs = 0;
+  while (lastUs < endUs) {
+    int64_t now = simNowUs();
+    double dt = (now - lastUs) / 1e6;
+    lastUs = now;
+    for (uint8_t i = 0; i < count; i++) {
+      bool watering = digitalRead(i) == HIGH;
+      moisture[i] += (watering ? simConfig.wateringPerSecond : 0) * dt - drying[i] * dt / 3600.0;
+      dryZoneSeconds += moisture[i] < lower ? dt : 0;
+      wetZoneSeconds += moisture[i] > upper ? dt : 0;
+    }
+    if (now >= nextReadUs) {
+      nextReadUs = now + 5000000;
+      for (uint8_t i = 0; i < count; i++) {
+        pumpZoneUpdate(i, (uint8_t)std::min(100.0, std::max(0.0, moisture[i])));
+      }
+    }
+    auto start = std::chrono::steady_clock::now();
+    manageWaterPumpCycle();
+    manageNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    manageCalls++;
+    delay(1);
+  }
+
+  PumpZoneStats stats = pumpZonesGetStats();
+  uint8_t maxHigh = simGpioPeakHigh();
+  double zoneHours = (double)count * simConfig.durationS / 3600.0;
+  printf("zones %u, max pumps %u, %.1f virtual h\n", count, simConfig.zoneMaxActive, simConfig.durationS / 3600.0);
+  printf("cycles %u, peak active %u (relays HIGH at once: %u), max wait %.1f s\n", stats.cycles, stats.peakActive, maxHigh,
+         stats.maxWaitMs / 1000.0);
+  printf("below %u%%: %.2f zone-h (%.2f%%), above %u%%: %.2f zone-h\n", lower, dryZoneSeconds / 3600.0,
+         100.0 * dryZoneSeconds / 3600.0 / zoneHours, upper, wetZoneSeconds / 3600.0);
+  printf("manageWaterPumpCycle(): %llu calls, %.0f ns per call\n", (unsigned long long)manageCalls,
+         manageCalls > 0 ? (double)manageNs / manageCalls : 0.0);
+  bool capHeld = maxHigh <= simConfig.zoneMaxActive && stats.peakActive <= simConfig.zoneMaxActive;
+  printf("%s\n", capHeld ? "PASS: pump cap held" : "FAIL: more pumps ran than allowed");
+  fflush(stdout);
+  return capHeld ? 0 : 1;
+}
+
+/**
+ * @brief Runs the trace through the sketch's moisture filter in bursts of MOISTURE_ADC_BURST samples, as moisture_adc.cpp
+ *        does with the DMA frames. The soil of the trace is steady, so its median raw value is the reference: after every
+ *        burst the filtered value must be within 1 % moisture of it, and must not cross lowerMoistureThreshold (30 %,
+ *        DRY_VALUE 4095 and WET_VALUE 1300 as in the sketch) on the side the reference is not on.
+ * @return 0 if the filter held.
+ */
+static int runFilterTest() {
+  const long dry = 4095, wet = 1300;
+  const long threshold = 30, tolerance = 1;
+  std::vector<uint16_t> sorted = simConfig.adcTrace;
+  std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+  const uint16_t reference = sorted[sorted.size() / 2];
+  const long referencePercent = map(reference, dry, wet, 0, 100);
+
+  moisture_filter_t filter;
+  moistureFilterReset(filter);
+  uint16_t burst[MOISTURE_ADC_BURST];
+  uint16_t minValue = 4095, maxValue = 0;
+  size_t rawCrossings = 0, filteredCrossings = 0, bursts = 0;
+  for (size_t first = 0; first + MOISTURE_ADC_BURST <= simConfig.adcTrace.size(); first += MOISTURE_ADC_BURST) {
+    for (size_t i = 0; i < MOISTURE_ADC_BURST; i++) {
+      burst[i] = simConfig.adcTrace[first + i];
+      rawCrossings += (map(burst[i], dry, wet, 0, 100) < threshold) != (referencePercent < threshold);
+    }
+    moistureFilterAddBurst(filter, burst, MOISTURE_ADC_BURST);
+    uint16_t value = moistureFilterValue(filter);
+    minValue = std::min(minValue, value);
+    maxValue = std::max(maxValue, value);
+    filteredCrossings += (map(value, dry, wet, 0, 100) < threshold) != (referencePercent < threshold);
+    bursts++;
+  }
+
+  // A higher raw value is drier soil
+  long lowPercent = map(maxValue, dry, wet, 0, 100), highPercent = map(minValue, dry, wet, 0, 100);
+  const long toleranceCounts = tolerance * (dry - wet) / 100;
+  bool withinTolerance = maxValue - reference <= toleranceCounts && reference - minValue <= toleranceCounts;
+  printf("%zu bursts of %u samples, reference %u (%ld%%), watering threshold %ld%%\n", bursts, MOISTURE_ADC_BURST,
+         reference, referencePercent, threshold);
+  printf("filtered %u..%u (%ld..%ld%%), noise estimate %.1f counts\n", minValue, maxValue, lowPercent, highPercent, filter.noise);
+  printf("across the threshold: %zu raw samples, %zu filtered values\n", rawCrossings, filteredCrossings);
+  bool ok = bursts > 0 && withinTolerance && filteredCrossings == 0;
+  printf("%s\n", ok ? "PASS: the filtered value stayed within 1% and on its side of the threshold"
+                     : "FAIL: the filtered value moved too far or crossed the threshold");
+  fflush(stdout);
+  return ok ? 0 : 1;
+}
+
+/**
+ * @brief Starts a watering and then blocks the caller for S virtual seconds, as WiFi.begin(), an SD write or an upload
+ *        blocks the sketch's loop(), before it calls manageWaterPumpCycle() again. The esp_timer task must still switch
+ *        the relay off after pumpOnTime: getLastPumpOnTimeUs() has to match it within the time the timer task can be
+ *        late: 20 host ms at --speed (a host thread can be scheduled that late on a busy machine), and at least 50
+ *        virtual ms. A relay left on until loop() runs again is off by the whole stall, seconds longer.
+ * @return 0 if every watering stopped on time.
+ */
+static int runStallTest() {
+  const unsigned int onTime = 1000, soakTime = 20000; // The sketch's pumpOnTime and pumpSoakTime
+  const int cycles = 3;
+  const int64_t toleranceUs = std::max<int64_t>(50000, (int64_t)(simConfig.speed * 20000));
+  simConfig.quiet = true;
+  InitWaterPump(simConfig.relayPin, onTime, soakTime);
+
+  bool onTimeKept = true;
+  for (int i = 0; i < cycles; i++) {
+    startWaterPumpCycle();
+    bool started = digitalRead(simConfig.relayPin) == HIGH;
+    delay(simConfig.stallTestS * 1000); // loop() blocked
+    bool offAfterStall = simConfig.stallTestS * 1000 <= onTime || digitalRead(simConfig.relayPin) == LOW;
+    manageWaterPumpCycle();
+    while (getPumpState() != IDLE) { // Let the cycle finish before the next one
+      manageWaterPumpCycle();
+      delay(100);
+    }
+    int64_t errorUs = (int64_t)getLastPumpOnTimeUs() - (int64_t)onTime * 1000;
+    bool ok = started && offAfterStall && llabs(errorUs) <= toleranceUs;
+    printf("cycle %d: loop() blocked %u s, relay ON for %.1f ms (pumpOnTime %u ms, tolerance %.1f ms)%s\n", i + 1,
+           simConfig.stallTestS, getLastPumpOnTimeUs() / 1000.0, onTime, toleranceUs / 1000.0, ok ? "" : " <- late");
+    onTimeKept = onTimeKept && ok;
+  }
+  printf("%s\n", onTimeKept ? "PASS: the pump stopped on time while loop() was blocked" : "FAIL: the pump ran on while loop() was blocked");
+  fflush(stdout);
+  return onTimeKept ? 0 : 1;
+}
+
+//-----------------------MAIN--------------------------
+
+int main(int argc, char** argv) {
+  if (!parseArgs(argc, argv)) {
+    usage(argv[0]);
+    return 2;
+  }
+  if (!simConfig.sdBench.empty()) {
+    return runSdBenchmark();
+  }
+  if (simConfig.tuneDays > 0) {
+    return runTuning();
+  }
+  if (simConfig.modelTestDays > 0) {
+    return runModelTest();
+  }
+  if (!simConfig.storageTest.empty()) {
+    return runStorageTest();
+  }
+  if (simConfig.schedulerTestSteps > 0) {
+    return runSchedulerTest();
+  }
+  if (simConfig.zoneTest > 0) {
+    _exit(runZoneTest()); // The timers' task never returns
+  }
+  if (simConfig.filterTest) {
+    return runFilterTest();
+  }
+  if (simConfig.stallTestS > 0) {
+    _exit(runStallTest());
+  }
+  fprintf(stderr, "[host_sim] %u virtual s at %.0fx, SD card in %s\n", simConfig.durationS, simConfig.speed, simConfig.sdRoot.c_str());
+
+  setup();
+  int64_t endUs = (int64_t)simConfig.durationS * 1000000;
+  uint32_t loops = 0;
+  while (simNowUs() < endUs) {
+    loop();
+    loops++;
+    delay(1); // The board's loop task spins freely; one virtual millisecond keeps the host CPU for the other tasks
+  }
+
+  fprintf(stderr, "[host_sim] Done: %u loop() iterations in %.1f virtual s\n", loops, simNowUs() / 1e6);
+  if (!simConfig.metricsOut.empty()) {
+    FILE* out = simConfig.metricsOut == "-" ? stdout : fopen(simConfig.metricsOut.c_str(), "w");
+    if (out == NULL || !simHttpGet("/metrics", out)) {
+      fprintf(stderr, "[host_sim] /metrics not available (is WiFi up at boot?)\n");
+    }
+    if (out != NULL && out != stdout) {
+      fclose(out);
+    }
+  }
+  if (!simConfig.lcdDump.empty() && !simLcdDump(simConfig.lcdDump.c_str())) {
+    fprintf(stderr, "[host_sim] Cannot write %s\n", simConfig.lcdDump.c_str());
+  }
+  fflush(stdout);
+  _exit(0); // The sketch's tasks never return, leave without running the destructors under them
+}
@@ -0,0 +1,148 @@
+/**
+ * scheduler_test.cpp
+ *
+ * Stress check of task_scheduler.cpp. The stepped clock starts 5 s before millis() wraps around at 2^32 ms, and
+ * advances by random steps: to the wake-up time the scheduler reports (as schedulerIdle() would sleep), by a few
+ * milliseconds (a busy loop()), or by up to 33 minutes at once (loop() blocked, many cascades of the wheel due together).
+ * The periods of the tasks sit on both sides of the slot sizes of each wheel level (1 ms, 256 ms, 16.4 s, 17.5 min) and
+ * beyond the wheel's range, and a one-shot task comes and goes. An independent model of each task's next deadline
+ * checks after every step that:
+ *   - schedulerNextWakeMs() is the time to the earliest deadline of the model;
+ *   - no task runs before its deadline, and the tasks of one schedulerRun() run in deadline order;
+ *   - after schedulerRun(), no task of the model is still due.
+ * Before schedulerBegin(), schedulerRun() must run nothing and schedulerAdd() must fail.
+ *
+ * Author: John Leung
+ * Date: October 16, 2026
+ */
+#include "scheduler_test.h"
+#include "Arduino.h"
+#include "task_scheduler.h"
+#include <random>
+
+// The model of one task: its next deadline in millis() and its period, id -1 when it is not registered
+typedef struct {
+  uint32_t deadline;
+  uint32_t period;
+  int id;
+} expected_task_t;
+
+static expected_task_t expected[SCHEDULER_MAX_TASKS];
+static uint32_t lastRunDeadline = 0;
+static uint32_t runs = 0;
+static uint32_t failures = 0;
+
+#define FAIL(...) \
+  do { \
+    if (failures++ < 10) { \
+      printf("  check failed: " __VA_ARGS__); \
+    } \
+  } while (0)
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+/**
+ * @brief The task function: checks the run against the model and moves the model to the next deadline. A periodic
+ *        task that is late by more than a period runs once, and its next deadline is the first one after now.
+ */
+static void checkRun(void* arg) {
+  expected_task_t& task = *(expected_task_t*)arg;
+  uint32_t now = millis();
+  if ((int32_t)(now - task.deadline) < 0) {
+    FAIL("task %d ran %d ms early at %u\n", task.id, (int)(task.deadline - now), now);
+  }
+  if ((int32_t)(task.deadline - lastRunDeadline) < 0) {
+    FAIL("task %d (deadline %u) ran after a task with deadline %u\n", task.id, task.deadline, lastRunDeadline);
+  }
+  lastRunDeadline = task.deadline;
+  runs++;
+  if (task.period == 0) {
+    task.id = -1;
+    return;
+  }
+  task.deadline += task.period;
+  while ((int32_t)(now - task.deadline) >= 0) {
+    task.deadline += task.period;
+  }
+}
+
+/**
+ * @brief Time to the earliest deadline of the model, as schedulerNextWakeMs() should report it.
+ */
+static uint32_t expectedWakeMs() {
+  uint32_t wake = UINT32_MAX;
+  uint32_t now = millis();
+  for (const expected_task_t& task : expected) {
+    if (task.id >= 0) {
+      int32_t left = (int32_t)(task.deadline - now);
+      wake = std::min(wake, left > 0 ? (uint32_t)left : 0);
+    }
+  }
+  return wake;
+}
+
+static void addTask(expected_task_t& task, const char* name, uint32_t period, uint32_t delayMs) {
+  task = {(uint32_t)(millis() + delayMs), period, 0};
+  task.id = schedulerAdd(name, checkRun, &task, period, delayMs);
+  if (task.id < 0) {
+    FAIL("schedulerAdd() refused %s\n", name);
+  }
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+int runSchedulerTest() {
+  const uint32_t periods[SCHEDULER_MAX_TASKS - 1] = {1,        7,        50,       255,     256,
+                                                    257,      1000,     16383,    16384,   70000,
+                                                    1048576,  3600000,  67108863, 67108864, 144000000};
+  std::mt19937 rng(1);
+  simConfig.quiet = true;
+  simSteppedUs = (int64_t)(0xFFFF0000u - 5000) * 1000; // millis() wraps after ~65 s
+  const uint32_t startMs = millis();
+
+  // Before schedulerBegin() the zero-initialised wheel must not be walked: nothing runs and nothing can be added
+  if (schedulerRun() != 0 || schedulerNextWakeMs() != UINT32_MAX || schedulerAdd("early", checkRun, NULL, 1) >= 0) {
+    FAIL("the scheduler ran or accepted a task before schedulerBegin()\n");
+  }
+
+  schedulerBegin();
+  for (uint8_t i = 0; i < SCHEDULER_MAX_TASKS - 1; i++) {
+    addTask(expected[i], "periodic", periods[i], rng() % 200000);
+  }
+  expected_task_t& oneShot = expected[SCHEDULER_MAX_TASKS - 1];
+  addTask(oneShot, "one-shot", 0, rng() % 200000);
+
+  uint64_t virtualMs = 0;
+  for (uint32_t step = 0; step < simConfig.schedulerTestSteps; step++) {
+    uint32_t wake = schedulerNextWakeMs();
+    uint32_t expectedWake = expectedWakeMs();
+    if (wake != expectedWake) {
+      FAIL("schedulerNextWakeMs() %u, expected %u at %u (step %u)\n", wake, expectedWake, (uint32_t)millis(), step);
+    }
+
+    uint32_t choice = rng() % 10;
+    uint32_t advance = choice < 6 ? std::min(wake, (uint32_t)100000000) : choice < 9 ? rng() % 300 : rng() % 2000000;
+    simAdvanceToUs(simNowUs() + (int64_t)advance * 1000);
+    virtualMs += advance;
+    lastRunDeadline = millis() - 0x7FFFFFFF;
+    schedulerRun();
+
+    for (const expected_task_t& task : expected) {
+      if (task.id >= 0 && (int32_t)(millis() - task.deadline) >= 0) {
+        FAIL("task %d with deadline %u not run at %u\n", task.id, task.deadline, (uint32_t)millis());
+      }
+    }
+    if (oneShot.id < 0 && rng() % 1000 == 0) {
+      addTask(oneShot, "one-shot", 0, rng() % 20000000);
+    }
+  }
+
+  bool wrapped = millis() < startMs || virtualMs > UINT32_MAX;
+  printf("%u steps over %.1f virtual days (millis() from %u to %u%s), %u task runs\n", simConfig.schedulerTestSteps,
+         virtualMs / 86400000.0, startMs, (uint32_t)millis(), wrapped ? ", wrapped" : "", runs);
+  bool ok = failures == 0 && wrapped && runs > 0;
+  printf("%s\n", ok ? "PASS: every task ran in order at or after its deadline, and the wake-up times were exact"
+                    : failures > 0 ? "FAIL: see the failed checks above" : "FAIL: too few steps to wrap millis()");
+  fflush(stdout);
+  return ok ? 0 : 1;
+}
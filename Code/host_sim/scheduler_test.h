@@ -0,0 +1,19 @@
+/**
+ * scheduler_test.h
+ *
+ * Stress check of the sketch's timer-wheel scheduler on the stepped clock, see scheduler_test.cpp.
+ *
+ * Author: John Leung
+ * Date: October 16, 2026
+ */
+#ifndef HOST_SIM_SCHEDULER_TEST_H
+#define HOST_SIM_SCHEDULER_TEST_H
+
+/**
+ * @brief Runs simConfig.schedulerTestSteps random clock steps against task_scheduler.cpp and prints the first failed
+ *        checks and a PASS or FAIL line on stdout.
+ * @return 0 if every check passed.
+ */
+int runSchedulerTest();
+
+#endif
@@ -0,0 +1,199 @@
+/**
+ * Arduino.h - host shim of the Arduino ESP32 core for the Linux build (see Code/host_sim/README.md).
+ *
+ * Provides the Arduino API (time, GPIO, Serial, String, Print/Stream), the ESP object, PSRAM helpers and the subset of
+ * FreeRTOS used by the sketch modules. Time is virtual, see sim.h.
+ */
+#ifndef HOST_SIM_ARDUINO_H
+#define HOST_SIM_ARDUINO_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <sys/time.h>
+#include <time.h>
+#include <ctime>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include "WString.h"
+#include "freertos_shim.h"
+#include "sim.h"
+
+// Like the ESP32 core (esp32-hal.h), min() and max() are the std templates, both arguments of the same type
+using std::min;
+using std::max;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define LOW    0
+#define HIGH   1
+#define INPUT  0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define IRAM_ATTR
+#define PROGMEM
+
+#ifndef constrain
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#endif
+
+typedef int esp_err_t;
+#define ESP_OK   0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_NOT_FOUND 0x105
+#define ESP_ERR_TIMEOUT 0x107
+
+#ifndef BIT0
+#define BIT0 0x00000001
+#define BIT1 0x00000002
+#define BIT2 0x00000004
+#define BIT3 0x00000008
+#endif
+
+// --- Time (virtual, see sim.h) ---
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+// time() returns the virtual wall clock (NTP is "synchronised" at the start of the run)
+time_t simTime(time_t* t);
+#define time(t) simTime(t)
+void configTime(long gmtOffsetSec, int daylightOffsetSec, const char* server1, const char* server2 = NULL, const char* server3 = NULL);
+
+// --- GPIO and ADC (analogRead() of the sensor pin reads the soil model) ---
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+uint16_t analogRead(uint8_t pin);
+void analogReadResolution(uint8_t bits);
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+inline bool isDigit(int c) { return isdigit(c) != 0; }
+long random(long max);
+long random(long min, long max);
+
+// --- Memory ---
+bool psramFound();
+void* ps_malloc(size_t size);
+void* ps_calloc(size_t n, size_t size);
+
+#ifndef __GLIBC_PREREQ
+#define __GLIBC_PREREQ(a, b) 0
+#endif
+#if !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char* dst, const char* src, size_t size);
+#endif
+
+// --- Print / Stream ---
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buf, size_t size) {
+      size_t n = 0;
+      while (size--) n += write(*buf++);
+      return n;
+    }
+    size_t write(const char* s) { return s != NULL ? write((const uint8_t*)s, strlen(s)) : 0; }
+    virtual void flush() {}
+
+    size_t print(const char* s) { return write(s); }
+    size_t print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char v, int base = 10) { return print((unsigned long)v, base); }
+    size_t print(int v, int base = 10) { return print((long)v, base); }
+    size_t print(unsigned int v, int base = 10) { return print((unsigned long)v, base); }
+    size_t print(long v, int base = 10) { return print(String(v, (unsigned char)base)); }
+    size_t print(unsigned long v, int base = 10) { return print(String(v, (unsigned char)base)); }
+    size_t print(long long v) { return print(String(v)); }
+    size_t print(unsigned long long v) { return print(String(v)); }
+    size_t print(double v, int decimals = 2) { return print(String(v, (unsigned int)decimals)); }
+    template <typename T> size_t println(const T& v) { size_t n = print(v); return n + println(); }
+    template <typename T> size_t println(const T& v, int f) { size_t n = print(v, f); return n + println(); }
+    size_t println() { return write((const uint8_t*)"\r\n", 2); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+      char buf[256];
+      va_list args;
+      va_start(args, format);
+      int len = vsnprintf(buf, sizeof(buf), format, args);
+      va_end(args);
+      if (len < 0) return 0;
+      if ((size_t)len < sizeof(buf)) return write((const uint8_t*)buf, len);
+      char* big = (char*)malloc(len + 1);
+      va_start(args, format);
+      vsnprintf(big, len + 1, format, args);
+      va_end(args);
+      size_t n = write((const uint8_t*)big, len);
+      free(big);
+      return n;
+    }
+};
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual size_t readBytes(char* buffer, size_t length) {
+      size_t n = 0;
+      while (n < length) {
+        int c = read();
+        if (c < 0) break;
+        buffer[n++] = (char)c;
+      }
+      return n;
+    }
+    size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*)buffer, length); }
+    void setTimeout(unsigned long timeout) { _timeout = timeout; }
+  protected:
+    unsigned long _timeout = 1000;
+};
+
+class HardwareSerial : public Stream {
+  public:
+    void begin(unsigned long baud) { (void)baud; }
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buf, size_t size) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    int peek() override;
+    operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+// --- ESP object ---
+class EspClass {
+  public:
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getHeapSize() { return 320 * 1024; }
+    uint32_t getFreePsram() { return 8 * 1024 * 1024; }
+    // A 240 MHz cycle counter on the host clock, so that cycle timings read in host nanoseconds
+    uint32_t getCpuFreqMHz() { return 240; }
+    uint32_t getCycleCount() {
+      return (uint32_t)(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() * 240 / 1000);
+    }
+    void restart();
+};
+
+extern EspClass ESP;
+
+// Implemented by the sketch
+void setup();
+void loop();
+
+#endif
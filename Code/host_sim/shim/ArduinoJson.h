@@ -0,0 +1,105 @@
+/**
+ * ArduinoJson.h - minimal stand-in for ArduinoJson 7, enough for the Apps Script reply parsed in google_drive.cpp:
+ * a flat JSON object whose values are read as strings. Build with ARDUINOJSON_INC=<ArduinoJson/src> to use the real
+ * library instead (it is header-only and also builds on the host).
+ */
+#ifndef HOST_SIM_ARDUINOJSON_H
+#define HOST_SIM_ARDUINOJSON_H
+
+#include "Arduino.h"
+#include <map>
+
+class DeserializationError {
+  public:
+    enum Code { Ok, InvalidInput };
+    DeserializationError(Code code = Ok) : _code(code) {}
+    explicit operator bool() const { return _code != Ok; }
+    const char* c_str() const { return _code == Ok ? "Ok" : "InvalidInput"; }
+
+  private:
+    Code _code;
+};
+
+class JsonVariantConst {
+  public:
+    explicit JsonVariantConst(const std::string* value) : _value(value) {}
+    template <typename T> T as() const;
+    operator const char*() const { return _value != NULL ? _value->c_str() : NULL; }
+
+  private:
+    const std::string* _value;
+};
+
+template <> inline const char* JsonVariantConst::as<const char*>() const { return _value != NULL ? _value->c_str() : NULL; }
+template <> inline String JsonVariantConst::as<String>() const { return _value != NULL ? String(_value->c_str()) : String(); }
+template <> inline int JsonVariantConst::as<int>() const { return _value != NULL ? atoi(_value->c_str()) : 0; }
+
+class JsonDocument {
+  public:
+    JsonVariantConst operator[](const char* key) const {
+      auto it = _values.find(key);
+      return JsonVariantConst(it != _values.end() ? &it->second : NULL);
+    }
+    void clear() { _values.clear(); }
+
+    std::map<std::string, std::string> _values;
+};
+
+/**
+ * @brief Parses a flat JSON object. Nested objects and arrays are rejected as InvalidInput.
+ */
+inline DeserializationError deserializeJson(JsonDocument& doc, const char* json) {
+  doc.clear();
+  const char* p = json;
+  auto skipSpace = [&p]() { while (*p && isspace((unsigned char)*p)) p++; };
+  auto parseString = [&p](std::string& out) {
+    if (*p != '"') return false;
+    for (p++; *p && *p != '"'; p++) {
+      if (*p == '\\' && p[1]) {
+        p++;
+        switch (*p) {
+          case 'n': out += '\n'; break;
+          case 't': out += '\t'; break;
+          case 'r': out += '\r'; break;
+          case 'u': out += '?'; p += std::min<size_t>(4, strlen(p + 1)); break;
+          default: out += *p; break;
+        }
+      } else {
+        out += *p;
+      }
+    }
+    if (*p != '"') return false;
+    p++;
+    return true;
+  };
+
+  skipSpace();
+  if (*p++ != '{') return DeserializationError::InvalidInput;
+  skipSpace();
+  if (*p == '}') return DeserializationError::Ok;
+  while (true) {
+    std::string key, value;
+    skipSpace();
+    if (!parseString(key)) return DeserializationError::InvalidInput;
+    skipSpace();
+    if (*p++ != ':') return DeserializationError::InvalidInput;
+    skipSpace();
+    if (*p == '"') {
+      if (!parseString(value)) return DeserializationError::InvalidInput;
+    } else {
+      const char* start = p;
+      while (*p && *p != ',' && *p != '}' && !isspace((unsigned char)*p)) p++;
+      if (p == start || *start == '{' || *start == '[') return DeserializationError::InvalidInput;
+      value.assign(start, p - start);
+    }
+    doc._values[key] = value;
+    skipSpace();
+    if (*p == ',') { p++; continue; }
+    if (*p == '}') return DeserializationError::Ok;
+    return DeserializationError::InvalidInput;
+  }
+}
+
+inline DeserializationError deserializeJson(JsonDocument& doc, const String& json) { return deserializeJson(doc, json.c_str()); }
+
+#endif
@@ -0,0 +1,75 @@
+/**
+ * HTTPClient.h - host shim of the Arduino ESP32 HTTPClient: HTTP/1.1 over WiFiClient, Content-Length bodies,
+ * keep-alive with setReuse(), collected response headers. Enough for google_drive.cpp, thingspeak_batch.cpp and the
+ * local stand-ins in Code/tools.
+ */
+#ifndef HOST_SIM_HTTPCLIENT_H
+#define HOST_SIM_HTTPCLIENT_H
+
+#include "Arduino.h"
+#include "WiFiClient.h"
+#include <map>
+
+#define HTTPC_ERROR_CONNECTION_REFUSED  (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED  (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED       (-4)
+#define HTTPC_ERROR_CONNECTION_LOST     (-5)
+#define HTTPC_ERROR_NO_HTTP_SERVER      (-7)
+#define HTTPC_ERROR_READ_TIMEOUT        (-11)
+
+typedef enum {
+  HTTP_CODE_OK = 200,
+  HTTP_CODE_ACCEPTED = 202,
+  HTTP_CODE_MOVED_PERMANENTLY = 301,
+  HTTP_CODE_FOUND = 302,
+  HTTP_CODE_BAD_REQUEST = 400,
+  HTTP_CODE_UNAUTHORIZED = 401,
+  HTTP_CODE_NOT_FOUND = 404,
+  HTTP_CODE_INTERNAL_SERVER_ERROR = 500
+} t_http_codes;
+
+class HTTPClient {
+  public:
+    ~HTTPClient() { end(); }
+    bool begin(WiFiClient& client, const String& url);
+    bool begin(const String& url);
+    void end();
+    void setReuse(bool reuse) { _reuse = reuse; }
+    void setTimeout(uint16_t timeoutMs) { _timeoutMs = timeoutMs; }
+    void setConnectTimeout(int32_t timeoutMs) {}
+    void addHeader(const String& name, const String& value) { _requestHeaders += name + ": " + value + "\r\n"; }
+    void collectHeaders(const char* headerKeys[], size_t count);
+    String header(const char* name);
+
+    int GET() { return sendRequest("GET"); }
+    int POST(const String& payload) { return sendRequest("POST", (uint8_t*)payload.c_str(), payload.length()); }
+    int POST(uint8_t* payload, size_t size) { return sendRequest("POST", payload, size); }
+    int sendRequest(const char* type, uint8_t* payload = NULL, size_t size = 0);
+    int sendRequest(const char* type, const String& payload) { return sendRequest(type, (uint8_t*)payload.c_str(), payload.length()); }
+    int sendRequest(const char* type, Stream* stream, size_t size);
+
+    String getString();
+    int getSize() { return _contentLength; }
+    WiFiClient* getStreamPtr() { return _client; }
+
+  private:
+    int sendHeader(const char* type, size_t size);
+    int readResponse();
+    bool readLine(String& line);
+
+    WiFiClient* _client = NULL;
+    WiFiClient* _ownClient = NULL;   // Created by begin(url)
+    String _host;
+    uint16_t _port = 80;
+    String _path;
+    bool _reuse = true;
+    bool _canReuse = false;
+    uint16_t _timeoutMs = 5000;
+    String _requestHeaders;
+    std::map<std::string, String> _collect;   // Lower-case header name -> value
+    int _contentLength = -1;
+    bool _bodyRead = false;
+};
+
+#endif
@@ -0,0 +1,9 @@
+/**
+ * LGFX_AUTODETECT.hpp - host shim, the panel is always the one configured by LGFX_Custom.
+ */
+#ifndef HOST_SIM_LGFX_AUTODETECT_HPP
+#define HOST_SIM_LGFX_AUTODETECT_HPP
+
+#include "LovyanGFX.hpp"
+
+#endif
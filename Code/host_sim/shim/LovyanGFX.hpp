@@ -0,0 +1,262 @@
+/**
+ * LovyanGFX.hpp - host shim of the LovyanGFX subset used by LGFX_ESP32_ST7789.cpp. The panel is a memory framebuffer
+ * that simLcdDump() writes as a PPM file.
+ *
+ * Pixels are stored like a 16-bit LovyanGFX sprite (RGB565, byte-swapped), so code that fills sprite buffers directly
+ * behaves as on the board. Text is not rasterised: print()/printf() record the strings with their position, and the
+ * LCD dump lists them next to the image. Pixels copied from a sprite's buffer to its parent panel with pushImage() or
+ * pushImageDMA() carry along the sprite's text inside the rectangle, as if it had been rasterised into them.
+ */
+#ifndef HOST_SIM_LOVYANGFX_HPP
+#define HOST_SIM_LOVYANGFX_HPP
+
+#include "Arduino.h"
+#include <string>
+#include <vector>
+
+#define SPI2_HOST 1
+#define SPI3_HOST 2
+#define SPI_DMA_CH_AUTO 3
+
+namespace lgfx {
+
+struct IFont {
+  const char* name;
+  uint8_t height;
+};
+
+namespace fonts {
+extern const IFont Font0;
+extern const IFont Font2;
+extern const IFont Font4;
+extern const IFont DejaVu12;
+extern const IFont DejaVu18;
+extern const IFont DejaVu24;
+extern const IFont DejaVu40;
+extern const IFont DejaVu56;
+extern const IFont DejaVu72;
+}  // namespace fonts
+
+// Pixel in the 16-bit sprite format: RGB565 with its bytes swapped
+struct swap565_t {
+  uint16_t raw;
+};
+
+// Text drawn with print()/printf()
+struct TextItem {
+  int32_t x;
+  int32_t y;
+  uint32_t color;
+  std::string text;
+};
+
+class Bus_SPI {
+  public:
+    struct config_t {
+      int spi_host = SPI2_HOST;
+      uint8_t spi_mode = 0;
+      uint32_t freq_write = 16000000;
+      uint32_t freq_read = 8000000;
+      bool spi_3wire = true;
+      bool use_lock = true;
+      int dma_channel = SPI_DMA_CH_AUTO;
+      int16_t pin_sclk = -1;
+      int16_t pin_mosi = -1;
+      int16_t pin_miso = -1;
+      int16_t pin_dc = -1;
+    };
+    config_t config() const { return _cfg; }
+    void config(const config_t& cfg) { _cfg = cfg; }
+
+  private:
+    config_t _cfg;
+};
+
+class Panel_Device {
+  public:
+    struct config_t {
+      int16_t pin_cs = -1;
+      int16_t pin_rst = -1;
+      int16_t pin_busy = -1;
+      uint16_t memory_width = 240;
+      uint16_t memory_height = 320;
+      uint16_t panel_width = 240;
+      uint16_t panel_height = 320;
+      uint16_t offset_x = 0;
+      uint16_t offset_y = 0;
+      uint8_t offset_rotation = 0;
+      uint8_t dummy_read_pixel = 8;
+      uint8_t dummy_read_bits = 1;
+      bool readable = true;
+      bool invert = false;
+      bool rgb_order = false;
+      bool dlen_16bit = false;
+      bool bus_shared = true;
+    };
+    virtual ~Panel_Device() {}
+    config_t config() const { return _cfg; }
+    void config(const config_t& cfg) { _cfg = cfg; }
+    void setBus(Bus_SPI* bus) { _bus = bus; }
+
+  protected:
+    config_t _cfg;
+    Bus_SPI* _bus = NULL;
+};
+
+class Panel_ST7789 : public Panel_Device {};
+
+class Light_PWM {
+  public:
+    struct config_t {
+      int16_t pin_bl = -1;
+      bool invert = false;
+      uint32_t freq = 12000;
+      uint8_t pwm_channel = 7;
+    };
+    config_t config() const { return _cfg; }
+    void config(const config_t& cfg) { _cfg = cfg; }
+
+  private:
+    config_t _cfg;
+};
+
+/**
+ * @brief Drawing on a 16-bit pixel buffer, shared by the panel and the sprites.
+ */
+class LGFXBase {
+  public:
+    virtual ~LGFXBase() {}
+
+    static uint16_t color565(uint8_t r, uint8_t g, uint8_t b) { return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3); }
+    static uint32_t color888(uint8_t r, uint8_t g, uint8_t b) { return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b; }
+
+    int32_t width() const { return _width; }
+    int32_t height() const { return _height; }
+    void* getBuffer() { return _buffer.empty() ? NULL : _buffer.data(); }
+    uint8_t getColorDepth() const { return 16; }
+
+    void startWrite() {}
+    void endWrite() {}
+
+    // uint32_t colours are RGB888, uint16_t colours are RGB565 (as in LovyanGFX)
+    void drawPixel(int32_t x, int32_t y, uint32_t color) { writePixel(x, y, swap565(from888(color))); }
+    void drawPixel(int32_t x, int32_t y, uint16_t color) { writePixel(x, y, swap565(color)); }
+    void drawPixel(int32_t x, int32_t y, int color) { drawPixel(x, y, (uint32_t)color); }
+    void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color);
+    void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t color);
+    void fillScreen(uint32_t color) { fillRect(0, 0, _width, _height, color); }
+    void fillScreen(uint16_t color) { fillRect(0, 0, _width, _height, color); }
+    void drawFastHLine(int32_t x, int32_t y, int32_t w, uint32_t color) { fillRect(x, y, w, 1, color); }
+    void drawFastVLine(int32_t x, int32_t y, int32_t h, uint32_t color) { fillRect(x, y, 1, h, color); }
+    void drawRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color);
+    void drawLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint32_t color);
+    // Copies w x h pixels of byte-swapped RGB565 (the sprite buffer format)
+    void pushImage(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t* data);
+    void pushImage(int32_t x, int32_t y, int32_t w, int32_t h, const swap565_t* data) { pushImage(x, y, w, h, (const uint16_t*)data); }
+    void pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t* data) { pushImage(x, y, w, h, data); }
+    void pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h, const swap565_t* data) { pushImage(x, y, w, h, data); }
+    void waitDMA() {}
+    // Drawing is limited to the clip rectangle (the whole buffer by default)
+    void setClipRect(int32_t x, int32_t y, int32_t w, int32_t h);
+    void clearClipRect() { setClipRect(0, 0, _width, _height); }
+
+    void setFont(const IFont* font) { _font = font; }
+    const IFont* getFont() const { return _font; }
+    void setTextColor(uint32_t color) { _textColor = color; }
+    void setTextColor(uint32_t color, uint32_t background) { _textColor = color; }
+    void setCursor(int32_t x, int32_t y) { _cursorX = x; _cursorY = y; }
+    int32_t getCursorX() const { return _cursorX; }
+    int32_t getCursorY() const { return _cursorY; }
+    int32_t fontHeight() const { return _font != NULL ? _font->height : 8; }
+    // Proportional fonts approximated as 0.6 x height per character
+    int32_t textWidth(const char* text) const { return (int32_t)(strlen(text) * fontHeight() * 6 / 10); }
+    size_t print(const char* text);
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    size_t vprintf(const char* format, va_list args);
+
+    const std::vector<TextItem>& textItems() const { return _text; }
+
+  protected:
+    static uint16_t from888(uint32_t c) { return color565(c >> 16, c >> 8, c); }
+    static uint16_t swap565(uint16_t c) { return (uint16_t)((c << 8) | (c >> 8)); }
+    void writePixel(int32_t x, int32_t y, uint16_t swapped) {
+      if (x >= _clipX0 && y >= _clipY0 && x < _clipX1 && y < _clipY1) _buffer[y * _width + x] = swapped;
+    }
+    void fillSwapped(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t swapped);
+    void resize(int32_t w, int32_t h);
+    // Text inside the rectangle (and the clip rectangle) is covered by new pixels
+    void coverText(int32_t x, int32_t y, int32_t w, int32_t h);
+    // Called by pushImage() after the pixels of the rectangle are copied
+    virtual void imagePushed(int32_t x, int32_t y, int32_t w, int32_t h) {}
+
+    int32_t _width = 0;
+    int32_t _height = 0;
+    std::vector<uint16_t> _buffer;
+    std::vector<TextItem> _text;
+    const IFont* _font = &fonts::Font0;
+    uint32_t _textColor = 0xFFFFFF;
+    int32_t _cursorX = 0;
+    int32_t _cursorY = 0;
+    int32_t _clipX0 = 0;
+    int32_t _clipY0 = 0;
+    int32_t _clipX1 = 0;
+    int32_t _clipY1 = 0;
+};
+
+class LGFX_Sprite;
+
+class LGFX_Device : public LGFXBase {
+  public:
+    bool init();
+    bool begin() { return init(); }
+    void setPanel(Panel_Device* panel) { _panel = panel; }
+    void setRotation(uint8_t rotation);
+    uint8_t getRotation() const { return _rotation; }
+    void setBrightness(uint8_t brightness) {}
+    // Copies a sprite's pixels (and its text) to the panel
+    void drawSprite(const LGFXBase& sprite, int32_t x, int32_t y);
+    // Sprites created with this panel as parent, whose text pushImage() carries along
+    void addSprite(const LGFXBase* sprite) { _sprites.push_back(sprite); }
+
+  protected:
+    void imagePushed(int32_t x, int32_t y, int32_t w, int32_t h) override;
+
+  private:
+    void carryText(const LGFXBase& sprite, int32_t dx, int32_t dy, int32_t x, int32_t y, int32_t w, int32_t h);
+
+    Panel_Device* _panel = NULL;
+    uint8_t _rotation = 0;
+    std::vector<const LGFXBase*> _sprites;
+    const LGFXBase* _pushing = NULL;  // Sprite being drawn by drawSprite()
+};
+
+class LGFX_Sprite : public LGFXBase {
+  public:
+    LGFX_Sprite() {}
+    explicit LGFX_Sprite(LGFX_Device* parent) : _parent(parent) { parent->addSprite(this); }
+    void* createSprite(int32_t w, int32_t h);
+    void deleteSprite() { resize(0, 0); }
+    void setColorDepth(int bits) {}
+    void pushSprite(int32_t x, int32_t y);
+    void pushSprite(LGFX_Device* dst, int32_t x, int32_t y) { dst->drawSprite(*this, x, y); }
+    // Moves the content of the scroll rectangle (the whole sprite by default) by (dx, dy); the uncovered area is filled
+    // with the base colour
+    void scroll(int32_t dx, int32_t dy = 0);
+    void setScrollRect(int32_t x, int32_t y, int32_t w, int32_t h);
+    void setBaseColor(uint32_t color) { _baseColor = swap565(from888(color)); }
+
+  private:
+    LGFX_Device* _parent = NULL;
+    uint16_t _baseColor = 0;
+    int32_t _scrollX = 0;
+    int32_t _scrollY = 0;
+    int32_t _scrollW = -1;  // -1: the whole sprite
+    int32_t _scrollH = -1;
+};
+
+}  // namespace lgfx
+
+namespace fonts = lgfx::fonts;
+using lgfx::LGFX_Sprite;
+
+#endif
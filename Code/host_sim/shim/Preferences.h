@@ -0,0 +1,33 @@
+/**
+ * Preferences.h - NVS key/value storage of the Arduino ESP32 core on the host: each namespace is a directory under
+ * --nvs (default sim_nvs) and each key a file, so what the sketch stores survives to the next run, as on the board.
+ */
+#ifndef HOST_SIM_PREFERENCES_H
+#define HOST_SIM_PREFERENCES_H
+
+#include "Arduino.h"
+#include <string>
+
+class Preferences {
+  public:
+    bool begin(const char* name, bool readOnly = false, const char* partitionLabel = NULL);
+    void end();
+    bool clear();
+    bool remove(const char* key);
+    bool isKey(const char* key);
+    size_t putUChar(const char* key, uint8_t value);
+    size_t putUInt(const char* key, uint32_t value);
+    size_t putBytes(const char* key, const void* value, size_t len);
+    uint8_t getUChar(const char* key, uint8_t defaultValue = 0);
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0);
+    size_t getBytesLength(const char* key);
+    size_t getBytes(const char* key, void* buf, size_t maxLen);
+
+  private:
+    std::string dir;
+    bool opened = false;
+    bool readOnly = true;
+    std::string path(const char* key) const;
+};
+
+#endif
@@ -0,0 +1,38 @@
+/**
+ * SD_MMC.h - host shim of the ESP32 SD_MMC card. The card is the host directory given with --sd (default ./sim_sd).
+ */
+#ifndef HOST_SIM_SD_MMC_H
+#define HOST_SIM_SD_MMC_H
+
+#include "FS.h"
+
+typedef enum { CARD_NONE, CARD_MMC, CARD_SD, CARD_SDHC, CARD_UNKNOWN } sdcard_type_t;
+
+#define SDMMC_FREQ_DEFAULT   20000
+#define SDMMC_FREQ_HIGHSPEED 40000
+#define SDMMC_FREQ_PROBING   400
+#define SDMMC_FREQ_52M       52000
+#define SDMMC_FREQ_26M       26000
+
+namespace fs {
+
+class SDMMCFS : public FS {
+  public:
+    bool setPins(int clk, int cmd, int d0, int d1 = -1, int d2 = -1, int d3 = -1) { return true; }
+    bool begin(const char* mountpoint = "/sdcard", bool mode1bit = false, bool formatIfMountFailed = false,
+               int sdmmcFrequency = SDMMC_FREQ_DEFAULT, uint8_t maxOpenFiles = 5);
+    void end() {}
+    sdcard_type_t cardType() { return _mounted ? CARD_SDHC : CARD_NONE; }
+    uint64_t cardSize();
+    uint64_t totalBytes();
+    uint64_t usedBytes();
+
+  private:
+    bool _mounted = false;
+};
+
+}  // namespace fs
+
+extern fs::SDMMCFS SD_MMC;
+
+#endif
@@ -0,0 +1,47 @@
+/**
+ * ThingSpeak.cpp - ThingSpeak library shim on the host.
+ */
+#include "ThingSpeak.h"
+#include "HTTPClient.h"
+
+ThingSpeakClass ThingSpeak;
+
+int ThingSpeakClass::setField(unsigned int field, const String& value) {
+  if (field < 1 || field > 8) {
+    return -200;
+  }
+  _fields[field - 1] = value;
+  return TS_OK_SUCCESS;
+}
+
+int ThingSpeakClass::writeFields(unsigned long channelNumber, const char* writeAPIKey) {
+  // Form body as sent by the library (values are already URL-encoded by the caller when needed)
+  String body = String("api_key=") + writeAPIKey;
+  for (int i = 0; i < 8; i++) {
+    if (_fields[i].length() > 0) {
+      body += "&field" + String(i + 1) + "=" + _fields[i];
+      _fields[i] = "";
+    }
+  }
+  if (_createdAt.length() > 0) {
+    body += "&created_at=" + _createdAt;
+    _createdAt = "";
+  }
+
+  if (!simWifiUp()) {
+    _lastStatus = TS_ERR_CONNECT_FAILED;
+  } else if (simConfig.thingspeakServer.empty()) {
+    Serial.printf("[host_sim] ThingSpeak channel %lu: %s\n", channelNumber, body.c_str());
+    _lastStatus = TS_OK_SUCCESS;
+  } else {
+    HTTPClient http;
+    http.begin(String(simConfig.thingspeakServer.c_str()) + "/update");
+    http.addHeader("Content-Type", "application/x-www-form-urlencoded");
+    _lastStatus = http.POST(body);
+    http.end();
+    if (_lastStatus < 0) {
+      _lastStatus = TS_ERR_CONNECT_FAILED;
+    }
+  }
+  return _lastStatus;
+}
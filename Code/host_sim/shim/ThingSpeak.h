@@ -0,0 +1,40 @@
+/**
+ * ThingSpeak.h - host shim of the ThingSpeak library. writeFields() POSTs the fields to <server>/update when
+ * --thingspeak-server is given, otherwise it only prints them and returns 200.
+ */
+#ifndef HOST_SIM_THINGSPEAK_H
+#define HOST_SIM_THINGSPEAK_H
+
+#include "Arduino.h"
+#include "WiFiClient.h"
+
+#define TS_OK_SUCCESS 200
+#define TS_ERR_CONNECT_FAILED (-301)
+
+class ThingSpeakClass {
+  public:
+    bool begin(Client& client) { return true; }
+    int setField(unsigned int field, int value) { return setField(field, String(value)); }
+    int setField(unsigned int field, long value) { return setField(field, String(value)); }
+    int setField(unsigned int field, unsigned int value) { return setField(field, String(value)); }
+    int setField(unsigned int field, unsigned long value) { return setField(field, String(value)); }
+    int setField(unsigned int field, float value) { return setField(field, String(value)); }
+    int setField(unsigned int field, const char* value) { return setField(field, String(value)); }
+    int setField(unsigned int field, const String& value);
+    int setCreatedAt(const char* createdAt) { _createdAt = createdAt; return TS_OK_SUCCESS; }
+    int writeFields(unsigned long channelNumber, const char* writeAPIKey);
+    int writeField(unsigned long channelNumber, unsigned int field, int value, const char* writeAPIKey) {
+      setField(field, value);
+      return writeFields(channelNumber, writeAPIKey);
+    }
+    int getLastReadStatus() { return _lastStatus; }
+
+  private:
+    String _fields[8];
+    String _createdAt;
+    int _lastStatus = TS_OK_SUCCESS;
+};
+
+extern ThingSpeakClass ThingSpeak;
+
+#endif
@@ -0,0 +1,123 @@
+/**
+ * WString.h - host shim of the Arduino String class, backed by std::string.
+ * Only the members used by the sketches are provided.
+ */
+#ifndef HOST_SIM_WSTRING_H
+#define HOST_SIM_WSTRING_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <string>
+
+class String {
+  public:
+    String() {}
+    String(const char* s) : _s(s != NULL ? s : "") {}
+    String(const std::string& s) : _s(s) {}
+    String(char c) : _s(1, c) {}
+    String(int v, unsigned char base = 10) { fromLong(v, base); }
+    String(unsigned int v, unsigned char base = 10) { fromULong(v, base); }
+    String(long v, unsigned char base = 10) { fromLong(v, base); }
+    String(unsigned long v, unsigned char base = 10) { fromULong(v, base); }
+    String(long long v) : _s(std::to_string(v)) {}
+    String(unsigned long long v) : _s(std::to_string(v)) {}
+    String(unsigned char v, unsigned char base = 10) { fromULong(v, base); }
+    String(float v, unsigned int decimals = 2) { fromDouble(v, decimals); }
+    String(double v, unsigned int decimals = 2) { fromDouble(v, decimals); }
+
+    const char* c_str() const { return _s.c_str(); }
+    unsigned int length() const { return _s.length(); }
+    bool reserve(unsigned int size) { _s.reserve(size); return true; }
+    char charAt(unsigned int i) const { return i < _s.length() ? _s[i] : 0; }
+    char operator[](unsigned int i) const { return charAt(i); }
+    char& operator[](unsigned int i) { return _s[i]; }
+    bool isEmpty() const { return _s.empty(); }
+
+    String& operator=(const char* s) { _s = s != NULL ? s : ""; return *this; }
+    String& operator+=(const String& s) { _s += s._s; return *this; }
+    String& operator+=(const char* s) { _s += s != NULL ? s : ""; return *this; }
+    String& operator+=(char c) { _s += c; return *this; }
+    String& operator+=(int v) { return *this += String(v); }
+    String& operator+=(unsigned int v) { return *this += String(v); }
+    String& operator+=(long v) { return *this += String(v); }
+    String& operator+=(unsigned long v) { return *this += String(v); }
+    bool concat(const String& s) { _s += s._s; return true; }
+    bool concat(const char* s, unsigned int len) { _s.append(s, len); return true; }
+
+    bool operator==(const String& s) const { return _s == s._s; }
+    bool operator==(const char* s) const { return _s == (s != NULL ? s : ""); }
+    bool operator!=(const String& s) const { return _s != s._s; }
+    bool operator!=(const char* s) const { return !(*this == s); }
+    bool operator<(const String& s) const { return _s < s._s; }
+    bool equals(const String& s) const { return _s == s._s; }
+    bool equalsIgnoreCase(const String& s) const { return strcasecmp(_s.c_str(), s._s.c_str()) == 0; }
+    bool startsWith(const String& s) const { return _s.compare(0, s._s.length(), s._s) == 0; }
+    bool endsWith(const String& s) const {
+      return _s.length() >= s._s.length() && _s.compare(_s.length() - s._s.length(), s._s.length(), s._s) == 0;
+    }
+
+    int indexOf(char c, unsigned int from = 0) const { return find(_s.find(c, from)); }
+    int indexOf(const String& s, unsigned int from = 0) const { return find(_s.find(s._s, from)); }
+    int lastIndexOf(char c) const { return find(_s.rfind(c)); }
+    int lastIndexOf(const String& s) const { return find(_s.rfind(s._s)); }
+    String substring(unsigned int from) const { return from < _s.length() ? String(_s.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const {
+      if (from > to) { unsigned int t = from; from = to; to = t; }
+      return from < _s.length() ? String(_s.substr(from, to - from)) : String();
+    }
+    void trim() {
+      size_t b = _s.find_first_not_of(" \t\r\n");
+      size_t e = _s.find_last_not_of(" \t\r\n");
+      _s = b == std::string::npos ? "" : _s.substr(b, e - b + 1);
+    }
+    void toLowerCase() { for (char& c : _s) c = tolower(c); }
+    void toUpperCase() { for (char& c : _s) c = toupper(c); }
+    void replace(const String& from, const String& to) {
+      if (from._s.empty()) return;
+      for (size_t p = _s.find(from._s); p != std::string::npos; p = _s.find(from._s, p + to._s.length())) {
+        _s.replace(p, from._s.length(), to._s);
+      }
+    }
+    void remove(unsigned int index, unsigned int count = (unsigned int)-1) { if (index < _s.length()) _s.erase(index, count); }
+    long toInt() const { return strtol(_s.c_str(), NULL, 10); }
+    float toFloat() const { return strtof(_s.c_str(), NULL); }
+    void toCharArray(char* buf, unsigned int size) const { if (size) { strncpy(buf, _s.c_str(), size - 1); buf[size - 1] = 0; } }
+
+    const std::string& str() const { return _s; }
+
+    friend String operator+(const String& a, const String& b) { return String(a._s + b._s); }
+    friend String operator+(const String& a, const char* b) { return String(a._s + (b != NULL ? b : "")); }
+    friend String operator+(const char* a, const String& b) { return String((a != NULL ? a : "") + b._s); }
+    friend String operator+(const String& a, char c) { return String(a._s + c); }
+    friend String operator+(const String& a, int v) { return a + String(v); }
+    friend String operator+(const String& a, unsigned int v) { return a + String(v); }
+    friend String operator+(const String& a, long v) { return a + String(v); }
+    friend String operator+(const String& a, unsigned long v) { return a + String(v); }
+
+  private:
+    static int find(size_t pos) { return pos == std::string::npos ? -1 : (int)pos; }
+    void fromLong(long v, unsigned char base) {
+      if (base == 10) { _s = std::to_string(v); return; }
+      fromULong((unsigned long)v, base);
+    }
+    void fromULong(unsigned long v, unsigned char base) {
+      char buf[72];
+      int i = sizeof(buf) - 1;
+      buf[i] = 0;
+      do { int d = v % base; buf[--i] = d < 10 ? '0' + d : 'A' + d - 10; v /= base; } while (v && i > 0);
+      _s = &buf[i];
+    }
+    void fromDouble(double v, unsigned int decimals) {
+      char buf[64];
+      snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+      _s = buf;
+    }
+
+    std::string _s;
+};
+
+#define F(s) (s)
+
+#endif
@@ -0,0 +1,46 @@
+/**
+ * WiFi.h - host shim of the ESP32 WiFi class. The link is up except during the outages given with --wifi-outage.
+ */
+#ifndef HOST_SIM_WIFI_H
+#define HOST_SIM_WIFI_H
+
+#include "Arduino.h"
+#include "WiFiClient.h"
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum { WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3 } wifi_mode_t;
+
+class IPAddress {
+  public:
+    IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : _a(a), _b(b), _c(c), _d(d) {}
+    String toString() const { return String(_a) + "." + String(_b) + "." + String(_c) + "." + String(_d); }
+    operator String() const { return toString(); }
+  private:
+    uint8_t _a, _b, _c, _d;
+};
+
+class WiFiClass {
+  public:
+    wl_status_t begin(const char* ssid, const char* pass = NULL);
+    wl_status_t status();
+    bool isConnected() { return status() == WL_CONNECTED; }
+    bool disconnect(bool wifiOff = false) { return true; }
+    bool reconnect() { return true; }
+    bool mode(wifi_mode_t m) { return true; }
+    bool setSleep(bool enable) { return true; }
+    int8_t RSSI();
+    IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+    String macAddress() { return "02:00:00:00:00:01"; }
+};
+
+extern WiFiClass WiFi;
+
+#endif
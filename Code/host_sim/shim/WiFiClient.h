@@ -0,0 +1,47 @@
+/**
+ * WiFiClient.h - host shim of the Arduino TCP client, on a POSIX socket. Connections fail while the simulated WiFi is down.
+ */
+#ifndef HOST_SIM_WIFICLIENT_H
+#define HOST_SIM_WIFICLIENT_H
+
+#include "Arduino.h"
+
+class Client : public Stream {
+  public:
+    virtual int connect(const char* host, uint16_t port) = 0;
+    virtual void stop() = 0;
+    virtual uint8_t connected() = 0;
+    virtual operator bool() = 0;
+};
+
+class WiFiClient : public Client {
+  public:
+    WiFiClient() {}
+    virtual ~WiFiClient() { stop(); }
+    int connect(const char* host, uint16_t port) override;
+    int connect(const char* host, uint16_t port, int32_t timeoutMs) { return connect(host, port); }
+    void stop() override;
+    uint8_t connected() override;
+    operator bool() override { return _fd >= 0; }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buf, size_t size) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    int read(uint8_t* buf, size_t size);
+    int peek() override;
+    void setTimeout(uint32_t seconds) { _timeoutMs = seconds * 1000; }
+    void setNoDelay(bool noDelay) {}
+
+  protected:
+    bool fill(int waitMs);   // Reads what the socket has into the buffer, waiting up to waitMs (host time)
+
+    int _fd = -1;
+    uint8_t _buf[1460];
+    size_t _bufPos = 0;
+    size_t _bufLen = 0;
+    uint32_t _timeoutMs = 30000;
+};
+
+#endif
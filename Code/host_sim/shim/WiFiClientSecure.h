@@ -0,0 +1,19 @@
+/**
+ * WiFiClientSecure.h - host shim. There is no TLS in the host build: connect() fails, so https uploads take the failure
+ * path (spool, retry), unless --tls-standin host:port is given. Then every https connection goes in plain text to that
+ * address, e.g. Code/tools/apps_script_standin.py, to exercise the success path with the unmodified webAppUrl.
+ */
+#ifndef HOST_SIM_WIFICLIENTSECURE_H
+#define HOST_SIM_WIFICLIENTSECURE_H
+
+#include "WiFiClient.h"
+
+class WiFiClientSecure : public WiFiClient {
+  public:
+    void setInsecure() {}
+    void setCACert(const char* rootCA) {}
+    void setHandshakeTimeout(unsigned long seconds) {}
+    int connect(const char* host, uint16_t port) override;
+};
+
+#endif
@@ -0,0 +1,158 @@
+/**
+ * adc_continuous.cpp - ADC continuous driver on the host: a thread fills one frame of conversion results every
+ * frame period of virtual time with simAdcSample(), keeps up to max_store_buf_size bytes for adc_continuous_read() and
+ * calls on_conv_done (or on_pool_ovf when the reader is late), as the DMA interrupt does on the board.
+ */
+#include "esp_adc/adc_continuous.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct adc_continuous_ctx_t {
+  uint32_t storeBytes;
+  uint32_t frameBytes;
+  adc_continuous_config_t config;
+  std::vector<adc_digi_pattern_config_t> patterns;
+  adc_continuous_evt_cbs_t callbacks = {NULL, NULL};
+  void* userData = NULL;
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::deque<uint8_t> pool;
+  std::atomic<bool> running{false};
+  std::thread thread;
+};
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+/**
+ * @brief Fills one frame, converting the pattern entries in turn. ADC1 channel n is GPIO n + 1 on the ESP32-S3.
+ */
+static void fillFrame(adc_continuous_ctx_t* ctx, std::vector<uint8_t>& frame, size_t& patternNext) {
+  for (size_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= frame.size(); i += SOC_ADC_DIGI_RESULT_BYTES) {
+    const adc_digi_pattern_config_t& pattern = ctx->patterns[patternNext];
+    patternNext = (patternNext + 1) % ctx->patterns.size();
+    adc_digi_output_data_t result;
+    result.val = 0;
+    result.type2.data = simAdcSample(pattern.channel + 1);
+    result.type2.channel = pattern.channel;
+    result.type2.unit = pattern.unit;
+    memcpy(&frame[i], &result, SOC_ADC_DIGI_RESULT_BYTES);
+  }
+}
+
+static void conversionThread(adc_continuous_ctx_t* ctx) {
+  int64_t frameUs = (int64_t)(ctx->frameBytes / SOC_ADC_DIGI_RESULT_BYTES) * 1000000 / ctx->config.sample_freq_hz;
+  int64_t deadline = simNowUs();
+  std::vector<uint8_t> frame(ctx->frameBytes);
+  size_t patternNext = 0;
+  while (ctx->running) {
+    deadline += frameUs;
+    simSleepUs(deadline - simNowUs());
+    fillFrame(ctx, frame, patternNext);
+    adc_continuous_evt_data_t event = {frame.data(), (uint32_t)frame.size()};
+    bool stored = false;
+    {
+      std::lock_guard<std::mutex> lock(ctx->mutex);
+      if (ctx->pool.size() + frame.size() <= ctx->storeBytes) {
+        ctx->pool.insert(ctx->pool.end(), frame.begin(), frame.end());
+        stored = true;
+      }
+    }
+    ctx->ready.notify_all();
+    adc_continuous_callback_t callback = stored ? ctx->callbacks.on_conv_done : ctx->callbacks.on_pool_ovf;
+    if (callback != NULL) {
+      callback(ctx, &event, ctx->userData);
+    }
+  }
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+esp_err_t adc_continuous_new_handle(const adc_continuous_handle_cfg_t* hdl_config, adc_continuous_handle_t* ret_handle) {
+  if (hdl_config->conv_frame_size == 0 || hdl_config->conv_frame_size % SOC_ADC_DIGI_RESULT_BYTES != 0 ||
+      hdl_config->max_store_buf_size < hdl_config->conv_frame_size) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  adc_continuous_ctx_t* ctx = new adc_continuous_ctx_t;
+  ctx->storeBytes = hdl_config->max_store_buf_size;
+  ctx->frameBytes = hdl_config->conv_frame_size;
+  memset(&ctx->config, 0, sizeof(ctx->config));
+  *ret_handle = ctx;
+  return ESP_OK;
+}
+
+esp_err_t adc_continuous_config(adc_continuous_handle_t handle, const adc_continuous_config_t* config) {
+  if (config->pattern_num == 0 || config->sample_freq_hz < SOC_ADC_SAMPLE_FREQ_THRES_LOW ||
+      config->sample_freq_hz > SOC_ADC_SAMPLE_FREQ_THRES_HIGH || config->format != ADC_DIGI_OUTPUT_FORMAT_TYPE2) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  handle->config = *config;
+  handle->patterns.assign(config->adc_pattern, config->adc_pattern + config->pattern_num);
+  return ESP_OK;
+}
+
+esp_err_t adc_continuous_register_event_callbacks(adc_continuous_handle_t handle, const adc_continuous_evt_cbs_t* cbs, void* user_data) {
+  handle->callbacks = *cbs;
+  handle->userData = user_data;
+  return ESP_OK;
+}
+
+esp_err_t adc_continuous_start(adc_continuous_handle_t handle) {
+  if (handle->patterns.empty() || handle->running) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  handle->running = true;
+  handle->thread = std::thread(conversionThread, handle);
+  return ESP_OK;
+}
+
+esp_err_t adc_continuous_stop(adc_continuous_handle_t handle) {
+  if (!handle->running) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  handle->running = false;
+  handle->thread.join();
+  return ESP_OK;
+}
+
+esp_err_t adc_continuous_read(adc_continuous_handle_t handle, uint8_t* buf, uint32_t length_max, uint32_t* out_length, uint32_t timeout_ms) {
+  std::unique_lock<std::mutex> lock(handle->mutex);
+  if (handle->pool.empty() && timeout_ms > 0) {
+    handle->ready.wait_for(lock, std::chrono::microseconds(simToHostUs((int64_t)timeout_ms * 1000)));
+  }
+  if (handle->pool.empty()) {
+    *out_length = 0;
+    return ESP_ERR_TIMEOUT;
+  }
+  // Whole conversion results only
+  uint32_t length = std::min<uint32_t>(length_max, handle->pool.size());
+  length -= length % SOC_ADC_DIGI_RESULT_BYTES;
+  std::copy(handle->pool.begin(), handle->pool.begin() + length, buf);
+  handle->pool.erase(handle->pool.begin(), handle->pool.begin() + length);
+  *out_length = length;
+  return ESP_OK;
+}
+
+esp_err_t adc_continuous_deinit(adc_continuous_handle_t handle) {
+  if (handle->running) {
+    adc_continuous_stop(handle);
+  }
+  delete handle;
+  return ESP_OK;
+}
+
+esp_err_t adc_continuous_io_to_channel(int io_num, adc_unit_t* unit_id, adc_channel_t* channel) {
+  // ESP32-S3: GPIO 1-10 are ADC1 channels 0-9, GPIO 11-20 are ADC2 channels 0-9
+  if (io_num >= 1 && io_num <= 10) {
+    *unit_id = ADC_UNIT_1;
+    *channel = (adc_channel_t)(io_num - 1);
+  } else if (io_num >= 11 && io_num <= 20) {
+    *unit_id = ADC_UNIT_2;
+    *channel = (adc_channel_t)(io_num - 11);
+  } else {
+    return ESP_ERR_INVALID_ARG;
+  }
+  return ESP_OK;
+}
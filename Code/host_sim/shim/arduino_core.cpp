@@ -0,0 +1,456 @@
+/**
+ * arduino_core.cpp - virtual clock, GPIO with the soil model, Serial, ESP and FreeRTOS for the host build.
+ */
+#include "Arduino.h"
+#include <poll.h>
+#include <unistd.h>
+#include <random>
+
+SimConfig simConfig;
+HardwareSerial Serial;
+EspClass ESP;
+
+static const std::chrono::steady_clock::time_point simStart = std::chrono::steady_clock::now();
+static const time_t simEpochAtStart = (time)(NULL);
+
+//-----------------------VIRTUAL TIME--------------------------
+
+int64_t simSteppedUs = -1;
+
+int64_t simNowUs() {
+  if (simSteppedUs >= 0) {
+    return simSteppedUs;
+  }
+  int64_t hostUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - simStart).count();
+  return (int64_t)(hostUs * simConfig.speed);
+}
+
+int64_t simToHostUs(int64_t virtualUs) {
+  return (int64_t)(virtualUs / simConfig.speed);
+}
+
+void simSleepUs(int64_t virtualUs) {
+  if (virtualUs > 0) {
+    std::this_thread::sleep_for(std::chrono::microseconds(simToHostUs(virtualUs)));
+  } else {
+    std::this_thread::yield();
+  }
+}
+
+unsigned long millis() { return (unsigned long)(uint32_t)(simNowUs() / 1000); }
+unsigned long micros() { return (unsigned long)(uint32_t)simNowUs(); }
+void delay(uint32_t ms) { simSleepUs((int64_t)ms * 1000); }
+void delayMicroseconds(uint32_t us) { simSleepUs(us); }
+void yield() { std::this_thread::yield(); }
+
+time_t simTime(time_t* t) {
+  time_t now = simEpochAtStart + (time_t)(simNowUs() / 1000000);
+  if (t != NULL) {
+    *t = now;
+  }
+  return now;
+}
+
+void configTime(long gmtOffsetSec, int daylightOffsetSec, const char* server1, const char* server2, const char* server3) {
+  // The virtual clock starts at the host's wall clock, as if NTP had answered at once
+}
+
+//-----------------------GPIO AND SOIL MODEL--------------------------
+
+static std::mutex gpioMutex;
+static uint8_t pinLevels[64];
+static uint8_t watchedPins = 0;       // Pins 0 .. watchedPins - 1 are counted by simGpioWatch()
+static uint8_t watchedHigh = 0, watchedPeak = 0;
+static double soilMoisture = -1;
+static int64_t soilUpdatedUs = 0;
+static std::mt19937 noise(12345);
+
+// Integrates drying and watering since the last call, relay state taken from pinLevels
+static void soilUpdate() {
+  int64_t now = simNowUs();
+  if (soilMoisture < 0) {
+    soilMoisture = simConfig.soilMoisture;
+    soilUpdatedUs = now;
+  }
+  double dt = (now - soilUpdatedUs) / 1e6;
+  soilUpdatedUs = now;
+  soilMoisture -= simConfig.dryingPerHour * dt / 3600.0;
+  if (pinLevels[simConfig.relayPin % 64] == HIGH) {
+    soilMoisture += simConfig.wateringPerSecond * dt;
+  }
+  soilMoisture = std::min(100.0, std::max(0.0, soilMoisture));
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  std::lock_guard<std::mutex> lock(gpioMutex);
+  soilUpdate(); // Close the interval with the old relay state
+  uint8_t level = val ? HIGH : LOW;
+  if (pin < watchedPins && pinLevels[pin] != level) {
+    watchedHigh = level == HIGH ? watchedHigh + 1 : watchedHigh - 1;
+    watchedPeak = std::max(watchedPeak, watchedHigh);
+  }
+  pinLevels[pin % 64] = level;
+}
+
+void simGpioWatch(uint8_t count) {
+  std::lock_guard<std::mutex> lock(gpioMutex);
+  watchedPins = std::min<uint8_t>(count, 64);
+  watchedHigh = 0;
+  for (uint8_t pin = 0; pin < watchedPins; pin++) {
+    watchedHigh += pinLevels[pin] == HIGH;
+  }
+  watchedPeak = watchedHigh;
+}
+
+uint8_t simGpioPeakHigh() {
+  std::lock_guard<std::mutex> lock(gpioMutex);
+  return watchedPeak;
+}
+
+int digitalRead(uint8_t pin) {
+  std::lock_guard<std::mutex> lock(gpioMutex);
+  return pinLevels[pin % 64];
+}
+
+uint16_t simAdcSample(uint8_t pin) {
+  std::lock_guard<std::mutex> lock(gpioMutex);
+  if (pin != simConfig.sensorPin) {
+    return 0;
+  }
+  soilUpdate();
+  if (!simConfig.adcTrace.empty()) {
+    static size_t traceNext = 0;
+    uint16_t sample = simConfig.adcTrace[traceNext];
+    traceNext = (traceNext + 1) % simConfig.adcTrace.size();
+    return sample;
+  }
+  // Same calibration as the sketch: 4095 in air (0%), 1300 in water (100%), plus a little ADC noise
+  std::normal_distribution<double> adcNoise(0.0, 8.0);
+  double raw = 4095.0 - (4095.0 - 1300.0) * soilMoisture / 100.0 + adcNoise(noise);
+  // While the radio transmits, a sample now and then is off by hundreds of counts
+  if (simConfig.adcSpikes > 0 && std::uniform_real_distribution<double>(0.0, 1.0)(noise) < simConfig.adcSpikes && simWifiUp()) {
+    raw += std::uniform_real_distribution<double>(-900.0, 600.0)(noise);
+  }
+  return (uint16_t)std::min(4095.0, std::max(0.0, raw));
+}
+
+uint16_t analogRead(uint8_t pin) {
+  return simAdcSample(pin);
+}
+
+void analogReadResolution(uint8_t bits) {}
+
+long map(long x, long inMin, long inMax, long outMin, long outMax) {
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+long random(long max) { return max > 0 ? (long)(noise() % max) : 0; }
+long random(long min, long max) { return min < max ? min + random(max - min) : min; }
+
+//-----------------------MEMORY--------------------------
+
+bool psramFound() { return true; }
+void* ps_malloc(size_t size) { return malloc(size); }
+void* ps_calloc(size_t n, size_t size) { return calloc(n, size); }
+
+#if !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char* dst, const char* src, size_t size) {
+  size_t len = strlen(src);
+  if (size > 0) {
+    size_t n = len < size - 1 ? len : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+  }
+  return len;
+}
+#endif
+
+uint32_t EspClass::getFreeHeap() { return 200 * 1024; }
+uint32_t EspClass::getMinFreeHeap() { return 180 * 1024; }
+void EspClass::restart() { Serial.println("ESP.restart() called, exiting"); exit(0); }
+
+//-----------------------SERIAL--------------------------
+
+static std::mutex serialMutex;
+
+size_t HardwareSerial::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* buf, size_t size) {
+  if (!simConfig.quiet) {
+    std::lock_guard<std::mutex> lock(serialMutex);
+    FILE* out = simConfig.serialToStderr ? stderr : stdout;
+    fwrite(buf, 1, size, out);
+    fflush(out);
+  }
+  return size;
+}
+
+// Serial input comes from stdin, e.g. to type serial commands into the simulated board
+static int stdinPeeked = -1;
+static bool stdinClosed = false;  // After EOF (e.g. stdin is /dev/null), poll() would report input for ever
+
+int HardwareSerial::available() {
+  if (stdinPeeked >= 0) {
+    return 1;
+  }
+  if (stdinClosed) {
+    return 0;
+  }
+  struct pollfd pfd = {0, POLLIN, 0};
+  if (poll(&pfd, 1, 0) <= 0 || !(pfd.revents & (POLLIN | POLLHUP))) {
+    return 0;
+  }
+  unsigned char c;
+  if (::read(0, &c, 1) != 1) {
+    stdinClosed = true;
+    return 0;
+  }
+  stdinPeeked = c;
+  return 1;
+}
+
+int HardwareSerial::read() {
+  int c = peek();
+  stdinPeeked = -1;
+  return c;
+}
+
+int HardwareSerial::peek() {
+  return available() ? stdinPeeked : -1;
+}
+
+//-----------------------FREERTOS--------------------------
+
+struct SimTaskExit {};
+
+struct SimTask {
+  std::mutex m;
+  std::condition_variable cv;
+  uint32_t notifyCount = 0;
+  TaskFunction_t fn = NULL;
+  void* arg = NULL;
+  std::string name;
+};
+
+struct SimQueue {
+  std::mutex m;
+  std::condition_variable cv;
+  std::deque<std::vector<uint8_t>> items;
+  UBaseType_t length;
+  UBaseType_t itemSize;
+};
+
+struct SimEventGroup {
+  std::mutex m;
+  std::condition_variable cv;
+  EventBits_t bits = 0;
+};
+
+static thread_local SimTask* currentTask = NULL;
+static std::recursive_mutex criticalMutex;
+
+// Waits on a condition variable for a number of ticks (virtual ms), portMAX_DELAY waits forever
+template <typename Lock, typename Pred>
+static bool waitTicks(std::condition_variable& cv, Lock& lock, TickType_t ticks, Pred pred) {
+  if (ticks == portMAX_DELAY) {
+    cv.wait(lock, pred);
+    return true;
+  }
+  if (ticks == 0) {
+    return pred(); // A poll, as in FreeRTOS: no timed wait on the host either
+  }
+  return cv.wait_for(lock, std::chrono::microseconds(simToHostUs((int64_t)ticks * 1000)), pred);
+}
+
+static void taskEntry(SimTask* task) {
+  currentTask = task;
+  try {
+    task->fn(task->arg);
+  } catch (const SimTaskExit&) {
+  }
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stackDepth, void* arg,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core) {
+  SimTask* task = new SimTask;
+  task->fn = fn;
+  task->arg = arg;
+  task->name = name != NULL ? name : "";
+  if (handle != NULL) {
+    *handle = task;
+  }
+  std::thread(taskEntry, task).detach();
+  return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stackDepth, void* arg,
+                       UBaseType_t priority, TaskHandle_t* handle) {
+  return xTaskCreatePinnedToCore(fn, name, stackDepth, arg, priority, handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  if (task == NULL || task == currentTask) {
+    throw SimTaskExit(); // Unwinds to taskEntry(), the task object is leaked like a handle kept by the sketch
+  }
+  // Deleting another task is not supported on the host, the sketch modules never do it
+}
+
+void vTaskDelay(TickType_t ticks) { simSleepUs((int64_t)ticks * 1000); }
+TickType_t xTaskGetTickCount() { return (TickType_t)(simNowUs() / 1000); }
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  if (currentTask == NULL) {
+    currentTask = new SimTask; // loop() task, created on first use
+    currentTask->name = "loopTask";
+  }
+  return currentTask;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) { return 1024; }
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait) {
+  SimTask* task = xTaskGetCurrentTaskHandle();
+  std::unique_lock<std::mutex> lock(task->m);
+  waitTicks(task->cv, lock, ticksToWait, [task] { return task->notifyCount > 0; });
+  uint32_t value = task->notifyCount;
+  if (value > 0) {
+    task->notifyCount = clearOnExit ? 0 : value - 1;
+  }
+  return value;
+}
+
+void xTaskNotifyGive(TaskHandle_t task) {
+  if (task == NULL) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(task->m);
+  task->notifyCount++;
+  task->cv.notify_all();
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken) {
+  xTaskNotifyGive(task);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  SimQueue* queue = new SimQueue;
+  queue->length = length;
+  queue->itemSize = itemSize;
+  return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) { delete queue; }
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticksToWait) {
+  std::unique_lock<std::mutex> lock(queue->m);
+  if (!waitTicks(queue->cv, lock, ticksToWait, [queue] { return queue->items.size() < queue->length; })) {
+    return pdFALSE;
+  }
+  const uint8_t* bytes = (const uint8_t*)item;
+  queue->items.emplace_back(bytes, bytes + (item != NULL ? queue->itemSize : 0));
+  queue->cv.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void* item, TickType_t ticksToWait) {
+  return xQueueSend(queue, item, ticksToWait);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void* item) {
+  std::lock_guard<std::mutex> lock(queue->m);
+  queue->items.clear();
+  const uint8_t* bytes = (const uint8_t*)item;
+  queue->items.emplace_back(bytes, bytes + queue->itemSize);
+  queue->cv.notify_all();
+  return pdTRUE;
+}
+
+static BaseType_t queueTake(QueueHandle_t queue, void* item, TickType_t ticksToWait, bool remove) {
+  std::unique_lock<std::mutex> lock(queue->m);
+  if (!waitTicks(queue->cv, lock, ticksToWait, [queue] { return !queue->items.empty(); })) {
+    return pdFALSE;
+  }
+  if (item != NULL && queue->itemSize > 0) {
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+  }
+  if (remove) {
+    queue->items.pop_front();
+    queue->cv.notify_all();
+  }
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticksToWait) {
+  return queueTake(queue, item, ticksToWait, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void* item, TickType_t ticksToWait) {
+  return queueTake(queue, item, ticksToWait, false);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  std::lock_guard<std::mutex> lock(queue->m);
+  return queue->items.size();
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+  std::lock_guard<std::mutex> lock(queue->m);
+  return queue->length - queue->items.size();
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount) {
+  SimQueue* sem = xQueueCreate(maxCount, 0);
+  for (UBaseType_t i = 0; i < initialCount; i++) {
+    sem->items.emplace_back();
+  }
+  return sem;
+}
+
+// No priority inheritance or recursion on the host, a plain binary semaphore given once
+SemaphoreHandle_t xSemaphoreCreateMutex() { return xSemaphoreCreateCounting(1, 1); }
+SemaphoreHandle_t xSemaphoreCreateBinary() { return xSemaphoreCreateCounting(1, 0); }
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticksToWait) { return xQueueReceive(sem, NULL, ticksToWait); }
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) { return xQueueSend(sem, NULL, 0); }
+void vSemaphoreDelete(SemaphoreHandle_t sem) { vQueueDelete(sem); }
+
+EventGroupHandle_t xEventGroupCreate() { return new SimEventGroup; }
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+  std::lock_guard<std::mutex> lock(group->m);
+  group->bits |= bits;
+  group->cv.notify_all();
+  return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+  std::lock_guard<std::mutex> lock(group->m);
+  EventBits_t before = group->bits;
+  group->bits &= ~bits;
+  return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+  std::lock_guard<std::mutex> lock(group->m);
+  return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit,
+                                BaseType_t waitForAll, TickType_t ticksToWait) {
+  std::unique_lock<std::mutex> lock(group->m);
+  auto satisfied = [group, bits, waitForAll] {
+    return waitForAll ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+  };
+  bool ok = waitTicks(group->cv, lock, ticksToWait, satisfied);
+  EventBits_t value = group->bits;
+  if (ok && clearOnExit) {
+    group->bits &= ~bits;
+  }
+  return value;
+}
+
+void simEnterCritical() { criticalMutex.lock(); }
+void simExitCritical() { criticalMutex.unlock(); }
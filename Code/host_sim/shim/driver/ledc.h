@@ -0,0 +1,10 @@
+/**
+ * driver/ledc.h - LEDC channel and timer identifiers used by the camera configuration.
+ */
+#ifndef HOST_SIM_DRIVER_LEDC_H
+#define HOST_SIM_DRIVER_LEDC_H
+
+typedef enum { LEDC_CHANNEL_0, LEDC_CHANNEL_1, LEDC_CHANNEL_2, LEDC_CHANNEL_3 } ledc_channel_t;
+typedef enum { LEDC_TIMER_0, LEDC_TIMER_1, LEDC_TIMER_2, LEDC_TIMER_3 } ledc_timer_t;
+
+#endif
@@ -0,0 +1,9 @@
+/**
+ * esp32-hal-log.h - host shim, see esp_log.h.
+ */
+#ifndef HOST_SIM_ESP32_HAL_LOG_H
+#define HOST_SIM_ESP32_HAL_LOG_H
+
+#include "esp_log.h"
+
+#endif
@@ -0,0 +1,148 @@
+/**
+ * esp_camera.cpp - simulated camera for the host build.
+ */
+#include "esp_camera.h"
+#include <dirent.h>
+#include <string>
+#include <vector>
+
+static const uint16_t frameSizes[][2] = {
+  {96, 96}, {160, 120}, {176, 144}, {240, 176}, {240, 240}, {320, 240}, {400, 296}, {480, 320}, {640, 480},
+  {800, 600}, {1024, 768}, {1280, 720}, {1280, 1024}, {1600, 1200}, {1920, 1080}, {720, 1280}, {864, 1536},
+  {2048, 1536}, {2560, 1440}, {2560, 1600}, {1080, 1920}, {2560, 1920},
+};
+
+static std::mutex cameraMutex;
+static bool cameraReady = false;
+static sensor_t cameraSensor;
+static std::vector<std::vector<uint8_t>> frames;   // JPEG files of the camera directory, or the placeholder
+static size_t nextFrame = 0;
+static int64_t lastCaptureUs = 0;
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+static int sensorSetInt(sensor_t* sensor, int value) { return 0; }
+static int sensorSetFramesize(sensor_t* sensor, framesize_t framesize) { sensor->framesize = framesize; return 0; }
+static int sensorSetQuality(sensor_t* sensor, int quality) { sensor->quality = quality; return 0; }
+
+/**
+ * @brief Loads the .jpg files of the camera directory in name order.
+ */
+static void loadFrames(const std::string& dir) {
+  std::vector<std::string> names;
+  DIR* d = opendir(dir.c_str());
+  if (d != NULL) {
+    for (struct dirent* entry = readdir(d); entry != NULL; entry = readdir(d)) {
+      std::string name = entry->d_name;
+      if (name.size() > 4 && (name.compare(name.size() - 4, 4, ".jpg") == 0 || name.compare(name.size() - 4, 4, ".JPG") == 0)) {
+        names.push_back(name);
+      }
+    }
+    closedir(d);
+  }
+  std::sort(names.begin(), names.end());
+  for (const std::string& name : names) {
+    FILE* fp = fopen((dir + "/" + name).c_str(), "rb");
+    if (fp == NULL) {
+      continue;
+    }
+    std::vector<uint8_t> data;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+      data.insert(data.end(), buf, buf + n);
+    }
+    fclose(fp);
+    frames.push_back(data);
+  }
+}
+
+/**
+ * @brief A placeholder frame the size of a typical SVGA JPEG: SOI, APP0 (JFIF), filler and EOI.
+ * It is not a decodable image, but it travels through the upload and streaming paths like a real one.
+ */
+static std::vector<uint8_t> placeholderFrame(size_t size) {
+  static const uint8_t head[] = {0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00,
+                                 0x01, 0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00};
+  std::vector<uint8_t> data(head, head + sizeof(head));
+  for (size_t i = data.size(); i < size - 2; i++) {
+    data.push_back((uint8_t)(i * 31));
+  }
+  data.push_back(0xFF);
+  data.push_back(0xD9);
+  return data;
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+esp_err_t esp_camera_init(const camera_config_t* config) {
+  std::lock_guard<std::mutex> lock(cameraMutex);
+  cameraSensor.framesize = config->frame_size;
+  cameraSensor.quality = config->jpeg_quality;
+  cameraSensor.set_vflip = sensorSetInt;
+  cameraSensor.set_hmirror = sensorSetInt;
+  cameraSensor.set_brightness = sensorSetInt;
+  cameraSensor.set_saturation = sensorSetInt;
+  cameraSensor.set_framesize = sensorSetFramesize;
+  cameraSensor.set_quality = sensorSetQuality;
+  frames.clear();
+  if (!simConfig.cameraDir.empty()) {
+    loadFrames(simConfig.cameraDir);
+    if (frames.empty()) {
+      Serial.printf("[host_sim] No .jpg files in %s\n", simConfig.cameraDir.c_str());
+      return ESP_ERR_NOT_FOUND;
+    }
+  } else {
+    frames.push_back(placeholderFrame(40 * 1024));
+  }
+  cameraReady = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_camera_deinit() {
+  std::lock_guard<std::mutex> lock(cameraMutex);
+  cameraReady = false;
+  frames.clear();
+  return ESP_OK;
+}
+
+camera_fb_t* esp_camera_fb_get() {
+  std::unique_lock<std::mutex> lock(cameraMutex);
+  if (!cameraReady) {
+    return NULL;
+  }
+  // The sensor delivers one frame per frame period, a caller asking sooner waits for the next one
+  int64_t due = lastCaptureUs + (int64_t)simConfig.cameraFrameMs * 1000;
+  int64_t now = simNowUs();
+  if (due > now) {
+    lock.unlock();
+    simSleepUs(due - now);
+    lock.lock();
+  }
+  lastCaptureUs = simNowUs();
+
+  const std::vector<uint8_t>& data = frames[nextFrame];
+  nextFrame = (nextFrame + 1) % frames.size();
+  camera_fb_t* fb = new camera_fb_t;
+  fb->buf = (uint8_t*)malloc(data.size());
+  memcpy(fb->buf, data.data(), data.size());
+  fb->len = data.size();
+  framesize_t size = cameraSensor.framesize < FRAMESIZE_INVALID ? cameraSensor.framesize : FRAMESIZE_SVGA;
+  fb->width = frameSizes[size][0];
+  fb->height = frameSizes[size][1];
+  fb->format = PIXFORMAT_JPEG;
+  fb->timestamp.tv_sec = lastCaptureUs / 1000000;
+  fb->timestamp.tv_usec = lastCaptureUs % 1000000;
+  return fb;
+}
+
+void esp_camera_fb_return(camera_fb_t* fb) {
+  if (fb != NULL) {
+    free(fb->buf);
+    delete fb;
+  }
+}
+
+sensor_t* esp_camera_sensor_get() {
+  return cameraReady ? &cameraSensor : NULL;
+}
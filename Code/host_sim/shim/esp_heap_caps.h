@@ -0,0 +1,23 @@
+/**
+ * esp_heap_caps.h - host shim. The host has no separate heaps, the figures are the fixed sizes of an ESP32-S3 with
+ * 8 MB of PSRAM so that the /metrics page keeps its shape.
+ */
+#ifndef HOST_SIM_ESP_HEAP_CAPS_H
+#define HOST_SIM_ESP_HEAP_CAPS_H
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#define MALLOC_CAP_8BIT     (1 << 2)
+#define MALLOC_CAP_DMA      (1 << 3)
+#define MALLOC_CAP_SPIRAM   (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_DEFAULT  (1 << 12)
+
+inline size_t heap_caps_get_free_size(uint32_t caps) { return (caps & MALLOC_CAP_SPIRAM) ? 8 * 1024 * 1024 : 320 * 1024; }
+inline size_t heap_caps_get_largest_free_block(uint32_t caps) { return heap_caps_get_free_size(caps); }
+inline size_t heap_caps_get_minimum_free_size(uint32_t caps) { return heap_caps_get_free_size(caps); }
+inline void* heap_caps_malloc(size_t size, uint32_t caps) { return malloc(size); }
+inline void heap_caps_free(void* ptr) { free(ptr); }
+
+#endif
@@ -0,0 +1,317 @@
+/**
+ * esp_http_server.cpp - HTTP server shim on host sockets.
+ */
+#include "esp_http_server.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <map>
+
+struct SimHttpServer {
+  httpd_config_t config;
+  int listenFd = -1;
+  std::vector<httpd_uri_t> handlers;
+  std::mutex mutex;
+};
+
+static std::mutex serversMutex;
+static std::vector<SimHttpServer*> servers;
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+static bool reqWrite(httpd_req_t* req, const char* buf, size_t len) {
+  if (req->fd < 0) {
+    return req->out == NULL || fwrite(buf, 1, len, req->out) == len;
+  }
+  while (len > 0) {
+    ssize_t n = send(req->fd, buf, len, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return false;
+    }
+    buf += n;
+    len -= n;
+  }
+  return true;
+}
+
+static bool reqWriteHeaders(httpd_req_t* req, long contentLength) {
+  req->headersSent = true;
+  if (req->fd < 0) {
+    return true; // simHttpGet() only wants the body
+  }
+  std::string head = "HTTP/1.1 " + req->status + "\r\nContent-Type: " + req->type + "\r\n" + req->headers;
+  if (contentLength >= 0) {
+    head += "Content-Length: " + std::to_string(contentLength) + "\r\n";
+  } else {
+    head += "Transfer-Encoding: chunked\r\n";
+  }
+  head += "Connection: close\r\n\r\n";
+  return reqWrite(req, head.data(), head.size());
+}
+
+static bool findHandler(SimHttpServer* server, const char* uri, int method, httpd_uri_t* found) {
+  std::string path = uri;
+  size_t query = path.find('?');
+  if (query != std::string::npos) {
+    path = path.substr(0, query);
+  }
+  std::lock_guard<std::mutex> lock(server->mutex);
+  for (const httpd_uri_t& handler : server->handlers) {
+    if (path == handler.uri && handler.method == method) {
+      *found = handler;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void reqInit(httpd_req_t* req, SimHttpServer* server, int fd) {
+  req->handle = server;
+  req->method = HTTP_GET;
+  req->uri[0] = '\0';
+  req->content_len = 0;
+  req->user_ctx = NULL;
+  req->fd = fd;
+  req->out = NULL;
+  req->status = "200 OK";
+  req->type = "text/html";
+  req->headersSent = false;
+  req->chunked = false;
+  req->async = false;
+}
+
+/**
+ * @brief Finishes a response: terminates a chunked body and closes the connection.
+ */
+static void reqFinish(httpd_req_t* req) {
+  if (req->chunked) {
+    reqWrite(req, "0\r\n\r\n", 5);
+  }
+  if (req->fd >= 0) {
+    close(req->fd);
+  }
+}
+
+/**
+ * @brief Reads the request head of one connection and runs the handler of its URI.
+ */
+static void serveConnection(SimHttpServer* server, int fd) {
+  std::string head;
+  char buf[1024];
+  while (head.find("\r\n\r\n") == std::string::npos && head.size() < 8192) {
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0) {
+      close(fd);
+      return;
+    }
+    head.append(buf, n);
+  }
+  httpd_req_t* req = new httpd_req_t;
+  reqInit(req, server, fd);
+  size_t sp1 = head.find(' ');
+  size_t sp2 = head.find(' ', sp1 + 1);
+  std::string method = head.substr(0, sp1);
+  std::string uri = sp1 != std::string::npos && sp2 != std::string::npos ? head.substr(sp1 + 1, sp2 - sp1 - 1) : "/";
+  req->method = method == "POST" ? HTTP_POST : (method == "HEAD" ? HTTP_HEAD : HTTP_GET);
+  strlcpy(req->uri, uri.c_str(), sizeof(req->uri));
+
+  httpd_uri_t handler;
+  if (!findHandler(server, req->uri, req->method, &handler)) {
+    httpd_resp_send_404(req);
+  } else {
+    req->user_ctx = handler.user_ctx;
+    if (handler.handler(req) != ESP_OK && !req->headersSent) {
+      httpd_resp_send_500(req);
+    }
+  }
+  if (!req->async) {
+    reqFinish(req);
+  }
+  delete req; // An async handler works on its own copy
+}
+
+static void serverTask(SimHttpServer* server) {
+  while (true) {
+    int fd = accept(server->listenFd, NULL, NULL);
+    if (fd < 0) {
+      return; // httpd_stop() closed the listener
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    serveConnection(server, fd);
+  }
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+esp_err_t httpd_start(httpd_handle_t* handle, const httpd_config_t* config) {
+  SimHttpServer* server = new SimHttpServer;
+  server->config = *config;
+  if (simConfig.httpPort > 0) {
+    int port = simConfig.httpPort + config->server_port - 80;
+    server->listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(server->listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (bind(server->listenFd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(server->listenFd, config->backlog_conn) != 0) {
+      Serial.printf("[host_sim] Cannot listen on port %d: %s\n", port, strerror(errno));
+      close(server->listenFd);
+      delete server;
+      return ESP_FAIL;
+    }
+    std::thread(serverTask, server).detach();
+  }
+  std::lock_guard<std::mutex> lock(serversMutex);
+  servers.push_back(server);
+  *handle = server;
+  return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle) {
+  if (handle->listenFd >= 0) {
+    shutdown(handle->listenFd, SHUT_RDWR);
+    close(handle->listenFd);
+    handle->listenFd = -1;
+  }
+  return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t* uri) {
+  std::lock_guard<std::mutex> lock(handle->mutex);
+  if (handle->handlers.size() >= handle->config.max_uri_handlers) {
+    return ESP_ERR_NO_MEM;
+  }
+  handle->handlers.push_back(*uri);
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t* req, const char* status) { req->status = status; return ESP_OK; }
+esp_err_t httpd_resp_set_type(httpd_req_t* req, const char* type) { req->type = type; return ESP_OK; }
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t* req, const char* field, const char* value) {
+  req->headers += std::string(field) + ": " + value + "\r\n";
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t* req, const char* buf, ssize_t len) {
+  if (len == HTTPD_RESP_USE_STRLEN) {
+    len = buf != NULL ? strlen(buf) : 0;
+  }
+  if (!reqWriteHeaders(req, len) || (len > 0 && !reqWrite(req, buf, len))) {
+    return ESP_FAIL;
+  }
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t* req, const char* buf, ssize_t len) {
+  if (len == HTTPD_RESP_USE_STRLEN) {
+    len = buf != NULL ? strlen(buf) : 0;
+  }
+  if (!req->headersSent) {
+    req->chunked = true;
+    if (!reqWriteHeaders(req, -1)) {
+      return ESP_FAIL;
+    }
+  }
+  if (len == 0) {
+    return ESP_OK; // The terminating chunk is written when the request finishes
+  }
+  if (req->fd >= 0) {
+    char size[16];
+    int n = snprintf(size, sizeof(size), "%zx\r\n", (size_t)len);
+    if (!reqWrite(req, size, n) || !reqWrite(req, buf, len) || !reqWrite(req, "\r\n", 2)) {
+      return ESP_FAIL;
+    }
+    return ESP_OK;
+  }
+  return reqWrite(req, buf, len) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t httpd_resp_send_404(httpd_req_t* req) {
+  httpd_resp_set_status(req, "404 Not Found");
+  httpd_resp_set_type(req, "text/plain");
+  return httpd_resp_send(req, "Not found", HTTPD_RESP_USE_STRLEN);
+}
+
+esp_err_t httpd_resp_send_500(httpd_req_t* req) {
+  httpd_resp_set_status(req, "500 Internal Server Error");
+  httpd_resp_set_type(req, "text/plain");
+  return httpd_resp_send(req, "Internal Server Error", HTTPD_RESP_USE_STRLEN);
+}
+
+size_t httpd_req_get_url_query_len(httpd_req_t* req) {
+  const char* query = strchr(req->uri, '?');
+  return query != NULL ? strlen(query + 1) : 0;
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t* req, char* buf, size_t len) {
+  const char* query = strchr(req->uri, '?');
+  if (query == NULL) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  strlcpy(buf, query + 1, len);
+  return ESP_OK;
+}
+
+esp_err_t httpd_query_key_value(const char* query, const char* key, char* val, size_t len) {
+  size_t keyLen = strlen(key);
+  for (const char* p = query; p != NULL && *p; p = strchr(p, '&') != NULL ? strchr(p, '&') + 1 : NULL) {
+    if (strncmp(p, key, keyLen) == 0 && p[keyLen] == '=') {
+      const char* value = p + keyLen + 1;
+      size_t valueLen = strcspn(value, "&");
+      size_t n = std::min(valueLen, len - 1);
+      memcpy(val, value, n);
+      val[n] = '\0';
+      return ESP_OK;
+    }
+  }
+  return ESP_ERR_NOT_FOUND;
+}
+
+int httpd_req_to_sockfd(httpd_req_t* req) {
+  return req->fd;
+}
+
+esp_err_t httpd_req_async_handler_begin(httpd_req_t* req, httpd_req_t** out) {
+  httpd_req_t* copy = new httpd_req_t(*req);
+  req->async = true; // The connection now belongs to the copy
+  *out = copy;
+  return ESP_OK;
+}
+
+esp_err_t httpd_req_async_handler_complete(httpd_req_t* req) {
+  reqFinish(req);
+  delete req;
+  return ESP_OK;
+}
+
+//-----------------------SIMULATOR--------------------------
+
+bool simHttpGet(const char* uri, FILE* out) {
+  SimHttpServer* server = NULL;
+  {
+    std::lock_guard<std::mutex> lock(serversMutex);
+    for (SimHttpServer* s : servers) {
+      if (s->config.server_port == 80) {
+        server = s;
+      }
+    }
+  }
+  if (server == NULL) {
+    return false;
+  }
+  httpd_req_t req;
+  reqInit(&req, server, -1);
+  req.out = out;
+  strlcpy(req.uri, uri, sizeof(req.uri));
+  httpd_uri_t handler;
+  if (!findHandler(server, uri, HTTP_GET, &handler)) {
+    return false;
+  }
+  req.user_ctx = handler.user_ctx;
+  return handler.handler(&req) == ESP_OK;
+}
@@ -0,0 +1,96 @@
+/**
+ * esp_http_server.h - host shim of the ESP-IDF HTTP server. Each server listens on the host port
+ * simConfig.httpPort + (server_port - 80), so the board's port 80/81 pages are at localhost:8080/8081 by default.
+ * One request per connection (the response closes it), which is all the camera pages need.
+ */
+#ifndef HOST_SIM_ESP_HTTP_SERVER_H
+#define HOST_SIM_ESP_HTTP_SERVER_H
+
+#include "Arduino.h"
+
+typedef enum { HTTP_DELETE = 0, HTTP_GET = 1, HTTP_HEAD = 2, HTTP_POST = 3, HTTP_PUT = 4 } httpd_method_t;
+
+struct SimHttpServer;
+typedef SimHttpServer* httpd_handle_t;
+
+struct httpd_req;
+typedef struct httpd_req httpd_req_t;
+typedef esp_err_t (*httpd_uri_handler_t)(httpd_req_t* req);
+
+typedef struct {
+  const char* uri;
+  httpd_method_t method;
+  httpd_uri_handler_t handler;
+  void* user_ctx;
+} httpd_uri_t;
+
+struct httpd_req {
+  httpd_handle_t handle;
+  int method;
+  char uri[512];
+  size_t content_len;
+  void* user_ctx;
+  // Host side
+  int fd;                   // Client socket, -1 when called through simHttpGet()
+  FILE* out;                // Body sink used by simHttpGet()
+  std::string status;
+  std::string type;
+  std::string headers;
+  bool headersSent;
+  bool chunked;
+  bool async;
+};
+
+typedef struct {
+  unsigned task_priority;
+  size_t stack_size;
+  BaseType_t core_id;
+  uint16_t server_port;
+  uint16_t ctrl_port;
+  uint16_t max_open_sockets;
+  uint16_t max_uri_handlers;
+  uint16_t max_resp_headers;
+  uint16_t backlog_conn;
+  bool lru_purge_enable;
+  uint16_t recv_wait_timeout;
+  uint16_t send_wait_timeout;
+} httpd_config_t;
+
+#define HTTPD_DEFAULT_CONFIG() {                \
+    .task_priority = 5,                         \
+    .stack_size = 4096,                         \
+    .core_id = tskNO_AFFINITY,                  \
+    .server_port = 80,                          \
+    .ctrl_port = 32768,                         \
+    .max_open_sockets = 7,                      \
+    .max_uri_handlers = 8,                      \
+    .max_resp_headers = 8,                      \
+    .backlog_conn = 5,                          \
+    .lru_purge_enable = false,                  \
+    .recv_wait_timeout = 5,                     \
+    .send_wait_timeout = 5,                     \
+}
+
+#define HTTPD_RESP_USE_STRLEN -1
+
+esp_err_t httpd_start(httpd_handle_t* handle, const httpd_config_t* config);
+esp_err_t httpd_stop(httpd_handle_t handle);
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t* uri);
+
+esp_err_t httpd_resp_set_status(httpd_req_t* req, const char* status);
+esp_err_t httpd_resp_set_type(httpd_req_t* req, const char* type);
+esp_err_t httpd_resp_set_hdr(httpd_req_t* req, const char* field, const char* value);
+esp_err_t httpd_resp_send(httpd_req_t* req, const char* buf, ssize_t len);
+esp_err_t httpd_resp_send_chunk(httpd_req_t* req, const char* buf, ssize_t len);
+esp_err_t httpd_resp_send_404(httpd_req_t* req);
+esp_err_t httpd_resp_send_500(httpd_req_t* req);
+
+size_t httpd_req_get_url_query_len(httpd_req_t* req);
+esp_err_t httpd_req_get_url_query_str(httpd_req_t* req, char* buf, size_t len);
+esp_err_t httpd_query_key_value(const char* query, const char* key, char* val, size_t len);
+int httpd_req_to_sockfd(httpd_req_t* req);
+
+esp_err_t httpd_req_async_handler_begin(httpd_req_t* req, httpd_req_t** out);
+esp_err_t httpd_req_async_handler_complete(httpd_req_t* req);
+
+#endif
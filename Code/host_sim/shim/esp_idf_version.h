@@ -0,0 +1,13 @@
+/**
+ * esp_idf_version.h - the host build reports the ESP-IDF of Arduino ESP32 core 3.0.x.
+ */
+#ifndef HOST_SIM_ESP_IDF_VERSION_H
+#define HOST_SIM_ESP_IDF_VERSION_H
+
+#define ESP_IDF_VERSION_MAJOR 5
+#define ESP_IDF_VERSION_MINOR 1
+#define ESP_IDF_VERSION_PATCH 4
+#define ESP_IDF_VERSION_VAL(major, minor, patch) (((major) << 16) | ((minor) << 8) | (patch))
+#define ESP_IDF_VERSION ESP_IDF_VERSION_VAL(ESP_IDF_VERSION_MAJOR, ESP_IDF_VERSION_MINOR, ESP_IDF_VERSION_PATCH)
+
+#endif
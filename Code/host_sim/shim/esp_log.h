@@ -0,0 +1,15 @@
+/**
+ * esp_log.h - host shim of the ESP-IDF log macros, printed like the board does with Core Debug Level "Info".
+ */
+#ifndef HOST_SIM_ESP_LOG_H
+#define HOST_SIM_ESP_LOG_H
+
+#include "Arduino.h"
+
+#define ESP_LOGE(tag, format, ...) Serial.printf("[E][%s] " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) Serial.printf("[W][%s] " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) Serial.printf("[I][%s] " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) do {} while (0)
+#define ESP_LOGV(tag, format, ...) do {} while (0)
+
+#endif
@@ -0,0 +1,21 @@
+/**
+ * esp_rom_crc.h - host version of the ROM CRC32 (IEEE 802.3, same result as the zlib crc32()).
+ */
+#ifndef HOST_SIM_ESP_ROM_CRC_H
+#define HOST_SIM_ESP_ROM_CRC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+inline uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len) {
+  crc = ~crc;
+  while (len--) {
+    crc ^= *buf++;
+    for (int k = 0; k < 8; k++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+#endif
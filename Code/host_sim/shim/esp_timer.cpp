@@ -0,0 +1,138 @@
+/**
+ * esp_timer.cpp - esp_timer on the host: one dispatch thread sleeping until the earliest armed deadline.
+ */
+#include "esp_timer.h"
+
+struct SimTimer {
+  esp_timer_cb_t callback;
+  void* arg;
+  int64_t deadlineUs;   // Virtual time, -1 when not armed
+  uint64_t periodUs;    // 0 for one-shot
+};
+
+static std::mutex timerMutex;
+static std::condition_variable timerCv;
+static std::vector<SimTimer*> timers;
+static bool timerThreadStarted = false;
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+static SimTimer* earliest() {
+  SimTimer* first = NULL;
+  for (SimTimer* t : timers) {
+    if (t->deadlineUs >= 0 && (first == NULL || t->deadlineUs < first->deadlineUs)) {
+      first = t;
+    }
+  }
+  return first;
+}
+
+static void timerThread() {
+  std::unique_lock<std::mutex> lock(timerMutex);
+  for (;;) {
+    SimTimer* next = earliest();
+    if (next == NULL) {
+      timerCv.wait(lock);
+      continue;
+    }
+    int64_t waitUs = next->deadlineUs - simNowUs();
+    if (waitUs > 0) {
+      timerCv.wait_for(lock, std::chrono::microseconds(simToHostUs(waitUs)));
+      continue; // Re-evaluate: the timer may have been stopped or another one armed meanwhile
+    }
+    if (next->periodUs > 0) {
+      next->deadlineUs += next->periodUs;
+    } else {
+      next->deadlineUs = -1;
+    }
+    // The callback may re-arm timers, so it runs without the lock
+    lock.unlock();
+    next->callback(next->arg);
+    lock.lock();
+  }
+}
+
+static esp_err_t arm(esp_timer_handle_t timer, uint64_t us, uint64_t period) {
+  std::lock_guard<std::mutex> lock(timerMutex);
+  if (timer->deadlineUs >= 0) {
+    return ESP_ERR_INVALID_STATE; // Already running, as on the board
+  }
+  timer->deadlineUs = simNowUs() + (int64_t)us;
+  timer->periodUs = period;
+  timerCv.notify_all();
+  return ESP_OK;
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle) {
+  std::lock_guard<std::mutex> lock(timerMutex);
+  SimTimer* timer = new SimTimer{args->callback, args->arg, -1, 0};
+  timers.push_back(timer);
+  if (!timerThreadStarted && simSteppedUs < 0) { // The stepped clock runs the callbacks in simAdvanceToUs()
+    std::thread(timerThread).detach();
+    timerThreadStarted = true;
+  }
+  *handle = timer;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutUs) {
+  return arm(timer, timeoutUs, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodUs) {
+  return arm(timer, periodUs, periodUs);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  std::lock_guard<std::mutex> lock(timerMutex);
+  if (timer->deadlineUs < 0) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->deadlineUs = -1;
+  timerCv.notify_all();
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+  std::lock_guard<std::mutex> lock(timerMutex);
+  timers.erase(std::remove(timers.begin(), timers.end(), timer), timers.end());
+  delete timer;
+  return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+  std::lock_guard<std::mutex> lock(timerMutex);
+  return timer->deadlineUs >= 0;
+}
+
+void simAdvanceToUs(int64_t virtualUs) {
+  std::unique_lock<std::mutex> lock(timerMutex);
+  for (;;) {
+    SimTimer* next = earliest();
+    if (next == NULL || next->deadlineUs > virtualUs) {
+      break;
+    }
+    simSteppedUs = std::max(simSteppedUs, next->deadlineUs);
+    if (next->periodUs > 0) {
+      next->deadlineUs += next->periodUs;
+    } else {
+      next->deadlineUs = -1;
+    }
+    lock.unlock();
+    next->callback(next->arg);
+    lock.lock();
+  }
+  simSteppedUs = std::max(simSteppedUs, virtualUs);
+}
+
+int64_t simNextTimerUs() {
+  std::lock_guard<std::mutex> lock(timerMutex);
+  SimTimer* next = earliest();
+  return next != NULL ? next->deadlineUs : INT64_MAX;
+}
+
+int64_t esp_timer_get_time() {
+  return simNowUs();
+}
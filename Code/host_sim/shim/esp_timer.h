@@ -0,0 +1,32 @@
+/**
+ * esp_timer.h - host shim of the ESP-IDF high resolution timer. Callbacks run in one "esp_timer" thread, in deadline
+ * order, like with ESP_TIMER_TASK dispatch on the board. Time is virtual (see sim.h).
+ */
+#ifndef HOST_SIM_ESP_TIMER_H
+#define HOST_SIM_ESP_TIMER_H
+
+#include "Arduino.h"
+
+typedef void (*esp_timer_cb_t)(void* arg);
+typedef enum { ESP_TIMER_TASK, ESP_TIMER_ISR } esp_timer_dispatch_t;
+
+typedef struct {
+  esp_timer_cb_t callback;
+  void* arg;
+  esp_timer_dispatch_t dispatch_method;
+  const char* name;
+  bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+struct SimTimer;
+typedef SimTimer* esp_timer_handle_t;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutUs);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodUs);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+esp_err_t esp_timer_delete(esp_timer_handle_t timer);
+bool esp_timer_is_active(esp_timer_handle_t timer);
+int64_t esp_timer_get_time();
+
+#endif
@@ -0,0 +1,9 @@
+/**
+ * fb_gfx.h - host shim, nothing of it is used by the sketch.
+ */
+#ifndef HOST_SIM_FB_GFX_H
+#define HOST_SIM_FB_GFX_H
+
+#include "esp_camera.h"
+
+#endif
@@ -0,0 +1,194 @@
+/**
+ * fs.cpp - FS, File and SD_MMC on a host directory.
+ */
+#include "SD_MMC.h"
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+fs::SDMMCFS SD_MMC;
+
+namespace fs {
+
+struct FileImpl {
+  FILE* fp = NULL;
+  DIR* dir = NULL;
+  std::string path;       // Path on the card
+  std::string hostPath;
+  std::string name;       // Last path component
+  ~FileImpl() {
+    if (fp != NULL) fclose(fp);
+    if (dir != NULL) closedir(dir);
+  }
+};
+
+static std::string baseName(const std::string& path) {
+  size_t slash = path.find_last_of('/');
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+//-----------------------FILE--------------------------
+
+size_t File::write(const uint8_t* buf, size_t size) {
+  return _impl && _impl->fp != NULL ? fwrite(buf, 1, size, _impl->fp) : 0;
+}
+
+int File::available() {
+  if (!_impl || _impl->fp == NULL) {
+    return 0;
+  }
+  long remaining = (long)size() - ftell(_impl->fp);
+  return remaining > 0 ? (int)std::min(remaining, (long)INT32_MAX) : 0;
+}
+
+int File::read() {
+  return _impl && _impl->fp != NULL ? fgetc(_impl->fp) : -1;
+}
+
+size_t File::read(uint8_t* buf, size_t size) {
+  return _impl && _impl->fp != NULL ? fread(buf, 1, size, _impl->fp) : 0;
+}
+
+int File::peek() {
+  if (!_impl || _impl->fp == NULL) {
+    return -1;
+  }
+  int c = fgetc(_impl->fp);
+  if (c != EOF) {
+    ungetc(c, _impl->fp);
+  }
+  return c;
+}
+
+void File::flush() {
+  if (_impl && _impl->fp != NULL) {
+    fflush(_impl->fp);
+    fsync(fileno(_impl->fp));  // Like the ESP32 core: File::flush() is fflush() and fsync()
+  }
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+  int whence = mode == SeekSet ? SEEK_SET : (mode == SeekCur ? SEEK_CUR : SEEK_END);
+  return _impl && _impl->fp != NULL && fseek(_impl->fp, pos, whence) == 0;
+}
+
+size_t File::position() const {
+  return _impl && _impl->fp != NULL ? ftell(_impl->fp) : 0;
+}
+
+size_t File::size() const {
+  if (!_impl || _impl->fp == NULL) {
+    return 0;
+  }
+  fflush(_impl->fp);
+  struct stat st;
+  return fstat(fileno(_impl->fp), &st) == 0 ? st.st_size : 0;
+}
+
+bool File::setBufferSize(size_t size) {
+  return _impl && _impl->fp != NULL && setvbuf(_impl->fp, NULL, _IOFBF, size) == 0;
+}
+
+void File::close() {
+  _impl.reset();
+}
+
+File::operator bool() const {
+  return _impl && (_impl->fp != NULL || _impl->dir != NULL);
+}
+
+time_t File::getLastWrite() {
+  struct stat st;
+  return _impl && stat(_impl->hostPath.c_str(), &st) == 0 ? st.st_mtime : 0;
+}
+
+const char* File::path() const { return _impl ? _impl->path.c_str() : NULL; }
+const char* File::name() const { return _impl ? _impl->name.c_str() : NULL; }
+bool File::isDirectory() const { return _impl && _impl->dir != NULL; }
+
+File File::openNextFile(const char* mode) {
+  if (!_impl || _impl->dir == NULL) {
+    return File();
+  }
+  for (struct dirent* entry = readdir(_impl->dir); entry != NULL; entry = readdir(_impl->dir)) {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+      continue;
+    }
+    std::string child = _impl->path == "/" ? "/" + std::string(entry->d_name) : _impl->path + "/" + entry->d_name;
+    return SD_MMC.open(child.c_str(), mode);
+  }
+  return File();
+}
+
+void File::rewindDirectory() {
+  if (_impl && _impl->dir != NULL) {
+    rewinddir(_impl->dir);
+  }
+}
+
+//-----------------------FS--------------------------
+
+std::string FS::hostPath(const char* path) const {
+  std::string p = path != NULL ? path : "/";
+  if (p.compare(0, _mountpoint.length(), _mountpoint) == 0) {
+    p = p.substr(_mountpoint.length()); // POSIX path under the VFS mount point
+  }
+  if (p.empty() || p[0] != '/') {
+    p = "/" + p;
+  }
+  return simConfig.sdRoot + p;
+}
+
+File FS::open(const char* path, const char* mode, bool create) {
+  std::shared_ptr<FileImpl> impl = std::make_shared<FileImpl>();
+  impl->path = path;
+  impl->hostPath = hostPath(path);
+  impl->name = baseName(impl->path);
+  struct stat st;
+  if (stat(impl->hostPath.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+    impl->dir = opendir(impl->hostPath.c_str());
+    return impl->dir != NULL ? File(impl) : File();
+  }
+  std::string m = mode;
+  if (m == "r" || m == "r+") {
+    m += "b";
+  } else if (m == "w" || m == "w+" || m == "a" || m == "a+") {
+    m += "b";
+  }
+  impl->fp = fopen(impl->hostPath.c_str(), m.c_str());
+  return impl->fp != NULL ? File(impl) : File();
+}
+
+bool FS::exists(const char* path) {
+  struct stat st;
+  return stat(hostPath(path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char* path) { return ::unlink(hostPath(path).c_str()) == 0; }
+bool FS::rename(const char* pathFrom, const char* pathTo) { return ::rename(hostPath(pathFrom).c_str(), hostPath(pathTo).c_str()) == 0; }
+bool FS::mkdir(const char* path) { return ::mkdir(hostPath(path).c_str(), 0755) == 0 || errno == EEXIST; }
+bool FS::rmdir(const char* path) { return ::rmdir(hostPath(path).c_str()) == 0; }
+
+//-----------------------SD_MMC--------------------------
+
+bool SDMMCFS::begin(const char* mountpoint, bool mode1bit, bool formatIfMountFailed, int sdmmcFrequency, uint8_t maxOpenFiles) {
+  _mountpoint = mountpoint;
+  ::mkdir(simConfig.sdRoot.c_str(), 0755);
+  struct stat st;
+  _mounted = stat(simConfig.sdRoot.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+  return _mounted;
+}
+
+uint64_t SDMMCFS::cardSize() { return totalBytes(); }
+
+uint64_t SDMMCFS::totalBytes() {
+  struct statvfs vfs;
+  return statvfs(simConfig.sdRoot.c_str(), &vfs) == 0 ? (uint64_t)vfs.f_blocks * vfs.f_frsize : 0;
+}
+
+uint64_t SDMMCFS::usedBytes() {
+  struct statvfs vfs;
+  return statvfs(simConfig.sdRoot.c_str(), &vfs) == 0 ? (uint64_t)(vfs.f_blocks - vfs.f_bfree) * vfs.f_frsize : 0;
+}
+
+}  // namespace fs
@@ -0,0 +1,11 @@
+/**
+ * img_converters.h - host shim. The simulated camera only produces JPEG, so no conversion is ever needed.
+ */
+#ifndef HOST_SIM_IMG_CONVERTERS_H
+#define HOST_SIM_IMG_CONVERTERS_H
+
+#include "esp_camera.h"
+
+inline bool frame2jpg(camera_fb_t* fb, uint8_t quality, uint8_t** out, size_t* outLen) { return false; }
+
+#endif
@@ -0,0 +1,234 @@
+/**
+ * lgfx.cpp - memory framebuffer behind the LovyanGFX shim, and the PPM dump of the panel.
+ */
+#include "LovyanGFX.hpp"
+
+namespace lgfx {
+
+namespace fonts {
+const IFont Font0 = {"Font0", 8};
+const IFont Font2 = {"Font2", 16};
+const IFont Font4 = {"Font4", 26};
+const IFont DejaVu12 = {"DejaVu12", 14};
+const IFont DejaVu18 = {"DejaVu18", 21};
+const IFont DejaVu24 = {"DejaVu24", 28};
+const IFont DejaVu40 = {"DejaVu40", 47};
+const IFont DejaVu56 = {"DejaVu56", 66};
+const IFont DejaVu72 = {"DejaVu72", 84};
+}  // namespace fonts
+
+static std::mutex panelMutex;
+static LGFX_Device* panel = NULL;   // The device simLcdDump() writes out
+
+//-----------------------LGFXBase--------------------------
+
+void LGFXBase::resize(int32_t w, int32_t h) {
+  _width = w;
+  _height = h;
+  _buffer.assign((size_t)w * h, 0);
+  _text.clear();
+  clearClipRect();
+}
+
+void LGFXBase::setClipRect(int32_t x, int32_t y, int32_t w, int32_t h) {
+  _clipX0 = std::max<int32_t>(x, 0);
+  _clipY0 = std::max<int32_t>(y, 0);
+  _clipX1 = std::min<int32_t>(x + w, _width);
+  _clipY1 = std::min<int32_t>(y + h, _height);
+}
+
+void LGFXBase::coverText(int32_t x, int32_t y, int32_t w, int32_t h) {
+  int32_t x0 = std::max(x, _clipX0), y0 = std::max(y, _clipY0);
+  int32_t x1 = std::min(x + w, _clipX1), y1 = std::min(y + h, _clipY1);
+  _text.erase(std::remove_if(_text.begin(), _text.end(), [&](const TextItem& t) {
+    return t.x >= x0 && t.y >= y0 && t.x < x1 && t.y < y1;
+  }), _text.end());
+}
+
+void LGFXBase::fillSwapped(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t swapped) {
+  int32_t x0 = std::max<int32_t>(x, _clipX0), y0 = std::max<int32_t>(y, _clipY0);
+  int32_t x1 = std::min<int32_t>(x + w, _clipX1), y1 = std::min<int32_t>(y + h, _clipY1);
+  for (int32_t yy = y0; yy < y1; yy++) {
+    std::fill(&_buffer[yy * _width + x0], &_buffer[yy * _width + x0] + std::max<int32_t>(x1 - x0, 0), swapped);
+  }
+  coverText(x, y, w, h);
+}
+
+void LGFXBase::fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) { fillSwapped(x, y, w, h, swap565(from888(color))); }
+void LGFXBase::fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t color) { fillSwapped(x, y, w, h, swap565(color)); }
+
+void LGFXBase::drawRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) {
+  drawFastHLine(x, y, w, color);
+  drawFastHLine(x, y + h - 1, w, color);
+  drawFastVLine(x, y, h, color);
+  drawFastVLine(x + w - 1, y, h, color);
+}
+
+void LGFXBase::drawLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint32_t color) {
+  int32_t dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+  int32_t dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+  int32_t err = dx + dy;
+  while (true) {
+    drawPixel(x0, y0, color);
+    if (x0 == x1 && y0 == y1) break;
+    int32_t e2 = 2 * err;
+    if (e2 >= dy) { err += dy; x0 += sx; }
+    if (e2 <= dx) { err += dx; y0 += sy; }
+  }
+}
+
+void LGFXBase::pushImage(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t* data) {
+  // Clipped, then copied row by row like LovyanGFX does when the formats match
+  int32_t x0 = std::max<int32_t>(x, _clipX0), y0 = std::max<int32_t>(y, _clipY0);
+  int32_t x1 = std::min<int32_t>(x + w, _clipX1), y1 = std::min<int32_t>(y + h, _clipY1);
+  for (int32_t yy = y0; yy < y1 && x0 < x1; yy++) {
+    memcpy(&_buffer[yy * _width + x0], &data[(yy - y) * w + (x0 - x)], (x1 - x0) * sizeof(uint16_t));
+  }
+  coverText(x, y, w, h);
+  imagePushed(x, y, w, h);
+}
+
+size_t LGFXBase::print(const char* text) {
+  _text.push_back({_cursorX, _cursorY, _textColor, text});
+  _cursorX += textWidth(text);
+  return strlen(text);
+}
+
+size_t LGFXBase::vprintf(const char* format, va_list args) {
+  char buf[256];
+  vsnprintf(buf, sizeof(buf), format, args);
+  return print(buf);
+}
+
+size_t LGFXBase::printf(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  size_t n = vprintf(format, args);
+  va_end(args);
+  return n;
+}
+
+//-----------------------LGFX_Device--------------------------
+
+bool LGFX_Device::init() {
+  if (_panel == NULL) {
+    return false;
+  }
+  setRotation(_rotation);
+  std::lock_guard<std::mutex> lock(panelMutex);
+  panel = this;
+  return true;
+}
+
+void LGFX_Device::setRotation(uint8_t rotation) {
+  _rotation = rotation & 7;
+  Panel_Device::config_t cfg = _panel != NULL ? _panel->config() : Panel_Device::config_t();
+  std::lock_guard<std::mutex> lock(panelMutex);
+  if (_rotation & 1) {
+    resize(cfg.panel_height, cfg.panel_width);
+  } else {
+    resize(cfg.panel_width, cfg.panel_height);
+  }
+}
+
+void LGFX_Device::drawSprite(const LGFXBase& sprite, int32_t x, int32_t y) {
+  std::lock_guard<std::mutex> lock(panelMutex);
+  _pushing = &sprite;
+  pushImage(x, y, sprite.width(), sprite.height(), (const uint16_t*)const_cast<LGFXBase&>(sprite).getBuffer());
+  _pushing = NULL;
+  carryText(sprite, x, y, x, y, sprite.width(), sprite.height());
+}
+
+void LGFX_Device::imagePushed(int32_t x, int32_t y, int32_t w, int32_t h) {
+  if (_pushing != NULL) {
+    return;   // drawSprite() carries the text itself
+  }
+  for (const LGFXBase* sprite : _sprites) {
+    carryText(*sprite, 0, 0, x, y, w, h);   // Pixels taken from the buffer of a sprite shown at (0, 0)
+  }
+}
+
+void LGFX_Device::carryText(const LGFXBase& sprite, int32_t dx, int32_t dy, int32_t x, int32_t y, int32_t w, int32_t h) {
+  int32_t x0 = std::max(x, _clipX0), y0 = std::max(y, _clipY0);
+  int32_t x1 = std::min(x + w, _clipX1), y1 = std::min(y + h, _clipY1);
+  for (const TextItem& t : sprite.textItems()) {
+    if (t.x + dx >= x0 && t.y + dy >= y0 && t.x + dx < x1 && t.y + dy < y1) {
+      _text.push_back({t.x + dx, t.y + dy, t.color, t.text});
+    }
+  }
+}
+
+//-----------------------LGFX_Sprite--------------------------
+
+void* LGFX_Sprite::createSprite(int32_t w, int32_t h) {
+  resize(w, h);
+  return getBuffer();
+}
+
+void LGFX_Sprite::pushSprite(int32_t x, int32_t y) {
+  if (_parent != NULL && !_buffer.empty()) {
+    _parent->drawSprite(*this, x, y);
+  }
+}
+
+void LGFX_Sprite::setScrollRect(int32_t x, int32_t y, int32_t w, int32_t h) {
+  _scrollX = x;
+  _scrollY = y;
+  _scrollW = w;
+  _scrollH = h;
+}
+
+void LGFX_Sprite::scroll(int32_t dx, int32_t dy) {
+  int32_t x0 = std::max<int32_t>(_scrollX, 0), y0 = std::max<int32_t>(_scrollY, 0);
+  int32_t x1 = _scrollW < 0 ? _width : std::min<int32_t>(_scrollX + _scrollW, _width);
+  int32_t y1 = _scrollH < 0 ? _height : std::min<int32_t>(_scrollY + _scrollH, _height);
+  std::vector<uint16_t> moved(_buffer);
+  for (int32_t y = y0; y < y1; y++) {
+    for (int32_t x = x0; x < x1; x++) {
+      int32_t sx = x - dx, sy = y - dy;
+      bool inside = sx >= x0 && sy >= y0 && sx < x1 && sy < y1;
+      moved[y * _width + x] = inside ? _buffer[sy * _width + sx] : _baseColor;
+    }
+  }
+  _buffer.swap(moved);
+  std::vector<TextItem> kept;
+  for (TextItem t : _text) {
+    if (t.x >= x0 && t.y >= y0 && t.x < x1 && t.y < y1) {
+      t.x += dx;
+      t.y += dy;
+      if (t.x < x0 || t.y < y0 || t.x >= x1 || t.y >= y1) {
+        continue;   // Scrolled out
+      }
+    }
+    kept.push_back(t);
+  }
+  _text.swap(kept);
+}
+
+}  // namespace lgfx
+
+//-----------------------SIMULATOR--------------------------
+
+bool simLcdDump(const char* path) {
+  std::lock_guard<std::mutex> lock(lgfx::panelMutex);
+  if (lgfx::panel == NULL) {
+    return false;
+  }
+  FILE* fp = fopen(path, "wb");
+  if (fp == NULL) {
+    return false;
+  }
+  int32_t w = lgfx::panel->width(), h = lgfx::panel->height();
+  const uint16_t* buf = (const uint16_t*)lgfx::panel->getBuffer();
+  fprintf(fp, "P6\n%d %d\n255\n", w, h);
+  for (int32_t i = 0; i < w * h; i++) {
+    uint16_t c = (uint16_t)((buf[i] << 8) | (buf[i] >> 8));
+    uint8_t rgb[3] = {(uint8_t)((c >> 11) << 3), (uint8_t)(((c >> 5) & 0x3F) << 2), (uint8_t)((c & 0x1F) << 3)};
+    fwrite(rgb, 1, 3, fp);
+  }
+  fclose(fp);
+  for (const lgfx::TextItem& t : lgfx::panel->textItems()) {
+    printf("[host_sim] LCD text at (%d,%d) #%06X: %s\n", t.x, t.y, t.color, t.text.c_str());
+  }
+  return true;
+}
@@ -0,0 +1,375 @@
+/**
+ * network.cpp - WiFi, WiFiClient and HTTPClient on the host.
+ */
+#include "WiFi.h"
+#include "WiFiClientSecure.h"
+#include "HTTPClient.h"
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+WiFiClass WiFi;
+
+//-----------------------WIFI--------------------------
+
+bool simWifiUp() {
+  uint32_t now = (uint32_t)(simNowUs() / 1000000);
+  for (const auto& outage : simConfig.wifiOutages) {
+    if (now >= outage.first && now < outage.second) {
+      return false;
+    }
+  }
+  return true;
+}
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* pass) { return status(); }
+wl_status_t WiFiClass::status() { return simWifiUp() ? WL_CONNECTED : WL_DISCONNECTED; }
+int8_t WiFiClass::RSSI() { return simWifiUp() ? -55 : 0; }
+
+//-----------------------WIFICLIENT--------------------------
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+  stop();
+  if (!simWifiUp()) {
+    return 0;
+  }
+  struct addrinfo hints = {};
+  struct addrinfo* res = NULL;
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(host, String(port).c_str(), &hints, &res) != 0 || res == NULL) {
+    return 0;
+  }
+  int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+  if (fd >= 0 && ::connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(res);
+  if (fd < 0) {
+    return 0;
+  }
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  _fd = fd;
+  _bufPos = _bufLen = 0;
+  return 1;
+}
+
+void WiFiClient::stop() {
+  if (_fd >= 0) {
+    close(_fd);
+    _fd = -1;
+  }
+  _bufPos = _bufLen = 0;
+}
+
+uint8_t WiFiClient::connected() {
+  if (_fd < 0) {
+    return 0;
+  }
+  if (_bufPos < _bufLen) {
+    return 1;
+  }
+  if (!simWifiUp()) {
+    stop(); // The link went down under the connection
+    return 0;
+  }
+  // A readable socket with nothing to read has been closed by the peer
+  struct pollfd pfd = {_fd, POLLIN, 0};
+  if (poll(&pfd, 1, 0) > 0) {
+    if (pfd.revents & (POLLERR | POLLHUP)) {
+      stop();
+      return 0;
+    }
+    char c;
+    if (recv(_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 0) {
+      stop();
+      return 0;
+    }
+  }
+  return 1;
+}
+
+size_t WiFiClient::write(const uint8_t* buf, size_t size) {
+  if (_fd < 0 || !simWifiUp()) {
+    return 0;
+  }
+  size_t sent = 0;
+  while (sent < size) {
+    ssize_t n = send(_fd, buf + sent, size - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      stop();
+      break;
+    }
+    sent += n;
+  }
+  return sent;
+}
+
+bool WiFiClient::fill(int waitMs) {
+  if (_fd < 0) {
+    return false;
+  }
+  if (_bufPos < _bufLen) {
+    return true;
+  }
+  struct pollfd pfd = {_fd, POLLIN, 0};
+  if (poll(&pfd, 1, waitMs) <= 0) {
+    return false;
+  }
+  ssize_t n = recv(_fd, _buf, sizeof(_buf), 0);
+  if (n <= 0) {
+    stop();
+    return false;
+  }
+  _bufPos = 0;
+  _bufLen = n;
+  return true;
+}
+
+int WiFiClient::available() {
+  fill(0);
+  return (int)(_bufLen - _bufPos);
+}
+
+int WiFiClient::read() {
+  // Network latency is real, so the timeout is in host time
+  if (!fill((int)_timeoutMs)) {
+    return -1;
+  }
+  return _buf[_bufPos++];
+}
+
+int WiFiClient::read(uint8_t* buf, size_t size) {
+  size_t n = 0;
+  while (n < size && fill(n == 0 ? (int)_timeoutMs : 0)) {
+    size_t chunk = std::min(size - n, _bufLen - _bufPos);
+    memcpy(buf + n, _buf + _bufPos, chunk);
+    _bufPos += chunk;
+    n += chunk;
+  }
+  return (int)n;
+}
+
+int WiFiClient::peek() {
+  return fill(0) ? _buf[_bufPos] : -1;
+}
+
+int WiFiClientSecure::connect(const char* host, uint16_t port) {
+  size_t colon = simConfig.tlsStandIn.rfind(':');
+  if (colon == std::string::npos) {
+    Serial.printf("[host_sim] TLS is not available, connection to %s:%u refused\n", host, port);
+    return 0;
+  }
+  // Plain text to the stand-in server, whatever host the sketch asked for
+  std::string standInHost = simConfig.tlsStandIn.substr(0, colon);
+  return WiFiClient::connect(standInHost.c_str(), (uint16_t)atoi(simConfig.tlsStandIn.c_str() + colon + 1));
+}
+
+//-----------------------HTTPCLIENT--------------------------
+
+// Splits "http://host[:port]/path"; https URLs keep their scheme in the port (443) and fail in WiFiClientSecure
+static bool splitUrl(const String& url, String& host, uint16_t& port, String& path) {
+  int schemeEnd = url.indexOf("://");
+  if (schemeEnd < 0) {
+    return false;
+  }
+  bool secure = url.substring(0, schemeEnd).equalsIgnoreCase("https");
+  int hostStart = schemeEnd + 3;
+  int pathStart = url.indexOf('/', hostStart);
+  String hostPort = pathStart < 0 ? url.substring(hostStart) : url.substring(hostStart, pathStart);
+  path = pathStart < 0 ? String("/") : url.substring(pathStart);
+  int colon = hostPort.indexOf(':');
+  host = colon < 0 ? hostPort : hostPort.substring(0, colon);
+  port = colon < 0 ? (secure ? 443 : 80) : (uint16_t)hostPort.substring(colon + 1).toInt();
+  return true;
+}
+
+bool HTTPClient::begin(WiFiClient& client, const String& url) {
+  _client = &client;
+  _requestHeaders = "";
+  _contentLength = -1;
+  _bodyRead = false;
+  if (!splitUrl(url, _host, _port, _path)) {
+    return false;
+  }
+  // Requests to ThingSpeak (e.g. the bulk updates) go to the stand-in server when one is given
+  if (_host.equalsIgnoreCase("api.thingspeak.com") && !simConfig.thingspeakServer.empty()) {
+    String path;
+    splitUrl(String(simConfig.thingspeakServer.c_str()) + "/", _host, _port, path);
+  }
+  return true;
+}
+
+bool HTTPClient::begin(const String& url) {
+  if (_ownClient == NULL) {
+    _ownClient = url.startsWith("https") ? new WiFiClientSecure() : new WiFiClient();
+  }
+  _reuse = false;
+  return begin(*_ownClient, url);
+}
+
+void HTTPClient::end() {
+  if (_client != NULL && _client->connected() && !_bodyRead && _contentLength > 0) {
+    getString(); // Drain the body so the connection can be reused
+  }
+  if (_client != NULL && !(_reuse && _canReuse)) {
+    _client->stop();
+  }
+  if (_ownClient != NULL) {
+    delete _ownClient;
+    _ownClient = NULL;
+  }
+  _client = NULL;
+}
+
+void HTTPClient::collectHeaders(const char* headerKeys[], size_t count) {
+  _collect.clear();
+  for (size_t i = 0; i < count; i++) {
+    String key = headerKeys[i];
+    key.toLowerCase();
+    _collect[key.str()] = "";
+  }
+}
+
+String HTTPClient::header(const char* name) {
+  String key = name;
+  key.toLowerCase();
+  auto it = _collect.find(key.str());
+  return it != _collect.end() ? it->second : String();
+}
+
+int HTTPClient::sendHeader(const char* type, size_t size) {
+  if (_client == NULL) {
+    return HTTPC_ERROR_NOT_CONNECTED;
+  }
+  if (!_client->connected() && !_client->connect(_host.c_str(), _port)) {
+    return HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+  String request = String(type) + " " + _path + " HTTP/1.1\r\n";
+  request += "Host: " + _host + (_port != 80 ? ":" + String(_port) : String("")) + "\r\n";
+  request += "User-Agent: ESP32HTTPClient\r\n";
+  request += String("Connection: ") + (_reuse ? "keep-alive" : "close") + "\r\n";
+  if (size > 0 || strcmp(type, "POST") == 0) {
+    request += "Content-Length: " + String((unsigned long)size) + "\r\n";
+  }
+  request += _requestHeaders + "\r\n";
+  if (_client->write((const uint8_t*)request.c_str(), request.length()) != request.length()) {
+    return HTTPC_ERROR_SEND_HEADER_FAILED;
+  }
+  return 0;
+}
+
+int HTTPClient::sendRequest(const char* type, uint8_t* payload, size_t size) {
+  int err = sendHeader(type, size);
+  if (err < 0) {
+    return err;
+  }
+  if (size > 0 && _client->write(payload, size) != size) {
+    return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+  }
+  return readResponse();
+}
+
+int HTTPClient::sendRequest(const char* type, Stream* stream, size_t size) {
+  int err = sendHeader(type, size);
+  if (err < 0) {
+    return err;
+  }
+  char buf[1436]; // Same chunk size as the ESP32 HTTPClient (one TCP segment)
+  size_t sent = 0;
+  while (sent < size) {
+    size_t n = stream->readBytes(buf, std::min(sizeof(buf), size - sent));
+    if (n == 0 || _client->write((const uint8_t*)buf, n) != n) {
+      return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+    }
+    sent += n;
+  }
+  return readResponse();
+}
+
+bool HTTPClient::readLine(String& line) {
+  line = "";
+  for (;;) {
+    int c = _client->read();
+    if (c < 0) {
+      return false;
+    }
+    if (c == '\n') {
+      line.trim();
+      return true;
+    }
+    line += (char)c;
+  }
+}
+
+int HTTPClient::readResponse() {
+  _client->setTimeout(_timeoutMs / 1000 + 1);
+  String line;
+  if (!readLine(line)) {
+    return HTTPC_ERROR_READ_TIMEOUT;
+  }
+  int space = line.indexOf(' ');
+  if (!line.startsWith("HTTP/") || space < 0) {
+    return HTTPC_ERROR_NO_HTTP_SERVER;
+  }
+  int code = line.substring(space + 1).toInt();
+  _contentLength = -1;
+  _canReuse = _reuse;
+  _bodyRead = false;
+  for (auto& entry : _collect) {
+    entry.second = "";
+  }
+  while (readLine(line) && line.length() > 0) {
+    int colon = line.indexOf(':');
+    if (colon < 0) {
+      continue;
+    }
+    String name = line.substring(0, colon);
+    String value = line.substring(colon + 1);
+    name.toLowerCase();
+    value.trim();
+    if (name == "content-length") {
+      _contentLength = value.toInt();
+    } else if (name == "connection" && value.equalsIgnoreCase("close")) {
+      _canReuse = false;
+    }
+    auto it = _collect.find(name.str());
+    if (it != _collect.end()) {
+      it->second = value;
+    }
+  }
+  if (_contentLength < 0) {
+    _canReuse = false; // Body runs until the server closes
+  }
+  return code;
+}
+
+String HTTPClient::getString() {
+  String body;
+  if (_client == NULL || _bodyRead) {
+    return body;
+  }
+  _bodyRead = true;
+  if (_contentLength >= 0) {
+    body.reserve(_contentLength);
+    for (int i = 0; i < _contentLength; i++) {
+      int c = _client->read();
+      if (c < 0) {
+        break;
+      }
+      body += (char)c;
+    }
+  } else {
+    for (int c = _client->read(); c >= 0; c = _client->read()) {
+      body += (char)c;
+    }
+  }
+  return body;
+}
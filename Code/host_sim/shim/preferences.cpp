@@ -0,0 +1,117 @@
+/**
+ * preferences.cpp - Preferences (NVS) on the host, one file per key, see Preferences.h.
+ */
+#include "Preferences.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::string Preferences::path(const char* key) const {
+  return dir + "/" + key;
+}
+
+bool Preferences::begin(const char* name, bool readOnly, const char* partitionLabel) {
+  if (opened || name == NULL || strlen(name) > 15) {
+    return false;
+  }
+  mkdir(simConfig.nvsDir.c_str(), 0755);
+  dir = simConfig.nvsDir + "/" + name;
+  struct stat st;
+  if (stat(dir.c_str(), &st) != 0) {
+    // As nvs_open(): a namespace that does not exist cannot be opened read-only
+    if (readOnly || mkdir(dir.c_str(), 0755) != 0) {
+      return false;
+    }
+  }
+  this->readOnly = readOnly;
+  opened = true;
+  return true;
+}
+
+void Preferences::end() {
+  opened = false;
+}
+
+bool Preferences::clear() {
+  if (!opened || readOnly) {
+    return false;
+  }
+  DIR* d = opendir(dir.c_str());
+  if (d == NULL) {
+    return false;
+  }
+  while (struct dirent* entry = readdir(d)) {
+    if (entry->d_name[0] != '.') {
+      unlink(path(entry->d_name).c_str());
+    }
+  }
+  closedir(d);
+  return true;
+}
+
+bool Preferences::remove(const char* key) {
+  return opened && !readOnly && unlink(path(key).c_str()) == 0;
+}
+
+bool Preferences::isKey(const char* key) {
+  return getBytesLength(key) > 0;
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t len) {
+  if (!opened || readOnly || key == NULL || strlen(key) > 15) {
+    return 0;
+  }
+  // Written to a temporary file and renamed: a key is either the old or the new value, as in NVS
+  std::string tmp = path(key) + ".tmp";
+  FILE* f = fopen(tmp.c_str(), "wb");
+  if (f == NULL) {
+    return 0;
+  }
+  bool ok = fwrite(value, 1, len, f) == len;
+  ok = fclose(f) == 0 && ok;
+  if (!ok || rename(tmp.c_str(), path(key).c_str()) != 0) {
+    unlink(tmp.c_str());
+    return 0;
+  }
+  return len;
+}
+
+size_t Preferences::putUChar(const char* key, uint8_t value) {
+  return putBytes(key, &value, sizeof(value));
+}
+
+size_t Preferences::putUInt(const char* key, uint32_t value) {
+  return putBytes(key, &value, sizeof(value));
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+  struct stat st;
+  if (!opened || stat(path(key).c_str(), &st) != 0) {
+    return 0;
+  }
+  return (size_t)st.st_size;
+}
+
+size_t Preferences::getBytes(const char* key, void* buf, size_t maxLen) {
+  size_t len = getBytesLength(key);
+  if (len == 0 || len > maxLen) {
+    return 0;
+  }
+  FILE* f = fopen(path(key).c_str(), "rb");
+  if (f == NULL) {
+    return 0;
+  }
+  size_t n = fread(buf, 1, len, f);
+  fclose(f);
+  return n;
+}
+
+uint8_t Preferences::getUChar(const char* key, uint8_t defaultValue) {
+  uint8_t value;
+  return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : defaultValue;
+}
+
+uint32_t Preferences::getUInt(const char* key, uint32_t defaultValue) {
+  uint32_t value;
+  return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : defaultValue;
+}
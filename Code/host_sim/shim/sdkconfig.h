@@ -0,0 +1,7 @@
+/**
+ * sdkconfig.h - host shim, no ESP-IDF options are needed by the sketch.
+ */
+#ifndef HOST_SIM_SDKCONFIG_H
+#define HOST_SIM_SDKCONFIG_H
+
+#endif
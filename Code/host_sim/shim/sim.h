@@ -0,0 +1,139 @@
+/**
+ * sim.h
+ *
+ * Settings and virtual clock of the host build. The shims below (Arduino.h, FreeRTOS, esp_timer, WiFi, SD_MMC, Preferences,
+ * camera, LovyanGFX) read their behaviour from simConfig, which main.cpp fills from the command line.
+ *
+ * Virtual time runs 'speed' times faster than the host clock: millis(), micros(), esp_timer_get_time() and time() return
+ * virtual time, and every delay, tick wait and esp_timer period is divided by 'speed' before the host thread sleeps.
+ * The tasks keep running on real threads, so the code under test is the same code that runs on the board.
+ *
+ * Author: John Leung
+ * Date: October 16, 2026
+ */
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <utility>
+
+// A parameter of the --tune grid: first, first + step, ... up to last
+struct SimRange {
+  double first, last, step;
+};
+
+struct SimConfig {
+  double speed = 60.0;              // Virtual seconds per host second
+  uint32_t durationS = 3600;        // Virtual run time
+  std::string sdRoot = "sim_sd";    // Host directory behind SD_MMC
+  std::string nvsDir = "sim_nvs";   // Host directory behind the NVS of Preferences
+  std::string cameraDir = "";       // JPEG files served by esp_camera_fb_get(), a built-in test image if empty
+  uint32_t cameraFrameMs = 40;      // Virtual time of one capture (25 fps)
+  std::vector<std::pair<uint32_t, uint32_t>> wifiOutages;  // [start, end) in virtual seconds
+  std::string thingspeakServer = "";  // e.g. http://127.0.0.1:8081, replaces api.thingspeak.com; writeFields() only logs if empty
+  std::string metricsOut = "";      // File to write the /metrics page to at the end, "-" for stdout
+  std::string lcdDump = "";         // PPM file to write the LCD framebuffer to at the end
+  int httpPort = 8000;              // Host port of the board's port 80 server (port 81 -> httpPort + 1), 0 = no listener
+  std::string tlsStandIn = "";      // host:port that https connections reach in plain text (e.g. apps_script_standin.py)
+  uint8_t sensorPin = 1;            // Pin read by analogRead() through the soil model
+  uint8_t relayPin = 47;            // Pin that waters the soil model when HIGH
+  double soilMoisture = 40.0;       // Initial soil moisture in percent
+  double dryingPerHour = 6.0;       // Moisture lost per virtual hour
+  double wateringPerSecond = 2.0;   // Moisture gained per second of relay on-time
+  double adcSpikes = 0.0;           // Probability of a spike (WiFi transmitting) per ADC sample while WiFi is up
+  std::vector<uint16_t> adcTrace;   // Recorded raw ADC samples replayed instead of the soil model (--adc-trace), looped
+  bool quiet = false;               // Do not echo Serial output
+  bool serialToStderr = false;      // Echo Serial output on stderr, stdout carries the results (--sd-bench)
+  std::string sdBench = "";         // "csv" or "json": run the SD benchmark on sdRoot instead of the sketch
+  uint8_t zoneTest = 0;             // Zones of the multi-zone scheduler test (--zone-test), 0 = run the sketch
+  uint8_t zoneMaxActive = 1;        // Pumps the scheduler may run at once in that test
+  uint32_t stallTestS = 0;          // Seconds loop() is blocked during each watering of the stall test (--stall-test)
+  bool filterTest = false;          // Check the moisture filter on the --filter-test trace instead of running the sketch
+  uint32_t schedulerTestSteps = 0;  // Random clock steps of the scheduler stress check (--scheduler-test), 0 = off
+  std::string storageTest = "";     // SD card module checks (--storage-test, storage_test.cpp): "all" or a module name
+  // Tuning sweep (--tune, tune.cpp): the sketch's controller against the soil-water model, one run per grid point
+  double tuneDays = 0;              // Virtual days of each run, 0 = run the sketch
+  unsigned tuneJobs = 0;            // Runs in parallel, 0 = one per core
+  SimRange gridLower = {30, 30, 1};         // lowerMoistureThreshold, %
+  SimRange gridUpper = {35, 35, 1};         // upperMoistureThreshold, %
+  SimRange gridOnMs = {1000, 1000, 1};      // pumpOnTime
+  SimRange gridSoakMs = {20000, 20000, 1};  // pumpSoakTime
+  double bandLow = 30, bandHigh = 35;       // Moisture band the time out of band is measured against
+  double etPerDay = 15;             // Evapotranspiration of a well-watered plant, % of the root zone per day
+  double infiltrationS = 120;       // Time constant of the water reaching the root zone from the surface
+  double sensorLagS = 60;           // Time constant of the probe following the root zone
+  double sensorNoise = 0.5;         // Standard deviation of one reading, %
+  double pumpFlowMlPerS = 30;       // Flow of the pump, for the water used
+  bool tunePredictive = false;      // Dose each watering with watering_model.cpp (--controller predictive)
+  double modelTestDays = 0;         // Virtual days of the watering model check (--model-test), 0 = off
+};
+
+extern SimConfig simConfig;
+
+// Virtual time of the stepped clock, -1 while virtual time follows the host clock. Set it to 0 before the first timer is
+// created to step the clock by hand (--tune): then it only moves with simAdvanceToUs(), and the esp_timer callbacks run
+// inside that call on the caller's thread, so a single-threaded run is deterministic and as fast as the host allows.
+extern int64_t simSteppedUs;
+
+/**
+ * @brief Virtual microseconds since the start of the run.
+ */
+int64_t simNowUs();
+
+/**
+ * @brief Moves the stepped clock forward to the given virtual time, running the esp_timer callbacks due on the way in
+ *        deadline order, each with the clock at its deadline.
+ */
+void simAdvanceToUs(int64_t virtualUs);
+
+/**
+ * @brief Deadline of the earliest armed esp_timer in virtual microseconds, INT64_MAX if none is armed.
+ */
+int64_t simNextTimerUs();
+
+/**
+ * @brief Sleeps the calling host thread for the given virtual time.
+ */
+void simSleepUs(int64_t virtualUs);
+
+/**
+ * @brief Host time (in microseconds) corresponding to a virtual duration.
+ */
+int64_t simToHostUs(int64_t virtualUs);
+
+/**
+ * @brief true while the simulated WiFi is up (outside the configured outages).
+ */
+bool simWifiUp();
+
+/**
+ * @brief One raw 12-bit ADC sample of the given pin: the soil model with noise for the sensor pin, or the next sample of
+ *        the recorded trace. analogRead() and the ADC continuous driver both read it.
+ */
+uint16_t simAdcSample(uint8_t pin);
+
+/**
+ * @brief Counts the pins 0 .. count - 1 that are HIGH at the same time, from now on. The count is kept by digitalWrite()
+ *        under the GPIO lock, so every switch of every task is seen in order, however the reader is scheduled.
+ */
+void simGpioWatch(uint8_t count);
+
+/**
+ * @brief Most pins of the simGpioWatch() range that have been HIGH at the same time.
+ */
+uint8_t simGpioPeakHigh();
+
+/**
+ * @brief Calls the handler registered for a GET on the port 80 server and writes the response to the given stream.
+ * @return true if a handler was found.
+ */
+bool simHttpGet(const char* uri, FILE* out);
+
+/**
+ * @brief Writes the LCD framebuffer as a binary PPM file.
+ */
+bool simLcdDump(const char* path);
+
+#endif
@@ -0,0 +1,335 @@
+/**
+ * storage_test.cpp
+ *
+ * Checks the SD card modules of the sketch on a scratch directory that stands in for the card, including what a power
+ * loss in the middle of an update leaves behind: the test takes a copy of the file's bytes before the update and puts
+ * back the part that the update writes last, which is the card's state if the power had gone before that write.
+ *
+ * spool  sd_spool.cpp: preallocated size, FIFO order, the oldest job dropped when full, a power loss during an append
+ * index  capture_index.cpp: a number taken only by a saved image, a power loss between the record and the header
+ * log    sensor_log.cpp: one aggregate per hour across reboots, a power loss during a compaction
+ * retention  capture_retention.cpp: the age limit past images without a capture time
+ *
+ * Author: John Leung
+ * Date: October 16, 2026
+ */
+#include "storage_test.h"
+#include "Arduino.h"
+#include "SD_MMC.h"
+#include "capture_index.h"
+#include "capture_retention.h"
+#include "sd_read_write.h"
+#include "sensor_log.h"
+#include "sd_spool.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+static int failures = 0;
+
+#define CHECK(condition) \
+  do { \
+    if (!(condition)) { \
+      printf("  check failed: %s (%s:%d)\n", #condition, __FILE__, __LINE__); \
+      failures++; \
+    } \
+  } while (0)
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+static std::string hostPath(const char* path) {
+  return simConfig.sdRoot + path;
+}
+
+static std::vector<uint8_t> readHostFile(const char* path) {
+  std::vector<uint8_t> bytes;
+  FILE* f = fopen(hostPath(path).c_str(), "rb");
+  if (f != NULL) {
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+      bytes.insert(bytes.end(), buf, buf + n);
+    }
+    fclose(f);
+  }
+  return bytes;
+}
+
+/**
+ * @brief Writes bytes [offset, offset + length) of 'bytes' back into the file: the state of that range before an
+ *        update, as if the power had gone before the update wrote it.
+ */
+static void restoreHostRange(const char* path, const std::vector<uint8_t>& bytes, size_t offset, size_t length) {
+  FILE* f = fopen(hostPath(path).c_str(), "r+b");
+  if (f != NULL) {
+    fseek(f, (long)offset, SEEK_SET);
+    fwrite(bytes.data() + offset, 1, length, f);
+    fclose(f);
+  }
+}
+
+/**
+ * @brief Pops every job of the spool and checks that their sequence numbers run from 'first' without a gap.
+ */
+static void checkSpoolDrains(uint32_t first, uint32_t count) {
+  CHECK(sdSpoolCount() == count);
+  spool_record_t record;
+  for (uint32_t i = 0; i < count; i++) {
+    bool peeked = sdSpoolPeek(record);
+    CHECK(peeked);
+    if (!peeked) {
+      return;
+    }
+    CHECK(record.seq == first + i);
+    CHECK(record.moisture == (uint8_t)(first + i));
+    sdSpoolPop();
+  }
+  CHECK(sdSpoolCount() == 0);
+  CHECK(!sdSpoolPeek(record));
+}
+
+static void testSpool() {
+  const char* path = "/spool_test.bin";
+  const uint32_t capacity = 5;
+  const size_t headers = 64;  // Two copies of the 32-byte header
+  char jpg[SPOOL_PATH_LENGTH];
+
+  CHECK(sdSpoolBegin(SD_MMC, path, capacity));
+  CHECK(readHostFile(path).size() == headers + capacity * sizeof(spool_record_t));
+
+  // In order, and kept across a reboot
+  for (uint32_t i = 0; i < 3; i++) {
+    snprintf(jpg, sizeof(jpg), "/camera/%u.jpg", i);
+    CHECK(sdSpoolAppend(jpg, (uint8_t)i, 1000 + i));
+  }
+  CHECK(sdSpoolBegin(SD_MMC, path, capacity));
+  spool_record_t record;
+  CHECK(sdSpoolPeek(record) && record.seq == 0 && strcmp(record.jpgPath, "/camera/0.jpg") == 0 && record.timestamp == 1000);
+  checkSpoolDrains(0, 3);
+
+  // Full: capacity - 1 jobs, the oldest dropped by each append
+  for (uint32_t i = 3; i < 3 + 2 * capacity; i++) {
+    CHECK(sdSpoolAppend("", (uint8_t)i, 0));
+  }
+  uint32_t next = 3 + 2 * capacity;
+  CHECK(sdSpoolCount() == capacity - 1);
+  CHECK(sdSpoolPeek(record) && record.seq == next - (capacity - 1));
+
+  // Power loss during an append to the full spool: the record is on the card, the header is not
+  std::vector<uint8_t> before = readHostFile(path);
+  CHECK(sdSpoolAppend("", (uint8_t)next, 0));
+  restoreHostRange(path, before, 0, headers);
+  CHECK(sdSpoolBegin(SD_MMC, path, capacity));
+  checkSpoolDrains(next - (capacity - 1), capacity - 1);
+
+  // Power loss during the append of a record (torn record): the spool is as before, and the next append takes the slot
+  CHECK(sdSpoolAppend("", (uint8_t)next, 0));
+  before = readHostFile(path);
+  CHECK(sdSpoolAppend("", (uint8_t)(next + 1), 0));
+  restoreHostRange(path, before, 0, headers);
+  CHECK(sdSpoolBegin(SD_MMC, path, capacity));
+  checkSpoolDrains(next, 1);
+  SD_MMC.remove(path);
+}
+
+/**
+ * @brief Saves an image the way upload_worker.cpp does: a name from the index, the file, then the record.
+ */
+static int32_t saveImage(capture_index_t& index, uint32_t timestamp) {
+  static const uint8_t jpg[] = {0xFF, 0xD8, 0xFF, 0xD9};
+  String path;
+  int32_t seq = captureIndexNext(index, timestamp, path);
+  if (seq < 0 || !writejpg(SD_MMC, path.c_str(), jpg, sizeof(jpg)) ||
+      !captureIndexAdd(index, seq, timestamp, sizeof(jpg), 50)) {
+    return -1;
+  }
+  return seq;
+}
+
+static void testIndex() {
+  const char* path = "/camera.idx";
+  const size_t headers = 48;  // Two copies of the 24-byte header
+  const uint32_t timestamp = 1792141200;  // 2026-10-16 03:00 UTC
+  String jpg, again;
+
+  capture_index_t index;
+  CHECK(captureIndexBegin(index, SD_MMC, "/camera"));
+  CHECK(index.nextSeq == 0 && captureIndexCount(index) == 0);
+
+  // A write that fails (no captureIndexAdd()) does not take the number
+  CHECK(captureIndexNext(index, timestamp, jpg) == 0);
+  CHECK(captureIndexNext(index, timestamp, again) == 0 && again == jpg);
+  CHECK(captureIndexCount(index) == 0);
+  CHECK(saveImage(index, timestamp) == 0);
+  CHECK(SD_MMC.exists(jpg));
+  CHECK(saveImage(index, 0) == 1);
+  CHECK(captureIndexCount(index) == 2);
+
+  // Kept across a reboot
+  capture_index_t rebooted;
+  CHECK(captureIndexBegin(rebooted, SD_MMC, "/camera"));
+  CHECK(rebooted.nextSeq == 2 && captureIndexCount(rebooted) == 2);
+  capture_record_t record;
+  CHECK(captureIndexGet(rebooted, 0, record) && record.timestamp == timestamp && record.status == CAPTURE_STATUS_SAVED);
+  CHECK(captureIndexPath(rebooted, 0, again) && again == jpg);
+
+  // A reboot between captureIndexNext() and the end of the write hands out the same number again
+  CHECK(captureIndexNext(rebooted, timestamp, jpg) == 2);
+  capture_index_t restarted;
+  CHECK(captureIndexBegin(restarted, SD_MMC, "/camera"));
+  CHECK(captureIndexNext(restarted, timestamp, again) == 2 && again == jpg);
+
+  // Power loss after the record, before the header: the record takes its number at the next boot
+  std::vector<uint8_t> before = readHostFile(path);
+  CHECK(saveImage(restarted, timestamp) == 2);
+  restoreHostRange(path, before, 0, headers);
+  capture_index_t recovered;
+  CHECK(captureIndexBegin(recovered, SD_MMC, "/camera"));
+  CHECK(recovered.nextSeq == 3 && captureIndexCount(recovered) == 3);
+  CHECK(captureIndexGet(recovered, 2, record) && record.timestamp == timestamp);
+  CHECK(saveImage(recovered, timestamp) == 3);
+}
+
+static bool collectHour(const sensor_log_hour_t& hour, void* arg) {
+  ((std::vector<sensor_log_hour_t>*)arg)->push_back(hour);
+  return true;
+}
+
+/**
+ * @brief Appends 'count' readings a minute apart from the start of an hour.
+ */
+static void appendHour(uint32_t hourStart, uint8_t moisture, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    CHECK(sensorLogAppend(hourStart + i * 60, 2000, moisture, 0, 0));
+  }
+}
+
+/**
+ * @brief Checks that hourly.bin holds one aggregate per hour from 'first', in order, each of 'count' readings, and
+ *        'undated' readings without a clock in one aggregate.
+ */
+static void checkHours(uint32_t first, uint32_t hours, uint32_t count, uint32_t undated = 0) {
+  std::vector<sensor_log_hour_t> found;
+  sensorLogScanHours(0, UINT32_MAX, collectHour, &found);
+  uint32_t dated = 0, undatedAggregates = 0;
+  for (const sensor_log_hour_t& h : found) {
+    if (h.hour == 0) {
+      undatedAggregates++;
+      CHECK(h.count == undated);
+      continue;
+    }
+    CHECK(h.hour == first + dated * 3600);
+    CHECK(h.count == count && h.moistureMean == 40 + dated);
+    dated++;
+  }
+  CHECK(dated == hours);
+  CHECK(undatedAggregates == (undated > 0 ? 1u : 0u));
+}
+
+static void testLog() {
+  const char* hourly = "/log/" SENSOR_LOG_HOURLY_FILE;
+  const size_t headers = 64;  // Two copies of the 32-byte header
+  const uint32_t hour = 1792141200;  // 2026-10-16 03:00 UTC
+
+  CHECK(sensorLogBegin(SD_MMC, "/log"));
+  checkHours(hour, 0, 10);
+  // A new hour closes the segment and compacts it
+  for (uint32_t i = 0; i < 3; i++) {
+    appendHour(hour + i * 3600, 40 + i, 10);
+  }
+  checkHours(hour, 2, 10);
+
+  // A reboot compacts the segment left open, and the next reboot compacts nothing again
+  CHECK(sensorLogFlush());
+  CHECK(sensorLogBegin(SD_MMC, "/log"));
+  checkHours(hour, 3, 10);
+  CHECK(sensorLogBegin(SD_MMC, "/log"));
+  checkHours(hour, 3, 10);
+
+  // Power loss during the compaction of a segment of two hours (readings before NTP set the clock, then hour 3), after
+  // its first aggregate: the segment is compacted again at the next boot, with no hour lost or counted twice
+  std::vector<uint8_t> before = readHostFile(hourly);
+  for (uint32_t i = 0; i < 5; i++) {
+    CHECK(sensorLogAppend(i, 2000, 30, 0, 0));
+  }
+  appendHour(hour + 3 * 3600, 43, 10);
+  appendHour(hour + 4 * 3600, 44, 10);
+  CHECK(sensorLogFlush());
+  CHECK(truncate(hostPath(hourly).c_str(), before.size() + sizeof(sensor_log_hour_t)) == 0);
+  restoreHostRange(hourly, before, 0, headers);
+  CHECK(sensorLogBegin(SD_MMC, "/log"));
+  checkHours(hour, 5, 10, 5);
+  CHECK(sensorLogBegin(SD_MMC, "/log"));
+  checkHours(hour, 5, 10, 5);
+
+  // A torn aggregate at the end of the file does not make the raw segments count again
+  FILE* f = fopen(hostPath(hourly).c_str(), "ab");
+  if (f != NULL) {
+    uint8_t torn[sizeof(sensor_log_hour_t)];
+    memset(torn, 0xA5, sizeof(torn));
+    fwrite(torn, 1, sizeof(torn), f);
+    fclose(f);
+  }
+  CHECK(sensorLogBegin(SD_MMC, "/log"));
+  checkHours(hour, 5, 10, 5);
+}
+
+static void testRetention() {
+  const uint32_t now = (uint32_t)time(NULL);
+  const uint32_t old = now - 200 * 86400, recent = now - 86400;
+  capture_retention_policy_t policy = {0, 0, 0, 180, 0, 0, 100, 60000};  // Only the age limit
+  capture_index_t index;
+  CHECK(captureIndexBegin(index, SD_MMC, "/retention"));
+
+  // Captured before NTP set the clock (0 to 2), then 200 days ago (3 to 5), then yesterday: 6 undated, 7 and 8 dated
+  uint32_t timestamps[] = {0, 0, 0, old, old + 30, old + 60, 0, recent, recent + 30};
+  for (uint32_t timestamp : timestamps) {
+    saveImage(index, timestamp);
+  }
+  captureRetentionBegin(index, &policy);
+  CHECK(captureRetentionGetStats().images == 9);
+  CHECK(captureRetentionRun() == 6);
+  CHECK(index.firstSeq == 6);
+  capture_record_t record;
+  CHECK(captureIndexGet(index, 6, record) && record.status == CAPTURE_STATUS_SAVED);
+  CHECK(captureIndexGet(index, 2, record) && record.status == CAPTURE_STATUS_DELETED);
+  CHECK(captureRetentionGetStats().images == 3);
+
+  // Image 6 was captured before the recent image 7, so it stays, and the next batch has nothing to delete
+  CHECK(captureRetentionRun() == 0);
+  CHECK(index.firstSeq == 6);
+}
+
+static void runModule(const char* name, void (*test)()) {
+  if (simConfig.storageTest != "all" && simConfig.storageTest != name) {
+    return;
+  }
+  int before = failures;
+  printf("%s:\n", name);
+  test();
+  printf("%s: %s\n", name, failures == before ? "PASS" : "FAIL");
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+int runStorageTest() {
+  char scratch[] = "/tmp/plant_sim_storage.XXXXXX";
+  if (mkdtemp(scratch) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+  simConfig.sdRoot = scratch;
+  simConfig.quiet = true;
+  sdmmcInit();
+
+  runModule("spool", testSpool);
+  runModule("index", testIndex);
+  runModule("log", testLog);
+  runModule("retention", testRetention);
+  fflush(stdout);
+  if (failures > 0) {
+    fprintf(stderr, "[host_sim] %d failed checks, the files are left in %s\n", failures, scratch);
+    return 1;
+  }
+  std::string cleanup = std::string("rm -rf ") + scratch;
+  return system(cleanup.c_str()) == 0 ? 0 : 1;
+}
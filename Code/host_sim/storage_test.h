@@ -0,0 +1,19 @@
+/**
+ * storage_test.h
+ *
+ * Checks of the sketch's SD card modules on a scratch directory, see storage_test.cpp.
+ *
+ * Author: John Leung
+ * Date: October 16, 2026
+ */
+#ifndef HOST_SIM_STORAGE_TEST_H
+#define HOST_SIM_STORAGE_TEST_H
+
+/**
+ * @brief Runs the checks selected by simConfig.storageTest ("all" or the name of one module) and prints one line per
+ *        failed check and a PASS or FAIL line per module on stdout.
+ * @return 0 if every check passed.
+ */
+int runStorageTest();
+
+#endif
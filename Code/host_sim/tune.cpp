@@ -0,0 +1,247 @@
+/**
+ * tune.cpp
+ *
+ * Tunes lowerMoistureThreshold, upperMoistureThreshold, pumpOnTime and pumpSoakTime of the sketch without waiting days on
+ * real plants. The sketch's own water_pump_control.cpp (pumpZoneUpdate(), which starts a cycle as startWaterPumpCycle()
+ * does, and manageWaterPumpCycle()) runs against a soil-water model on the stepped virtual clock: nothing sleeps, the
+ * clock jumps from one event (a sensor reading, a pump timer) to the next, so a month takes well under a second. Each point of the parameter grid runs in its
+ * own forked process, which gives it fresh static state in the controller, and the runs are spread over the cores.
+ *
+ * Soil-water model, in percent of the root zone's volume:
+ * - The pump fills a surface store, which reaches the root zone with a time constant (infiltration lag).
+ * - Above field capacity, the excess drains away below the roots (lost water).
+ * - Evapotranspiration follows the sun (zero at night) and falls off as the soil dries towards the wilting point.
+ * - The probe follows the root zone with its own lag, and each reading has Gaussian noise.
+ *
+ * The same model checks the gain that watering_model.cpp learns from the waterings (--model-test).
+ *
+ * Author: John Leung
+ * Date: October 16, 2026
+ */
+#include "tune.h"
+#include "Arduino.h"
+#include "water_pump_control.h"
+#include "watering_model.h"
+#include <random>
+#include <thread>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define FIELD_CAPACITY      45.0                // % above which the soil drains
+#define WILTING_POINT       10.0                // % at which the plant stops drawing water
+#define DRAINAGE_TAU_S      (6 * 3600.0)        // Time constant of the drainage above field capacity
+#define READ_INTERVAL_US    5000000LL           // sensorReadInterval of the sketch with ThingSpeak batching
+#define NOISE_SEED          20261016            // Same noise in every run, so that the runs differ only by the grid
+#define MODEL_GAIN_TOLERANCE 0.15               // Largest relative error of the learned gain that --model-test accepts
+
+typedef struct {
+  double lower, upper;
+  unsigned onMs, soakMs;
+} tune_point_t;
+
+typedef struct {
+  bool done;
+  uint32_t cycles;
+  double pumpS;             // Relay ON time
+  double belowH, aboveH;    // Time of the root zone below and above the band
+  double drained;           // Water lost below the roots, % of the root zone
+  double minMoisture, maxMoisture;
+} tune_result_t;
+
+typedef struct {
+  double surface;           // Water on its way to the root zone
+  double rootZone;          // Moisture of the root zone, the plant's water
+  double probe;             // What the probe sees, lagging the root zone
+} soil_t;
+
+//-----------------------LOCAL FUNCTIONS--------------------------
+
+static std::vector<double> rangeValues(const SimRange& range) {
+  std::vector<double> values;
+  for (double v = range.first; v <= range.last + 1e-9 && values.size() < 1000; v += range.step > 0 ? range.step : 1e9) {
+    values.push_back(v);
+  }
+  return values;
+}
+
+static std::vector<tune_point_t> gridPoints() {
+  std::vector<tune_point_t> points;
+  for (double lower : rangeValues(simConfig.gridLower)) {
+    for (double upper : rangeValues(simConfig.gridUpper)) {
+      if (upper < lower) {
+        continue;
+      }
+      for (double onMs : rangeValues(simConfig.gridOnMs)) {
+        for (double soakMs : rangeValues(simConfig.gridSoakMs)) {
+          points.push_back({lower, upper, (unsigned)onMs, (unsigned)soakMs});
+        }
+      }
+    }
+  }
+  return points;
+}
+
+/**
+ * @brief Fraction of the day's evapotranspiration at this time of day: a half sine from 6:00 to 18:00, mean 1 over 24 h.
+ */
+static double sunFactor(int64_t nowUs) {
+  double hour = fmod(nowUs / 3600e6, 24.0);
+  return hour < 6 || hour > 18 ? 0 : M_PI * sin(M_PI * (hour - 6) / 12);
+}
+
+/**
+ * @brief Moves the soil from t0 to t1 with the relay state constant in between, and adds up the results.
+ */
+static void soilStep(soil_t& soil, int64_t t0, int64_t t1, bool pumpOn, tune_result_t& result) {
+  double dt = (t1 - t0) / 1e6;
+  if (dt <= 0) {
+    return;
+  }
+  soil.surface += pumpOn ? simConfig.wateringPerSecond * dt : 0;
+  double infiltrated = soil.surface * (1 - exp(-dt / simConfig.infiltrationS));
+  soil.surface -= infiltrated;
+  soil.rootZone += infiltrated;
+  if (soil.rootZone > FIELD_CAPACITY) {
+    double drained = (soil.rootZone - FIELD_CAPACITY) * (1 - exp(-dt / DRAINAGE_TAU_S));
+    soil.rootZone -= drained;
+    result.drained += drained;
+  }
+  double stress = constrain((soil.rootZone - WILTING_POINT) / (FIELD_CAPACITY / 2 - WILTING_POINT), 0.0, 1.0);
+  soil.rootZone -= simConfig.etPerDay / 86400.0 * sunFactor(t0) * stress * dt;
+  soil.rootZone = std::max(0.0, soil.rootZone);
+  soil.probe += (soil.rootZone - soil.probe) * (1 - exp(-dt / simConfig.sensorLagS));
+
+  result.pumpS += pumpOn ? dt : 0;
+  result.belowH += soil.rootZone < simConfig.bandLow ? dt / 3600 : 0;
+  result.aboveH += soil.rootZone > simConfig.bandHigh ? dt / 3600 : 0;
+  result.minMoisture = std::min(result.minMoisture, soil.rootZone);
+  result.maxMoisture = std::max(result.maxMoisture, soil.rootZone);
+}
+
+/**
+ * @brief One run: the probe's readings go to the zone every 5 s as in the sketch's loop(), the pump is driven by the
+ *        sketch's code. Runs in a fresh child process on the stepped clock.
+ */
+static void simulate(const tune_point_t& point, tune_result_t& result) {
+  simSteppedUs = 0;
+  simConfig.quiet = true;
+  const pump_zone_t zone = {simConfig.relayPin, (uint8_t)point.lower, (uint8_t)point.upper, point.onMs, point.soakMs};
+  pumpZonesBegin(&zone, 1, 1);
+  wateringModelBegin(&zone, 1, simConfig.tunePredictive ? WATERING_PREDICTIVE : WATERING_HYSTERESIS);
+  pumpZonesSetDoseFunction(wateringModelDose);
+
+  std::mt19937 rng(NOISE_SEED);
+  std::normal_distribution<double> noise(0, simConfig.sensorNoise);
+  soil_t soil = {0, simConfig.soilMoisture, simConfig.soilMoisture};
+  result = {false, 0, 0, 0, 0, 0, soil.rootZone, soil.rootZone};
+  int64_t endUs = (int64_t)(simConfig.tuneDays * 86400e6);
+  int64_t now = 0, nextReadUs = 0;
+  bool pumpOn = false;
+  while (now < endUs) {
+    int64_t next = std::min(std::min(nextReadUs, simNextTimerUs()), endUs);
+    soilStep(soil, now, next, pumpOn, result);
+    simAdvanceToUs(next); // The pump timers switch the relay here
+    now = next;
+    if (now >= nextReadUs) {
+      nextReadUs += READ_INTERVAL_US;
+      uint8_t moistureValue = (uint8_t)constrain(lround(soil.probe + noise(rng)), 0L, 100L);
+      wateringModelAddReading(0, moistureValue);
+      pumpZoneUpdate(0, moistureValue);
+    }
+    manageWaterPumpCycle();
+    bool relay = digitalRead(simConfig.relayPin) == HIGH;
+    result.cycles += relay && !pumpOn;
+    pumpOn = relay;
+  }
+  result.done = true;
+}
+
+static void printResult(const tune_point_t& point, const tune_result_t& result) {
+  double hours = simConfig.tuneDays * 24;
+  printf("%.0f,%.0f,%u,%u,%u,%.0f,%.0f,%.1f,%.1f,%.2f,%.1f,%.1f,%.1f\n", point.lower, point.upper, point.onMs,
+         point.soakMs, result.cycles, result.pumpS, result.pumpS * simConfig.pumpFlowMlPerS, result.belowH,
+         result.aboveH, 100 * (result.belowH + result.aboveH) / hours, result.drained, result.minMoisture,
+         result.maxMoisture);
+}
+
+//-----------------------API FUNCTIONS--------------------------
+
+int runTuning() {
+  std::vector<tune_point_t> points = gridPoints();
+  if (points.empty()) {
+    fprintf(stderr, "[host_sim] The parameter grid is empty\n");
+    return 2;
+  }
+  unsigned jobs = simConfig.tuneJobs > 0 ? simConfig.tuneJobs : std::max(1U, std::thread::hardware_concurrency());
+  // The children write their results straight into this shared array
+  size_t bytes = points.size() * sizeof(tune_result_t);
+  tune_result_t* results = (tune_result_t*)mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (results == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+  memset(results, 0, bytes);
+  fprintf(stderr, "[host_sim] %zu runs of %.0f virtual days, %u at a time\n", points.size(), simConfig.tuneDays, jobs);
+  fflush(stdout);
+  fflush(stderr);
+
+  auto start = std::chrono::steady_clock::now();
+  unsigned running = 0;
+  for (size_t i = 0; i < points.size() || running > 0;) {
+    if (i < points.size() && running < jobs) {
+      pid_t pid = fork();
+      if (pid == 0) {
+        simulate(points[i], results[i]);
+        _exit(0);
+      }
+      if (pid < 0) {
+        perror("fork");
+        return 1;
+      }
+      running++;
+      i++;
+    } else {
+      wait(NULL);
+      running--;
+    }
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  printf("lower_pct,upper_pct,on_ms,soak_ms,cycles,pump_s,water_ml,below_band_h,above_band_h,out_of_band_pct,"
+         "drained_pct,min_pct,max_pct\n");
+  size_t failed = 0;
+  for (size_t i = 0; i < points.size(); i++) {
+    if (results[i].done) {
+      printResult(points[i], results[i]);
+    } else {
+      failed++;
+    }
+  }
+  fflush(stdout);
+  fprintf(stderr, "[host_sim] %.0f virtual days in %.2f s (%.0f days per second)%s\n",
+          simConfig.tuneDays * (points.size() - failed), seconds, simConfig.tuneDays * (points.size() - failed) / seconds,
+          failed > 0 ? ", some runs failed" : "");
+  munmap(results, bytes);
+  return failed > 0 ? 1 : 0;
+}
+
+int runModelTest() {
+  // The sketch's defaults, the first value of each grid range
+  tune_point_t point = {simConfig.gridLower.first, simConfig.gridUpper.first, (unsigned)simConfig.gridOnMs.first,
+                        (unsigned)simConfig.gridSoakMs.first};
+  simConfig.tuneDays = simConfig.modelTestDays;
+  tune_result_t result;
+  simulate(point, result);
+
+  // Below field capacity all the water pumped reaches the root zone, so the gain to learn is the pump's wateringPerSecond
+  WateringEstimate estimate = wateringModelGetEstimate(0);
+  double error = fabs(estimate.gain - simConfig.wateringPerSecond) / simConfig.wateringPerSecond;
+  bool ok = estimate.cycles >= WATERING_MODEL_MIN_CYCLES && error <= MODEL_GAIN_TOLERANCE;
+  printf("%s controller, %.0f days, %u waterings: %u observations learned, %u discarded, gain %.2f %%/s "
+         "(soil %.2f %%/s, error %.0f %%), response %.0f s -> %s\n",
+         simConfig.tunePredictive ? "Predictive" : "Hysteresis", simConfig.modelTestDays, result.cycles,
+         estimate.cycles, estimate.discarded, estimate.gain, simConfig.wateringPerSecond, 100 * error,
+         estimate.responseS, ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,26 @@
+/**
+ * tune.h
+ *
+ * Faster-than-real-time tuning of the sketch's watering controller, see tune.cpp.
+ *
+ * Author: John Leung
+ * Date: October 16, 2026
+ */
+#ifndef HOST_SIM_TUNE_H
+#define HOST_SIM_TUNE_H
+
+/**
+ * @brief Runs the controller against the soil-water model for simConfig.tuneDays at every point of the parameter grid,
+ *        simConfig.tuneJobs runs at a time, and writes one CSV line per point on stdout.
+ * @return 0 on success.
+ */
+int runTuning();
+
+/**
+ * @brief Runs the sketch's default pump parameters against the soil-water model for simConfig.modelTestDays and checks
+ *        that watering_model.cpp has learned the soil's gain, within 15 %, from the waterings of the --controller mode.
+ * @return 0 if the estimate has converged, 1 otherwise.
+ */
+int runModelTest();
+
+#endif
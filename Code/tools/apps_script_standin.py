@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""
+apps_script_standin.py
+
+A local stand-in for the Google Apps Script Web App used by google_drive.cpp.
+It accepts both the base64 text body and the multipart/form-data body with the raw JPEG as its file part.
+It answers the upload exactly like script.google.com does: the POST is answered with a
+302 redirect, and the GET to the redirect location returns the JSON status and image URL.
+Received images are decoded and saved to the output folder so they can be checked.
+
+Usage:
+    python3 apps_script_standin.py --port 8080 --out ./received
+
+Then set webAppUrl in the sketch to "http://<PC_IP_ADDRESS>:8080/exec" and watch the
+"Google Drive POST: ... bytes in ... ms, peak heap use ... bytes" lines on the Serial Monitor.
+"""
+
+import argparse
+import base64
+import binascii
+import json
+import os
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+results = {}
+
+
+def multipart_file(body, content_type):
+    """Returns the bytes of the first part of a multipart/form-data body."""
+    boundary = content_type.split("boundary=")[-1].strip('"').encode()
+    part = body.split(b"--" + boundary)[1]
+    headers, _, data = part.partition(b"\r\n\r\n")
+    if not data.endswith(b"\r\n"):
+        raise ValueError("multipart part is not terminated")
+    return data[:-2]
+
+
+class StandInHandler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def do_POST(self):
+        start = time.time()
+        length = int(self.headers.get("Content-Length", 0))
+        body = self.rfile.read(length)
+        elapsed = time.time() - start
+
+        try:
+            content_type = self.headers.get("Content-Type", "")
+            if content_type.startswith("multipart/form-data"):
+                image = multipart_file(body, content_type)  # DRIVE_UPLOAD_BINARY: the raw JPEG bytes
+            else:
+                image = base64.b64decode(body, validate=True)
+            name = time.strftime("%Y%m%d-%H%M%S") + ".jpg"
+            with open(os.path.join(self.server.out_dir, name), "wb") as f:
+                f.write(image)
+            result = {"status": "success", "url": "https://drive.google.com/uc?export=view&id=" + name}
+        except (binascii.Error, ValueError) as err:
+            result = {"status": "error", "message": str(err)}
+
+        token = str(len(results))
+        results[token] = result
+        print("POST %d bytes (%s) received in %.3f s -> %s" %
+              (length, self.headers.get("Content-Type"), elapsed, result["status"]))
+
+        self.send_response(302)
+        self.send_header("Location", "%s://%s/result?token=%s" %
+                         (self.server.redirect_scheme, self.headers.get("Host"), token))
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+
+    def do_GET(self):
+        token = self.path.split("token=")[-1]
+        payload = json.dumps(results.pop(token, {"status": "error", "message": "unknown token"})).encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(payload)))
+        self.end_headers()
+        self.wfile.write(payload)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Local stand-in for the Google Apps Script image uploader")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--out", default="received")
+    parser.add_argument("--redirect-scheme", default="http",
+                        help="scheme of the redirect URL, https when reached through host_sim --tls-standin")
+    args = parser.parse_args()
+
+    os.makedirs(args.out, exist_ok=True)
+    server = ThreadingHTTPServer(("", args.port), StandInHandler)
+    server.out_dir = args.out
+    server.redirect_scheme = args.redirect_scheme
+    print("Apps Script stand-in listening on port %d, saving images to %s" % (args.port, args.out))
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+"""
+thingspeak_standin.py
+
+A local stand-in for ThingSpeak's bulk_update.json endpoint used by thingspeak_batch.cpp.
+It accepts POST /channels/<id>/bulk_update.json, checks the JSON body like ThingSpeak does
+(write_api_key, at most 960 updates, created_at on every update) and answers 202 Accepted.
+The single-reading POST /update of ThingSpeak.writeFields() is accepted too (host_sim build).
+Each bulk update is printed with its number of readings, time span and size, and the readings
+are appended to a CSV file so the sampling rate can be checked afterwards.
+
+Usage:
+    python3 thingspeak_standin.py --port 8081 --csv readings.csv
+
+Then call thingspeakBatchSetServer("http://<PC_IP_ADDRESS>:8081") before thingspeakBatchBegin()
+in the sketch. Use --fail-every N to answer every Nth request with 500 and check that the
+readings are kept and sent again with the next flush.
+"""
+
+import argparse
+import json
+import re
+import time
+from urllib.parse import parse_qs
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+MAX_UPDATES = 960
+PATH_PATTERN = re.compile(r"^/channels/(\d+)/bulk_update\.json$")
+
+
+class StandInHandler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def reply(self, code, payload):
+        data = json.dumps(payload).encode()
+        self.send_response(code)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+    def reply_update(self, body):
+        # ThingSpeak answers /update with the new entry number as plain text
+        form = parse_qs(body.decode(errors="replace"))
+        fields = {k: v[0] for k, v in form.items() if k.startswith("field")}
+        self.server.entries += 1
+        print("POST /update: %s" % ", ".join("%s=%s" % kv for kv in sorted(fields.items())))
+        if self.server.csv:
+            with open(self.server.csv, "a") as f:
+                f.write("%s,%s\n" % (time.strftime("%Y-%m-%dT%H:%M:%SZ", time.gmtime()),
+                                     ",".join("%s=%s" % kv for kv in sorted(fields.items()))))
+        data = str(self.server.entries).encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "text/plain")
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+    def do_POST(self):
+        length = int(self.headers.get("Content-Length", 0))
+        body = self.rfile.read(length)
+        if self.path == "/update":
+            self.reply_update(body)
+            return
+        match = PATH_PATTERN.match(self.path)
+        if match is None:
+            self.reply(404, {"error": "unknown path " + self.path})
+            return
+
+        self.server.requests += 1
+        if self.server.fail_every and self.server.requests % self.server.fail_every == 0:
+            print("POST #%d: failing on purpose" % self.server.requests)
+            self.reply(500, {"error": "simulated failure"})
+            return
+
+        try:
+            doc = json.loads(body)
+            updates = doc["updates"]
+            if not doc.get("write_api_key"):
+                raise ValueError("missing write_api_key")
+            if len(updates) == 0 or len(updates) > MAX_UPDATES:
+                raise ValueError("%d updates (1 to %d allowed)" % (len(updates), MAX_UPDATES))
+            for update in updates:
+                if "created_at" not in update:
+                    raise ValueError("update without created_at")
+        except (ValueError, KeyError, TypeError) as err:
+            print("POST #%d rejected: %s" % (self.server.requests, err))
+            self.reply(400, {"error": str(err)})
+            return
+
+        now = time.time()
+        gap = now - self.server.last_post if self.server.last_post else 0
+        self.server.last_post = now
+        with_url = sum(1 for u in updates if any(k != "created_at" and u[k].startswith("http") for k in u))
+        print("POST #%d channel %s: %d readings (%d with image URL) from %s to %s, %d bytes, %.1f s since last" %
+              (self.server.requests, match.group(1), len(updates), with_url,
+               updates[0]["created_at"], updates[-1]["created_at"], length, gap))
+
+        if self.server.csv:
+            with open(self.server.csv, "a") as f:
+                for update in updates:
+                    fields = ",".join("%s=%s" % (k, v) for k, v in sorted(update.items()) if k != "created_at")
+                    f.write("%s,%s\n" % (update["created_at"], fields))
+
+        self.reply(202, {"success": True})
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Local stand-in for the ThingSpeak bulk update endpoint")
+    parser.add_argument("--port", type=int, default=8081)
+    parser.add_argument("--csv", default="", help="append the received readings to this file")
+    parser.add_argument("--fail-every", type=int, default=0, help="answer every Nth request with 500")
+    args = parser.parse_args()
+
+    server = ThreadingHTTPServer(("", args.port), StandInHandler)
+    server.csv = args.csv
+    server.fail_every = args.fail_every
+    server.requests = 0
+    server.entries = 0
+    server.last_post = 0
+    print("ThingSpeak stand-in listening on port %d" % args.port)
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()